@@ -1,65 +1,47 @@
 #!/usr/bin/env python3
 import serial
-import time
+
+from gateway_serial import GatewaySerial, GatewayError
 
 PORT = 'COM7'
 BAUD = 115200
 
 print(f"Connecting to {PORT}...")
 try:
-    with serial.Serial(PORT, BAUD, timeout=2) as ser:
-        time.sleep(2)  # Wait for connection
-        
-        # Clear any existing data
-        ser.reset_input_buffer()
-        
-        # Send 's' command to show statistics
-        print("\nSending 's' command to show status...")
-        ser.write(b's\n')
-        time.sleep(1)
-        
-        # Read all available data
+    with GatewaySerial(PORT, BAUD) as gw:
+        stats = gw.stats()
+
         print("\n" + "="*60)
         print("GATEWAY STATUS:")
         print("="*60)
-        
-        lines_read = 0
-        timeout_counter = 0
-        while timeout_counter < 30:  # Read for 3 seconds
-            if ser.in_waiting:
-                try:
-                    line = ser.readline().decode('utf-8', errors='ignore').strip()
-                    if line:
-                        print(line)
-                        lines_read += 1
-                        timeout_counter = 0  # Reset timeout when we get data
-                except Exception as e:
-                    pass
-            else:
-                time.sleep(0.1)
-                timeout_counter += 1
-        
+        print(f"Uptime:            {stats['uptime']} s")
+        print(f"Radio:             {'up' if stats['radio'] else 'NOT INITIALIZED'}")
+        print(f"Packets Received:  {stats['packetsReceived']}")
+        print(f"Packets Sent:      {stats['packetsSent']}")
+        print(f"Packets Forwarded: {stats['packetsForwarded']}")
+        print(f"Packets Failed:    {stats['packetsFailed']}")
+        print(f"Free Heap:         {stats['freeHeap']} bytes")
+        link = stats.get('link')
+        if link:
+            print(f"Uplink State:      {link['state']} ({link['sessions']} sessions)")
+            print(f"WiFi RSSI:         {stats['rssi']} dBm")
+            queue = stats['queue']
+            print(f"Uplink Queue:      {queue['depth']} queued, {queue['dropped']} dropped")
+        else:
+            print("Uplink:            MQTT disabled")
+        frame = stats['frameUs']
+        print(f"Frame Handling:    p50 {frame['p50']} us, p99 {frame['p99']} us ({frame['n']} frames)")
+        for stage, p in stats.get('pipeline', {}).items():
+            print(f"  {stage:<16} p50 {p['p50']} us, p99 {p['p99']} us, max {p['max']} us ({p['n']})")
         print("="*60)
-        print(f"\nRead {lines_read} lines from serial port")
-        
-        if lines_read == 0:
-            print("\nNo response received. Trying to read boot messages...")
-            ser.write(b'\n')
-            time.sleep(1)
-            while ser.in_waiting:
-                try:
-                    line = ser.readline().decode('utf-8', errors='ignore').strip()
-                    if line:
-                        print(line)
-                except:
-                    pass
 
-except serial.SerialException as e:
+except GatewayError as e:
+    print(f"Gateway error: {e}")
+except (serial.SerialException, TimeoutError) as e:
     print(f"Error: {e}")
     print("Make sure:")
-    print("  1. The device is plugged into COM7")
+    print(f"  1. The device is plugged into {PORT}")
     print("  2. No other serial monitors are open")
     print("  3. The device has power")
 except KeyboardInterrupt:
     print("\nAborted by user")
-
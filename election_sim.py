@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""Simulate several bridging gateways against a local MQTT broker.
+
+Each simulated gateway follows the firmware's bridging election: it announces its rank on
+{prefix}/bridge/rank, holds every bridged frame for FALLBACK_MS per better-ranked live
+peer, drops it if a claim for the same frame key arrives on {prefix}/bridge/claim, and
+otherwise "transmits" it and publishes its own claim. A publisher then injects frames on
+{prefix}/raw and the script reports how many times each frame went on air.
+
+Usage: python3 election_sim.py [--broker localhost] [--gateways 4] [--frames 50] [--kill-best]
+Requires: pip install paho-mqtt
+"""
+import argparse
+import json
+import random
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+FALLBACK_MS = 1500
+PREFIX = 'MESHCORE/SIM'
+
+
+def make_client(client_id):
+    # paho-mqtt 2.x requires the callback API version up front
+    if hasattr(mqtt, 'CallbackAPIVersion'):
+        return mqtt.Client(mqtt.CallbackAPIVersion.VERSION1, client_id=client_id)
+    return mqtt.Client(client_id=client_id)
+
+
+def frame_key(data):
+    # FNV-1a, identical to BridgeElection::frameKey
+    h = 2166136261
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h or 1
+
+
+class SimGateway:
+    def __init__(self, gw_id, rank, broker, port):
+        self.id = gw_id
+        self.rank = rank
+        self.peers = {}
+        self.claims = set()
+        self.transmitted = []
+        self.fallbacks = 0
+        self.suppressed = 0
+        self.alive = True
+        self.lock = threading.Lock()
+        self.client = make_client(gw_id)
+        self.client.on_message = self.on_message
+        self.client.connect(broker, port)
+        self.client.subscribe(PREFIX + '/raw')
+        self.client.subscribe(PREFIX + '/bridge/+')
+        self.client.loop_start()
+
+    def announce(self):
+        self.client.publish(PREFIX + '/bridge/rank', json.dumps({'gateway': self.id, 'rank': self.rank}))
+
+    def position(self):
+        return sum(1 for pid, r in self.peers.items() if r > self.rank or (r == self.rank and pid < self.id))
+
+    def on_message(self, client, userdata, msg):
+        if not self.alive:
+            return
+        body = json.loads(msg.payload)
+        if body.get('gateway') == self.id:
+            return
+        with self.lock:
+            if msg.topic.endswith('/bridge/rank'):
+                self.peers[body['gateway']] = body['rank']
+                return
+            if msg.topic.endswith('/bridge/claim'):
+                self.claims.add(body['key'])
+                return
+            data = bytes.fromhex(body['data'])
+            key = frame_key(data)
+            if key in self.claims:
+                self.suppressed += 1
+                return
+            position = self.position()
+        threading.Timer(position * FALLBACK_MS / 1000.0, self.service, args=(key, position)).start()
+
+    def service(self, key, position):
+        with self.lock:
+            if not self.alive:
+                return
+            if key in self.claims:
+                self.suppressed += 1
+                return
+            self.claims.add(key)
+            self.transmitted.append(key)
+            if position > 0:
+                self.fallbacks += 1
+        self.client.publish(PREFIX + '/bridge/claim', json.dumps({'gateway': self.id, 'key': key}))
+
+    def stop(self):
+        self.alive = False
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Bridging election simulator')
+    ap.add_argument('--broker', default='localhost')
+    ap.add_argument('--port', type=int, default=1883)
+    ap.add_argument('--gateways', type=int, default=4)
+    ap.add_argument('--frames', type=int, default=50)
+    ap.add_argument('--kill-best', action='store_true', help='silence the best-ranked gateway halfway through')
+    args = ap.parse_args()
+
+    gateways = [SimGateway('sim-gw%d' % i, random.randint(100, 400), args.broker, args.port)
+                for i in range(args.gateways)]
+    time.sleep(0.5)
+    for g in gateways:
+        g.announce()
+    time.sleep(0.5)
+    best = max(gateways, key=lambda g: (g.rank, [-ord(c) for c in g.id]))
+    print('Ranks: ' + ', '.join('%s=%d' % (g.id, g.rank) for g in gateways))
+    print('Expected winner: %s' % best.id)
+
+    source = make_client('sim-source')
+    source.connect(args.broker, args.port)
+    source.loop_start()
+    keys = []
+    for n in range(args.frames):
+        if args.kill_best and n == args.frames // 2:
+            print('Silencing %s' % best.id)
+            best.stop()
+        data = bytes(random.getrandbits(8) for _ in range(24))
+        keys.append(frame_key(data))
+        source.publish(PREFIX + '/raw', json.dumps({'gateway': 'sim-source', 'data': data.hex()}))
+        time.sleep(0.2)
+    time.sleep(args.gateways * FALLBACK_MS / 1000.0 + 1.0)
+
+    on_air = {k: 0 for k in keys}
+    for g in gateways:
+        for k in g.transmitted:
+            on_air[k] = on_air.get(k, 0) + 1
+    print('-' * 60)
+    for g in gateways:
+        print('%-10s rank %3d  tx %3d  fallbacks %3d  suppressed %3d' %
+              (g.id, g.rank, len(g.transmitted), g.fallbacks, g.suppressed))
+    missed = sum(1 for v in on_air.values() if v == 0)
+    dupes = sum(1 for v in on_air.values() if v > 1)
+    print('-' * 60)
+    print('Frames: %d  transmitted once: %d  duplicated: %d  never sent: %d' %
+          (len(keys), len(keys) - missed - dupes, dupes, missed))
+    for g in gateways:
+        if g.alive:
+            g.stop()
+    source.loop_stop()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Watch a gateway's uplink across two brokers while one of them is killed.
+
+Run two local brokers (e.g. `mosquitto -p 1883` and `mosquitto -p 1884`), point the gateway at
+the first as its primary server and at the second as broker 2 (fanout or standby mode), then
+start this script. After --kill-after seconds it runs --kill-cmd (e.g. "pkill -f 'mosquitto -p 1883'")
+and keeps counting. It reports how many of the gateway's messages reached each broker and the
+longest gap with nothing arriving on either, which in standby mode is the failover time.
+
+Usage: python3 failover_watch.py --gateway MyNode [--primary localhost:1883] [--secondary localhost:1884]
+                                 [--prefix MESHCORE] [--kill-after 30] [--kill-cmd "..."] [--duration 90]
+Requires: pip install paho-mqtt
+"""
+import argparse
+import json
+import subprocess
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+
+def make_client(client_id):
+    # paho-mqtt 2.x requires the callback API version up front
+    if hasattr(mqtt, 'CallbackAPIVersion'):
+        return mqtt.Client(mqtt.CallbackAPIVersion.VERSION1, client_id=client_id)
+    return mqtt.Client(client_id=client_id)
+
+
+class BrokerWatch:
+    def __init__(self, label, address, prefix, gateway, lock, arrivals):
+        host, _, port = address.partition(':')
+        self.label = label
+        self.gateway = gateway
+        self.count = 0
+        self.lock = lock
+        self.arrivals = arrivals
+        self.client = make_client('failover-watch-' + label)
+        self.client.on_message = self.on_message
+        self.client.connect(host, int(port or 1883))
+        self.client.subscribe(prefix + '/#')
+        self.client.loop_start()
+
+    def on_message(self, client, userdata, msg):
+        # Only count traffic from the gateway under test (status/stats topics carry its id)
+        from_gateway = ('/' + self.gateway + '/') in msg.topic
+        if not from_gateway:
+            try:
+                from_gateway = json.loads(msg.payload).get('gateway') == self.gateway
+            except (ValueError, AttributeError):
+                return
+        if not from_gateway:
+            return
+        with self.lock:
+            self.count += 1
+            self.arrivals.append((time.time(), self.label))
+
+    def stop(self):
+        try:
+            self.client.loop_stop()
+            self.client.disconnect()
+        except Exception:
+            pass
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Multi-broker failover watcher')
+    ap.add_argument('--gateway', required=True, help='gateway client id (node name)')
+    ap.add_argument('--primary', default='localhost:1883')
+    ap.add_argument('--secondary', default='localhost:1884')
+    ap.add_argument('--prefix', default='MESHCORE')
+    ap.add_argument('--kill-after', type=float, default=30.0)
+    ap.add_argument('--kill-cmd', default='', help='shell command that stops the primary broker')
+    ap.add_argument('--duration', type=float, default=90.0)
+    args = ap.parse_args()
+
+    lock = threading.Lock()
+    arrivals = []
+    watches = [BrokerWatch('primary', args.primary, args.prefix, args.gateway, lock, arrivals),
+               BrokerWatch('secondary', args.secondary, args.prefix, args.gateway, lock, arrivals)]
+    start = time.time()
+    killed_at = None
+    while time.time() - start < args.duration:
+        if killed_at is None and args.kill_cmd and time.time() - start >= args.kill_after:
+            print('Stopping primary: %s' % args.kill_cmd)
+            subprocess.call(args.kill_cmd, shell=True)
+            killed_at = time.time()
+        time.sleep(1.0)
+        with lock:
+            print('t=%5.1fs  primary %4d  secondary %4d' %
+                  (time.time() - start, watches[0].count, watches[1].count))
+
+    with lock:
+        times = [t for t, _ in arrivals]
+    gaps = [b - a for a, b in zip(times, times[1:])]
+    print('-' * 60)
+    for w in watches:
+        print('%-9s %d messages' % (w.label, w.count))
+    if gaps:
+        print('Longest gap with no uplink: %.1fs' % max(gaps))
+    if killed_at is not None:
+        after = [t for t in times if t > killed_at]
+        if after:
+            print('First message after the kill: %.1fs' % (after[0] - killed_at))
+        else:
+            print('No messages after the kill')
+    for w in watches:
+        w.stop()
+
+
+if __name__ == '__main__':
+    main()
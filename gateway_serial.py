@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+Client for the gateway's scripted serial commands.
+
+Lines starting with '@' are commands (get, set, save, stats, neighbours, help); each one is
+answered by a single "@OK {json}" or "@ERR {json}" line. Everything else on the port (live
+activity, boot messages) is skipped, so no sleeps are needed between commands.
+
+    with GatewaySerial('COM7') as gw:
+        gw.set(**{'wifi.ssid': 'My Network', 'lora.frequency': 915.8})
+        gw.save()
+        print(gw.stats()['packetsReceived'])
+"""
+import json
+import time
+
+import serial
+
+
+class GatewayError(Exception):
+    """The gateway answered @ERR"""
+
+    def __init__(self, reply):
+        self.reply = reply
+        message = reply.get('error', 'error')
+        if 'key' in reply:
+            message += f" ({reply['key']})"
+        super().__init__(message)
+
+
+def quote(value):
+    """Render a value for a set command"""
+    if isinstance(value, bool):
+        return 'true' if value else 'false'
+    text = str(value)
+    if text == '' or any(c in text for c in ' \t"\\'):
+        return '"' + text.replace('\\', '\\\\').replace('"', '\\"') + '"'
+    return text
+
+
+class GatewaySerial:
+    def __init__(self, port, baud=115200, timeout=10.0):
+        self.timeout = timeout
+        self.ser = serial.Serial(port, baud, timeout=0.2)
+        self.ser.reset_input_buffer()
+        self.wait_ready()
+
+    def wait_ready(self):
+        """Opening the port resets most boards; probe until the console answers"""
+        deadline = time.time() + self.timeout
+        while time.time() < deadline:
+            try:
+                return self.command('help', timeout=1.0)
+            except TimeoutError:
+                pass
+        raise TimeoutError('gateway console did not answer')
+
+    def close(self):
+        self.ser.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def command(self, line, timeout=None):
+        """Send one command line and return the decoded @OK body; raises GatewayError on @ERR"""
+        self.ser.write(('@' + line + '\n').encode())
+        deadline = time.time() + (timeout or self.timeout)
+        while time.time() < deadline:
+            raw = self.ser.readline()
+            if not raw:
+                continue
+            text = raw.decode('utf-8', errors='replace').strip()
+            if text.startswith('@OK '):
+                return json.loads(text[4:])
+            if text.startswith('@ERR '):
+                raise GatewayError(json.loads(text[5:]))
+        raise TimeoutError(f"no reply to '{line}'")
+
+    def get(self, *keys):
+        return self.command(' '.join(('get',) + keys))
+
+    def set(self, **values):
+        pairs = ' '.join(f'{key}={quote(value)}' for key, value in values.items())
+        return self.command('set ' + pairs, timeout=30.0)
+
+    def save(self):
+        return self.command('save')
+
+    def stats(self):
+        return self.command('stats --json')
+
+    def neighbours(self):
+        return self.command('neighbours --json')['neighbors']
+
+    def restart(self):
+        """Single-key 'r'; the gateway reboots without a reply"""
+        self.ser.write(b'r')
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Measure the gateway's broker reconnects phase by phase: full against resumed TLS handshakes.
+
+Run a local TLS broker (e.g. mosquitto with a listener on 8883) and point the gateway's MQTT
+server at this machine's --listen port, with TLS on and the broker's CA loaded. The script
+forwards that port to the broker and every round cuts the forwarded connection. The broker
+itself keeps running, so its session tickets stay valid and the gateway's next connect can
+resume. After each reconnect it reads the stats over the serial console and records
+link.reconnect (DNS, TCP, TLS, CONNECT and SUBSCRIBE times).
+
+Usage: python3 reconnect_bench.py --serial /dev/ttyUSB0 [--listen 8884] [--broker localhost:8883]
+                                  [--rounds 20] [--settle 3]
+Requires: pip install pyserial
+"""
+import argparse
+import socket
+import statistics
+import threading
+import time
+
+from gateway_serial import GatewaySerial
+
+PHASES = ('dnsMs', 'tcpMs', 'tlsMs', 'connectMs', 'subscribeMs', 'totalMs')
+
+
+class CuttableProxy:
+    """TCP forwarder whose open connections can be dropped on demand"""
+
+    def __init__(self, listen_port, broker_host, broker_port):
+        self.target = (broker_host, broker_port)
+        self.server = socket.create_server(('', listen_port), reuse_port=False)
+        self.lock = threading.Lock()
+        self.open = []
+        self.accepted = 0
+        threading.Thread(target=self.accept_loop, daemon=True).start()
+
+    def accept_loop(self):
+        while True:
+            client, _ = self.server.accept()
+            try:
+                upstream = socket.create_connection(self.target, timeout=5)
+            except OSError:
+                client.close()
+                continue
+            upstream.settimeout(None)
+            with self.lock:
+                self.open.append((client, upstream))
+                self.accepted += 1
+            threading.Thread(target=self.pump, args=(client, upstream), daemon=True).start()
+            threading.Thread(target=self.pump, args=(upstream, client), daemon=True).start()
+
+    @staticmethod
+    def pump(src, dst):
+        try:
+            while True:
+                data = src.recv(4096)
+                if not data:
+                    break
+                dst.sendall(data)
+        except OSError:
+            pass
+        for s in (src, dst):
+            try:
+                s.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+
+    def cut(self):
+        with self.lock:
+            pairs, self.open = self.open, []
+        for pair in pairs:
+            for s in pair:
+                try:
+                    s.shutdown(socket.SHUT_RDWR)
+                    s.close()
+                except OSError:
+                    pass
+        return len(pairs)
+
+
+def wait_for_session(gw, after, timeout):
+    """Poll the stats until link.sessions passes `after`; returns the link object"""
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        link = gw.stats().get('link', {})
+        if link.get('sessions', 0) > after and link.get('state') == 'online':
+            return link
+        time.sleep(0.5)
+    return None
+
+
+def summarise(label, rows):
+    if not rows:
+        return
+    print(f"\n{label} ({len(rows)} reconnects), ms")
+    print(f"  {'phase':<12} {'median':>8} {'mean':>8} {'max':>8}")
+    for phase in PHASES:
+        values = [r[phase] for r in rows]
+        print(f"  {phase:<12} {statistics.median(values):>8.0f} {statistics.mean(values):>8.0f} {max(values):>8}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--serial', required=True, help='gateway serial port')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--listen', type=int, default=8884, help='port the gateway connects to')
+    parser.add_argument('--broker', default='localhost:8883', help='TLS broker host:port')
+    parser.add_argument('--rounds', type=int, default=20)
+    parser.add_argument('--settle', type=float, default=3.0, help='seconds to stay connected between cuts')
+    parser.add_argument('--timeout', type=float, default=120.0, help='seconds to wait for each reconnect')
+    args = parser.parse_args()
+
+    host, _, port = args.broker.rpartition(':')
+    proxy = CuttableProxy(args.listen, host or 'localhost', int(port))
+    print(f"Forwarding :{args.listen} -> {args.broker}; waiting for the gateway to connect...")
+
+    rows = []
+    with GatewaySerial(args.serial, args.baud) as gw:
+        link = wait_for_session(gw, 0, args.timeout)
+        if link is None:
+            print("✗ The gateway never connected through the proxy; check its MQTT server and port")
+            return 1
+        print(f"{'round':>5} {'dns':>6} {'tcp':>6} {'tls':>6} {'conn':>6} {'sub':>6} {'total':>7}  flags")
+        for n in range(1, args.rounds + 1):
+            time.sleep(args.settle)
+            sessions = link.get('sessions', 0)
+            proxy.cut()
+            link = wait_for_session(gw, sessions, args.timeout)
+            if link is None:
+                print(f"{n:>5} ✗ no reconnect within {args.timeout:.0f} s")
+                continue
+            rc = link.get('reconnect', {})
+            rows.append(rc)
+            flags = ' '.join(name for key, name in (('dnsCached', 'dns-cached'), ('tlsResumed', 'tls-resumed'),
+                                                     ('sessionResumed', 'mqtt-session')) if rc.get(key))
+            print(f"{n:>5} {rc.get('dnsMs', 0):>6} {rc.get('tcpMs', 0):>6} {rc.get('tlsMs', 0):>6} "
+                  f"{rc.get('connectMs', 0):>6} {rc.get('subscribeMs', 0):>6} {rc.get('totalMs', 0):>7}  {flags}")
+        tls = link.get('tls', {}) if link else {}
+
+    summarise('Full TLS handshake', [r for r in rows if not r.get('tlsResumed')])
+    summarise('Resumed TLS session', [r for r in rows if r.get('tlsResumed')])
+    if tls:
+        print(f"\nGateway TLS counters: {tls.get('full', 0)} full (avg {tls.get('fullAvgMs', 0)} ms), "
+              f"{tls.get('resumed', 0)} resumed (avg {tls.get('resumedAvgMs', 0)} ms), suite {tls.get('suite', '?')}")
+    print(f"Connections through the proxy: {proxy.accepted}")
+    return 0
+
+
+if __name__ == '__main__':
+    raise SystemExit(main())
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""
+Capture the gateway's binary sniffer stream into a pcap file.
+
+Switches the gateway into sniffer mode ('@sniff on <baud>'), decodes the COBS-framed RX/TX
+records (layout in src/sniffer.h) and writes them as LoRaTap frames (link type 270), which
+Wireshark opens directly. Ctrl-C switches the gateway back to the normal console.
+
+    python3 sniffer_capture.py COM7 capture.pcap
+    python3 sniffer_capture.py /dev/ttyUSB0 capture.pcap --baud 2000000 --tx
+    python3 sniffer_capture.py --raw dump.bin capture.pcap      # decode a saved byte stream
+
+Needs pyserial for live capture (pip install pyserial).
+"""
+import argparse
+import struct
+import sys
+import time
+
+LINKTYPE_LORATAP = 270
+CONSOLE_BAUD = 115200
+
+RECORD_INFO, RECORD_RX, RECORD_TX = 0, 1, 2
+FLAG_CRC_ERROR, FLAG_TX_FAILED, FLAG_CLOCK_SET = 0x01, 0x02, 0x04
+HEADER = struct.Struct('<BBHQ')
+PACKET = struct.Struct('<hhH')
+INFO = struct.Struct('<IIBBBbqII')
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as snifferCrc16()"""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    """One frame without its 0x00 delimiter; None if malformed"""
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    """Splits a byte stream on 0x00 and yields decoded records; anything else is counted as noise"""
+
+    def __init__(self):
+        self.pending = bytearray()
+        self.bad = 0
+        self.text = []
+
+    def feed(self, data):
+        self.pending += data
+        while True:
+            end = self.pending.find(b'\x00')
+            if end < 0:
+                return
+            frame = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            if not frame:
+                continue
+            record = cobs_decode(frame)
+            if record is None or len(record) < HEADER.size + 2 or crc16(record[:-2]) != struct.unpack('<H', record[-2:])[0]:
+                # Console text between frames (replies, messages not routed through the log)
+                printable = frame.decode('utf-8', errors='replace').strip()
+                if printable.startswith('@') or '\n' in printable:
+                    self.text += [line for line in printable.splitlines() if line.strip()]
+                else:
+                    self.bad += 1
+                continue
+            yield record[:-2]
+
+
+class PcapWriter:
+    def __init__(self, path):
+        self.file = open(path, 'wb')
+        self.file.write(struct.pack('<IHHiIII', 0xA1B2C3D4, 2, 4, 0, 0, 65535, LINKTYPE_LORATAP))
+
+    def write(self, when_us, info, rssi, snr, payload):
+        # LoRaTap v0: version, padding, length (BE), frequency (Hz, BE), bandwidth (125 kHz
+        # steps), SF, packet/max/current RSSI (-139 dBm offset), SNR (0.25 dB), sync word
+        bw_steps = max(1, round(info['bandwidthHz'] / 125000)) if info else 0
+        rssi_byte = max(0, min(255, rssi + 139))
+        tap = struct.pack('>BBHIBBBBBbB', 0, 0, 15, info['frequencyHz'] if info else 0, bw_steps,
+                          info['sf'] if info else 0, rssi_byte, rssi_byte, rssi_byte,
+                          max(-128, min(127, snr)), info['syncWord'] if info else 0)
+        data = tap + payload
+        self.file.write(struct.pack('<IIII', when_us // 1000000, when_us % 1000000, len(data), len(data)))
+        self.file.write(data)
+
+    def close(self):
+        self.file.close()
+
+
+class Capture:
+    def __init__(self, pcap, include_tx):
+        self.pcap = pcap
+        self.include_tx = include_tx
+        self.info = None
+        self.anchor = None          # (uptimeUs, host unix us) when the device clock is unsynced
+        self.expected_seq = None
+        self.counts = {'rx': 0, 'crc': 0, 'tx': 0, 'gaps': 0, 'lost': 0}
+
+    def wall_clock(self, uptime_us):
+        if self.info and self.info['offset']:
+            return uptime_us + self.info['offset']
+        if self.anchor is None:
+            self.anchor = (uptime_us, int(time.time() * 1e6))
+        return self.anchor[1] + (uptime_us - self.anchor[0])
+
+    def record(self, record):
+        kind, flags, seq, uptime_us = HEADER.unpack_from(record)
+        if self.expected_seq is not None and seq != self.expected_seq:
+            missed = (seq - self.expected_seq) & 0xFFFF
+            self.counts['gaps'] += 1
+            self.counts['lost'] += missed
+            print(f"! {missed} record(s) missing before #{seq}")
+        self.expected_seq = (seq + 1) & 0xFFFF
+        body = record[HEADER.size:]
+
+        if kind == RECORD_INFO:
+            freq, bw, sf, cr, sync, power, offset, node, dropped = INFO.unpack_from(body)
+            self.info = {'frequencyHz': freq, 'bandwidthHz': bw, 'sf': sf, 'syncWord': sync,
+                         'offset': offset if flags & FLAG_CLOCK_SET else 0}
+            print(f"# node {node:08X}  {freq / 1e6:.3f} MHz  BW {bw / 1e3:g} kHz  SF{sf}  CR4/{cr}  "
+                  f"sync 0x{sync:02X}  {power} dBm  clock {'UTC' if offset else 'unsynced'}  "
+                  f"{dropped} dropped on device")
+            return
+
+        rssi, snr_q, length = PACKET.unpack_from(body)
+        payload = body[PACKET.size:PACKET.size + length]
+        when = self.wall_clock(uptime_us)
+        if kind == RECORD_RX:
+            self.counts['crc' if flags & FLAG_CRC_ERROR else 'rx'] += 1
+            mark = 'RX CRC!' if flags & FLAG_CRC_ERROR else 'RX'
+            print(f"{uptime_us / 1e6:12.6f} {mark:8} {length:3} B  RSSI {rssi:4} dBm  SNR {snr_q / 4:5.2f} dB  "
+                  f"{payload[:24].hex()}{'...' if length > 24 else ''}")
+            self.pcap.write(when, self.info, rssi, snr_q, payload)
+        elif kind == RECORD_TX:
+            self.counts['tx'] += 1
+            mark = 'TX FAIL' if flags & FLAG_TX_FAILED else 'TX'
+            print(f"{uptime_us / 1e6:12.6f} {mark:8} {length:3} B  {payload[:24].hex()}{'...' if length > 24 else ''}")
+            if self.include_tx:
+                self.pcap.write(when, self.info, 0, 0, payload)
+
+
+def wait_reply(ser, timeout=3.0):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        line = ser.readline().decode('utf-8', errors='replace').strip()
+        if line.startswith('@OK') or line.startswith('@ERR'):
+            return line
+    return None
+
+
+def live(args, capture, decoder):
+    import serial
+    ser = serial.Serial(args.port, CONSOLE_BAUD, timeout=0.2)
+    time.sleep(0.1)
+    ser.reset_input_buffer()
+    # Opening the port may reset the board; retry until the console answers
+    reply = None
+    deadline = time.time() + 15
+    while reply is None and time.time() < deadline:
+        ser.write(f'@sniff on {args.baud}\n'.encode())
+        reply = wait_reply(ser, 1.0)
+    if not reply or not reply.startswith('@OK'):
+        sys.exit(f"gateway did not enter sniffer mode: {reply}")
+    ser.flush()
+    ser.baudrate = args.baud
+    raw = open(args.save_raw, 'wb') if args.save_raw else None
+    print(f"Capturing at {args.baud} baud into {args.pcap}, Ctrl-C to stop")
+    started = time.time()
+    try:
+        while not args.duration or time.time() - started < args.duration:
+            data = ser.read(4096)
+            if raw:
+                raw.write(data)
+            for record in decoder.feed(data):
+                capture.record(record)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        ser.write(b'\n@sniff off\n')
+        reply = wait_reply(ser)
+        ser.baudrate = CONSOLE_BAUD
+        if raw:
+            raw.close()
+        ser.close()
+        if reply:
+            print(f"Gateway back on the console: {reply}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('port', nargs='?', help='serial port of the gateway')
+    parser.add_argument('pcap', help='capture file to write')
+    parser.add_argument('--baud', type=int, default=921600, help='stream rate (default 921600)')
+    parser.add_argument('--tx', action='store_true', help='also write transmitted frames to the pcap')
+    parser.add_argument('--duration', type=float, default=0, help='stop after this many seconds')
+    parser.add_argument('--raw', help='decode a saved byte stream instead of a serial port')
+    parser.add_argument('--save-raw', help='also keep the undecoded byte stream')
+    args = parser.parse_args()
+    if not args.port and not args.raw:
+        parser.error('give a serial port or --raw FILE')
+
+    pcap = PcapWriter(args.pcap)
+    capture = Capture(pcap, args.tx)
+    decoder = Decoder()
+    try:
+        if args.raw:
+            with open(args.raw, 'rb') as f:
+                for record in decoder.feed(f.read()):
+                    capture.record(record)
+        else:
+            live(args, capture, decoder)
+    finally:
+        pcap.close()
+
+    c = capture.counts
+    print(f"\n{c['rx']} RX, {c['crc']} RX with CRC errors, {c['tx']} TX; "
+          f"{c['lost']} records lost in {c['gaps']} gaps, {decoder.bad} unreadable frames")
+    for line in decoder.text:
+        print(f"  console: {line}")
+
+
+if __name__ == '__main__':
+    main()
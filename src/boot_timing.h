@@ -0,0 +1,86 @@
+#ifndef BOOT_TIMING_H
+#define BOOT_TIMING_H
+
+// Start-up split into phases, each timed from the end of the previous one, plus the two moments
+// that matter operationally: when the radio first listens (time-to-first-RX) and when the first
+// broker session comes up. setup() runs the radio phase before the console and the uplink, and
+// WiFi, NTP and TLS proceed from loop(), so RF repeating does not wait on the network. The
+// caller reads the clock and passes the times in.
+
+#include <stdint.h>
+#include <string.h>
+
+enum BootPhase : uint8_t {
+    BOOT_PHASE_SERIAL,      // core start-up to setup(), serial port
+    BOOT_PHASE_SETTINGS,    // NVS load, first-boot defaults and IDs
+    BOOT_PHASE_RADIO,       // SPI, modem init, startReceive
+    BOOT_PHASE_UPLINK,      // MQTT handler created; the connection itself continues from loop()
+    BOOT_PHASE_CONSOLE,     // banner, menu, command help
+    BOOT_PHASE_COUNT
+};
+
+inline const char* bootPhaseName(uint8_t phase) {
+    switch (phase) {
+        case BOOT_PHASE_SERIAL: return "serial";
+        case BOOT_PHASE_SETTINGS: return "settings";
+        case BOOT_PHASE_RADIO: return "radio";
+        case BOOT_PHASE_UPLINK: return "uplink";
+        case BOOT_PHASE_CONSOLE: return "console";
+    }
+    return "?";
+}
+
+// Names for esp_reset_reason_t values
+inline const char* resetReasonName(int reason) {
+    switch (reason) {
+        case 1: return "power-on";
+        case 2: return "external";
+        case 3: return "software";
+        case 4: return "panic";
+        case 5: return "interrupt watchdog";
+        case 6: return "task watchdog";
+        case 7: return "watchdog";
+        case 8: return "deep sleep";
+        case 9: return "brownout";
+        case 10: return "SDIO";
+    }
+    return "unknown";
+}
+
+struct BootReport {
+    uint32_t phaseUs[BOOT_PHASE_COUNT];
+    uint32_t rxReadyUs;     // since start-up when the radio first entered RX, 0 if it has not
+    uint32_t uplinkMs;      // since start-up when the first broker session came up, 0 if not yet
+    uint8_t resetReason;    // esp_reset_reason_t
+};
+
+class BootTimer {
+public:
+    BootTimer() : mark(0) { memset(&report, 0, sizeof(report)); }
+
+    // Close a phase at nowUs (micros() since start-up); the first phase starts at 0
+    void end(BootPhase phase, uint32_t nowUs) {
+        report.phaseUs[phase] = nowUs - mark;
+        mark = nowUs;
+    }
+
+    void noteRxReady(uint32_t nowUs) {
+        if (report.rxReadyUs == 0) report.rxReadyUs = nowUs;
+    }
+
+    void noteUplink(uint32_t nowMs) {
+        if (report.uplinkMs == 0) report.uplinkMs = nowMs;
+    }
+
+    void setResetReason(int reason) { report.resetReason = (uint8_t)reason; }
+
+    uint32_t totalUs() const { return mark; }
+
+    const BootReport& get() const { return report; }
+
+private:
+    BootReport report;
+    uint32_t mark;
+};
+
+#endif // BOOT_TIMING_H
@@ -0,0 +1,292 @@
+#ifndef BRIDGE_DECODER_H
+#define BRIDGE_DECODER_H
+
+// Single-pass decoder for bridged MQTT payloads ({prefix}/raw, /messages, /adverts).
+// Instead of building a JsonDocument, one scan over the top-level object records where the
+// few fields we use start and end. The publishing gateway is compared as soon as its key is
+// seen, so our own echoes are rejected without decoding anything else. Tested and benchmarked
+// on the host (test/test_bridge_decoder.cpp, bench_bridge_decoder.cpp).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+// Largest LoRa frame the radio will transmit
+#define BRIDGE_FRAME_MAX 255
+
+enum BridgeField : uint8_t {
+    BF_GATEWAY,
+    BF_DATA,
+    BF_MESSAGE,
+    BF_NODE_ID,
+    BF_NAME,
+    BF_LAT,
+    BF_LON,
+    BF_CAPTURED_AGE,
+    BF_RANK,            // election announcements
+    BF_KEY,             // election claims
+    BF_COUNT
+};
+
+enum BridgeScanResult : uint8_t {
+    BRIDGE_OK,
+    BRIDGE_SELF,        // published by this gateway
+    BRIDGE_MALFORMED
+};
+
+// Raw value location inside the payload. Strings exclude the quotes and keep escapes.
+struct JsonSpan {
+    const char* p;
+    uint16_t len;
+    bool isString;
+};
+
+struct BridgeFields {
+    JsonSpan f[BF_COUNT];
+    bool has(BridgeField id) const { return f[id].p != nullptr; }
+    const JsonSpan& operator[](BridgeField id) const { return f[id]; }
+};
+
+namespace bridge_detail {
+
+inline const char* skipWs(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+    return p;
+}
+
+// p points just past the opening quote; returns the closing quote or nullptr
+inline const char* endOfString(const char* p, const char* end) {
+    while (p < end) {
+        if (*p == '\\') {
+            p += 2;
+            continue;
+        }
+        if (*p == '"') return p;
+        ++p;
+    }
+    return nullptr;
+}
+
+// Skip any JSON value; returns the first character after it or nullptr if malformed
+inline const char* skipValue(const char* p, const char* end) {
+    if (p >= end) return nullptr;
+    if (*p == '"') {
+        const char* q = endOfString(p + 1, end);
+        return q ? q + 1 : nullptr;
+    }
+    if (*p == '{' || *p == '[') {
+        // Nested containers are never needed; count depth and skip strings inside
+        int depth = 0;
+        while (p < end) {
+            char c = *p;
+            if (c == '"') {
+                p = endOfString(p + 1, end);
+                if (!p) return nullptr;
+            } else if (c == '{' || c == '[') {
+                if (++depth > 32) return nullptr;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) return p + 1;
+            }
+            ++p;
+        }
+        return nullptr;
+    }
+    // number, true, false, null
+    const char* start = p;
+    while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+           *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+        ++p;
+    }
+    return p > start ? p : nullptr;
+}
+
+inline int fieldForKey(const char* k, size_t n) {
+    switch (n) {
+        case 3:
+            if (memcmp(k, "lat", 3) == 0) return BF_LAT;
+            if (memcmp(k, "lon", 3) == 0) return BF_LON;
+            if (memcmp(k, "key", 3) == 0) return BF_KEY;
+            break;
+        case 4:
+            if (memcmp(k, "data", 4) == 0) return BF_DATA;
+            if (memcmp(k, "name", 4) == 0) return BF_NAME;
+            if (memcmp(k, "rank", 4) == 0) return BF_RANK;
+            break;
+        case 6:
+            if (memcmp(k, "nodeId", 6) == 0) return BF_NODE_ID;
+            break;
+        case 7:
+            if (memcmp(k, "gateway", 7) == 0) return BF_GATEWAY;
+            if (memcmp(k, "message", 7) == 0) return BF_MESSAGE;
+            break;
+        case 13:
+            if (memcmp(k, "capturedAgeMs", 13) == 0) return BF_CAPTURED_AGE;
+            break;
+    }
+    return -1;
+}
+
+inline int hexNibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return 10 + c - 'a';
+    if (c >= 'A' && c <= 'F') return 10 + c - 'A';
+    return -1;
+}
+
+} // namespace bridge_detail
+
+// Scan the top-level object once. selfId may be nullptr to disable the echo check.
+inline BridgeScanResult bridgeScan(const char* json, size_t len, const char* selfId, BridgeFields& out) {
+    using namespace bridge_detail;
+    memset(&out, 0, sizeof(out));
+    const char* end = json + len;
+    const char* p = skipWs(json, end);
+    if (p >= end || *p != '{') return BRIDGE_MALFORMED;
+    p = skipWs(p + 1, end);
+    if (p < end && *p == '}') return BRIDGE_OK;
+    size_t selfLen = selfId ? strlen(selfId) : 0;
+    while (p < end) {
+        if (*p != '"') return BRIDGE_MALFORMED;
+        const char* key = p + 1;
+        const char* keyEnd = endOfString(key, end);
+        if (!keyEnd) return BRIDGE_MALFORMED;
+        p = skipWs(keyEnd + 1, end);
+        if (p >= end || *p != ':') return BRIDGE_MALFORMED;
+        p = skipWs(p + 1, end);
+        const char* valueStart = p;
+        p = skipValue(p, end);
+        if (!p) return BRIDGE_MALFORMED;
+        int field = fieldForKey(key, (size_t)(keyEnd - key));
+        if (field >= 0 && out.f[field].p == nullptr) {
+            JsonSpan& s = out.f[field];
+            s.isString = *valueStart == '"';
+            s.p = s.isString ? valueStart + 1 : valueStart;
+            size_t n = (size_t)(p - valueStart) - (s.isString ? 2 : 0);
+            if (n > 0xFFFF) return BRIDGE_MALFORMED;
+            s.len = (uint16_t)n;
+            if (field == BF_GATEWAY && selfLen && s.isString &&
+                s.len == selfLen && memcmp(s.p, selfId, selfLen) == 0) {
+                return BRIDGE_SELF;
+            }
+        }
+        p = skipWs(p, end);
+        if (p < end && *p == ',') {
+            p = skipWs(p + 1, end);
+            continue;
+        }
+        if (p < end && *p == '}') return BRIDGE_OK;
+        return BRIDGE_MALFORMED;
+    }
+    return BRIDGE_MALFORMED;
+}
+
+// Decode a hex string span into out; returns the byte count or -1 if invalid/too long
+inline int bridgeHexDecode(const JsonSpan& s, uint8_t* out, size_t cap) {
+    if (!s.p || !s.isString || s.len == 0 || (s.len & 1) || s.len / 2 > cap) return -1;
+    for (size_t i = 0; i < s.len; i += 2) {
+        int hi = bridge_detail::hexNibble(s.p[i]);
+        int lo = bridge_detail::hexNibble(s.p[i + 1]);
+        if (hi < 0 || lo < 0) return -1;
+        out[i / 2] = (uint8_t)((hi << 4) | lo);
+    }
+    return (int)(s.len / 2);
+}
+
+// Unescape a JSON string span into out (UTF-8, not NUL-terminated unless room allows).
+// Returns the byte count or -1 if the escape sequence is invalid or out is too small.
+inline int bridgeUnescape(const JsonSpan& s, char* out, size_t cap) {
+    if (!s.p || !s.isString) return -1;
+    size_t o = 0;
+    for (size_t i = 0; i < s.len; ++i) {
+        char c = s.p[i];
+        if (c != '\\') {
+            if (o >= cap) return -1;
+            out[o++] = c;
+            continue;
+        }
+        if (++i >= s.len) return -1;
+        char e = s.p[i];
+        char lit = 0;
+        switch (e) {
+            case '"': lit = '"'; break;
+            case '\\': lit = '\\'; break;
+            case '/': lit = '/'; break;
+            case 'b': lit = '\b'; break;
+            case 'f': lit = '\f'; break;
+            case 'n': lit = '\n'; break;
+            case 'r': lit = '\r'; break;
+            case 't': lit = '\t'; break;
+            case 'u': {
+                uint32_t cp = 0;
+                for (int k = 0; k < 4; ++k) {
+                    if (++i >= s.len) return -1;
+                    int n = bridge_detail::hexNibble(s.p[i]);
+                    if (n < 0) return -1;
+                    cp = (cp << 4) | (uint32_t)n;
+                }
+                // Combine a surrogate pair when the low half follows
+                if (cp >= 0xD800 && cp <= 0xDBFF && i + 6 < s.len && s.p[i + 1] == '\\' && s.p[i + 2] == 'u') {
+                    uint32_t lo = 0;
+                    bool ok = true;
+                    for (int k = 0; k < 4; ++k) {
+                        int n = bridge_detail::hexNibble(s.p[i + 3 + k]);
+                        if (n < 0) { ok = false; break; }
+                        lo = (lo << 4) | (uint32_t)n;
+                    }
+                    if (ok && lo >= 0xDC00 && lo <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        i += 6;
+                    }
+                }
+                uint8_t tmp[4];
+                size_t n;
+                if (cp < 0x80) { tmp[0] = (uint8_t)cp; n = 1; }
+                else if (cp < 0x800) { tmp[0] = (uint8_t)(0xC0 | (cp >> 6)); tmp[1] = (uint8_t)(0x80 | (cp & 0x3F)); n = 2; }
+                else if (cp < 0x10000) { tmp[0] = (uint8_t)(0xE0 | (cp >> 12)); tmp[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F)); tmp[2] = (uint8_t)(0x80 | (cp & 0x3F)); n = 3; }
+                else { tmp[0] = (uint8_t)(0xF0 | (cp >> 18)); tmp[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F)); tmp[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F)); tmp[3] = (uint8_t)(0x80 | (cp & 0x3F)); n = 4; }
+                if (o + n > cap) return -1;
+                memcpy(out + o, tmp, n);
+                o += n;
+                continue;
+            }
+            default:
+                return -1;
+        }
+        if (o >= cap) return -1;
+        out[o++] = lit;
+    }
+    return (int)o;
+}
+
+// Numbers are copied to a small buffer so strtoul/strtod never read past the span
+inline bool bridgeParseU32(const JsonSpan& s, uint32_t& out) {
+    char buf[16];
+    if (!s.p || s.isString || s.len == 0 || s.len >= sizeof(buf)) return false;
+    memcpy(buf, s.p, s.len);
+    buf[s.len] = '\0';
+    char* endp = nullptr;
+    unsigned long v = strtoul(buf, &endp, 10);
+    if (endp != buf + s.len) return false;
+    out = (uint32_t)v;
+    return true;
+}
+
+inline bool bridgeParseDouble(const JsonSpan& s, double& out) {
+    char buf[32];
+    if (!s.p || s.isString || s.len == 0 || s.len >= sizeof(buf)) return false;
+    memcpy(buf, s.p, s.len);
+    buf[s.len] = '\0';
+    char* endp = nullptr;
+    double v = strtod(buf, &endp);
+    if (endp != buf + s.len) return false;
+    out = v;
+    return true;
+}
+
+struct BridgeFrame {
+    uint8_t data[BRIDGE_FRAME_MAX];
+    uint16_t length;
+};
+
+#endif // BRIDGE_DECODER_H
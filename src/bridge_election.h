@@ -0,0 +1,184 @@
+#ifndef BRIDGE_ELECTION_H
+#define BRIDGE_ELECTION_H
+
+// Coordination between gateways that bridge the same region from MQTT to RF.
+// Each gateway periodically announces a rank derived from how well it hears the mesh.
+// For every bridged frame the best-ranked live gateway transmits at once and publishes a
+// claim keyed by the frame's hash; the others hold the frame for fallbackMs per gateway
+// ranked ahead of them and drop it if a claim arrives first. If the winner is offline or
+// its claim is lost, the next gateway in line transmits instead. Times are passed in, so
+// test/test_bridge_election.cpp runs whole elections on a virtual clock.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define ELECTION_MAX_PEERS 8
+#define ELECTION_ID_BYTES 32
+#define ELECTION_ANNOUNCE_MS 30000UL
+#define ELECTION_PEER_TTL_MS (3 * ELECTION_ANNOUNCE_MS)   // peers missing 3 announcements drop out
+#define ELECTION_CLAIM_SLOTS 32
+#define ELECTION_CLAIM_TTL_MS 60000UL
+
+struct BridgeElectionStats {
+    uint32_t transmitted;     // frames this gateway put on air
+    uint32_t fallbacks;       // ...of which after a better-ranked peer stayed silent
+    uint32_t suppressed;      // frames dropped because a peer claimed them
+    uint16_t rank;
+    uint8_t position;         // live peers ranked ahead of us
+    uint8_t peers;            // live peers
+};
+
+class BridgeElection {
+public:
+    BridgeElection() : ownRank(0), snrAvg(0.0f), samples(0), claimNext(0),
+                       transmitted(0), fallbacks(0), suppressed(0) {
+        selfId[0] = '\0';
+        memset(peers, 0, sizeof(peers));
+        memset(claims, 0, sizeof(claims));
+    }
+
+    void setSelf(const char* id) {
+        strncpy(selfId, id ? id : "", sizeof(selfId) - 1);
+        selfId[sizeof(selfId) - 1] = '\0';
+    }
+
+    // Feed every RF reception; rank follows a moving average of SNR (0 = hears nothing)
+    void noteRfSample(float snr) {
+        snrAvg = samples == 0 ? snr : snrAvg * 0.9f + snr * 0.1f;
+        if (samples < 0xFFFF) samples++;
+        float r = (snrAvg + 30.0f) * 10.0f;
+        ownRank = r < 1.0f ? 1 : (r > 65535.0f ? 65535 : (uint16_t)r);
+    }
+
+    uint16_t rank() const { return ownRank; }
+
+    void notePeer(const char* id, size_t len, uint16_t peerRank, unsigned long nowMs) {
+        if (len >= ELECTION_ID_BYTES) len = ELECTION_ID_BYTES - 1;
+        int match = -1;
+        int victim = -1;   // free entry, otherwise the stalest peer
+        for (size_t i = 0; i < ELECTION_MAX_PEERS; ++i) {
+            const Peer& p = peers[i];
+            if (p.used && p.idLen == len && memcmp(p.id, id, len) == 0) {
+                match = (int)i;
+                break;
+            }
+            if (!p.used) {
+                if (victim < 0 || peers[victim].used) victim = (int)i;
+            } else if (victim < 0 || (peers[victim].used &&
+                                      nowMs - p.lastSeenMs > nowMs - peers[victim].lastSeenMs)) {
+                victim = (int)i;
+            }
+        }
+        Peer& p = peers[match >= 0 ? match : victim];
+        if (match < 0) {
+            p.used = true;
+            p.idLen = (uint8_t)len;
+            memcpy(p.id, id, len);
+            p.id[len] = '\0';
+        }
+        p.rank = peerRank;
+        p.lastSeenMs = nowMs;
+    }
+
+    // Live peers that beat us: higher rank, or equal rank and a smaller gateway id
+    uint8_t position(unsigned long nowMs) const {
+        uint8_t ahead = 0;
+        for (size_t i = 0; i < ELECTION_MAX_PEERS; ++i) {
+            const Peer& p = peers[i];
+            if (!isLive(p, nowMs)) continue;
+            if (p.rank > ownRank || (p.rank == ownRank && strcmp(p.id, selfId) < 0)) ahead++;
+        }
+        return ahead;
+    }
+
+    // How long to hold a frame before transmitting it ourselves
+    unsigned long holdoffMs(unsigned long nowMs, uint16_t fallbackMs) const {
+        return (unsigned long)position(nowMs) * fallbackMs;
+    }
+
+    void noteClaim(uint32_t key, unsigned long nowMs) {
+        for (size_t i = 0; i < ELECTION_CLAIM_SLOTS; ++i) {
+            if (claims[i].key == key && nowMs - claims[i].atMs < ELECTION_CLAIM_TTL_MS) {
+                claims[i].atMs = nowMs;
+                return;
+            }
+        }
+        claims[claimNext].key = key;
+        claims[claimNext].atMs = nowMs;
+        claimNext = (claimNext + 1) % ELECTION_CLAIM_SLOTS;
+    }
+
+    bool isClaimed(uint32_t key, unsigned long nowMs) const {
+        for (size_t i = 0; i < ELECTION_CLAIM_SLOTS; ++i) {
+            if (claims[i].atMs != 0 && claims[i].key == key &&
+                nowMs - claims[i].atMs < ELECTION_CLAIM_TTL_MS) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Outcome bookkeeping for the stats JSON
+    void noteTransmitted(bool wasFallback) {
+        transmitted++;
+        if (wasFallback) fallbacks++;
+    }
+
+    void noteSuppressed() { suppressed++; }
+
+    BridgeElectionStats getStats(unsigned long nowMs) const {
+        BridgeElectionStats s;
+        s.transmitted = transmitted;
+        s.fallbacks = fallbacks;
+        s.suppressed = suppressed;
+        s.rank = ownRank;
+        s.position = position(nowMs);
+        s.peers = 0;
+        for (size_t i = 0; i < ELECTION_MAX_PEERS; ++i) {
+            if (isLive(peers[i], nowMs)) s.peers++;
+        }
+        return s;
+    }
+
+    // Packet identity shared by every gateway that receives the same MQTT message (FNV-1a)
+    static uint32_t frameKey(const uint8_t* data, size_t len) {
+        uint32_t h = 2166136261UL;
+        for (size_t i = 0; i < len; ++i) {
+            h ^= data[i];
+            h *= 16777619UL;
+        }
+        return h ? h : 1;
+    }
+
+private:
+    struct Peer {
+        bool used;
+        uint8_t idLen;
+        uint16_t rank;
+        unsigned long lastSeenMs;
+        char id[ELECTION_ID_BYTES];
+    };
+
+    struct Claim {
+        uint32_t key;
+        unsigned long atMs;    // 0 = empty
+    };
+
+    char selfId[ELECTION_ID_BYTES];
+    uint16_t ownRank;
+    float snrAvg;
+    uint16_t samples;
+    Peer peers[ELECTION_MAX_PEERS];
+    Claim claims[ELECTION_CLAIM_SLOTS];
+    size_t claimNext;
+    uint32_t transmitted;
+    uint32_t fallbacks;
+    uint32_t suppressed;
+
+    static bool isLive(const Peer& p, unsigned long nowMs) {
+        return p.used && nowMs - p.lastSeenMs < ELECTION_PEER_TTL_MS;
+    }
+};
+
+#endif // BRIDGE_ELECTION_H
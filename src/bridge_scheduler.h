@@ -0,0 +1,226 @@
+#ifndef BRIDGE_SCHEDULER_H
+#define BRIDGE_SCHEDULER_H
+
+// Admission control and fair queuing for MQTT->RF bridged frames.
+// Every publishing gateway gets its own token bucket and a short FIFO; the transmitter
+// drains the FIFOs round-robin, so one chatty region cannot monopolise our airtime.
+// Frames live in a fixed pool owned by the scheduler; nothing is allocated per message.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "bridge_decoder.h"
+
+#define BRIDGE_MAX_SOURCES 16
+#define BRIDGE_SOURCE_ID_BYTES 32
+#define BRIDGE_QUEUE_FRAMES 16      // shared frame pool
+#define BRIDGE_QUEUE_PER_SOURCE 4   // per-source FIFO depth
+
+struct BridgeSourceStats {
+    char id[BRIDGE_SOURCE_ID_BYTES];
+    uint32_t accepted;
+    uint32_t sent;
+    uint32_t rateDropped;     // bucket empty
+    uint32_t queueDropped;    // FIFO or pool full
+    uint8_t queued;
+};
+
+class BridgeScheduler {
+public:
+    BridgeScheduler() : ratePerMin(0), burst(1), rrNext(0), poolInUse(0), tableFullDrops(0) {
+        memset(sources, 0, sizeof(sources));
+        memset(dueMs, 0, sizeof(dueMs));
+    }
+
+    // ratePerMin == 0 disables rate limiting (fair queuing still applies)
+    void setLimits(uint16_t framesPerMin, uint8_t burstFrames) {
+        ratePerMin = framesPerMin;
+        burst = burstFrames ? burstFrames : 1;
+        for (size_t i = 0; i < BRIDGE_MAX_SOURCES; ++i) {
+            if (sources[i].used && sources[i].tokens > burst) sources[i].tokens = burst;
+        }
+    }
+
+    // Reserve a frame for a message from sourceId (not NUL-terminated). Returns nullptr and
+    // counts a drop when the source is over its rate or its queue is full. The caller fills
+    // the frame, then calls commit() or abort().
+    BridgeFrame* admit(const char* sourceId, size_t idLen, unsigned long nowMs) {
+        int s = findOrAddSource(sourceId, idLen, nowMs);
+        if (s < 0) {
+            tableFullDrops++;
+            return nullptr;
+        }
+        Source& src = sources[s];
+        src.lastSeenMs = nowMs;
+        refill(src, nowMs);
+        if (ratePerMin > 0 && src.tokens < 1.0f) {
+            src.stats.rateDropped++;
+            return nullptr;
+        }
+        if (src.count >= BRIDGE_QUEUE_PER_SOURCE) {
+            src.stats.queueDropped++;
+            return nullptr;
+        }
+        int slot = acquireFrame();
+        if (slot < 0) {
+            src.stats.queueDropped++;
+            return nullptr;
+        }
+        if (ratePerMin > 0) src.tokens -= 1.0f;
+        pendingSource[slot] = (uint8_t)s;
+        frames[slot].length = 0;
+        return &frames[slot];
+    }
+
+    // notBeforeMs holds the frame back (e.g. while a better-placed gateway gets the first
+    // chance to transmit it); 0 makes it eligible immediately
+    void commit(BridgeFrame* frame, unsigned long notBeforeMs = 0) {
+        int slot = slotOf(frame);
+        if (slot < 0) return;
+        dueMs[slot] = notBeforeMs;
+        Source& src = sources[pendingSource[slot]];
+        src.fifo[(src.head + src.count) % BRIDGE_QUEUE_PER_SOURCE] = (uint8_t)slot;
+        src.count++;
+        src.stats.accepted++;
+    }
+
+    // Decoding failed: return the frame and refund the token
+    void abort(BridgeFrame* frame) {
+        int slot = slotOf(frame);
+        if (slot < 0) return;
+        Source& src = sources[pendingSource[slot]];
+        if (ratePerMin > 0 && src.tokens + 1.0f <= burst) src.tokens += 1.0f;
+        releaseFrame(slot);
+    }
+
+    // Next due frame in round-robin order across sources; call release() after transmitting.
+    // A held frame blocks only its own source's FIFO.
+    BridgeFrame* next(unsigned long nowMs) {
+        for (size_t k = 0; k < BRIDGE_MAX_SOURCES; ++k) {
+            size_t i = (rrNext + k) % BRIDGE_MAX_SOURCES;
+            Source& src = sources[i];
+            if (!src.used || src.count == 0) continue;
+            uint8_t slot = src.fifo[src.head];
+            if (dueMs[slot] != 0 && (long)(nowMs - dueMs[slot]) < 0) continue;
+            src.head = (uint8_t)((src.head + 1) % BRIDGE_QUEUE_PER_SOURCE);
+            src.count--;
+            src.stats.sent++;
+            rrNext = (i + 1) % BRIDGE_MAX_SOURCES;
+            return &frames[slot];
+        }
+        return nullptr;
+    }
+
+    void release(BridgeFrame* frame) {
+        int slot = slotOf(frame);
+        if (slot >= 0) releaseFrame(slot);
+    }
+
+    size_t queued() const {
+        size_t n = 0;
+        for (size_t i = 0; i < BRIDGE_MAX_SOURCES; ++i) n += sources[i].count;
+        return n;
+    }
+
+    // Copy per-source counters; returns the number of sources written
+    size_t getSources(BridgeSourceStats* out, size_t max) const {
+        size_t n = 0;
+        for (size_t i = 0; i < BRIDGE_MAX_SOURCES && n < max; ++i) {
+            if (!sources[i].used) continue;
+            out[n] = sources[i].stats;
+            out[n].queued = sources[i].count;
+            n++;
+        }
+        return n;
+    }
+
+    uint32_t totalDropped() const {
+        uint32_t n = tableFullDrops;
+        for (size_t i = 0; i < BRIDGE_MAX_SOURCES; ++i) {
+            n += sources[i].stats.rateDropped + sources[i].stats.queueDropped;
+        }
+        return n;
+    }
+
+private:
+    struct Source {
+        bool used;
+        uint8_t idLen;
+        float tokens;
+        unsigned long lastRefillMs;
+        unsigned long lastSeenMs;
+        uint8_t fifo[BRIDGE_QUEUE_PER_SOURCE];
+        uint8_t head;
+        uint8_t count;
+        BridgeSourceStats stats;   // stats.id doubles as the lookup key
+    };
+
+    Source sources[BRIDGE_MAX_SOURCES];
+    BridgeFrame frames[BRIDGE_QUEUE_FRAMES];
+    uint8_t pendingSource[BRIDGE_QUEUE_FRAMES];
+    unsigned long dueMs[BRIDGE_QUEUE_FRAMES];
+    uint16_t ratePerMin;
+    uint8_t burst;
+    size_t rrNext;
+    uint32_t poolInUse;
+    uint32_t tableFullDrops;
+
+    void refill(Source& src, unsigned long nowMs) {
+        if (ratePerMin == 0) return;
+        unsigned long elapsed = nowMs - src.lastRefillMs;
+        src.lastRefillMs = nowMs;
+        src.tokens += (float)elapsed * (float)ratePerMin / 60000.0f;
+        if (src.tokens > burst) src.tokens = burst;
+    }
+
+    // Unknown sources take a free entry, or evict the longest-idle source with nothing queued
+    int findOrAddSource(const char* id, size_t len, unsigned long nowMs) {
+        if (len >= BRIDGE_SOURCE_ID_BYTES) len = BRIDGE_SOURCE_ID_BYTES - 1;
+        int freeSlot = -1;
+        int idle = -1;
+        for (size_t i = 0; i < BRIDGE_MAX_SOURCES; ++i) {
+            Source& src = sources[i];
+            if (!src.used) {
+                if (freeSlot < 0) freeSlot = (int)i;
+                continue;
+            }
+            if (src.idLen == len && memcmp(src.stats.id, id, len) == 0) return (int)i;
+            if (src.count == 0 && (idle < 0 || nowMs - src.lastSeenMs > nowMs - sources[idle].lastSeenMs)) {
+                idle = (int)i;
+            }
+        }
+        int s = freeSlot >= 0 ? freeSlot : idle;
+        if (s < 0) return -1;
+        Source& src = sources[s];
+        memset(&src, 0, sizeof(src));
+        src.used = true;
+        src.idLen = (uint8_t)len;
+        memcpy(src.stats.id, id, len);
+        src.stats.id[len] = '\0';
+        src.tokens = burst;
+        src.lastRefillMs = nowMs;
+        return s;
+    }
+
+    int acquireFrame() {
+        for (int i = 0; i < BRIDGE_QUEUE_FRAMES; ++i) {
+            if (!(poolInUse & (1UL << i))) {
+                poolInUse |= (1UL << i);
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void releaseFrame(int slot) {
+        poolInUse &= ~(1UL << slot);
+    }
+
+    int slotOf(const BridgeFrame* frame) const {
+        if (!frame) return -1;
+        ptrdiff_t i = frame - frames;
+        return (i >= 0 && i < BRIDGE_QUEUE_FRAMES) ? (int)i : -1;
+    }
+};
+
+#endif // BRIDGE_SCHEDULER_H
@@ -0,0 +1,515 @@
+#ifndef BROKER_CLIENT_H
+#define BROKER_CLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClient.h>
+#include <new>
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_internal.h"     // mbedtls_ssl_handshake_params, for the resume flag
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl_ciphersuites.h"
+#include "mbedtls/ecp.h"
+#include "config.h"
+#include "cert_store.h"
+#include "latency_probe.h"
+#include "broker_resolver.h"
+
+// Broker connection used by both MQTT transports: a cached address lookup, a plain TCP
+// socket and, when enabled, TLS driven directly through mbedTLS. WiFiClientSecure performs
+// setup and handshake in one call, so it offers no way to offer a saved session; here the
+// session (ticket or session ID) from the last handshake is offered on the next connect to
+// the same host, turning a reconnect into an abbreviated handshake without certificate
+// verification or key exchange. Each connect records how long every phase took.
+//
+// The TLS profile trims what the client offers. Without hardware ECC the ESP32 spends most
+// of a full handshake in public-key operations: an ECDSA P-256 signature check and an
+// ECDHE P-256/X25519 exchange are far cheaper than RSA-2048 verification, and AES-GCM runs
+// on the AES accelerator. A smaller maximum fragment length (RFC 6066) caps record size in
+// both directions when the broker agrees to it; builds with variable-length buffers then
+// shrink the 16 KB input buffer after the handshake.
+
+#define BROKER_TCP_TIMEOUT_MS 5000
+#define BROKER_TLS_TIMEOUT_MS 10000UL
+#define BROKER_IO_TIMEOUT_MS 5000UL
+
+struct BrokerConnectTimings {
+    uint32_t dnsMs;
+    uint32_t tcpMs;
+    uint32_t tlsMs;
+    bool dnsCached;
+    bool tlsResumed;
+    int tlsError;          // last mbedTLS error, 0 if none
+};
+
+// Handshake counters since boot
+struct BrokerTlsStats {
+    uint32_t fullHandshakes;
+    uint32_t resumedHandshakes;
+    uint32_t failures;
+    uint32_t lastMs;
+    uint32_t fullAvgMs;
+    uint32_t fullMaxMs;
+    uint32_t resumedAvgMs;
+    uint32_t heapHeld;        // heap taken by the open TLS session (0 when none)
+    uint16_t recordPayload;   // largest plaintext per outgoing record for the open session
+    const char* suite;        // negotiated cipher suite of the last handshake
+};
+
+class BrokerClient : public Client {
+public:
+    BrokerClient() : useTls(false), insecure(false), caPem(nullptr), caSlot(-1), profile(DEFAULT_TLS_PROFILE),
+                     maxFragment(0), tls(nullptr), haveSession(false), sessionPort(0), peeked(-1),
+                     writeStalls(0), fullMsTotal(0), resumedMsTotal(0) {
+        host[0] = '\0';
+        sessionHost[0] = '\0';
+        memset(&timings, 0, sizeof(timings));
+        memset(&tlsStats, 0, sizeof(tlsStats));
+        tlsStats.suite = "";
+        mbedtls_ssl_session_init(&savedSession);
+    }
+
+    ~BrokerClient() {
+        stop();
+        mbedtls_ssl_session_free(&savedSession);
+    }
+
+    // Configuration is read at connect time
+    void setTls(bool enabled) { useTls = enabled; }
+    void setCACert(const char* pem) {
+        caPem = pem;
+        caSlot = -1;
+    }
+    // CA read from the certificate store at each handshake instead of a resident PEM
+    void setCASlot(uint8_t slot) {
+        caPem = nullptr;
+        caSlot = (int8_t)slot;
+    }
+    void setInsecure(bool skipVerify = true) { insecure = skipVerify; }
+    void setTlsProfile(uint8_t tlsProfile, uint16_t maxFragmentBytes) {
+        if (tlsProfile != profile || maxFragmentBytes != maxFragment) clearSession();
+        profile = tlsProfile;
+        maxFragment = maxFragmentBytes;
+    }
+
+    // Forget the saved session, e.g. after the CA or broker changed
+    void clearSession() {
+        mbedtls_ssl_session_free(&savedSession);
+        mbedtls_ssl_session_init(&savedSession);
+        haveSession = false;
+    }
+
+    const BrokerConnectTimings& lastTimings() const { return timings; }
+
+    BrokerTlsStats tlsStatistics() const {
+        BrokerTlsStats s = tlsStats;
+        s.fullAvgMs = s.fullHandshakes ? (uint32_t)(fullMsTotal / s.fullHandshakes) : 0;
+        s.resumedAvgMs = s.resumedHandshakes ? (uint32_t)(resumedMsTotal / s.resumedHandshakes) : 0;
+        if (!tls) {
+            s.heapHeld = 0;
+            s.recordPayload = 0;
+        }
+        return s;
+    }
+    BrokerResolver& resolver() { return dns; }
+
+    int connect(const char* hostName, uint16_t port) override {
+        stop();
+        memset(&timings, 0, sizeof(timings));
+        copyHost(hostName);
+        unsigned long t0 = millis();
+        IPAddress ip;
+        bool cached = false;
+        bool ok = dns.resolve(hostName, ip, cached);
+        timings.dnsMs = millis() - t0;
+        timings.dnsCached = cached;
+        if (!ok) return 0;
+        return open(ip, port);
+    }
+
+    int connect(IPAddress ip, uint16_t port) override {
+        stop();
+        memset(&timings, 0, sizeof(timings));
+        copyHost(ip.toString().c_str());
+        return open(ip, port);
+    }
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        uint32_t t0 = micros();
+        size_t done = writeRaw(buf, size);
+        uint32_t us = micros() - t0;
+        writeTimes.add(us);
+        if (us > LATENCY_WRITE_STALL_US) writeStalls++;
+        return done;
+    }
+
+    // Socket write durations, sampled on whichever task writes (the async I/O task or the
+    // main loop with PubSubClient); read without locking, so a sample may be torn
+    LatencyPercentiles writeLatency() const { return writeTimes.percentiles(); }
+    uint32_t writeStallCount() const { return writeStalls; }
+
+    size_t writeRaw(const uint8_t* buf, size_t size) {
+        if (!tls) return tcp.write(buf, size);
+        size_t done = 0;
+        unsigned long start = millis();
+        while (done < size) {
+            int ret = mbedtls_ssl_write(&tls->ssl, buf + done, size - done);
+            if (ret > 0) {
+                done += (size_t)ret;
+                continue;
+            }
+            if ((ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_WANT_READ) ||
+                millis() - start > BROKER_IO_TIMEOUT_MS) {
+                timings.tlsError = ret;
+                break;
+            }
+            delay(1);
+        }
+        return done;
+    }
+
+    int available() override {
+        if (!tls) return tcp.available();
+        size_t n = mbedtls_ssl_get_bytes_avail(&tls->ssl);
+        if (n == 0 && tcp.available() > 0) {
+            // Process the pending record so its plaintext becomes available
+            int ret = mbedtls_ssl_read(&tls->ssl, nullptr, 0);
+            if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+                timings.tlsError = ret;
+            }
+            n = mbedtls_ssl_get_bytes_avail(&tls->ssl);
+        }
+        return (int)n + (peeked >= 0 ? 1 : 0);
+    }
+
+    int read() override {
+        uint8_t b;
+        return read(&b, 1) == 1 ? b : -1;
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+        if (!tls) return tcp.read(buf, size);
+        if (size == 0) return 0;
+        size_t got = 0;
+        if (peeked >= 0) {
+            buf[got++] = (uint8_t)peeked;
+            peeked = -1;
+            if (got == size) return (int)got;
+        }
+        int ret = mbedtls_ssl_read(&tls->ssl, buf + got, size - got);
+        if (ret > 0) return (int)got + ret;
+        return got > 0 ? (int)got : -1;
+    }
+
+    int peek() override {
+        if (!tls) return tcp.peek();
+        if (peeked < 0) {
+            uint8_t b;
+            if (mbedtls_ssl_read(&tls->ssl, &b, 1) == 1) peeked = b;
+        }
+        return peeked;
+    }
+
+    void flush() override {
+        if (!tls) tcp.flush();
+    }
+
+    void stop() override {
+        if (tls) {
+            mbedtls_ssl_close_notify(&tls->ssl);
+            freeTls();
+        }
+        tcp.stop();
+        peeked = -1;
+    }
+
+    uint8_t connected() override {
+        if (tls && (peeked >= 0 || mbedtls_ssl_get_bytes_avail(&tls->ssl) > 0)) return 1;
+        return tcp.connected();
+    }
+
+    operator bool() override { return connected() != 0; }
+
+private:
+    // mbedTLS state exists only while a TLS session is open (~40 KB with default buffers)
+    struct TlsState {
+        mbedtls_ssl_context ssl;
+        mbedtls_ssl_config conf;
+        mbedtls_ctr_drbg_context drbg;
+        mbedtls_entropy_context entropy;
+        mbedtls_x509_crt ca;
+    };
+
+    WiFiClient tcp;
+    BrokerResolver dns;
+    bool useTls;
+    bool insecure;
+    const char* caPem;
+    int8_t caSlot;              // certificate store slot, -1 = use caPem
+    uint8_t profile;
+    uint16_t maxFragment;
+    TlsState* tls;
+    char host[BROKER_HOST_BYTES];
+    mbedtls_ssl_session savedSession;
+    bool haveSession;
+    char sessionHost[BROKER_HOST_BYTES];
+    uint16_t sessionPort;
+    int peeked;
+    BrokerConnectTimings timings;
+    BrokerTlsStats tlsStats;
+    LatencyWindow writeTimes;
+    volatile uint32_t writeStalls;
+    uint64_t fullMsTotal;
+    uint64_t resumedMsTotal;
+
+    void copyHost(const char* h) {
+        strncpy(host, h ? h : "", sizeof(host) - 1);
+        host[sizeof(host) - 1] = '\0';
+    }
+
+    int open(IPAddress ip, uint16_t port) {
+        unsigned long t0 = millis();
+        if (!tcp.connect(ip, port, BROKER_TCP_TIMEOUT_MS)) {
+            timings.tcpMs = millis() - t0;
+            dns.invalidate();   // the broker may have moved
+            return 0;
+        }
+        tcp.setNoDelay(true);
+        timings.tcpMs = millis() - t0;
+        if (!useTls) return 1;
+        t0 = millis();
+        uint32_t heapBefore = ESP.getFreeHeap();
+        bool ok = handshake(port);
+        timings.tlsMs = millis() - t0;
+        tlsStats.lastMs = timings.tlsMs;
+        if (!ok) {
+            tlsStats.failures++;
+            freeTls();
+            tcp.stop();
+            return 0;
+        }
+        if (timings.tlsResumed) {
+            tlsStats.resumedHandshakes++;
+            resumedMsTotal += timings.tlsMs;
+        } else {
+            tlsStats.fullHandshakes++;
+            fullMsTotal += timings.tlsMs;
+            if (timings.tlsMs > tlsStats.fullMaxMs) tlsStats.fullMaxMs = timings.tlsMs;
+        }
+        uint32_t heapAfter = ESP.getFreeHeap();
+        tlsStats.heapHeld = heapBefore > heapAfter ? heapBefore - heapAfter : 0;
+        int payload = mbedtls_ssl_get_max_out_record_payload(&tls->ssl);
+        tlsStats.recordPayload = payload > 0 ? (uint16_t)payload : 0;
+        const char* suite = mbedtls_ssl_get_ciphersuite(&tls->ssl);
+        tlsStats.suite = suite ? suite : "";
+        return 1;
+    }
+
+    // Suites and curves offered by each profile, most preferred first. "fast" only reorders:
+    // its suites and curves go first and everything else mbedTLS offers by default follows,
+    // so no broker that worked with "default" is locked out. "ecdsa" offers nothing else.
+    void applyProfile(mbedtls_ssl_config* conf) {
+        static const int fastSuites[] = {
+            MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+            MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+            MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+            MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+            MBEDTLS_TLS_RSA_WITH_AES_128_GCM_SHA256,
+            0
+        };
+        static const int ecdsaSuites[] = {
+            MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+            MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+            0
+        };
+        static const mbedtls_ecp_group_id fastCurves[] = {
+            MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_CURVE25519, MBEDTLS_ECP_DP_SECP384R1, MBEDTLS_ECP_DP_NONE
+        };
+        // mbedTLS keeps pointers to these lists, so the merged ones are built once and kept
+        static const int* fastOrder = nullptr;
+        static const mbedtls_ecp_group_id* fastCurveOrder = nullptr;
+        if (profile == TLS_PROFILE_FAST) {
+            if (!fastOrder) fastOrder = preferFirst(fastSuites, mbedtls_ssl_list_ciphersuites(), 0);
+            if (!fastCurveOrder) fastCurveOrder = preferFirst(fastCurves, mbedtls_ecp_grp_id_list(), MBEDTLS_ECP_DP_NONE);
+            if (fastOrder) mbedtls_ssl_conf_ciphersuites(conf, fastOrder);
+            if (fastCurveOrder) mbedtls_ssl_conf_curves(conf, fastCurveOrder);
+        } else if (profile == TLS_PROFILE_ECDSA) {
+            mbedtls_ssl_conf_ciphersuites(conf, ecdsaSuites);
+            mbedtls_ssl_conf_curves(conf, fastCurves);
+            mbedtls_ssl_conf_min_version(conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+        }
+#ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+        unsigned char code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+        switch (maxFragment) {
+            case 512: code = MBEDTLS_SSL_MAX_FRAG_LEN_512; break;
+            case 1024: code = MBEDTLS_SSL_MAX_FRAG_LEN_1024; break;
+            case 2048: code = MBEDTLS_SSL_MAX_FRAG_LEN_2048; break;
+            case 4096: code = MBEDTLS_SSL_MAX_FRAG_LEN_4096; break;
+        }
+        mbedtls_ssl_conf_max_frag_len(conf, code);
+#endif
+    }
+
+    // The entries of preferred that defaults contains, then the rest of defaults, in a list
+    // that lives for the rest of the run; nullptr if out of memory
+    template <typename T>
+    static const T* preferFirst(const T* preferred, const T* defaults, T end) {
+        size_t n = 0;
+        while (defaults[n] != end) n++;
+        T* merged = (T*)malloc((n + 1) * sizeof(T));
+        if (!merged) return nullptr;
+        size_t k = 0;
+        for (const T* p = preferred; *p != end; ++p) {
+            if (listHas(defaults, *p, end)) merged[k++] = *p;
+        }
+        for (const T* d = defaults; *d != end; ++d) {
+            if (!listHas(preferred, *d, end)) merged[k++] = *d;
+        }
+        merged[k] = end;
+        return merged;
+    }
+
+    template <typename T>
+    static bool listHas(const T* list, T value, T end) {
+        for (; *list != end; ++list) {
+            if (*list == value) return true;
+        }
+        return false;
+    }
+
+    // A stored CA is only in RAM while it is parsed; the parsed chain is freed after the handshake
+    int loadCaChain(mbedtls_x509_crt* ca) {
+        if (caSlot < 0) return mbedtls_x509_crt_parse(ca, (const unsigned char*)caPem, strlen(caPem) + 1);
+        CertStore store;
+        CertBlob blob;
+        if (!store.load((uint8_t)caSlot, blob)) return MBEDTLS_ERR_X509_FILE_IO_ERROR;
+        int ret = 0;
+        for (size_t at = 0; ret == 0 && at < blob.length;) {
+            size_t length = derCertLength(blob.data + at, blob.length - at);
+            if (length == 0) {
+                ret = MBEDTLS_ERR_X509_INVALID_FORMAT;
+                break;
+            }
+            ret = mbedtls_x509_crt_parse_der(ca, blob.data + at, length);
+            at += length;
+        }
+        CertStore::release(blob);
+        return ret;
+    }
+
+    bool handshake(uint16_t port) {
+        tls = new (std::nothrow) TlsState;
+        if (!tls) return false;
+        mbedtls_ssl_init(&tls->ssl);
+        mbedtls_ssl_config_init(&tls->conf);
+        mbedtls_ctr_drbg_init(&tls->drbg);
+        mbedtls_entropy_init(&tls->entropy);
+        mbedtls_x509_crt_init(&tls->ca);
+
+        static const unsigned char pers[] = "meshcore_gw";
+        int ret = mbedtls_ctr_drbg_seed(&tls->drbg, mbedtls_entropy_func, &tls->entropy, pers, sizeof(pers) - 1);
+        if (ret == 0) {
+            ret = mbedtls_ssl_config_defaults(&tls->conf, MBEDTLS_SSL_IS_CLIENT,
+                                              MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+        }
+        if (ret == 0 && !insecure && (caPem || caSlot >= 0)) {
+            ret = loadCaChain(&tls->ca);
+            if (ret == 0) {
+                mbedtls_ssl_conf_ca_chain(&tls->conf, &tls->ca, nullptr);
+                mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+            }
+        } else if (ret == 0) {
+            mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_NONE);
+        }
+        if (ret == 0) {
+            mbedtls_ssl_conf_rng(&tls->conf, mbedtls_ctr_drbg_random, &tls->drbg);
+            mbedtls_ssl_conf_session_tickets(&tls->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+            applyProfile(&tls->conf);
+            ret = mbedtls_ssl_setup(&tls->ssl, &tls->conf);
+        }
+        // Hostname drives SNI and certificate name checks even though we dial the cached IP
+        if (ret == 0) ret = mbedtls_ssl_set_hostname(&tls->ssl, host);
+        if (ret != 0) {
+            timings.tlsError = ret;
+            return false;
+        }
+        mbedtls_ssl_set_bio(&tls->ssl, this, bioSend, bioRecv, nullptr);
+
+        bool offered = haveSession && sessionPort == port && strcmp(sessionHost, host) == 0;
+        if (offered) mbedtls_ssl_set_session(&tls->ssl, &savedSession);
+
+        // Stepped by hand rather than through mbedtls_ssl_handshake() so the server's resume
+        // decision can be read: it is set while parsing the ServerHello and freed at wrap-up.
+        // With a ticket the client offers a fresh random session ID (RFC 5077 section 3.4), so
+        // comparing IDs afterwards would count every ticket resumption as a full handshake
+        bool resumed = false;
+        unsigned long start = millis();
+        while (tls->ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+            ret = mbedtls_ssl_handshake_step(&tls->ssl);
+            if (tls->ssl.handshake && tls->ssl.handshake->resume) resumed = true;
+            if (ret == 0) continue;
+            if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+                millis() - start > BROKER_TLS_TIMEOUT_MS) {
+                timings.tlsError = ret;
+                // A rejected resumption is harmless, but do not keep offering a session
+                // that may be the cause of the failure
+                if (offered) clearSession();
+                return false;
+            }
+            delay(1);
+        }
+
+        // The chain is only consulted during the handshake (renegotiation is disabled), so
+        // release the parsed certificates rather than hold them for the whole session
+        mbedtls_ssl_conf_ca_chain(&tls->conf, nullptr, nullptr);
+        mbedtls_x509_crt_free(&tls->ca);
+        mbedtls_x509_crt_init(&tls->ca);
+
+        // Session ID and ticket resumptions alike; a fresh session replaces the saved one
+        timings.tlsResumed = offered && resumed;
+        if (!timings.tlsResumed) {
+            clearSession();
+            if (mbedtls_ssl_get_session(&tls->ssl, &savedSession) == 0) {
+                haveSession = true;
+                strncpy(sessionHost, host, sizeof(sessionHost) - 1);
+                sessionHost[sizeof(sessionHost) - 1] = '\0';
+                sessionPort = port;
+            }
+        }
+        return true;
+    }
+
+    void freeTls() {
+        if (!tls) return;
+        mbedtls_ssl_free(&tls->ssl);
+        mbedtls_ssl_config_free(&tls->conf);
+        mbedtls_ctr_drbg_free(&tls->drbg);
+        mbedtls_entropy_free(&tls->entropy);
+        mbedtls_x509_crt_free(&tls->ca);
+        delete tls;
+        tls = nullptr;
+    }
+
+    // mbedTLS BIO over the TCP socket; never blocks, mbedTLS retries on WANT_*
+    static int bioSend(void* ctx, const unsigned char* buf, size_t len) {
+        BrokerClient* self = static_cast<BrokerClient*>(ctx);
+        if (!self->tcp.connected()) return MBEDTLS_ERR_NET_CONN_RESET;
+        size_t n = self->tcp.write(buf, len);
+        return n > 0 ? (int)n : MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    static int bioRecv(void* ctx, unsigned char* buf, size_t len) {
+        BrokerClient* self = static_cast<BrokerClient*>(ctx);
+        int avail = self->tcp.available();
+        if (avail <= 0) return self->tcp.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+        int n = self->tcp.read(buf, len < (size_t)avail ? len : (size_t)avail);
+        return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+    }
+};
+
+#endif // BROKER_CLIENT_H
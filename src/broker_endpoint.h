@@ -0,0 +1,202 @@
+#ifndef BROKER_ENDPOINT_H
+#define BROKER_ENDPOINT_H
+
+// An additional broker connection next to the handler's primary one. In fan-out mode every
+// publish is copied to each endpoint; in standby mode the endpoint stays connected and idle
+// until the primary goes down, then carries the uplink. Each endpoint owns its socket, async
+// transport and a RAM-only outbound queue, so a slow or unreachable broker only backs up its
+// own queue and never delays the primary. Requires the async transport (ESP32, WiFi).
+
+#if defined(ESP32) && !defined(USE_ETHERNET)
+
+#include <Arduino.h>
+#include "config.h"
+#include "broker_client.h"
+#include "mqtt_async_transport.h"
+#include "outbound_queue.h"
+#include "broker_failover.h"
+#include "log.h"
+
+#define ENDPOINT_CONNECT_TIMEOUT_MS 15000UL
+
+enum EndpointState : uint8_t {
+    EP_DISABLED,
+    EP_BACKOFF,
+    EP_CONNECTING,
+    EP_ONLINE
+};
+
+inline const char* endpointStateName(EndpointState s) {
+    switch (s) {
+        case EP_DISABLED: return "disabled";
+        case EP_BACKOFF: return "backoff";
+        case EP_CONNECTING: return "connecting";
+        case EP_ONLINE: return "online";
+    }
+    return "?";
+}
+
+struct BrokerEndpointStats {
+    EndpointState state;
+    uint32_t sessions;
+    uint32_t published;     // publishes accepted by the transport, replays included
+    uint32_t queued;        // current backlog
+    uint32_t dropped;       // store-and-forward publishes lost to a full backlog
+};
+
+class BrokerEndpoint {
+public:
+    BrokerEndpoint() : transport(nullptr), state(EP_DISABLED), attemptStart(0), sessions(0), published(0),
+                       expirySec(0) {
+        memset(&cfg, 0, sizeof(cfg));
+        clientId[0] = '\0';
+    }
+
+    ~BrokerEndpoint() { delete transport; }
+
+    // The client id gets an index suffix so two endpoints on one broker cluster do not
+    // take over each other's session. caSlot is a certificate store slot, or -1 for caPem.
+    // The settings are copied: c lives in a configuration snapshot that a later change reclaims.
+    bool begin(const BrokerEndpointConfig& c, int8_t caSlot, const char* caPem, const char* baseClientId,
+               uint8_t index, MQTTInboundCallback onMessage) {
+        cfg = c;
+        if (transport || !c.enabled || c.server[0] == '\0') return false;
+        snprintf(clientId, sizeof(clientId), "%s_b%u", baseClientId, (unsigned)index);
+        transport = new AsyncMQTTTransport(client);
+        if (!transport->start()) {
+            delete transport;
+            transport = nullptr;
+            return false;
+        }
+        client.setTls(c.useTLS);
+        if (c.useTLS) {
+            if (caSlot >= 0) {
+                client.setCASlot((uint8_t)caSlot);
+            } else {
+                client.setCACert(caPem);
+            }
+            client.setInsecure(c.insecureTLS);
+            client.setTlsProfile(c.tlsProfile, 0);
+        }
+        transport->setClient(client);
+        transport->setServer(cfg.server, cfg.port);
+        transport->setCallback(onMessage);
+        state = EP_BACKOFF;
+        backoff.reset(millis());
+        return true;
+    }
+
+    // One bounded step: (re)connect with backoff, then drain the backlog. base carries the
+    // handler's will and keepalive; identity and credentials are the endpoint's own.
+    void loop(bool networkUp, const MqttConnectOptions& base) {
+        if (!transport) return;
+        unsigned long now = millis();
+        switch (state) {
+            case EP_DISABLED:
+                return;
+            case EP_BACKOFF:
+                if (connectDue(networkUp)) {
+                    MqttConnectOptions o = base;
+                    o.clientId = clientId;
+                    o.username = cfg.username;
+                    o.password = cfg.password;
+                    o.cleanSession = true;
+                    o.sessionExpirySec = 0;
+                    transport->connect(o);
+                    attemptStart = now;
+                    state = EP_CONNECTING;
+                }
+                break;
+            case EP_CONNECTING:
+                if (transport->connected()) {
+                    state = EP_ONLINE;
+                    backoff.succeeded();
+                    sessions++;
+                    LOG_INFO("✓ MQTT broker %s connected", cfg.server);
+                } else if (!transport->connecting() || now - attemptStart > ENDPOINT_CONNECT_TIMEOUT_MS) {
+                    LOG_WARN("✗ MQTT broker %s connection failed, rc=%d", cfg.server, transport->state());
+                    retryLater(now);
+                }
+                break;
+            case EP_ONLINE:
+                if (!networkUp || !transport->connected()) {
+                    LOG_WARN("⚠ MQTT broker %s connection lost", cfg.server);
+                    retryLater(now);
+                }
+                break;
+        }
+        transport->loop();
+        if (state == EP_ONLINE && !backlog.isEmpty()) {
+            backlog.replay([this](const char* topic, const char* payload, size_t length, bool retain) {
+                if (!transport->connected() ||
+                    !transport->publish(topic, (const uint8_t*)payload, length, retain, 1, expirySec)) {
+                    return false;
+                }
+                published++;
+                return true;
+            });
+        }
+    }
+
+    // Whether loop() would start a connect attempt now (so the caller only builds options then);
+    // it waits for the transport to finish closing the previous session
+    bool connectDue(bool networkUp) const {
+        return transport && state == EP_BACKOFF && networkUp && backoff.due(millis()) &&
+               transport->idle();
+    }
+
+    // Same contract as the handler's own publish path: store-and-forward traffic is queued
+    // while the endpoint is down or backed up, everything else is best effort
+    bool publish(const char* topic, const uint8_t* data, size_t length, bool retain, bool storeAndForward,
+                 uint16_t messageExpirySec) {
+        if (!transport) return false;
+        expirySec = messageExpirySec;
+        return publishOrQueue(backlog, state == EP_ONLINE, topic, (const char*)data, length, retain, storeAndForward,
+                              [&](uint8_t qos) {
+                                  if (!transport->publish(topic, data, length, retain, qos, qos ? messageExpirySec : 0)) {
+                                      return false;
+                                  }
+                                  published++;
+                                  return true;
+                              });
+    }
+
+    bool active() const { return transport != nullptr; }
+    bool online() const { return state == EP_ONLINE; }
+    MQTTTransport* session() { return transport; }
+    const char* server() const { return cfg.server; }
+
+    BrokerEndpointStats getStats() {
+        BrokerEndpointStats s;
+        OutboundQueueStats q = backlog.getStats();
+        s.state = state;
+        s.sessions = sessions;
+        s.published = published;
+        s.queued = q.depth;
+        s.dropped = q.dropped;
+        return s;
+    }
+
+private:
+    BrokerEndpointConfig cfg;
+    BrokerClient client;
+    AsyncMQTTTransport* transport;
+    OutboundQueue backlog;      // begin() is never called, so it stays RAM-only
+    EndpointState state;
+    EndpointBackoff backoff;
+    unsigned long attemptStart;
+    uint32_t sessions;
+    uint32_t published;
+    uint16_t expirySec;
+    char clientId[72];
+
+    void retryLater(unsigned long now) {
+        transport->disconnect();
+        backoff.failed(now);
+        state = EP_BACKOFF;
+    }
+};
+
+#endif // ESP32 && !USE_ETHERNET
+
+#endif // BROKER_ENDPOINT_H
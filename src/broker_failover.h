@@ -0,0 +1,96 @@
+#ifndef BROKER_FAILOVER_H
+#define BROKER_FAILOVER_H
+
+// The decisions behind additional brokers, kept apart from the sockets and transports that
+// carry them out: the reconnect backoff of an endpoint, the store-and-forward publish rule
+// shared by the primary and every endpoint, and which endpoint carries the uplink in standby
+// mode. BrokerEndpoint and MQTTHandler drive them with the async transport; the failover
+// tests (test/failover_gateway.h) drive the same code with in-process links.
+
+#include <Arduino.h>
+#include "outbound_queue.h"
+
+#define ENDPOINT_BACKOFF_BASE_MS    1000UL
+#define ENDPOINT_BACKOFF_MAX_MS     60000UL
+
+// Reconnect pacing: the delay doubles after each failed attempt up to the cap, and a
+// successful session starts over from the base
+class EndpointBackoff {
+public:
+    EndpointBackoff() : nextAttemptAt(0), failures(0) {}
+
+    void reset(unsigned long now) {
+        nextAttemptAt = now;
+        failures = 0;
+    }
+
+    bool due(unsigned long now) const { return (long)(now - nextAttemptAt) >= 0; }
+
+    void succeeded() { failures = 0; }
+
+    void failed(unsigned long now) {
+        unsigned long delayMs = ENDPOINT_BACKOFF_BASE_MS << (failures < 6 ? failures : 6);
+        if (delayMs > ENDPOINT_BACKOFF_MAX_MS) delayMs = ENDPOINT_BACKOFF_MAX_MS;
+        failures++;
+        nextAttemptAt = now + delayMs;
+    }
+
+    uint32_t failureCount() const { return failures; }
+
+private:
+    unsigned long nextAttemptAt;
+    uint32_t failures;
+};
+
+// One publish to a broker with its own backlog. Store-and-forward traffic is sent straight
+// away only while the broker is up and nothing is queued ahead of it, so a replay stays in
+// order, and is queued otherwise; everything else is best effort. send(qos) hands the
+// message to the transport.
+template <typename SendFn>
+bool publishOrQueue(OutboundQueue& backlog, bool up, const char* topic, const char* payload, size_t length,
+                    bool retain, bool storeAndForward, SendFn send) {
+    if (storeAndForward) {
+        if (up && backlog.isEmpty() && send(1)) return true;
+        return backlog.enqueue(topic, payload, length, retain);
+    }
+    return up && send(0);
+}
+
+// First of count endpoints fit to carry the uplink, or -1
+template <typename UsableFn>
+int firstUsableEndpoint(size_t count, UsableFn usable) {
+    for (size_t i = 0; i < count; ++i) {
+        if (usable(i)) return (int)i;
+    }
+    return -1;
+}
+
+// Standby mode: the first online endpoint takes the uplink (and the subscriptions) while the
+// primary is down, and gives it back once the primary returns
+class StandbySelector {
+public:
+    StandbySelector() : current(-1), released(-1), failovers(0) {}
+
+    // True when the standby changed; the caller then moves the subscriptions from
+    // releasedIndex() to standbyIndex()
+    template <typename OnlineFn>
+    bool update(bool primaryUp, size_t count, OnlineFn online) {
+        int want = primaryUp ? -1 : firstUsableEndpoint(count, online);
+        if (want == current) return false;
+        released = current;
+        current = want;
+        if (current >= 0) failovers++;
+        return true;
+    }
+
+    int standbyIndex() const { return current; }
+    int releasedIndex() const { return released; }
+    uint32_t failoverCount() const { return failovers; }
+
+private:
+    int current;
+    int released;
+    uint32_t failovers;
+};
+
+#endif // BROKER_FAILOVER_H
@@ -0,0 +1,53 @@
+#ifndef BROKER_RESOLVER_H
+#define BROKER_RESOLVER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define BROKER_DNS_TTL_MS 300000UL    // hostByName() hides record TTLs; bound staleness instead
+#define BROKER_HOST_BYTES 128
+
+// Address cache for the broker host; a failed TCP connect drops the entry early
+class BrokerResolver {
+public:
+    BrokerResolver() : valid(false), resolvedAt(0), hits(0), lookups(0) { name[0] = '\0'; }
+
+    bool resolve(const char* host, IPAddress& out, bool& cached) {
+        cached = false;
+        if (out.fromString(host)) return true;   // literal address
+        unsigned long now = millis();
+        if (valid && strcmp(host, name) == 0 && now - resolvedAt < BROKER_DNS_TTL_MS) {
+            out = addr;
+            cached = true;
+            hits++;
+            return true;
+        }
+        lookups++;
+        IPAddress ip;
+        if (!WiFi.hostByName(host, ip)) {
+            valid = false;
+            return false;
+        }
+        strncpy(name, host, sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+        addr = ip;
+        resolvedAt = now;
+        valid = true;
+        out = ip;
+        return true;
+    }
+
+    void invalidate() { valid = false; }
+    uint32_t cacheHits() const { return hits; }
+    uint32_t cacheMisses() const { return lookups; }
+
+private:
+    char name[BROKER_HOST_BYTES];
+    IPAddress addr;
+    bool valid;
+    unsigned long resolvedAt;
+    uint32_t hits;
+    uint32_t lookups;
+};
+
+#endif // BROKER_RESOLVER_H
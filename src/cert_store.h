@@ -0,0 +1,160 @@
+#ifndef CERT_STORE_H
+#define CERT_STORE_H
+
+// CA certificates kept out of the resident configuration. Each broker has a slot in its own
+// NVS namespace; a certificate is read into a heap buffer only while a TLS handshake parses
+// it and freed straight after. PEM input is converted to DER on the way in (about 25% smaller
+// than the base64 text); a slot may hold several certificates back to back.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <new>
+#include "config.h"
+
+#define CERT_NAMESPACE "meshcore_ca"
+#define CERT_SLOT_PRIMARY 0
+#define CERT_SLOTS (1 + MQTT_EXTRA_BROKERS)    // primary broker, then each additional broker
+#define CERT_MAX_BYTES 4096                     // DER bytes per slot
+
+struct CertBlob {
+    uint8_t* data;
+    size_t length;
+};
+
+// Length of the DER certificate at data (outer SEQUENCE header included), 0 if malformed
+inline size_t derCertLength(const uint8_t* data, size_t available) {
+    if (available < 2 || data[0] != 0x30) return 0;
+    size_t header = 2;
+    size_t length = data[1];
+    if (length & 0x80) {
+        size_t bytes = length & 0x7F;
+        if (bytes == 0 || bytes > 3 || available < 2 + bytes) return 0;
+        length = 0;
+        for (size_t i = 0; i < bytes; ++i) length = (length << 8) | data[2 + i];
+        header += bytes;
+    }
+    return header + length <= available ? header + length : 0;
+}
+
+// Decode every "CERTIFICATE" block of a PEM bundle into concatenated DER. Returns the DER
+// length, or 0 if there is no certificate or it does not fit.
+inline size_t pemToDer(const char* pem, uint8_t* out, size_t outSize) {
+    static const char BEGIN[] = "-----BEGIN CERTIFICATE-----";
+    static const char END[] = "-----END CERTIFICATE-----";
+    size_t written = 0;
+    const char* p = pem;
+    while ((p = strstr(p, BEGIN)) != nullptr) {
+        p += sizeof(BEGIN) - 1;
+        const char* end = strstr(p, END);
+        if (!end) return 0;
+        uint32_t bits = 0;
+        int count = 0;
+        for (; p < end; ++p) {
+            char c = *p;
+            int v;
+            if (c >= 'A' && c <= 'Z') v = c - 'A';
+            else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') v = c - '0' + 52;
+            else if (c == '+') v = 62;
+            else if (c == '/') v = 63;
+            else continue;      // whitespace, line breaks and '=' padding
+            bits = (bits << 6) | (uint32_t)v;
+            count += 6;
+            if (count >= 8) {
+                count -= 8;
+                if (written >= outSize) return 0;
+                out[written++] = (uint8_t)(bits >> count);
+            }
+        }
+        p = end + sizeof(END) - 1;
+    }
+    return written;
+}
+
+class CertStore {
+public:
+    // Store a PEM certificate (or chain) in a slot as DER
+    bool storePem(uint8_t slot, const char* pem) {
+        if (slot >= CERT_SLOTS || !pem) return false;
+        uint8_t* der = new (std::nothrow) uint8_t[CERT_MAX_BYTES];
+        if (!der) return false;
+        size_t length = pemToDer(pem, der, CERT_MAX_BYTES);
+        bool ok = storeDer(slot, der, length);
+        delete[] der;
+        return ok;
+    }
+
+    // Store DER bytes already converted from PEM (see pemToDer)
+    bool storeDer(uint8_t slot, const uint8_t* der, size_t length) {
+        if (slot >= CERT_SLOTS || !der || length == 0 || length > CERT_MAX_BYTES) return false;
+        if (derCertLength(der, length) == 0) return false;
+        char key[8];
+        prefs.begin(CERT_NAMESPACE, false);
+        bool ok = prefs.putBytes(slotKey(slot, key), der, length) == length;
+        prefs.end();
+        return ok;
+    }
+
+    bool remove(uint8_t slot) {
+        if (slot >= CERT_SLOTS) return false;
+        char key[8];
+        prefs.begin(CERT_NAMESPACE, false);
+        bool ok = prefs.remove(slotKey(slot, key));
+        prefs.end();
+        return ok;
+    }
+
+    void clear() {
+        prefs.begin(CERT_NAMESPACE, false);
+        prefs.clear();
+        prefs.end();
+    }
+
+    // Stored DER bytes in a slot, 0 if empty
+    size_t size(uint8_t slot) {
+        if (slot >= CERT_SLOTS) return 0;
+        char key[8];
+        prefs.begin(CERT_NAMESPACE, true);
+        size_t length = prefs.getBytesLength(slotKey(slot, key));
+        prefs.end();
+        return length;
+    }
+
+    bool has(uint8_t slot) { return size(slot) > 0; }
+
+    // Read a slot into a heap buffer; the caller hands it back with release()
+    bool load(uint8_t slot, CertBlob& out) {
+        out.data = nullptr;
+        out.length = 0;
+        if (slot >= CERT_SLOTS) return false;
+        char key[8];
+        prefs.begin(CERT_NAMESPACE, true);
+        size_t length = prefs.getBytesLength(slotKey(slot, key));
+        if (length > 0 && length <= CERT_MAX_BYTES) {
+            out.data = new (std::nothrow) uint8_t[length];
+            if (out.data && prefs.getBytes(key, out.data, length) == length) {
+                out.length = length;
+            } else {
+                release(out);
+            }
+        }
+        prefs.end();
+        return out.length > 0;
+    }
+
+    static void release(CertBlob& blob) {
+        delete[] blob.data;
+        blob.data = nullptr;
+        blob.length = 0;
+    }
+
+private:
+    Preferences prefs;
+
+    static const char* slotKey(uint8_t slot, char* key) {
+        snprintf(key, 8, "ca%u", (unsigned)slot);
+        return key;
+    }
+};
+
+#endif // CERT_STORE_H
@@ -26,6 +26,38 @@
 #define DEFAULT_MQTT_CLIENT_ID "meshcore_gateway"
 #define DEFAULT_MQTT_TOPIC_PREFIX "MESHCORE"
 
+// Bridge interest set: topic classes a gateway subscribes to (bit order matches
+// INTEREST_TOPIC_NAMES) and the regions it listens to besides its own
+#define INTEREST_RAW       0x01
+#define INTEREST_MESSAGES  0x02
+#define INTEREST_STATUS    0x04
+#define INTEREST_STATS     0x08
+#define INTEREST_FLOODS    0x10
+#define INTEREST_ADVERTS   0x20
+#define INTEREST_TOPIC_COUNT 6
+#define DEFAULT_INTEREST_TOPICS (INTEREST_RAW | INTEREST_MESSAGES | INTEREST_ADVERTS)
+#define DEFAULT_INTEREST_REGIONS "*"
+#define INTEREST_MAX_REGIONS 6
+
+// TLS profiles (names in TLS_PROFILE_NAMES): which cipher suites and key-exchange curves
+// the broker client offers. "default" leaves mbedTLS's own list; "fast" offers the same
+// suites and curves with ECDHE-ECDSA/AES-GCM and P-256/X25519 moved to the front; "ecdsa"
+// offers nothing but ECDHE-ECDSA with AES-GCM.
+#define TLS_PROFILE_DEFAULT 0
+#define TLS_PROFILE_FAST    1
+#define TLS_PROFILE_ECDSA   2
+#define TLS_PROFILE_COUNT   3
+#define DEFAULT_TLS_PROFILE TLS_PROFILE_DEFAULT
+
+// Additional broker endpoints next to the primary server. "fanout" sends every publish to
+// every endpoint; "standby" keeps them connected and moves the uplink (and the command and
+// bridge subscriptions) to the first one online while the primary is down.
+#define MQTT_EXTRA_BROKERS 2
+#define BROKER_MODE_SINGLE  0
+#define BROKER_MODE_FANOUT  1
+#define BROKER_MODE_STANDBY 2
+#define BROKER_MODE_COUNT   3
+
 // WiFi Settings
 #define DEFAULT_WIFI_SSID ""
 #define DEFAULT_WIFI_PASSWORD ""
@@ -109,6 +141,17 @@ struct WiFiConfig {
     bool enabled;
 };
 
+struct BrokerEndpointConfig {
+    bool enabled;
+    char server[128];
+    uint16_t port;
+    char username[64];
+    char password[64];
+    bool useTLS;
+    bool insecureTLS;
+    uint8_t tlsProfile;     // TLS_PROFILE_*; CA is shared with the primary server
+};
+
 struct MQTTConfig {
     char server[128];
     uint16_t port;
@@ -121,13 +164,26 @@ struct MQTTConfig {
     char region[32];          // e.g. "NSW" (optional)
     bool useTLS;
     bool insecureTLS;       // Allow TLS without certificate validation (setInsecure)
+    uint8_t tlsProfile;     // TLS_PROFILE_*
+    uint16_t tlsMaxFragment; // requested max record payload (512/1024/2048/4096), 0 = 16 KB default
     bool enabled;
     bool publishRaw;         // Publish raw hex data
     bool publishDecoded;     // Publish decoded messages
     bool subscribeCommands;  // Subscribe to command topics
     bool bridgeAll;          // Subscribe to raw/messages for RF rebroadcast
-    bool useCustomCA;        // Use a user-provided CA certificate
-    char caCert[2048];       // PEM-encoded CA certificate (optional)
+    bool useCustomCA;        // Use the CA in certificate store slot 0 (cert_store.h)
+    bool asyncTransport;     // Event-driven MQTT client task (PubSubClient when false)
+    bool mqtt5;              // Request MQTT 5 (async transport; falls back to 3.1.1 if refused)
+    bool persistentSession;    // cleanSession=false: broker keeps subscriptions and queued commands
+    uint16_t messageExpirySec; // MQTT 5 expiry for bridged RF traffic; 0 = never
+    uint16_t bridgeRatePerMin; // MQTT->RF frames per minute per source gateway; 0 = unlimited
+    uint8_t bridgeBurst;       // token bucket depth per source gateway
+    bool bridgeElection;       // coordinate with same-region gateways so one transmits each frame
+    uint16_t bridgeFallbackMs; // hold time per better-ranked peer before transmitting anyway
+    char interestRegions[96];  // "*" = every child region, "" = own prefix only, else e.g. "NSW,ACT"
+    uint8_t interestTopics;    // INTEREST_* topic classes to subscribe to
+    uint8_t brokerMode;      // BROKER_MODE_*
+    BrokerEndpointConfig extraBrokers[MQTT_EXTRA_BROKERS];
 };
 
 struct LoRaConfig {
@@ -257,6 +313,100 @@ inline void deriveTopicPrefix(const MQTTConfig& mqtt, char* out, size_t outSize)
     appendUpperSegment(mqtt.region);    // Expect subdivision code part (e.g., NSW, AUK)
 }
 
+static const char* const TLS_PROFILE_NAMES[TLS_PROFILE_COUNT] = { "default", "fast", "ecdsa" };
+
+inline const char* tlsProfileName(uint8_t profile) {
+    return profile < TLS_PROFILE_COUNT ? TLS_PROFILE_NAMES[profile] : "?";
+}
+
+static const char* const BROKER_MODE_NAMES[BROKER_MODE_COUNT] = { "single", "fanout", "standby" };
+
+inline const char* brokerModeName(uint8_t mode) {
+    return mode < BROKER_MODE_COUNT ? BROKER_MODE_NAMES[mode] : "?";
+}
+
+static const char* const INTEREST_TOPIC_NAMES[INTEREST_TOPIC_COUNT] = {
+    "raw", "messages", "status", "stats", "floods", "adverts"
+};
+
+// "raw,adverts" -> INTEREST_RAW | INTEREST_ADVERTS; unknown names are ignored
+inline uint8_t parseInterestTopics(const char* list) {
+    uint8_t mask = 0;
+    const char* p = list;
+    while (p && *p) {
+        while (*p == ' ' || *p == ',') ++p;
+        const char* end = p;
+        while (*end && *end != ',' && *end != ' ') ++end;
+        for (uint8_t i = 0; i < INTEREST_TOPIC_COUNT; ++i) {
+            size_t n = strlen(INTEREST_TOPIC_NAMES[i]);
+            if ((size_t)(end - p) == n && strncasecmp(p, INTEREST_TOPIC_NAMES[i], n) == 0) mask |= (uint8_t)(1 << i);
+        }
+        p = end;
+    }
+    return mask;
+}
+
+inline void formatInterestTopics(uint8_t mask, char* out, size_t outSize) {
+    if (outSize == 0) return;
+    out[0] = '\0';
+    for (uint8_t i = 0; i < INTEREST_TOPIC_COUNT; ++i) {
+        if (!(mask & (1 << i))) continue;
+        if (out[0] != '\0') strncat(out, ",", outSize - strlen(out) - 1);
+        strncat(out, INTEREST_TOPIC_NAMES[i], outSize - strlen(out) - 1);
+    }
+}
+
+// What a settings change touches, for hot-apply without a reboot. Fields not covered here
+// (publish flags, expiry, discovery, location, clock, ...) are read live and need no action.
+#define CONFIG_CHANGE_RADIO          0x0001  // LoRa modem parameters: retune in place
+#define CONFIG_CHANGE_WIFI           0x0002  // WiFi credentials: rejoin, then reconnect the broker
+#define CONFIG_CHANGE_BROKER         0x0004  // server, credentials, TLS, client ID, protocol: reconnect
+#define CONFIG_CHANGE_TOPICS         0x0008  // prefix or subscription switches: new MQTT session
+#define CONFIG_CHANGE_INTEREST       0x0010  // bridge interest set: incremental (un)subscribe
+#define CONFIG_CHANGE_BRIDGE_LIMITS  0x0020
+#define CONFIG_CHANGE_RESTART        0x0040  // MQTT/WiFi disabled, transport or broker set: reboot
+
+inline uint16_t configChanges(const GatewayConfig& a, const GatewayConfig& b) {
+    uint16_t changes = 0;
+    const LoRaConfig& la = a.lora;
+    const LoRaConfig& lb = b.lora;
+    if (la.frequency != lb.frequency || la.bandwidth != lb.bandwidth || la.spreadingFactor != lb.spreadingFactor ||
+        la.codingRate != lb.codingRate || la.txPower != lb.txPower || la.syncWord != lb.syncWord ||
+        la.enableCRC != lb.enableCRC) {
+        changes |= CONFIG_CHANGE_RADIO;
+    }
+    if (strcmp(a.wifi.ssid, b.wifi.ssid) != 0 || strcmp(a.wifi.password, b.wifi.password) != 0) {
+        changes |= CONFIG_CHANGE_WIFI;
+    }
+    const MQTTConfig& ma = a.mqtt;
+    const MQTTConfig& mb = b.mqtt;
+    if (strcmp(ma.server, mb.server) != 0 || ma.port != mb.port || strcmp(ma.username, mb.username) != 0 ||
+        strcmp(ma.password, mb.password) != 0 || strcmp(ma.clientId, mb.clientId) != 0 ||
+        ma.useTLS != mb.useTLS || ma.insecureTLS != mb.insecureTLS || ma.tlsProfile != mb.tlsProfile ||
+        ma.tlsMaxFragment != mb.tlsMaxFragment || ma.useCustomCA != mb.useCustomCA || ma.mqtt5 != mb.mqtt5 ||
+        ma.persistentSession != mb.persistentSession) {
+        changes |= CONFIG_CHANGE_BROKER;
+    }
+    if (strcmp(ma.topicPrefix, mb.topicPrefix) != 0 || ma.subscribeCommands != mb.subscribeCommands ||
+        ma.bridgeAll != mb.bridgeAll || ma.bridgeElection != mb.bridgeElection) {
+        changes |= CONFIG_CHANGE_TOPICS;
+    }
+    if (strcmp(ma.interestRegions, mb.interestRegions) != 0 || ma.interestTopics != mb.interestTopics) {
+        changes |= CONFIG_CHANGE_INTEREST;
+    }
+    if (ma.bridgeRatePerMin != mb.bridgeRatePerMin || ma.bridgeBurst != mb.bridgeBurst) {
+        changes |= CONFIG_CHANGE_BRIDGE_LIMITS;
+    }
+    // Enabling MQTT is applied by starting the handler; disabling it or changing what the
+    // handler built at startup (transport, additional brokers) is not
+    if ((a.mqtt.enabled && !b.mqtt.enabled) || (a.wifi.enabled && !b.wifi.enabled) ||
+        ma.asyncTransport != mb.asyncTransport || ma.brokerMode != mb.brokerMode ||
+        memcmp(ma.extraBrokers, mb.extraBrokers, sizeof(ma.extraBrokers)) != 0) {
+        changes |= CONFIG_CHANGE_RESTART;
+    }
+    return changes;
+}
+
 // Default configuration
 inline GatewayConfig getDefaultConfig() {
     GatewayConfig config;
@@ -279,13 +429,36 @@ inline GatewayConfig getDefaultConfig() {
     deriveTopicPrefix(config.mqtt, config.mqtt.topicPrefix, sizeof(config.mqtt.topicPrefix));
     config.mqtt.useTLS = true;
     config.mqtt.insecureTLS = false;
+    config.mqtt.tlsProfile = DEFAULT_TLS_PROFILE;
+    config.mqtt.tlsMaxFragment = 0;
     config.mqtt.enabled = false;
     config.mqtt.publishRaw = true;
     config.mqtt.publishDecoded = true;
     config.mqtt.subscribeCommands = true;
     config.mqtt.bridgeAll = true;
     config.mqtt.useCustomCA = false;
-    config.mqtt.caCert[0] = '\0';
+    config.mqtt.asyncTransport = true;
+    config.mqtt.mqtt5 = true;
+    config.mqtt.persistentSession = false;
+    config.mqtt.messageExpirySec = 120;
+    config.mqtt.bridgeRatePerMin = 12;
+    config.mqtt.bridgeBurst = 4;
+    config.mqtt.bridgeElection = true;
+    config.mqtt.bridgeFallbackMs = 1500;
+    strncpy(config.mqtt.interestRegions, DEFAULT_INTEREST_REGIONS, sizeof(config.mqtt.interestRegions));
+    config.mqtt.interestTopics = DEFAULT_INTEREST_TOPICS;
+    config.mqtt.brokerMode = BROKER_MODE_SINGLE;
+    for (uint8_t i = 0; i < MQTT_EXTRA_BROKERS; ++i) {
+        BrokerEndpointConfig& b = config.mqtt.extraBrokers[i];
+        b.enabled = false;
+        b.server[0] = '\0';
+        b.port = DEFAULT_MQTT_PORT;
+        b.username[0] = '\0';
+        b.password[0] = '\0';
+        b.useTLS = true;
+        b.insecureTLS = false;
+        b.tlsProfile = DEFAULT_TLS_PROFILE;
+    }
     
     // LoRa defaults
     config.lora.frequency = DEFAULT_LORA_FREQ;
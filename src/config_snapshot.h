@@ -0,0 +1,169 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+// The running configuration as immutable snapshots. Readers (RX and TX paths, the MQTT handler)
+// take the current snapshot pointer without locking; a writer copies the current version into a
+// fresh snapshot, edits the copy and swaps it in with one atomic store, so nobody ever sees a
+// half-edited configuration.
+//
+// Replaced snapshots are freed by epoch-based reclamation. A reader announces the epoch it
+// entered in its slot (one per task) for as long as it holds snapshot pointers; a snapshot
+// retired at epoch e is freed once no slot holds an epoch <= e. Publishing and reclaiming happen
+// on one writer task (the Arduino loop). The writer may read without a guard since only it frees
+// snapshots, as long as it does not keep a pointer across its own publish/reclaim. Only
+// std::atomic, so test/test_config_snapshot.cpp runs it with host threads.
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include "config.h"
+
+#define CONFIG_READER_LOOP 0        // Arduino loop task: RX, TX and the MQTT handler
+#define CONFIG_READER_IO 1          // async MQTT I/O task
+#define CONFIG_READER_SLOTS 4
+#define CONFIG_RETIRED_MAX 4        // replaced snapshots still pinned by readers
+
+struct ConfigSnapshot {
+    GatewayConfig config;
+    uint32_t version;               // 1 for the first published configuration
+};
+
+class ConfigSnapshots {
+public:
+    ConfigSnapshots() : current(nullptr), epoch(1), retiredCount(0) {
+        for (uint8_t i = 0; i < CONFIG_READER_SLOTS; ++i) readers[i].store(0);
+    }
+
+    // Seeded copy for a private reader set (e.g. the menu's quick test)
+    explicit ConfigSnapshots(const GatewayConfig& initial) : ConfigSnapshots() {
+        publish(initial);
+    }
+
+    ~ConfigSnapshots() {
+        delete current.load();
+        for (uint8_t i = 0; i < retiredCount; ++i) delete retired[i].snapshot;
+    }
+
+    ConfigSnapshots(const ConfigSnapshots&) = delete;
+    ConfigSnapshots& operator=(const ConfigSnapshots&) = delete;
+
+    // Make a copy of next the current configuration. False (current unchanged) if out of memory
+    // or too many replaced snapshots are still pinned by readers.
+    bool publish(const GatewayConfig& next) {
+        ConfigSnapshot* fresh = new (std::nothrow) ConfigSnapshot;
+        if (!fresh) return false;
+        memcpy(&fresh->config, &next, sizeof(GatewayConfig));
+        return install(fresh);
+    }
+
+    // Copy the current configuration, let edit change the copy, publish it
+    template <typename Edit>
+    bool update(Edit edit) {
+        const ConfigSnapshot* base = current.load();
+        if (!base) return false;
+        ConfigSnapshot* fresh = new (std::nothrow) ConfigSnapshot;
+        if (!fresh) return false;
+        memcpy(&fresh->config, &base->config, sizeof(GatewayConfig));
+        edit(fresh->config);
+        return install(fresh);
+    }
+
+    // Current configuration; only valid after the first publish()
+    const GatewayConfig& config() const { return current.load()->config; }
+
+    const ConfigSnapshot* snapshot() const { return current.load(); }
+
+    uint32_t version() const {
+        const ConfigSnapshot* s = current.load();
+        return s ? s->version : 0;
+    }
+
+    uint8_t pendingReclaim() const { return retiredCount; }
+
+    // Reader side, see ConfigReadGuard. enter() returns false when the slot is already held
+    // (a nested guard on the same task), in which case the outer guard keeps the pin.
+    bool enter(uint8_t slot) {
+        if (readers[slot].load(std::memory_order_relaxed) != 0) return false;
+        readers[slot].store(epoch.load());
+        return true;
+    }
+
+    void leave(uint8_t slot) {
+        readers[slot].store(0, std::memory_order_release);
+    }
+
+    // Free replaced snapshots no reader can still hold. Writer task only.
+    void reclaim() {
+        if (retiredCount == 0) return;
+        uint32_t oldest = UINT32_MAX;
+        for (uint8_t i = 0; i < CONFIG_READER_SLOTS; ++i) {
+            uint32_t e = readers[i].load();
+            if (e != 0 && e < oldest) oldest = e;
+        }
+        uint8_t kept = 0;
+        for (uint8_t i = 0; i < retiredCount; ++i) {
+            if (retired[i].epoch < oldest) {
+                delete retired[i].snapshot;
+            } else {
+                retired[kept++] = retired[i];
+            }
+        }
+        retiredCount = kept;
+    }
+
+private:
+    struct Retired {
+        ConfigSnapshot* snapshot;
+        uint32_t epoch;             // readers that entered at or before this may hold it
+    };
+
+    std::atomic<ConfigSnapshot*> current;
+    std::atomic<uint32_t> epoch;    // 0 in a reader slot means idle; wraps after 2^32 publishes
+    std::atomic<uint32_t> readers[CONFIG_READER_SLOTS];
+    Retired retired[CONFIG_RETIRED_MAX];
+    uint8_t retiredCount;
+
+    bool install(ConfigSnapshot* fresh) {
+        reclaim();
+        ConfigSnapshot* old = current.load();
+        if (old && retiredCount == CONFIG_RETIRED_MAX) {
+            delete fresh;
+            return false;
+        }
+        fresh->version = old ? old->version + 1 : 1;
+        // Sequentially consistent swap and epoch bump pair with enter(): a reader whose slot
+        // store the scan in reclaim() misses loads current afterwards and sees the new snapshot
+        current.store(fresh);
+        uint32_t retiredAt = epoch.fetch_add(1);
+        if (old) retired[retiredCount++] = { old, retiredAt };
+        reclaim();
+        return true;
+    }
+};
+
+// Pins the configuration for one task while it is in scope; reads through it see the snapshot
+// that was current when the guard was taken
+class ConfigReadGuard {
+public:
+    ConfigReadGuard(ConfigSnapshots& snapshots, uint8_t slot)
+        : snapshots(snapshots), slot(slot), outer(snapshots.enter(slot)), pinned(&snapshots.config()) {}
+
+    ~ConfigReadGuard() {
+        if (outer) snapshots.leave(slot);
+    }
+
+    ConfigReadGuard(const ConfigReadGuard&) = delete;
+    ConfigReadGuard& operator=(const ConfigReadGuard&) = delete;
+
+    const GatewayConfig& operator*() const { return *pinned; }
+    const GatewayConfig* operator->() const { return pinned; }
+
+private:
+    ConfigSnapshots& snapshots;
+    uint8_t slot;
+    bool outer;
+    const GatewayConfig* pinned;
+};
+
+#endif // CONFIG_SNAPSHOT_H
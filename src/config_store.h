@@ -0,0 +1,149 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+// On-flash format of the gateway configuration: the whole GatewayConfig as one NVS blob behind
+// a small header carrying a layout version and a CRC32 of the payload. Loading is a single
+// getBytes instead of one lookup per field. No NVS calls in here, so the format and the
+// migrations can be exercised on a Linux host.
+//
+// Any change to the layout of GatewayConfig (or the structs inside it) must bump
+// CONFIG_BLOB_VERSION and register a migration from the previous version below.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "config.h"
+
+#define CONFIG_BLOB_KEY "cfg"
+#define CONFIG_BLOB_VERSION 2
+#define CONFIG_BLOB_MAX 8192        // larger blobs are treated as corrupt
+
+struct ConfigBlobHeader {
+    uint32_t magic;         // CONFIG_MAGIC
+    uint16_t version;       // layout of the payload
+    uint16_t headerSize;
+    uint32_t length;        // payload bytes
+    uint32_t crc;           // CRC32 of the payload
+};
+
+// The stored record: header followed by the payload in the current layout
+struct ConfigRecord {
+    ConfigBlobHeader header;
+    GatewayConfig config;
+};
+
+enum ConfigBlobResult : uint8_t {
+    CONFIG_BLOB_OK,
+    CONFIG_BLOB_MIGRATED,       // valid, converted from an older version
+    CONFIG_BLOB_CORRUPT,        // bad header, length or CRC
+    CONFIG_BLOB_UNSUPPORTED     // newer than this firmware, or no migration path
+};
+
+inline const char* configBlobResultName(ConfigBlobResult r) {
+    switch (r) {
+        case CONFIG_BLOB_OK: return "ok";
+        case CONFIG_BLOB_MIGRATED: return "migrated";
+        case CONFIG_BLOB_CORRUPT: return "corrupt";
+        case CONFIG_BLOB_UNSUPPORTED: return "unsupported version";
+    }
+    return "?";
+}
+
+// CRC-32 (IEEE 802.3, reflected), nibble table
+inline uint32_t configCrc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+// Data a migration moves out of the configuration record, for the caller to store elsewhere
+struct ConfigMigrationContext {
+    char* caPem;            // v1 -> v2: the CA certificate that was in MQTTConfig
+    size_t caPemSize;
+};
+
+// One step from fromVersion to fromVersion + 1, rewriting the payload in place. capacity is
+// the size of the buffer behind payload; length is updated to the new payload size.
+typedef bool (*ConfigMigrationFn)(uint8_t* payload, size_t& length, size_t capacity, ConfigMigrationContext& ctx);
+
+#define CONFIG_V1_CA_BYTES 2048
+
+// v2 dropped MQTTConfig::caCert[2048], the last member of MQTTConfig; the certificate moved to
+// the certificate store. Everything after it shifts down by exactly its size.
+inline bool migrateConfigV1(uint8_t* payload, size_t& length, size_t capacity, ConfigMigrationContext& ctx) {
+    (void)capacity;
+    size_t at = offsetof(GatewayConfig, mqtt) + sizeof(MQTTConfig);
+    if (length < at + CONFIG_V1_CA_BYTES) return false;
+    if (ctx.caPem && ctx.caPemSize > 0) {
+        size_t n = ctx.caPemSize - 1 < CONFIG_V1_CA_BYTES ? ctx.caPemSize - 1 : CONFIG_V1_CA_BYTES;
+        memcpy(ctx.caPem, payload + at, n);
+        ctx.caPem[n] = '\0';
+    }
+    memmove(payload + at, payload + at + CONFIG_V1_CA_BYTES, length - at - CONFIG_V1_CA_BYTES);
+    length -= CONFIG_V1_CA_BYTES;
+    return true;
+}
+
+struct ConfigMigration {
+    uint16_t fromVersion;
+    ConfigMigrationFn apply;
+};
+
+// Registered migrations, oldest first; the list ends with a null entry
+static const ConfigMigration CONFIG_MIGRATIONS[] = {
+    { 1, migrateConfigV1 },
+    { 0, nullptr }
+};
+
+inline ConfigMigrationFn findConfigMigration(uint16_t fromVersion) {
+    for (const ConfigMigration* m = CONFIG_MIGRATIONS; m->apply; ++m) {
+        if (m->fromVersion == fromVersion) return m->apply;
+    }
+    return nullptr;
+}
+
+inline void sealConfigRecord(ConfigRecord& record) {
+    record.header.magic = CONFIG_MAGIC;
+    record.header.version = CONFIG_BLOB_VERSION;
+    record.header.headerSize = sizeof(ConfigBlobHeader);
+    record.header.length = sizeof(GatewayConfig);
+    record.header.crc = configCrc32((const uint8_t*)&record.config, sizeof(GatewayConfig));
+}
+
+// Validate a stored blob and bring its payload to the current layout. blob holds length bytes
+// read from flash inside a buffer of capacity bytes (room for migrations to grow the payload).
+// On success out holds the configuration and version the layout the blob was stored in;
+// anything a migration moved out of the record is left in ctx.
+inline ConfigBlobResult openConfigBlob(uint8_t* blob, size_t length, size_t capacity, GatewayConfig& out,
+                                       uint16_t& version, ConfigMigrationContext& ctx) {
+    ConfigBlobHeader header;
+    if (length < sizeof(header) || length > capacity) return CONFIG_BLOB_CORRUPT;
+    memcpy(&header, blob, sizeof(header));
+    version = header.version;
+    if (header.magic != CONFIG_MAGIC || header.headerSize != sizeof(header) ||
+        header.length != length - sizeof(header)) {
+        return CONFIG_BLOB_CORRUPT;
+    }
+    uint8_t* payload = blob + sizeof(header);
+    size_t payloadLength = header.length;
+    if (configCrc32(payload, payloadLength) != header.crc) return CONFIG_BLOB_CORRUPT;
+    if (header.version > CONFIG_BLOB_VERSION) return CONFIG_BLOB_UNSUPPORTED;
+
+    for (uint16_t v = header.version; v < CONFIG_BLOB_VERSION; ++v) {
+        ConfigMigrationFn step = findConfigMigration(v);
+        if (!step || !step(payload, payloadLength, capacity - sizeof(header), ctx)) return CONFIG_BLOB_UNSUPPORTED;
+    }
+    // Same version but a different size means the layout changed without a version bump
+    if (payloadLength != sizeof(GatewayConfig)) return CONFIG_BLOB_CORRUPT;
+    memcpy(&out, payload, sizeof(GatewayConfig));
+    return header.version == CONFIG_BLOB_VERSION ? CONFIG_BLOB_OK : CONFIG_BLOB_MIGRATED;
+}
+
+#endif // CONFIG_STORE_H
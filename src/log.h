@@ -0,0 +1,426 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Logging for the packet path. A LOG_* call does not format or touch the UART: it stores the
+// format string pointer (which must be a literal) and copies of its arguments in a fixed-size
+// slot of a lock-free ring, a few microseconds. A low-priority task formats the records and
+// writes them to Serial. If the ring is full the record is dropped and counted instead of
+// blocking the caller; the drain task reports how many were lost.
+//
+// Levels above LOG_LEVEL compile to nothing, arguments included. Set it from build_flags,
+// e.g. -DLOG_LEVEL=3 to keep INFO and drop the per-packet DEBUG dumps.
+//
+// Arguments: integers, floating point, pointers, C strings (copied, so stack buffers are fine)
+// and LogHex / LogText views of a byte buffer, which render under %s as space-separated hex and
+// as raw text respectively. Copied bytes are capped at LOG_DATA_BYTES per record.
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <atomic>
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_RING_SLOTS 32           // power of two
+#define LOG_MAX_ARGS 6
+#define LOG_DATA_BYTES 96           // copied strings and byte views per record
+#define LOG_LINE_MAX 256
+#define LOG_DRAIN_INTERVAL_MS 20
+#define LOG_TASK_STACK 3072
+#define LOG_TASK_PRIORITY 1         // idle + 1: yields to WiFi, the MQTT I/O task and loop()
+#define LOG_TASK_CORE 0
+
+// Byte buffer views; the bytes are copied into the record
+struct LogHex {
+    const uint8_t* data;
+    size_t length;
+    LogHex(const uint8_t* d, size_t n) : data(d), length(n) {}
+};
+
+struct LogText {
+    const uint8_t* data;
+    size_t length;
+    LogText(const uint8_t* d, size_t n) : data(d), length(n) {}
+};
+
+enum LogArgKind : uint8_t {
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,        // data[offset..offset+length), NUL-terminated
+    LOG_ARG_HEX         // data[offset..offset+length) rendered as hex
+};
+
+struct LogArg {
+    union {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void* p;
+    } v;
+    uint8_t kind;
+    uint8_t offset;
+    uint8_t length;
+    bool truncated;
+};
+
+struct LogRecord {
+    const char* fmt;
+    uint32_t ms;
+    uint8_t level;
+    uint8_t argc;
+    uint8_t dataUsed;
+    LogArg args[LOG_MAX_ARGS];
+    char data[LOG_DATA_BYTES];
+};
+
+struct LogStats {
+    uint32_t written;
+    uint32_t dropped;       // ring full
+    uint32_t truncated;     // arguments beyond LOG_MAX_ARGS or LOG_DATA_BYTES
+};
+
+// Bounded multi-producer ring (per-slot sequence numbers) with a single consumer, the drain
+class LogRing {
+public:
+    LogRing() : enqueuePos(0), dequeuePos(0), written(0), dropped(0), truncated(0), reportedDrops(0) {
+        for (uint32_t i = 0; i < LOG_RING_SLOTS; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void write(uint8_t level, const char* fmt, const Args&... args) {
+        uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & (LOG_RING_SLOTS - 1)];
+            uint32_t seq = cell->seq.load(std::memory_order_acquire);
+            int32_t diff = (int32_t)(seq - pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        LogRecord& r = cell->record;
+        r.fmt = fmt;
+        r.ms = millis();
+        r.level = level;
+        r.argc = 0;
+        r.dataUsed = 0;
+        bool clipped = false;
+        int expand[] = { 0, (clipped |= !capture(r, args), 0)... };
+        (void)expand;
+        if (clipped) truncated.fetch_add(1, std::memory_order_relaxed);
+        written.fetch_add(1, std::memory_order_relaxed);
+        cell->seq.store(pos + 1, std::memory_order_release);
+    }
+
+    // Format the oldest record into line; false when the ring is empty. Single consumer.
+    bool pop(char* line, size_t size) {
+        uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell = &cells[pos & (LOG_RING_SLOTS - 1)];
+        if ((int32_t)(cell->seq.load(std::memory_order_acquire) - (pos + 1)) != 0) return false;
+        format(cell->record, line, size);
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        cell->seq.store(pos + LOG_RING_SLOTS, std::memory_order_release);
+        return true;
+    }
+
+    // Drops since the last call, for the drain to report
+    uint32_t takeNewDrops() {
+        uint32_t now = dropped.load(std::memory_order_relaxed);
+        uint32_t fresh = now - reportedDrops;
+        reportedDrops = now;
+        return fresh;
+    }
+
+    LogStats getStats() const {
+        LogStats s;
+        s.written = written.load(std::memory_order_relaxed);
+        s.dropped = dropped.load(std::memory_order_relaxed);
+        s.truncated = truncated.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // Render a record with the conversions of its format string; each conversion is handed to
+    // snprintf on its own with the stored argument widened to the matching type
+    static size_t format(const LogRecord& r, char* out, size_t size) {
+        if (size == 0) return 0;
+        size_t n = 0;
+        uint8_t next = 0;
+        const char* f = r.fmt;
+        while (*f && n + 1 < size) {
+            if (*f != '%') {
+                out[n++] = *f++;
+                continue;
+            }
+            if (f[1] == '%') {
+                out[n++] = '%';
+                f += 2;
+                continue;
+            }
+            // %[flags][width][.precision][length]conversion
+            char spec[24];
+            size_t s = 0;
+            spec[s++] = *f++;
+            while (*f && strchr("-+ #0123456789.", *f) && s < sizeof(spec) - 4) spec[s++] = *f++;
+            while (*f && strchr("hlLqjzt", *f)) f++;
+            char conv = *f ? *f++ : 's';
+            if (next >= r.argc) {
+                n += appendText(out + n, size - n, "?");
+                continue;
+            }
+            const LogArg& a = r.args[next++];
+            n += formatArg(r, a, spec, s, conv, out + n, size - n);
+        }
+        out[n] = '\0';
+        return n;
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint32_t> seq;
+        LogRecord record;
+    };
+
+    Cell cells[LOG_RING_SLOTS];
+    std::atomic<uint32_t> enqueuePos;
+    std::atomic<uint32_t> dequeuePos;
+    std::atomic<uint32_t> written;
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> truncated;
+    uint32_t reportedDrops;
+
+    static bool addArg(LogRecord& r, uint8_t kind, LogArg*& out) {
+        if (r.argc >= LOG_MAX_ARGS) return false;
+        out = &r.args[r.argc++];
+        out->kind = kind;
+        out->offset = 0;
+        out->length = 0;
+        out->truncated = false;
+        return true;
+    }
+
+    static bool capture(LogRecord& r, long long v) {
+        LogArg* a;
+        if (!addArg(r, LOG_ARG_INT, a)) return false;
+        a->v.i = v;
+        return true;
+    }
+    static bool capture(LogRecord& r, unsigned long long v) {
+        LogArg* a;
+        if (!addArg(r, LOG_ARG_UINT, a)) return false;
+        a->v.u = v;
+        return true;
+    }
+    static bool capture(LogRecord& r, int v) { return capture(r, (long long)v); }
+    static bool capture(LogRecord& r, long v) { return capture(r, (long long)v); }
+    static bool capture(LogRecord& r, unsigned int v) { return capture(r, (unsigned long long)v); }
+    static bool capture(LogRecord& r, unsigned long v) { return capture(r, (unsigned long long)v); }
+    static bool capture(LogRecord& r, bool v) { return capture(r, (long long)v); }
+    static bool capture(LogRecord& r, char v) { return capture(r, (long long)v); }
+    static bool capture(LogRecord& r, uint8_t v) { return capture(r, (unsigned long long)v); }
+    static bool capture(LogRecord& r, int8_t v) { return capture(r, (long long)v); }
+    static bool capture(LogRecord& r, uint16_t v) { return capture(r, (unsigned long long)v); }
+    static bool capture(LogRecord& r, int16_t v) { return capture(r, (long long)v); }
+    static bool capture(LogRecord& r, double v) {
+        LogArg* a;
+        if (!addArg(r, LOG_ARG_DOUBLE, a)) return false;
+        a->v.d = v;
+        return true;
+    }
+    static bool capture(LogRecord& r, float v) { return capture(r, (double)v); }
+    static bool capture(LogRecord& r, const void* v) {
+        LogArg* a;
+        if (!addArg(r, LOG_ARG_PTR, a)) return false;
+        a->v.p = v;
+        return true;
+    }
+    static bool capture(LogRecord& r, const char* v) {
+        return copyBytes(r, LOG_ARG_STR, (const uint8_t*)(v ? v : "(null)"), v ? strlen(v) : 6);
+    }
+    static bool capture(LogRecord& r, char* v) { return capture(r, (const char*)v); }
+    static bool capture(LogRecord& r, const String& v) { return capture(r, v.c_str()); }
+    static bool capture(LogRecord& r, const LogText& v) { return copyBytes(r, LOG_ARG_STR, v.data, v.length); }
+    static bool capture(LogRecord& r, const LogHex& v) { return copyBytes(r, LOG_ARG_HEX, v.data, v.length); }
+
+    // Copy into the record's data area; strings keep room for their terminator
+    static bool copyBytes(LogRecord& r, uint8_t kind, const uint8_t* src, size_t length) {
+        LogArg* a;
+        if (!addArg(r, kind, a)) return false;
+        size_t room = LOG_DATA_BYTES - r.dataUsed;
+        if (kind == LOG_ARG_STR) room = room > 0 ? room - 1 : 0;
+        size_t n = length < room ? length : room;
+        a->offset = r.dataUsed;
+        a->length = (uint8_t)n;
+        a->truncated = n < length;
+        memcpy(r.data + r.dataUsed, src, n);
+        r.dataUsed += (uint8_t)n;
+        if (kind == LOG_ARG_STR && r.dataUsed < LOG_DATA_BYTES) r.data[r.dataUsed++] = '\0';
+        return !a->truncated;
+    }
+
+    static size_t appendText(char* out, size_t size, const char* text) {
+        int w = snprintf(out, size, "%s", text);
+        if (w < 0) return 0;
+        return (size_t)w < size ? (size_t)w : size - 1;
+    }
+
+    static size_t formatArg(const LogRecord& r, const LogArg& a, char* spec, size_t s, char conv,
+                            char* out, size_t size) {
+        if (a.kind == LOG_ARG_HEX) {
+            static const char HEX_DIGITS[] = "0123456789ABCDEF";
+            size_t n = 0;
+            for (uint8_t i = 0; i < a.length && n + 3 < size; ++i) {
+                uint8_t b = (uint8_t)r.data[a.offset + i];
+                if (i) out[n++] = ' ';
+                out[n++] = HEX_DIGITS[b >> 4];
+                out[n++] = HEX_DIGITS[b & 0x0F];
+            }
+            out[n] = '\0';
+            if (a.truncated) n += appendText(out + n, size - n, " ...");
+            return n;
+        }
+        int w;
+        if (conv == 's') {
+            spec[s++] = 's';
+            spec[s] = '\0';
+            w = a.kind == LOG_ARG_STR ? snprintf(out, size, spec, r.data + a.offset) : snprintf(out, size, spec, "?");
+        } else if (strchr("diouxXc", conv)) {
+            if (conv != 'c') {
+                spec[s++] = 'l';
+                spec[s++] = 'l';
+            }
+            spec[s++] = conv;
+            spec[s] = '\0';
+            long long v = a.kind == LOG_ARG_DOUBLE ? (long long)a.v.d : a.v.i;
+            if (conv == 'c') w = snprintf(out, size, spec, (int)v);
+            else if (conv == 'd' || conv == 'i') w = snprintf(out, size, spec, v);
+            else w = snprintf(out, size, spec, (unsigned long long)v);
+        } else if (strchr("fFeEgGaA", conv)) {
+            spec[s++] = conv;
+            spec[s] = '\0';
+            double v = a.kind == LOG_ARG_DOUBLE ? a.v.d
+                     : a.kind == LOG_ARG_UINT ? (double)a.v.u : (double)a.v.i;
+            w = snprintf(out, size, spec, v);
+        } else {
+            spec[s++] = 'p';
+            spec[s] = '\0';
+            w = snprintf(out, size, spec, a.v.p);
+        }
+        if (w < 0) return 0;
+        return (size_t)w < size ? (size_t)w : size - 1;
+    }
+};
+
+inline LogRing& logRing() {
+    static LogRing ring;
+    return ring;
+}
+
+// While held (the serial menu is open) nothing is written; the ring fills and further records
+// are dropped and counted, so the drop count is reported once output resumes
+inline std::atomic<bool>& logHeld() {
+    static std::atomic<bool> held(false);
+    return held;
+}
+
+inline void logHold(bool hold) {
+    logHeld().store(hold);
+}
+
+// Write out everything queued; returns the number of lines. Called by the drain task, or from
+// loop() when the task could not be started.
+inline size_t logDrain() {
+    if (logHeld().load()) return 0;
+    LogRing& ring = logRing();
+    char line[LOG_LINE_MAX + 2];
+    size_t lines = 0;
+    while (ring.pop(line, LOG_LINE_MAX)) {
+        // Text and line end in one write, so console replies written from loop() never land
+        // in the middle of a log line
+        size_t n = strlen(line);
+        line[n++] = '\r';
+        line[n++] = '\n';
+        Serial.write((const uint8_t*)line, n);
+        lines++;
+    }
+    uint32_t lost = ring.takeNewDrops();
+    if (lost) Serial.printf("⚠ %lu log lines dropped (log ring full)\n", (unsigned long)lost);
+    return lines;
+}
+
+inline bool& logTaskRunning() {
+    static bool running = false;
+    return running;
+}
+
+#ifdef ESP32
+inline void logTaskEntry(void*) {
+    for (;;) {
+        logDrain();
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
+}
+#endif
+
+// Start the drain task; without it records are drained by logService() from loop()
+inline bool logBegin() {
+#ifdef ESP32
+    if (!logTaskRunning()) {
+        logTaskRunning() = xTaskCreatePinnedToCore(logTaskEntry, "log", LOG_TASK_STACK, nullptr,
+                                                   LOG_TASK_PRIORITY, nullptr, LOG_TASK_CORE) == pdPASS;
+    }
+#endif
+    return logTaskRunning();
+}
+
+inline void logService() {
+    if (!logTaskRunning()) logDrain();
+}
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logRing().write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logRing().write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logRing().write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logRing().write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) logRing().write(LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) do {} while (0)
+#endif
+
+#endif // LOG_H
@@ -18,12 +18,20 @@
 #include <SPI.h>
 #include <RadioLib.h>
 #include <string.h>
+#include <sys/time.h>
+#include <esp_timer.h>
 
 // Configuration and handlers
 #include "config.h"
+#include "config_snapshot.h"
+#include "boot_timing.h"
+#include "pipeline_timing.h"
+#include "log.h"
 #include "settings_manager.h"
 #include "mqtt_handler.h"
 #include "serial_config.h"
+#include "serial_protocol.h"
+#include "sniffer.h"
 
 // LoRa radio object
 #ifdef RAK4631_ETH
@@ -59,7 +67,10 @@ static void printBoxKeyValue(const char *key, const String &value, int keyWidth
 }
 
 // Global objects
-GatewayConfig config;
+GatewayConfig config;           // draft: loaded from flash, edited by the menu, then published
+ConfigSnapshots configSnapshots; // published versions the radio and uplink run with
+GatewayConfig *pendingConfig = nullptr; // pushed over MQTT, applied from loop()
+bool pendingConfigSave = false;
 SettingsManager settingsManager;
 MQTTHandler *mqttHandler = nullptr;
 ConfigMenu *serialConfig = nullptr;
@@ -71,6 +82,7 @@ uint32_t packetsForwarded = 0;
 uint32_t packetsFailed = 0;
 
 // Timing
+BootTimer bootTimer;
 unsigned long lastStatsPublish = 0;
 unsigned long lastStatusBlink = 0;
 unsigned long lastPacketCheck = 0;
@@ -80,6 +92,37 @@ bool configMode = false;
 bool radioInitialized = false;
 volatile bool packetReceived = false;
 
+// Per-frame handling time: from reading the frame off the radio until it has been handed to
+// MQTT and the repeat decision is made (excludes the deliberate repeat delay and TX air time)
+static LatencyWindow frameLatency;
+static unsigned long frameStartUs = 0;
+static bool frameTimed = true;
+
+static void markFrameHandled()
+{
+    if (!frameTimed)
+    {
+        frameLatency.add((uint32_t)(micros() - frameStartUs));
+        frameTimed = true;
+    }
+}
+
+// Per-stage histograms of each received frame's path (pipeline_timing.h), stamped with
+// esp_timer_get_time() so they share a clock with the ISR timestamp
+static PipelineTimer pipeline;
+
+// '@' command lines from scripts (serial_protocol.h); the reply is built in a static buffer
+// so a large "get" or "stats" does not sit on the loop stack
+static HostLineReader hostLine;
+static char hostReplyBuffer[HOST_REPLY_MAX];
+
+// Binary capture stream (sniffer.h), switched on with "@sniff on"; rxIrqUs is when the radio
+// raised its RX interrupt, so timestamps do not include loop latency
+static Sniffer sniffer;
+static uint8_t snifferFrame[SNIFFER_FRAME_MAX];
+static volatile int64_t rxIrqUs = 0;
+static unsigned long sniffBaudChange = 0; // applied once the "sniff" reply is on the wire
+
 // Discovery / Neighbour tracking
 static NeighborInfo neighbors[16];
 static size_t neighborCount = 0;
@@ -139,10 +182,15 @@ static void rememberPacket(uint32_t hash, unsigned long nowMs)
 
 // Function declarations
 void setupLoRa();
+int applyRadioConfig(const LoRaConfig &previous);
+void startMqttHandler();
+void applyConfig(uint16_t forced = 0);
+MQTTHandler *applyForQuickTest();
 void handleLoRaReceive();
 void handleLoRaPacket(uint8_t *data, size_t length, int rssi, float snr);
 bool sendLoRaPacket(const uint8_t *data, size_t length);
 void checkSerialInput();
+void handleHostCommand(char *line, bool overflowed);
 void publishStats();
 void publishNeighbours();
 void blinkLED();
@@ -151,6 +199,9 @@ void exitConfigMode();
 void sendAdvert();
 void printTelemetryToSerial();
 void printNeighboursToSerial();
+void printLatencyToSerial();
+void printBootToSerial();
+void serviceGateway();
 
 // Radio interrupt flag
 volatile uint32_t interruptCount = 0;
@@ -158,12 +209,70 @@ void IRAM_ATTR setRadioFlag()
 {
     packetReceived = true;
     interruptCount++;
+    rxIrqUs = esp_timer_get_time();
+}
+
+// Write one sniffer frame if the UART buffer takes it whole; a frame that would make the loop
+// wait is skipped and counted, and shows up as a gap in the sequence numbers
+static void snifferWrite(size_t length)
+{
+    if ((size_t)Serial.availableForWrite() >= length)
+    {
+        Serial.write(snifferFrame, length);
+        sniffer.noteWritten();
+    }
+    else
+    {
+        sniffer.noteDropped();
+    }
+}
+
+static void snifferPacket(uint8_t type, uint8_t flags, int64_t atUs, int rssi, float snr, const uint8_t *data,
+                          size_t length)
+{
+    if (sniffer.isActive())
+        snifferWrite(sniffer.packet(type, flags, (uint64_t)atUs, rssi, snr, data, length, snifferFrame));
+}
+
+// Radio settings and wall-clock offset for the capture, on start, on every configuration
+// change and every SNIFFER_INFO_INTERVAL_MS
+static void snifferService()
+{
+    if (!sniffer.isActive() || !sniffer.infoDue(millis(), configSnapshots.version()))
+        return;
+    const GatewayConfig &cfg = configSnapshots.config();
+    SnifferRadioInfo info;
+    info.frequencyHz = (uint32_t)(cfg.lora.frequency * 1000000.0 + 0.5);
+    info.bandwidthHz = (uint32_t)(cfg.lora.bandwidth * 1000.0f + 0.5f);
+    info.spreadingFactor = cfg.lora.spreadingFactor;
+    info.codingRate = cfg.lora.codingRate;
+    info.syncWord = cfg.lora.syncWord;
+    info.txPower = (int8_t)cfg.lora.txPower;
+    info.nodeId = cfg.repeater.nodeId;
+    int64_t now = esp_timer_get_time();
+    int64_t offset = 0;
+    struct timeval tv;
+    if (time(nullptr) > 1600000000 && gettimeofday(&tv, nullptr) == 0)
+        offset = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - now;
+    snifferWrite(sniffer.info(info, (uint64_t)now, offset, snifferFrame));
 }
 
 void setup()
 {
+    // Buffered so the boot log never holds up the radio at 115200 baud
+    Serial.setTxBufferSize(1024);
     Serial.begin(115200);
-    delay(1000);
+    // Packet-path logging is formatted and written by a low-priority task
+    logBegin();
+    int resetReason = esp_reset_reason();
+    bootTimer.setResetReason(resetReason);
+    // After power-on the USB-serial bridge and monitor need a moment to attach; after a
+    // watchdog or software reset the radio comes back first
+    if (resetReason == ESP_RST_POWERON)
+    {
+        delay(1000);
+    }
+    bootTimer.end(BOOT_PHASE_SERIAL, micros());
 
     // Initialize settings manager
     if (!settingsManager.begin())
@@ -171,12 +280,13 @@ void setup()
         Serial.println(F("✗ Failed to initialize settings manager"));
     }
 
-    // Load configuration or use defaults
+    // Load configuration or use defaults; first-boot values are written back in one save below
+    bool settingsDirty = false;
     if (!settingsManager.loadConfig(config))
     {
         Serial.println(F("⚠ No saved configuration found, using defaults"));
         config = getDefaultConfig();
-        settingsManager.saveConfig(config);
+        settingsDirty = true;
     }
     else
     {
@@ -188,7 +298,7 @@ void setup()
     {
         uint64_t chipid = ESP.getEfuseMac();
         config.repeater.nodeId = (uint32_t)(chipid & 0xFFFFFFFF);
-        settingsManager.saveConfig(config);
+        settingsDirty = true;
         Serial.printf("✓ Generated Node ID: 0x%08X\n", config.repeater.nodeId);
     }
 
@@ -202,10 +312,35 @@ void setup()
         deriveClientIdFromNodeName(config.repeater.nodeName, config.mqtt.clientId, sizeof(config.mqtt.clientId));
         if (strcmp(prevId, config.mqtt.clientId) != 0)
         {
-            settingsManager.saveConfig(config);
+            settingsDirty = true;
             Serial.printf("✓ MQTT Client ID set to: %s\n", config.mqtt.clientId);
         }
     }
+    if (settingsDirty)
+    {
+        settingsManager.saveConfig(config);
+    }
+
+    // From here on the radio and uplink read the published snapshot, never the draft
+    configSnapshots.publish(config);
+    bootTimer.end(BOOT_PHASE_SETTINGS, micros());
+
+    // Radio first: RF repeating works while the uplink is still coming up
+    Serial.println(F("Initializing LoRa..."));
+    setupLoRa();
+    Serial.println(F("✓ LoRa initialized"));
+    bootTimer.end(BOOT_PHASE_RADIO, micros());
+
+    // WiFi, NTP, TLS and the broker connect all proceed from loop()
+    if (config.wifi.enabled && config.mqtt.enabled)
+    {
+        startMqttHandler();
+    }
+    else
+    {
+        Serial.println(F("⚠ MQTT disabled (WiFi or MQTT not enabled in config)"));
+    }
+    bootTimer.end(BOOT_PHASE_UPLINK, micros());
 
     Serial.println(F("┌────────────────────────────────────────────────────────┐"));
     printBoxLine(String("Node Name: ") + config.repeater.nodeName);
@@ -224,41 +359,11 @@ void setup()
     Serial.println(F("└────────────────────────────────────────────────────────┘"));
     Serial.println();
 
-    // Setup LoRa
-    Serial.println(F("Initializing LoRa..."));
-    setupLoRa();
-    Serial.println(F("✓ LoRa initialized"));
-
-    // Setup MQTT if enabled
-    if (config.wifi.enabled && config.mqtt.enabled)
-    {
-        Serial.println(F("\nInitializing MQTT..."));
-        mqttHandler = new MQTTHandler(config);
-
-        // Set callback for MQTT -> LoRa messages
-        mqttHandler->setMessageCallback([](const uint8_t *payload, size_t length)
-                                        {
-            Serial.printf("Forwarding MQTT message to LoRa (%d bytes)\n", length);
-            sendLoRaPacket(payload, length); });
-
-        if (mqttHandler->begin())
-        {
-            Serial.println(F("✓ MQTT initialized"));
-            mqttHandler->publishGatewayStatus(true);
-        }
-        else
-        {
-            Serial.println(F("✗ MQTT initialization failed"));
-        }
-    }
-    else
-    {
-        Serial.println(F("⚠ MQTT disabled (WiFi or MQTT not enabled in config)"));
-    }
-
     // Setup serial configuration interface
     serialConfig = new ConfigMenu(config, settingsManager);
     serialConfig->setOnExitCallback(exitConfigMode);
+    serialConfig->setIdleCallback(serviceGateway);
+    serialConfig->setQuickTestCallback(applyForQuickTest);
     serialConfig->begin();
 
     Serial.println();
@@ -271,39 +376,35 @@ void setup()
     Serial.println(F("  's' - Show statistics"));
     Serial.println(F("  'n' - Show neighbours"));
     Serial.println(F("  'd' - Debug info (interrupt count)"));
+    Serial.println(F("  'l' - Link latency (broker RTT, publish, socket writes)"));
     Serial.println(F("  't' - Send test packet (TX test)"));
     Serial.println(F("  'r' - Restart device"));
     Serial.println();
     Serial.println(F("(Hint) Press 'c' at any time to open the configuration menu"));
+    bootTimer.end(BOOT_PHASE_CONSOLE, micros());
+    printBootToSerial();
 }
 
-void loop()
+// Radio, uplink and the periodic work. Runs every loop() pass and, while the configuration
+// menu waits for input, from the menu's line editor, so the gateway stays on the air.
+void serviceGateway()
 {
-    // Handle LoRa messages
-    if (!configMode)
-    {
-        handleLoRaReceive();
+    // Free configuration versions no reader holds any more, then pin the current one for this pass
+    configSnapshots.reclaim();
+    ConfigReadGuard live(configSnapshots, CONFIG_READER_LOOP);
 
-        // Handle MQTT
-        if (mqttHandler)
-        {
-            mqttHandler->loop();
-        }
-    }
+    // Handle LoRa messages
+    handleLoRaReceive();
 
-    // Check for serial commands
-    if (!configMode)
-    {
-        checkSerialInput();
-    }
-    else
+    // Handle MQTT
+    if (mqttHandler)
     {
-        serialConfig->handleMenu();
+        mqttHandler->loop();
     }
 
     // Publish statistics periodically
     unsigned long now = millis();
-    if (!configMode && mqttHandler && mqttHandler->isConnected() && now - lastStatsPublish > 60000)
+    if (mqttHandler && mqttHandler->isConnected() && now - lastStatsPublish > 60000)
     {
         publishStats();
         publishNeighbours(); // Also publish neighbor list with stats
@@ -311,7 +412,7 @@ void loop()
     }
 
     // Periodic advert broadcast
-    if (!configMode && config.discovery.advertEnabled && now - lastAdvertSent > (unsigned long)config.discovery.advertIntervalSec * 1000UL)
+    if (live->discovery.advertEnabled && now - lastAdvertSent > (unsigned long)live->discovery.advertIntervalSec * 1000UL)
     {
         sendAdvert();
         lastAdvertSent = now;
@@ -324,11 +425,79 @@ void loop()
         lastStatusBlink = now;
     }
 
+    snifferService();
+
+    // Drains the log ring here only if the drain task could not be started
+    logService();
+}
+
+void loop()
+{
+    serviceGateway();
+
+    // Settings pushed via commands/config; held while the menu has its own draft open
+    if (!configMode && pendingConfig)
+    {
+        config = *pendingConfig;
+        delete pendingConfig;
+        pendingConfig = nullptr;
+        applyConfig();
+        if (pendingConfigSave)
+        {
+            settingsManager.saveConfig(config);
+        }
+    }
+
+    // Check for serial commands
+    if (!configMode)
+    {
+        checkSerialInput();
+    }
+    else
+    {
+        serialConfig->handleMenu();
+    }
+
     yield();
 }
 
+void startMqttHandler()
+{
+    Serial.println(F("\nInitializing MQTT..."));
+    mqttHandler = new MQTTHandler(configSnapshots);
+    mqttHandler->setBootTimer(&bootTimer);
+    mqttHandler->setPipelineTimer(&pipeline);
+
+    // Set callback for MQTT -> LoRa messages
+    mqttHandler->setMessageCallback([](const uint8_t *payload, size_t length)
+                                    {
+        LOG_INFO("Forwarding MQTT message to LoRa (%d bytes)", length);
+        sendLoRaPacket(payload, length); });
+
+    // Applied from loop(): the command arrives inside the transport's dispatch, and a broker
+    // change would tear that transport down under it
+    mqttHandler->setConfigCallback([](const GatewayConfig &next, bool save)
+                                   {
+        if (!pendingConfig) pendingConfig = new (std::nothrow) GatewayConfig;
+        if (!pendingConfig) return;
+        *pendingConfig = next;
+        pendingConfigSave = save; });
+
+    // Connection proceeds from loop() so RF reception starts immediately
+    if (mqttHandler->begin())
+    {
+        Serial.println(F("✓ MQTT initialized, connecting in background"));
+    }
+    else
+    {
+        Serial.println(F("✗ MQTT initialization failed"));
+    }
+}
+
 void setupLoRa()
 {
+    const LoRaConfig &lora = configSnapshots.config().lora;
+
     // Initialize SPI
     SPI.begin(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_CS);
 
@@ -339,32 +508,32 @@ void setupLoRa()
 #ifdef RAK4631_ETH
     // SX1262 API differs: frequency, bandwidth (kHz), spreading factor, coding rate, syncWord, power, preambleLength
     state = radio.begin(
-        config.lora.frequency,
-        config.lora.bandwidth,
-        config.lora.spreadingFactor,
-        config.lora.codingRate,
-        config.lora.syncWord,
-        config.lora.txPower,
+        lora.frequency,
+        lora.bandwidth,
+        lora.spreadingFactor,
+        lora.codingRate,
+        lora.syncWord,
+        lora.txPower,
         8);
     // Enable DIO2 RF switch control and DIO3 TCXO if needed (defaults okay for WisBlock)
     radio.setDio2AsRfSwitch(true);
 #elif defined(HELTEC_V3)
     state = radio.begin(
-        config.lora.frequency,
-        config.lora.bandwidth,
-        config.lora.spreadingFactor,
-        config.lora.codingRate,
-        config.lora.syncWord,
-        config.lora.txPower,
+        lora.frequency,
+        lora.bandwidth,
+        lora.spreadingFactor,
+        lora.codingRate,
+        lora.syncWord,
+        lora.txPower,
         8, 1.8F, false);
 #else
     state = radio.begin(
-        config.lora.frequency,
-        config.lora.bandwidth,
-        config.lora.spreadingFactor,
-        config.lora.codingRate,
-        config.lora.syncWord,
-        config.lora.txPower,
+        lora.frequency,
+        lora.bandwidth,
+        lora.spreadingFactor,
+        lora.codingRate,
+        lora.syncWord,
+        lora.txPower,
         8, // preamble length
         0  // gain (0 = auto)
     );
@@ -375,7 +544,7 @@ void setupLoRa()
         Serial.println(F("success!"));
 
         // Enable CRC if configured
-        if (config.lora.enableCRC)
+        if (lora.enableCRC)
         {
             radio.setCRC(true);
         }
@@ -385,7 +554,7 @@ void setupLoRa()
 #if defined(LILYGO_LORA32_V21)
         Serial.print(F("Configuring PA... "));
         // Use PA_BOOST pin (required for LilyGo V2.1)
-        state = radio.setOutputPower(config.lora.txPower, true); // true = use PA_BOOST
+        state = radio.setOutputPower(lora.txPower, true); // true = use PA_BOOST
         if (state == RADIOLIB_ERR_NONE)
         {
             Serial.println(F("OK"));
@@ -407,6 +576,7 @@ void setupLoRa()
         {
             Serial.println(F("✓ Radio listening for packets"));
             radioInitialized = true;
+            bootTimer.noteRxReady(micros());
         }
         else
         {
@@ -425,35 +595,35 @@ void setupLoRa()
     Serial.println(F("\n┌── LoRa Configuration ──────────────────────────────────┐"));
     {
         char buf[32];
-        snprintf(buf, sizeof(buf), "%.3f MHz", config.lora.frequency);
+        snprintf(buf, sizeof(buf), "%.3f MHz", lora.frequency);
         printBoxKeyValue("Frequency:", buf, 16);
     }
     {
         char buf[32];
-        snprintf(buf, sizeof(buf), "%.1f kHz", config.lora.bandwidth);
+        snprintf(buf, sizeof(buf), "%.1f kHz", lora.bandwidth);
         printBoxKeyValue("Bandwidth:", buf, 16);
     }
     {
         char buf[16];
-        snprintf(buf, sizeof(buf), "%d", config.lora.spreadingFactor);
+        snprintf(buf, sizeof(buf), "%d", lora.spreadingFactor);
         printBoxKeyValue("Spreading Factor:", buf, 18);
     }
     {
         char buf[16];
-        snprintf(buf, sizeof(buf), "4/%d", config.lora.codingRate);
+        snprintf(buf, sizeof(buf), "4/%d", lora.codingRate);
         printBoxKeyValue("Coding Rate:", buf, 16);
     }
     {
         char buf[16];
-        snprintf(buf, sizeof(buf), "%d dBm", config.lora.txPower);
+        snprintf(buf, sizeof(buf), "%d dBm", lora.txPower);
         printBoxKeyValue("TX Power:", buf, 16);
     }
     {
         char buf[16];
-        snprintf(buf, sizeof(buf), "0x%02X", config.lora.syncWord);
+        snprintf(buf, sizeof(buf), "0x%02X", lora.syncWord);
         printBoxKeyValue("Sync Word:", buf, 16);
     }
-    printBoxKeyValue("CRC:", String(config.lora.enableCRC ? "Enabled" : "Disabled"), 16);
+    printBoxKeyValue("CRC:", String(lora.enableCRC ? "Enabled" : "Disabled"), 16);
     Serial.println(F("└────────────────────────────────────────────────────────┘\n"));
 }
 
@@ -466,7 +636,10 @@ void handleLoRaReceive()
     if (packetReceived)
     {
         packetReceived = false;
-        Serial.println(F("🔔 Interrupt fired! Reading packet..."));
+        int64_t rxAtUs = rxIrqUs;
+        frameStartUs = micros();
+        frameTimed = false;
+        LOG_TRACE("🔔 Interrupt fired! Reading packet...");
 
         // Buffer for received data
         uint8_t buffer[256];
@@ -481,27 +654,35 @@ void handleLoRaReceive()
             int rssi = radio.getRSSI();
             float snr = radio.getSNR();
 
-            Serial.printf("📥 RX SUCCESS: %d bytes, RSSI=%d dBm, SNR=%.1f dB\n", length, rssi, snr);
+            pipeline.begin(rxAtUs);
+            pipeline.mark(PIPE_READ, esp_timer_get_time());
+
+            LOG_DEBUG("📥 RX SUCCESS: %d bytes, RSSI=%d dBm, SNR=%.1f dB", length, rssi, snr);
             packetsReceived++;
+            snifferPacket(SNIFFER_RX, 0, rxAtUs, rssi, snr, buffer, length);
 
             // Handle the packet
             handleLoRaPacket(buffer, length, rssi, snr);
+            pipeline.finish(esp_timer_get_time());
         }
         else if (state == RADIOLIB_ERR_CRC_MISMATCH)
         {
-            Serial.println(F("⚠ CRC error!"));
+            LOG_WARN("⚠ CRC error!");
+            // The damaged payload is still in the buffer; the capture keeps it for analysis
+            snifferPacket(SNIFFER_RX, SNIFFER_FLAG_CRC_ERROR, rxAtUs, radio.getRSSI(), radio.getSNR(), buffer,
+                          min((size_t)radio.getPacketLength(), sizeof(buffer)));
         }
         else
         {
-            Serial.printf("⚠ Read error, code: %d\n", state);
+            LOG_WARN("⚠ Read error, code: %d", state);
         }
+        markFrameHandled();
 
         // ✅ CRITICAL FIX: Put radio back into receive mode
         state = radio.startReceive();
         if (state != RADIOLIB_ERR_NONE)
         {
-            Serial.print(F("✗ Failed to restart receive, code: "));
-            Serial.println(state);
+            LOG_ERROR("✗ Failed to restart receive, code: %d", state);
             radioInitialized = false;
         }
     }
@@ -509,18 +690,14 @@ void handleLoRaReceive()
 
 void handleLoRaPacket(uint8_t *data, size_t length, int rssi, float snr)
 {
+    // Settings as published when the packet arrived, for the whole packet
+    ConfigReadGuard cfg(configSnapshots, CONFIG_READER_LOOP);
+
     // Log to serial
-    Serial.printf("\n📡 LoRa RX: %d bytes | RSSI: %d dBm | SNR: %.1f dB\n", length, rssi, snr);
+    LOG_INFO("\n📡 LoRa RX: %d bytes | RSSI: %d dBm | SNR: %.1f dB", length, rssi, snr);
 
-    // Print hex dump (first 32 bytes)
-    Serial.print("   Data: ");
-    for (size_t i = 0; i < min(length, (size_t)32); i++)
-    {
-        Serial.printf("%02X ", data[i]);
-    }
-    if (length > 32)
-        Serial.print("...");
-    Serial.println();
+    // Hex dump (first 32 bytes)
+    LOG_DEBUG("   Data: %s%s", LogHex(data, min(length, (size_t)32)), length > 32 ? " ..." : "");
 
     // Try to interpret as text if printable
     bool isPrintable = true;
@@ -541,12 +718,7 @@ void handleLoRaPacket(uint8_t *data, size_t length, int rssi, float snr)
 
     if (isPrintable && length > 0)
     {
-        Serial.print("   Text: \"");
-        for (size_t i = 0; i < length; i++)
-        {
-            Serial.write(data[i]);
-        }
-        Serial.println("\"");
+        LOG_DEBUG("   Text: \"%s\"", LogText(data, length));
 
         // Simple neighbour discovery on ADVERT messages: "ADVERT <nodeIdHex> <nodeName> <lat> <lon>"
         if (length >= 6 && strncmp((const char *)data, "ADVERT", 6) == 0)
@@ -576,11 +748,11 @@ void handleLoRaPacket(uint8_t *data, size_t length, int rssi, float snr)
 
             // Apply access control denylist: drop adverts from denied node IDs
             bool denied = false;
-            if (config.access.denyEnabled)
+            if (cfg->access.denyEnabled)
             {
-                for (uint8_t i = 0; i < config.access.denyCount && i < (sizeof(config.access.denylist) / sizeof(config.access.denylist[0])); ++i)
+                for (uint8_t i = 0; i < cfg->access.denyCount && i < (sizeof(cfg->access.denylist) / sizeof(cfg->access.denylist[0])); ++i)
                 {
-                    if (config.access.denylist[i] == nid && nid != 0)
+                    if (cfg->access.denylist[i] == nid && nid != 0)
                     {
                         denied = true;
                         break;
@@ -590,7 +762,7 @@ void handleLoRaPacket(uint8_t *data, size_t length, int rssi, float snr)
 
             if (denied)
             {
-                Serial.println(F("   ✗ Advert dropped (denied node)"));
+                LOG_INFO("   ✗ Advert dropped (denied node)");
                 // Skip neighbor update and further processing for denied node
                 return;
             }
@@ -625,34 +797,37 @@ void handleLoRaPacket(uint8_t *data, size_t length, int rssi, float snr)
                 neighbors[idx].latitude = lat;
                 neighbors[idx].longitude = lon;
                 neighbors[idx].lastSeenMs = millis();
-                Serial.println(F("   ✓ Neighbour updated from advert"));
+                LOG_DEBUG("   ✓ Neighbour updated from advert");
             }
         }
     }
 
-    // Forward to MQTT if connected
-    if (mqttHandler && mqttHandler->isConnected())
+    pipeline.mark(PIPE_DECODE, esp_timer_get_time());
+
+    // Forward to MQTT (held in the outbound queue while the broker is unreachable)
+    if (mqttHandler)
     {
+        mqttHandler->noteRfReception(snr);
         // If this was an ADVERT received over RF, publish a structured advert event
         if (parsedAdvert)
         {
             mqttHandler->publishAdvert(advertNodeId, advertName, advertLat, advertLon);
         }
         // Publish raw packet
-        if (config.mqtt.publishRaw)
+        if (cfg->mqtt.publishRaw)
         {
             mqttHandler->publishRawPacket(data, length, rssi, snr);
         }
 
         // Publish decoded message if it looks like text
-        if (config.mqtt.publishDecoded && isPrintable)
+        if (cfg->mqtt.publishDecoded && isPrintable)
         {
             char message[256] = {0};
             size_t msgLen = min(length, sizeof(message) - 1);
             memcpy(message, data, msgLen);
 
             // For ADVERT messages, set origin to the advertising node; otherwise use gateway id
-            uint32_t fromId = parsedAdvert && advertNodeId != 0 ? advertNodeId : config.repeater.nodeId;
+            uint32_t fromId = parsedAdvert && advertNodeId != 0 ? advertNodeId : cfg->repeater.nodeId;
             mqttHandler->publishDecodedMessage(
                 fromId,
                 0xFFFFFFFF, // to (broadcast)
@@ -665,12 +840,15 @@ void handleLoRaPacket(uint8_t *data, size_t length, int rssi, float snr)
         }
 
         packetsForwarded++;
+        pipeline.mark(PIPE_PUBLISH, esp_timer_get_time());
     }
 
+    markFrameHandled();
+
     // Optional: Repeat packet if configured as repeater
     // This is a simple repeater - just retransmit what we receive
     // In a real mesh implementation, you'd check hop count, routing, etc.
-    if (config.repeater.maxHops > 0 && length > 0)
+    if (cfg->repeater.maxHops > 0 && length > 0)
     {
         unsigned long nowMs = millis();
         uint32_t h = fnv1aHash32(data, length);
@@ -681,13 +859,13 @@ void handleLoRaPacket(uint8_t *data, size_t length, int rssi, float snr)
             // Retransmit
             if (sendLoRaPacket(data, length))
             {
-                Serial.println("   ↻ Packet repeated");
+                LOG_INFO("   ↻ Packet repeated");
                 rememberPacket(h, millis());
             }
         }
         else
         {
-            Serial.println("   ↻ Skipped repeat (duplicate seen recently)");
+            LOG_DEBUG("   ↻ Skipped repeat (duplicate seen recently)");
         }
     }
 }
@@ -700,15 +878,19 @@ bool sendLoRaPacket(const uint8_t *data, size_t length)
         return false;
     }
 
-    Serial.printf("\n📤 LoRa TX: %d bytes\n", length);
+    LOG_INFO("\n📤 LoRa TX: %d bytes", length);
 
     // Transmit the packet
+    int64_t txAtUs = esp_timer_get_time();
+    pipeline.mark(PIPE_REPEAT_WAIT, txAtUs); // only while a received frame is being repeated
     int state = radio.transmit((uint8_t *)data, length);
+    pipeline.mark(PIPE_REPEAT_TX, esp_timer_get_time());
+    snifferPacket(SNIFFER_TX, state == RADIOLIB_ERR_NONE ? 0 : SNIFFER_FLAG_TX_FAILED, txAtUs, 0, 0.0f, data, length);
 
     if (state == RADIOLIB_ERR_NONE)
     {
         packetsSent++;
-        Serial.println("   ✓ Sent successfully");
+        LOG_DEBUG("   ✓ Sent successfully");
 
         // Put radio back into receive mode
         radio.startReceive();
@@ -717,8 +899,7 @@ bool sendLoRaPacket(const uint8_t *data, size_t length)
     else
     {
         packetsFailed++;
-        Serial.print("   ✗ Failed, code: ");
-        Serial.println(state);
+        LOG_WARN("   ✗ Failed, code: %d", state);
 
         // Try to recover
         radio.startReceive();
@@ -728,15 +909,29 @@ bool sendLoRaPacket(const uint8_t *data, size_t length)
 
 void checkSerialInput()
 {
-    if (Serial.available())
+    hostLine.expire(millis());
+    while (Serial.available())
     {
         char c = Serial.read();
 
+        // A command line is read whole in one pass; single keys are handled one per pass
+        if (c == HOST_COMMAND_PREFIX || hostLine.active())
+        {
+            if (hostLine.feed(c, millis()))
+            {
+                handleHostCommand(hostLine.line(), hostLine.overflowed());
+                return;
+            }
+            continue;
+        }
+
         switch (c)
         {
         case 'c':
         case 'C':
             configMode = true;
+            config = configSnapshots.config(); // edit a copy of what is running, runtime changes included
+            logHold(true);                     // live view paused; radio and uplink keep running
             serialConfig->showMainMenu();
             break;
 
@@ -771,6 +966,42 @@ void checkSerialInput()
             Serial.printf("│ Packets Failed:      %u\n", packetsFailed);
             Serial.printf("│ Radio Initialized:   %s\n", radioInitialized ? "YES" : "NO");
             Serial.printf("│ Packet Flag:         %s\n", packetReceived ? "SET" : "CLEAR");
+            {
+                const SettingsLoadStats& ls = settingsManager.getLoadStats();
+                const SettingsSaveStats& ss = settingsManager.getSaveStats();
+                Serial.printf("│ Settings Load:       %s v%u, %lu us\n",
+                              ls.source == CONFIG_SOURCE_BLOB ? "blob" : ls.source == CONFIG_SOURCE_LEGACY ? "per-key" : "defaults",
+                              (unsigned)ls.version, (unsigned long)ls.us);
+                Serial.printf("│ Settings Saves:      %lu (%lu written, %lu unchanged, %lu failed)\n", (unsigned long)ss.saves,
+                              (unsigned long)ss.writes, (unsigned long)ss.unchanged, (unsigned long)ss.failures);
+                Serial.printf("│ Last Save:           %lu ms (max %lu ms)\n", (unsigned long)(ss.lastUs / 1000),
+                              (unsigned long)(ss.maxUs / 1000));
+            }
+            {
+                LatencyPercentiles frame = frameLatency.percentiles();
+                Serial.printf("│ Frame Handling:      p50 %lu us, p99 %lu us, max %lu us (%lu frames)\n",
+                              (unsigned long)frame.p50, (unsigned long)frame.p99, (unsigned long)frame.max,
+                              (unsigned long)frame.samples);
+                Serial.println(F("│ Pipeline:"));
+                for (uint8_t i = 0; i < PIPE_STAGE_COUNT; ++i)
+                {
+                    const LatencyHistogram &h = pipeline.stage(i);
+                    LatencyPercentiles stage = h.percentiles();
+                    Serial.printf("│   %-19s p50 %lu us, p99 %lu us, max %lu us, mean %lu us (%lu)\n",
+                                  pipelineStageName(i), (unsigned long)stage.p50, (unsigned long)stage.p99,
+                                  (unsigned long)stage.max, (unsigned long)h.mean(), (unsigned long)stage.samples);
+                }
+                LogStats log = logRing().getStats();
+                Serial.printf("│ Log:                 level %d, %lu lines, %lu dropped, %s\n", LOG_LEVEL,
+                              (unsigned long)log.written, (unsigned long)log.dropped,
+                              logTaskRunning() ? "drain task" : "drained from loop");
+            }
+            {
+                const BootReport &boot = bootTimer.get();
+                Serial.printf("│ Boot:                %s reset, RX up at %lu ms, uplink at %lu ms\n",
+                              resetReasonName(boot.resetReason), (unsigned long)(boot.rxReadyUs / 1000),
+                              (unsigned long)boot.uplinkMs);
+            }
             // Check radio status
             if (radioInitialized)
             {
@@ -792,6 +1023,13 @@ void checkSerialInput()
             Serial.println(F("└────────────────────────────────────────────────────────┘\n"));
             break;
 
+        case 'l':
+        case 'L':
+            Serial.println(F("\n┌── Link Latency ────────────────────────────────────────┐"));
+            printLatencyToSerial();
+            Serial.println(F("└────────────────────────────────────────────────────────┘\n"));
+            break;
+
         case 't':
         case 'T':
             Serial.println(F("\n📡 Sending test packet..."));
@@ -809,6 +1047,223 @@ void checkSerialInput()
             }
             break;
         }
+        break;
+    }
+}
+
+// Serialize a JSON document as the reply body
+static void hostDocument(HostReply &reply, const JsonDocument &doc)
+{
+    size_t length = measureJson(doc);
+    if (length < reply.room())
+        serializeJson(doc, reply.tail(), reply.room());
+    reply.advance(length);
+}
+
+static void hostGet(HostReply &reply, int argc, char **argv)
+{
+    hostGetConfig(reply, configSnapshots.config(), argc, argv);
+}
+
+// All pairs are checked before anything is applied, then go out as one snapshot, the same
+// way the menu applies its draft
+static void hostSet(HostReply &reply, int argc, char **argv)
+{
+    config = configSnapshots.config();
+    if (!hostParseSet(reply, config, argc, argv))
+    {
+        config = configSnapshots.config();
+        return;
+    }
+    uint16_t changes = configChanges(configSnapshots.config(), config);
+    uint32_t version = configSnapshots.version();
+    LoRaConfig requested = config.lora;
+    applyConfig();
+    if (configSnapshots.version() == version)
+    {
+        hostError(reply, "not applied (out of memory)");
+        return;
+    }
+    if (memcmp(&requested, &configSnapshots.config().lora, sizeof(LoRaConfig)) != 0)
+    {
+        hostError(reply, "radio rejected the settings, previous radio settings restored");
+        return;
+    }
+    reply.open();
+    reply.key("version");
+    reply.number(configSnapshots.version());
+    reply.key("restart");
+    reply.boolean(changes & CONFIG_CHANGE_RESTART);
+    reply.key("saved");
+    reply.boolean(false);
+    reply.close();
+}
+
+static void hostSave(HostReply &reply)
+{
+    if (!settingsManager.saveConfig(configSnapshots.config()))
+    {
+        hostError(reply, "flash write failed");
+        return;
+    }
+    reply.open();
+    reply.key("saved");
+    reply.boolean(true);
+    reply.key("version");
+    reply.number(configSnapshots.version());
+    reply.close();
+}
+
+// Same document as the MQTT stats topic plus the console-only figures from 'd'
+static void hostStats(HostReply &reply)
+{
+    // Heap, not the loop task's stack
+    DynamicJsonDocument doc(MQTT_STATS_DOC_BYTES);
+    if (doc.capacity() == 0)
+    {
+        hostError(reply, "out of memory");
+        return;
+    }
+    if (mqttHandler)
+    {
+        mqttHandler->buildStats(doc, packetsReceived, packetsSent, packetsForwarded, packetsFailed);
+    }
+    else
+    {
+        doc["timestamp"] = millis();
+        doc["uptime"] = millis() / 1000;
+        doc["packetsReceived"] = packetsReceived;
+        doc["packetsSent"] = packetsSent;
+        doc["packetsForwarded"] = packetsForwarded;
+        doc["packetsFailed"] = packetsFailed;
+        doc["freeHeap"] = ESP.getFreeHeap();
+        MQTTHandler::addPipeline(doc.createNestedObject("pipeline"), pipeline);
+    }
+    doc["radio"] = radioInitialized;
+    doc["configVersion"] = configSnapshots.version();
+    MQTTHandler::addPercentiles(doc.createNestedObject("frameUs"), frameLatency.percentiles());
+    LogStats log = logRing().getStats();
+    JsonObject logging = doc.createNestedObject("log");
+    logging["written"] = log.written;
+    logging["dropped"] = log.dropped;
+    SnifferStats sniff = sniffer.getStats();
+    JsonObject capture = doc.createNestedObject("sniffer");
+    capture["active"] = sniffer.isActive();
+    capture["records"] = sniff.records;
+    capture["dropped"] = sniff.dropped;
+    hostDocument(reply, doc);
+}
+
+static void hostNeighbours(HostReply &reply)
+{
+    StaticJsonDocument<2048> doc;
+    MQTTHandler::buildNeighbors(doc, configSnapshots.config(), neighbors, neighborCount);
+    hostDocument(reply, doc);
+}
+
+// Human logs are held while the capture runs; the baud rate changes after the reply is sent
+static void hostSniff(HostReply &reply, int argc, char **argv)
+{
+    bool on = argc > 1 && !strcmp(argv[1], "on");
+    if (argc < 2 || argc > 3 || (!on && strcmp(argv[1], "off")) || (!on && argc > 2))
+    {
+        hostError(reply, "usage: sniff on [baud] | sniff off");
+        return;
+    }
+    unsigned long baud = on ? SNIFFER_BAUD : 115200;
+    if (argc > 2)
+    {
+        char *end;
+        baud = strtoul(argv[2], &end, 10);
+        if (*end != '\0' || baud < 9600 || baud > 5000000)
+        {
+            hostError(reply, "baud out of range", argv[2]);
+            return;
+        }
+    }
+    if (on)
+    {
+        sniffer.start();
+        logHold(true);
+    }
+    else
+    {
+        sniffer.stop();
+        logHold(false);
+    }
+    SnifferStats stats = sniffer.getStats();
+    reply.open();
+    reply.key("sniffer");
+    reply.boolean(on);
+    reply.key("baud");
+    reply.number(baud);
+    reply.key("records");
+    reply.number(stats.records);
+    reply.key("dropped");
+    reply.number(stats.dropped);
+    reply.close();
+    sniffBaudChange = baud;
+}
+
+static void hostHelp(HostReply &reply)
+{
+    static const char *const commands[] = {"get", "set", "save", "stats", "neighbours", "sniff", "help"};
+    reply.open();
+    reply.key("commands");
+    reply.openArray();
+    for (const char *command : commands)
+        reply.string(command);
+    reply.closeArray();
+    reply.key("keys");
+    reply.openArray();
+    for (size_t i = 0; i < CONFIG_KEY_COUNT; ++i)
+        reply.string(CONFIG_KEYS[i].name);
+    reply.closeArray();
+    reply.close();
+}
+
+// Run one '@' command line and write its single reply line
+void handleHostCommand(char *line, bool overflowed)
+{
+    HostReply reply(hostReplyBuffer, sizeof(hostReplyBuffer));
+    char *argv[HOST_MAX_ARGS];
+    int argc = overflowed ? 0 : splitHostArgs(line, argv, HOST_MAX_ARGS);
+
+    if (overflowed)
+        hostError(reply, "line too long");
+    else if (argc < 0)
+        hostError(reply, "unterminated quote or too many arguments");
+    else if (argc == 0)
+        hostError(reply, "empty command");
+    else if (!strcmp(argv[0], "get"))
+        hostGet(reply, argc, argv);
+    else if (!strcmp(argv[0], "set"))
+        hostSet(reply, argc, argv);
+    else if (!strcmp(argv[0], "save"))
+        hostSave(reply);
+    else if (!strcmp(argv[0], "stats"))
+        hostStats(reply);
+    else if (!strcmp(argv[0], "neighbours") || !strcmp(argv[0], "neighbors"))
+        hostNeighbours(reply);
+    else if (!strcmp(argv[0], "sniff"))
+        hostSniff(reply, argc, argv);
+    else if (!strcmp(argv[0], "help"))
+        hostHelp(reply);
+    else
+        hostError(reply, "unknown command", argv[0]);
+
+    if (!reply.finish())
+    {
+        hostError(reply, "reply too long");
+        reply.finish();
+    }
+    Serial.write((const uint8_t *)reply.text(), reply.textLength());
+
+    if (sniffBaudChange)
+    {
+        Serial.flush();
+        Serial.updateBaudRate(sniffBaudChange);
+        sniffBaudChange = 0;
     }
 }
 
@@ -839,22 +1294,24 @@ void blinkLED()
 
 void sendAdvert()
 {
+    ConfigReadGuard cfg(configSnapshots, CONFIG_READER_LOOP);
+
     // Compose a simple advert string: ADVERT <nodeIdHex> <nodeName> <lat> <lon>
     char payload[160];
     snprintf(payload, sizeof(payload), "ADVERT %08X %s %.6f %.6f",
-             config.repeater.nodeId,
-             config.repeater.nodeName,
-             (double)config.location.latitude,
-             (double)config.location.longitude);
+             cfg->repeater.nodeId,
+             cfg->repeater.nodeName,
+             (double)cfg->location.latitude,
+             (double)cfg->location.longitude);
     sendLoRaPacket((const uint8_t *)payload, strlen(payload));
-    // Also publish an advert event on MQTT for visibility if connected
-    if (mqttHandler && mqttHandler->isConnected())
+    // Also publish an advert event on MQTT for visibility (queued if offline)
+    if (mqttHandler)
     {
         mqttHandler->publishAdvert(
-            config.repeater.nodeId,
-            config.repeater.nodeName,
-            config.location.latitude,
-            config.location.longitude);
+            cfg->repeater.nodeId,
+            cfg->repeater.nodeName,
+            cfg->location.latitude,
+            cfg->location.longitude);
     }
 }
 
@@ -870,6 +1327,76 @@ void printTelemetryToSerial()
         Serial.printf("WiFi RSSI:        %-36d \n", WiFi.RSSI());
         Serial.printf("IP Address:       %-36s \n", WiFi.localIP().toString().c_str());
     }
+    if (mqttHandler)
+    {
+        OutboundQueueStats q = mqttHandler->getQueueStats();
+        Serial.printf("Uplink Queue:     %-36lu \n", (unsigned long)q.depth);
+        Serial.printf("Queue Spill:      %-36s \n", (String(q.spillBytes) + " bytes").c_str());
+        Serial.printf("Replay Rate:      %-36s \n", (String(q.replayRate, 1) + " msg/s").c_str());
+        Serial.printf("Queue Dropped:    %-36lu \n", (unsigned long)q.dropped);
+        Serial.printf("MQTT Transport:   %-36s \n", (String(mqttHandler->transportName()) +
+                                                       (mqttHandler->protocolVersion() == MQTT_PROTOCOL_V5 ? " / MQTT 5" : " / MQTT 3.1.1")).c_str());
+        LinkStats link = mqttHandler->getLinkStats();
+        Serial.printf("Uplink State:     %-36s \n", (String(linkStateName(link.state)) + " for " + String(link.stateAgeMs / 1000) + "s").c_str());
+        char phases[48];
+        snprintf(phases, sizeof(phases), "wifi %lu  time %lu  mqtt %lu",
+                 (unsigned long)link.phases[LINK_PHASE_WIFI].lastMs,
+                 (unsigned long)link.phases[LINK_PHASE_TIME].lastMs,
+                 (unsigned long)link.phases[LINK_PHASE_MQTT].lastMs);
+        Serial.printf("Link Phases (ms): %-36s \n", phases);
+        Serial.printf("Link Sessions:    %-36s \n", (String(link.sessions) + " (last outage " + String(link.lastOutageMs / 1000) + "s)").c_str());
+        char reconnectLine[64];
+        snprintf(reconnectLine, sizeof(reconnectLine), "dns %lu%s tcp %lu tls %lu%s conn %lu sub %lu%s",
+                 (unsigned long)link.reconnect.dnsMs, link.reconnect.dnsCached ? "c" : "",
+                 (unsigned long)link.reconnect.tcpMs, (unsigned long)link.reconnect.tlsMs,
+                 link.reconnect.tlsResumed ? "r" : "",
+                 (unsigned long)link.reconnect.connectMs, (unsigned long)link.reconnect.subscribeMs,
+                 link.reconnect.sessionResumed ? "k" : "");
+        Serial.printf("Reconnect (ms):   %-36s \n", reconnectLine);
+    }
+}
+
+void printLatencyToSerial()
+{
+    if (!mqttHandler)
+    {
+        Serial.println(F("(MQTT disabled)"));
+        return;
+    }
+    LatencyReport lat = mqttHandler->getLatency();
+    Serial.printf("Broker RTT (ms):  p50 %lu  p90 %lu  p99 %lu  max %lu  (%lu samples)\n",
+                  (unsigned long)lat.rttMs.p50, (unsigned long)lat.rttMs.p90, (unsigned long)lat.rttMs.p99,
+                  (unsigned long)lat.rttMs.max, (unsigned long)lat.rttMs.samples);
+    Serial.printf("Probes:           %lu sent, %lu lost\n", (unsigned long)lat.probesSent, (unsigned long)lat.probesLost);
+    Serial.printf("Publish (us):     p50 %lu  p90 %lu  p99 %lu  max %lu\n",
+                  (unsigned long)lat.publishUs.p50, (unsigned long)lat.publishUs.p90,
+                  (unsigned long)lat.publishUs.p99, (unsigned long)lat.publishUs.max);
+    Serial.printf("Socket write (us): p50 %lu  p90 %lu  p99 %lu  max %lu\n",
+                  (unsigned long)lat.writeUs.p50, (unsigned long)lat.writeUs.p90,
+                  (unsigned long)lat.writeUs.p99, (unsigned long)lat.writeUs.max);
+    Serial.printf("Write stalls:     %lu (> %lu ms)\n", (unsigned long)lat.writeStalls,
+                  (unsigned long)(LATENCY_WRITE_STALL_US / 1000UL));
+#ifndef USE_ETHERNET
+    Serial.printf("WiFi RSSI:        %d dBm\n", WiFi.RSSI());
+#endif
+}
+
+// Reset reason, time-to-first-RX and where the rest of setup() went
+void printBootToSerial()
+{
+    const BootReport &boot = bootTimer.get();
+    Serial.printf("Boot (%s reset): RX up at %lu ms, setup done at %lu ms\n", resetReasonName(boot.resetReason),
+                  (unsigned long)(boot.rxReadyUs / 1000), (unsigned long)(bootTimer.totalUs() / 1000));
+    Serial.print(F("Boot phases (ms):"));
+    for (uint8_t i = 0; i < BOOT_PHASE_COUNT; ++i)
+    {
+        Serial.printf(" %s %.1f", bootPhaseName(i), boot.phaseUs[i] / 1000.0f);
+    }
+    Serial.println();
+    if (boot.uplinkMs)
+    {
+        Serial.printf("First broker session: %lu ms\n", (unsigned long)boot.uplinkMs);
+    }
 }
 
 void printNeighboursToSerial()
@@ -894,13 +1421,122 @@ void printNeighboursToSerial()
     }
 }
 
+// Menu quick test after a save: the draft goes live now rather than on exit, so the test
+// watches the gateway's own uplink reconnect with it
+MQTTHandler *applyForQuickTest()
+{
+    applyConfig(serialConfig->commitCaEdits() ? CONFIG_CHANGE_BROKER : 0);
+    return mqttHandler;
+}
+
 // Exit configuration mode helper
 void exitConfigMode()
 {
     configMode = false;
+    logHold(sniffer.isActive());
     Serial.println(F("\n✓ Exited configuration mode"));
 
-    // Restart if configuration changed significantly
-    Serial.println(F("⚠ Some changes may require a restart"));
+    // A new or removed CA is not part of the settings diff; the broker reconnects to use it
+    applyConfig(serialConfig->commitCaEdits() ? CONFIG_CHANGE_BROKER : 0);
     Serial.println(F("(Hint) Live view resumed. Press 'c' to return to the menu"));
 }
+
+// Retune the modem in place with the RadioLib setters, touching only what changed, and go
+// straight back to RX. Returns the first RadioLib error, or RADIOLIB_ERR_NONE.
+int applyRadioConfig(const LoRaConfig &previous)
+{
+    const LoRaConfig &lora = configSnapshots.config().lora;
+    int state = radio.standby();
+    if (state == RADIOLIB_ERR_NONE && lora.frequency != previous.frequency)
+        state = radio.setFrequency(lora.frequency);
+    if (state == RADIOLIB_ERR_NONE && lora.bandwidth != previous.bandwidth)
+        state = radio.setBandwidth(lora.bandwidth);
+    if (state == RADIOLIB_ERR_NONE && lora.spreadingFactor != previous.spreadingFactor)
+        state = radio.setSpreadingFactor(lora.spreadingFactor);
+    if (state == RADIOLIB_ERR_NONE && lora.codingRate != previous.codingRate)
+        state = radio.setCodingRate(lora.codingRate);
+    if (state == RADIOLIB_ERR_NONE && lora.syncWord != previous.syncWord)
+        state = radio.setSyncWord(lora.syncWord);
+    if (state == RADIOLIB_ERR_NONE && lora.txPower != previous.txPower)
+    {
+#if defined(LILYGO_LORA32_V21)
+        state = radio.setOutputPower(lora.txPower, true); // PA_BOOST, as in setupLoRa()
+#else
+        state = radio.setOutputPower(lora.txPower);
+#endif
+    }
+    if (state == RADIOLIB_ERR_NONE && lora.enableCRC != previous.enableCRC)
+        state = radio.setCRC(lora.enableCRC);
+    int rx = radio.startReceive();
+    return state != RADIOLIB_ERR_NONE ? state : rx;
+}
+
+// Apply whatever differs from the running configuration without a reboot: the radio is
+// retuned in place, the uplink reconnects or resubscribes in the background. Used by the
+// serial menu on exit and by the MQTT config command. The draft is published as a new
+// snapshot first, so every reader switches to the new settings at once. forced adds change
+// bits the settings diff cannot see.
+void applyConfig(uint16_t forced)
+{
+    // Pins the outgoing snapshot so it can be diffed against after the swap
+    ConfigReadGuard previous(configSnapshots, CONFIG_READER_LOOP);
+    if (!configSnapshots.publish(config))
+    {
+        Serial.println(F("✗ Settings not applied (out of memory), try again"));
+        return;
+    }
+    uint16_t changes = configChanges(*previous, configSnapshots.config()) | forced;
+    unsigned long started = micros();
+    String applied;
+
+    if (changes & CONFIG_CHANGE_RADIO)
+    {
+        unsigned long radioStart = micros();
+        int state = radioInitialized ? applyRadioConfig(previous->lora) : RADIOLIB_ERR_NONE;
+        if (!radioInitialized)
+        {
+            setupLoRa();
+        }
+        else if (state != RADIOLIB_ERR_NONE)
+        {
+            // A rejected value may leave the modem half-retuned; bring back the previous settings
+            Serial.printf("✗ Radio settings rejected (code %d), restoring previous settings\n", state);
+            config.lora = previous->lora;
+            configSnapshots.publish(config);
+            setupLoRa();
+        }
+        applied += String("radio ") + String((micros() - radioStart) / 1000.0f, 1) + " ms, ";
+    }
+
+    if (mqttHandler)
+    {
+        mqttHandler->reconfigure(changes);
+        if (changes & (CONFIG_CHANGE_WIFI | CONFIG_CHANGE_BROKER))
+            applied += "broker reconnect, ";
+        else if (changes & CONFIG_CHANGE_TOPICS)
+            applied += "new MQTT session, ";
+        else if (changes & CONFIG_CHANGE_INTEREST)
+            applied += "resubscribe, ";
+        if (changes & CONFIG_CHANGE_BRIDGE_LIMITS)
+            applied += "bridge limits, ";
+    }
+    else if (config.wifi.enabled && config.mqtt.enabled)
+    {
+        startMqttHandler();
+        applied += "MQTT started, ";
+    }
+
+    if (applied.length() > 0)
+    {
+        applied.remove(applied.length() - 2);
+        Serial.printf("✓ Settings applied in %.1f ms: %s\n", (micros() - started) / 1000.0f, applied.c_str());
+    }
+    else if (!(changes & CONFIG_CHANGE_RESTART))
+    {
+        Serial.println(F("✓ Settings applied (no restart needed)"));
+    }
+    if (changes & CONFIG_CHANGE_RESTART)
+    {
+        Serial.println(F("⚠ Transport, additional broker or disable changes take effect after a restart"));
+    }
+}
@@ -0,0 +1,720 @@
+#ifndef MQTT_ASYNC_TRANSPORT_H
+#define MQTT_ASYNC_TRANSPORT_H
+
+#include <Arduino.h>
+#include "mqtt_transport.h"
+#include "mqtt_session_state.h"
+
+#ifdef ESP32
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/ringbuf.h>
+
+// Ring buffers between the main loop and the I/O task (variable-length, no-split items). A
+// no-split item takes at most half the ring, so TX is sized for a 4 KB packet (stats).
+#define MQTT_ASYNC_TX_RING_BYTES 8192
+#define MQTT_ASYNC_RX_RING_BYTES 4096
+#define MQTT_ASYNC_RX_FRAME_BYTES 2048
+// QoS 1 publishes awaiting PUBACK; publish() refuses new QoS 1 messages when the window is full
+#define MQTT_ASYNC_INFLIGHT_WINDOW 8
+#define MQTT_ASYNC_RETRY_MS 5000
+#define MQTT_ASYNC_CONNACK_TIMEOUT_MS 10000
+#define MQTT_ASYNC_TASK_STACK 8192   // TLS handshake runs on this stack
+#define MQTT_ASYNC_TASK_PRIORITY 2
+#define MQTT_ASYNC_TASK_CORE 0       // keep network work on the WiFi core, loop() stays on core 1
+#define MQTT_ASYNC_RX_PER_LOOP 8
+// MQTT 5 outbound topic aliases, assigned first-come per session (no eviction)
+#define MQTT_ASYNC_TOPIC_ALIASES 8
+#define MQTT_ASYNC_ALIAS_TOPIC_BYTES 128
+
+// PubSubClient-compatible state codes so existing log output stays meaningful
+#define MQTT_ASYNC_CONNECTION_TIMEOUT -4
+#define MQTT_ASYNC_CONNECTION_LOST -3
+#define MQTT_ASYNC_CONNECT_FAILED -2
+#define MQTT_ASYNC_DISCONNECTED -1
+#define MQTT_ASYNC_CONNECTED 0
+
+struct AsyncTransportStats {
+    uint32_t published;
+    uint32_t acked;
+    uint32_t retransmits;
+    uint32_t inflight;
+    uint32_t rxDropped;
+    uint32_t subscribeFailures;
+    uint8_t protocolVersion;
+    uint32_t topicAliases;      // aliases assigned in the current session
+    uint32_t aliasBytesSaved;   // topic bytes not sent thanks to aliases
+    uint32_t discarded;         // publishes dropped: meant for another broker, or not re-encodable
+};
+
+// Event-driven MQTT client: a dedicated FreeRTOS task owns the socket, performs the
+// (blocking) TCP/TLS connect off the main loop, reads without blocking and writes queued
+// packets. The main loop only encodes into a ring buffer and drains received messages.
+class AsyncMQTTTransport : public MQTTTransport {
+public:
+    AsyncMQTTTransport(Client& c)
+        : client(&c), port(1883), useIp(false), nextClient(&c), nextPort(1883), nextUseIp(false),
+          txRing(nullptr), rxRing(nullptr), task(nullptr),
+          lastState(MQTT_ASYNC_DISCONNECTED), inflightReserved(0),
+          nextPacketId(1), reader(rxFrame, sizeof(rxFrame)),
+          keepAliveMs(60000), lastTx(0), lastRx(0), pingOutstanding(false),
+          connackDeadline(0), sessionVersion(MQTT_PROTOCOL_V311), resumed(false), v5Rejected(false),
+          inflightLimit(MQTT_ASYNC_INFLIGHT_WINDOW), endpoint(0), brokerAliasMax(0), aliasCount(0),
+          published(0), acked(0), retransmits(0), rxDropped(0), subscribeFailures(0), aliasBytesSaved(0),
+          discarded(0), subscribesPending(0) {
+        memset(inflight, 0, sizeof(inflight));
+        memset(aliasTopicLen, 0, sizeof(aliasTopicLen));
+        endpointHost[0] = '\0';
+        nextHost[0] = '\0';
+    }
+
+    ~AsyncMQTTTransport() override {
+        // Let the task close the socket cleanly before it is torn down
+        disconnect();
+        unsigned long start = millis();
+        while (st.load() != MQTT_SESSION_IDLE && millis() - start < 1000UL) delay(10);
+        if (task) vTaskDelete(task);
+        if (txRing) vRingbufferDelete(txRing);
+        if (rxRing) vRingbufferDelete(rxRing);
+        for (size_t i = 0; i < MQTT_ASYNC_INFLIGHT_WINDOW; ++i) {
+            if (inflight[i].data) free(inflight[i].data);
+        }
+    }
+
+    const char* name() const override { return "async"; }
+
+    // Allocate ring buffers and start the I/O task; returns false if resources are unavailable
+    bool start() {
+        if (task) return true;
+        txRing = xRingbufferCreate(MQTT_ASYNC_TX_RING_BYTES, RINGBUF_TYPE_NOSPLIT);
+        rxRing = xRingbufferCreate(MQTT_ASYNC_RX_RING_BYTES, RINGBUF_TYPE_NOSPLIT);
+        if (!txRing || !rxRing) return false;
+        return xTaskCreatePinnedToCore(taskEntry, "mqtt_io", MQTT_ASYNC_TASK_STACK, this,
+                                       MQTT_ASYNC_TASK_PRIORITY, &task, MQTT_ASYNC_TASK_CORE) == pdPASS;
+    }
+
+    // The task reads the connection parameters while it connects, so these only stage them
+    // (the host name is copied); the next connect() from idle puts them in effect
+    void setClient(Client& c) override { nextClient = &c; }
+    void setServer(const char* h, uint16_t p) override {
+        copyStr(nextHost, sizeof(nextHost), h);
+        nextPort = p;
+        nextUseIp = false;
+    }
+    void setServer(IPAddress ip, uint16_t p) override { nextIp = ip; nextPort = p; nextUseIp = true; }
+    void setCallback(MQTTInboundCallback cb) override { callback = cb; }
+
+    MQTTConnectResult connect(const MqttConnectOptions& o) override {
+        uint8_t s = st.load();
+        if (s == MQTT_SESSION_CONNECTED) return MQTT_CONNECT_OK;
+        if (s != MQTT_SESSION_IDLE) return MQTT_CONNECT_PENDING;
+        if (!task) return MQTT_CONNECT_FAILED;
+        applyServer();
+        copyStr(clientId, sizeof(clientId), o.clientId);
+        copyStr(username, sizeof(username), o.username);
+        copyStr(password, sizeof(password), o.password);
+        copyStr(willTopic, sizeof(willTopic), o.willTopic);
+        copyStr(willPayload, sizeof(willPayload), o.willPayload);
+        options = o;
+        options.clientId = clientId;
+        options.username = username;
+        options.password = o.password ? password : nullptr;
+        options.willTopic = willTopic;
+        options.willPayload = willPayload;
+        // A broker that refused MQTT 5 once gets 3.1.1 for the rest of this boot
+        if (options.protocolVersion != MQTT_PROTOCOL_V5 || v5Rejected) options.protocolVersion = MQTT_PROTOCOL_V311;
+        options.topicAliasMax = 0; // inbound aliases are not used; the broker always sends full topics
+        keepAliveMs = (uint32_t)o.keepAliveSec * 1000UL;
+        if (!st.requestConnect()) return MQTT_CONNECT_PENDING;
+        xTaskNotifyGive(task);
+        return MQTT_CONNECT_PENDING;
+    }
+
+    bool connecting() override {
+        uint8_t s = st.load();
+        return s == MQTT_SESSION_REQ_CONNECT || s == MQTT_SESSION_CONNECTING || s == MQTT_SESSION_WAIT_CONNACK;
+    }
+
+    bool connected() override { return st.load() == MQTT_SESSION_CONNECTED; }
+    bool idle() override { return st.load() == MQTT_SESSION_IDLE; }
+
+    void disconnect() override {
+        if (st.requestDisconnect() && task) xTaskNotifyGive(task);
+    }
+
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retain, uint8_t qos,
+                 uint32_t expirySec = 0) override {
+        if (st.load() != MQTT_SESSION_CONNECTED || !txRing) return false;
+        if (qos > 1) qos = 1;
+        if (qos == 1 && inflightReserved.fetch_add(1) >= inflightLimit) {
+            inflightReserved--;
+            return false; // window full: caller keeps the message (store-and-forward)
+        }
+        uint16_t id = (qos == 1) ? allocPacketId() : 0;
+        // Queued with the full topic; the I/O task substitutes a topic alias when it writes
+        MqttPublishProps props = { 0, expirySec };
+        const MqttPublishProps* p = (sessionVersion == MQTT_PROTOCOL_V5) ? &props : nullptr;
+        size_t topicLen = strlen(topic);
+        size_t pktLen = mqttPublishSize(topicLen, length, qos, p);
+        void* mem = nullptr;
+        if (xRingbufferSendAcquire(txRing, &mem, TX_ITEM_HEADER + pktLen, 0) != pdTRUE) {
+            if (qos == 1) inflightReserved--;
+            return false;
+        }
+        uint8_t* item = (uint8_t*)mem;
+        writeItemHeader(item, qos, id);
+        mqttEncodePublish(item + TX_ITEM_HEADER, pktLen, topic, topicLen, payload, length, qos, retain, id, false, p);
+        xRingbufferSendComplete(txRing, mem);
+        published++;
+        xTaskNotifyGive(task);
+        return true;
+    }
+
+    bool subscribe(const char* topic, uint8_t qos, bool noLocal = false) override {
+        const char* topics[1] = { topic };
+        uint8_t options = (uint8_t)(qos | (noLocal ? MQTT_SUB_NO_LOCAL : 0));
+        return subscribeMany(topics, &options, 1);
+    }
+
+    bool unsubscribe(const char* topic) override {
+        const char* topics[1] = { topic };
+        return unsubscribeMany(topics, 1);
+    }
+
+    // One SUBSCRIBE carrying several topic filters; options are QoS | MQTT_SUB_* flags
+    bool subscribeMany(const char* const* topics, const uint8_t* options, size_t count) override {
+        if (st.load() != MQTT_SESSION_CONNECTED || !txRing) return false;
+        uint8_t pkt[1024];
+        size_t n = mqttEncodeSubscribe(pkt, sizeof(pkt), allocPacketId(), topics, options, count,
+                                       sessionVersion == MQTT_PROTOCOL_V5);
+        if (n == 0) return false;
+        subscribesPending++;   // before queueing: the SUBACK may arrive first
+        if (enqueueControl(pkt, n)) return true;
+        subscribesPending--;
+        return false;
+    }
+
+    bool unsubscribeMany(const char* const* topics, size_t count) override {
+        if (st.load() != MQTT_SESSION_CONNECTED || !txRing) return false;
+        uint8_t pkt[1024];
+        size_t n = mqttEncodeUnsubscribe(pkt, sizeof(pkt), allocPacketId(), topics, count,
+                                         sessionVersion == MQTT_PROTOCOL_V5);
+        return n > 0 && enqueueControl(pkt, n);
+    }
+
+    void loop() override {
+        if (!rxRing) return;
+        for (int i = 0; i < MQTT_ASYNC_RX_PER_LOOP; ++i) {
+            size_t size = 0;
+            uint8_t* item = (uint8_t*)xRingbufferReceive(rxRing, &size, 0);
+            if (!item) break;
+            uint16_t topicLen = (uint16_t)((item[0] << 8) | item[1]);
+            char* topic = (char*)(item + 2);
+            uint8_t* payload = item + 2 + topicLen + 1;
+            unsigned int payloadLen = (unsigned int)(size - 2 - topicLen - 1);
+            if (callback) callback(topic, payload, payloadLen);
+            vRingbufferReturnItem(rxRing, item);
+        }
+    }
+
+    int state() override { return lastState; }
+
+    uint32_t pendingSubscribes() const override { return subscribesPending; }
+
+    size_t maxPacketSize() override {
+        return txRing ? xRingbufferGetMaxItemSize(txRing) - TX_ITEM_HEADER : 0;
+    }
+
+    uint8_t protocolVersion() const override { return sessionVersion; }
+    bool sessionPresent() const override { return resumed; }
+
+    AsyncTransportStats getStats() const {
+        AsyncTransportStats s;
+        s.published = published;
+        s.acked = acked;
+        s.retransmits = retransmits;
+        s.inflight = inflightReserved;
+        s.rxDropped = rxDropped;
+        s.subscribeFailures = subscribeFailures;
+        s.protocolVersion = sessionVersion;
+        s.topicAliases = aliasCount;
+        s.aliasBytesSaved = aliasBytesSaved;
+        s.discarded = discarded;
+        return s;
+    }
+
+private:
+    struct InflightSlot {
+        uint16_t packetId;     // 0 = free
+        uint32_t sentMs;
+        uint16_t length;
+        uint8_t version;       // protocol level the packet was encoded for
+        uint8_t endpoint;      // broker it was meant for
+        uint8_t* data;
+    };
+
+    // [qos][protocol level][endpoint][packetId hi][packetId lo]: packets are encoded when
+    // queued, and the header says which session layout and broker they were encoded for
+    static const size_t TX_ITEM_HEADER = 5;
+
+    // In effect for the current session; the task reads them (host is endpointHost)
+    Client* client;
+    IPAddress serverIp;
+    uint16_t port;
+    bool useIp;
+    // Staged by setClient()/setServer() on the main loop
+    Client* nextClient;
+    char nextHost[128];
+    IPAddress nextIp;
+    uint16_t nextPort;
+    bool nextUseIp;
+    MQTTInboundCallback callback;
+
+    // Copies of the connect options owned by the transport while the task connects
+    MqttConnectOptions options;
+    char clientId[64];
+    char username[64];
+    char password[64];
+    char willTopic[128];
+    char willPayload[128];
+
+    RingbufHandle_t txRing;
+    RingbufHandle_t rxRing;
+    TaskHandle_t task;
+    MqttSessionState st;
+    std::atomic<int> lastState;
+    std::atomic<uint32_t> inflightReserved;
+    uint16_t nextPacketId;   // main loop only
+
+    // I/O task state
+    uint8_t rxFrame[MQTT_ASYNC_RX_FRAME_BYTES];
+    MqttFrameReader reader;
+    InflightSlot inflight[MQTT_ASYNC_INFLIGHT_WINDOW];
+    uint32_t keepAliveMs;
+    unsigned long lastTx;
+    unsigned long lastRx;
+    bool pingOutstanding;
+    unsigned long connackDeadline;
+
+    // Negotiated in CONNACK by the I/O task before the session is marked connected
+    std::atomic<uint8_t> sessionVersion;
+    std::atomic<bool> resumed;
+    std::atomic<bool> v5Rejected;
+    std::atomic<uint32_t> inflightLimit;
+    // Bumped when a connect goes to a different broker, so the I/O task can tell which
+    // queued packets were meant for an earlier one
+    std::atomic<uint8_t> endpoint;
+    char endpointHost[128];
+
+    // MQTT 5 outbound topic aliases (I/O task only, reset per session)
+    uint8_t txScratch[MQTT_ASYNC_RX_FRAME_BYTES];
+    char aliasTopics[MQTT_ASYNC_TOPIC_ALIASES][MQTT_ASYNC_ALIAS_TOPIC_BYTES];
+    uint8_t aliasTopicLen[MQTT_ASYNC_TOPIC_ALIASES];
+    uint16_t brokerAliasMax;
+    std::atomic<uint32_t> aliasCount;
+
+    std::atomic<uint32_t> published;
+    std::atomic<uint32_t> acked;
+    std::atomic<uint32_t> retransmits;
+    std::atomic<uint32_t> rxDropped;
+    std::atomic<uint32_t> subscribeFailures;
+    std::atomic<uint32_t> aliasBytesSaved;
+    std::atomic<uint32_t> discarded;
+    std::atomic<uint32_t> subscribesPending;
+
+    static void copyStr(char* dst, size_t cap, const char* src) {
+        if (!src) src = "";
+        strncpy(dst, src, cap - 1);
+        dst[cap - 1] = '\0';
+    }
+
+    // Main loop, idle only: the staged parameters become the ones the task connects with. A
+    // different broker starts a new endpoint; the IP form only reaches the same host.
+    void applyServer() {
+        if (!nextUseIp && (nextPort != port || strcmp(nextHost, endpointHost) != 0)) {
+            memcpy(endpointHost, nextHost, sizeof(endpointHost));
+            endpoint = (uint8_t)(endpoint + 1);
+        }
+        client = nextClient;
+        serverIp = nextIp;
+        port = nextPort;
+        useIp = nextUseIp;
+    }
+
+    uint16_t allocPacketId() {
+        uint16_t id = nextPacketId++;
+        if (nextPacketId == 0) nextPacketId = 1;
+        return id;
+    }
+
+    void writeItemHeader(uint8_t* item, uint8_t qos, uint16_t id) {
+        item[0] = qos;
+        item[1] = sessionVersion;
+        item[2] = endpoint;
+        item[3] = (uint8_t)(id >> 8);
+        item[4] = (uint8_t)(id & 0xFF);
+    }
+
+    bool enqueueControl(const uint8_t* pkt, size_t n) {
+        void* mem = nullptr;
+        if (xRingbufferSendAcquire(txRing, &mem, TX_ITEM_HEADER + n, 0) != pdTRUE) return false;
+        uint8_t* item = (uint8_t*)mem;
+        writeItemHeader(item, 0, 0);
+        memcpy(item + TX_ITEM_HEADER, pkt, n);
+        xRingbufferSendComplete(txRing, mem);
+        xTaskNotifyGive(task);
+        return true;
+    }
+
+    static void taskEntry(void* arg) {
+        static_cast<AsyncMQTTTransport*>(arg)->run();
+    }
+
+    void run() {
+        for (;;) {
+            bool busy = false;
+            switch (st.load()) {
+                case MQTT_SESSION_REQ_CONNECT:
+                    openSession();
+                    busy = true;
+                    break;
+                case MQTT_SESSION_WAIT_CONNACK:
+                case MQTT_SESSION_CONNECTED:
+                    busy = pump();
+                    break;
+                case MQTT_SESSION_REQ_DISCONNECT: {
+                    uint8_t pkt[2];
+                    if (client->connected()) client->write(pkt, mqttEncodeDisconnect(pkt));
+                    closeSession(MQTT_ASYNC_DISCONNECTED);
+                    break;
+                }
+                default:
+                    break;
+            }
+            // Sleep until the main loop queues work, or poll the socket again shortly
+            if (!busy) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(st.load() == MQTT_SESSION_IDLE ? 100 : 5));
+        }
+    }
+
+    void openSession() {
+        if (!st.advance(MQTT_SESSION_REQ_CONNECT, MQTT_SESSION_CONNECTING)) return;   // disconnect() came first
+        reader.reset();
+        int ok = useIp ? client->connect(serverIp, port) : client->connect(endpointHost, port);
+        if (!ok) {
+            closeSession(MQTT_ASYNC_CONNECT_FAILED);
+            return;
+        }
+        if (st.load() != MQTT_SESSION_CONNECTING) {
+            // disconnect() was requested while the handshake was running
+            closeSession(MQTT_ASYNC_DISCONNECTED);
+            return;
+        }
+        uint8_t pkt[512];
+        size_t n = mqttEncodeConnect(pkt, sizeof(pkt), options);
+        if (n == 0 || client->write(pkt, n) != n) {
+            closeSession(MQTT_ASYNC_CONNECT_FAILED);
+            return;
+        }
+        lastTx = lastRx = millis();
+        pingOutstanding = false;
+        connackDeadline = millis() + MQTT_ASYNC_CONNACK_TIMEOUT_MS;
+        // A disconnect() during the write stays in place; run() sends DISCONNECT and closes
+        st.advance(MQTT_SESSION_CONNECTING, MQTT_SESSION_WAIT_CONNACK);
+    }
+
+    void closeSession(int reason) {
+        client->stop();
+        subscribesPending = 0;
+        lastState = reason;
+        st.closed();
+    }
+
+    bool writeAll(const uint8_t* data, size_t n) {
+        if (client->write(data, n) != n) {
+            closeSession(MQTT_ASYNC_CONNECTION_LOST);
+            return false;
+        }
+        lastTx = millis();
+        return true;
+    }
+
+    // One service pass: read what is available, flush queued packets, keepalive and retries.
+    // Returns true if any work was done so the task can loop again without sleeping.
+    bool pump() {
+        if (!client->connected()) {
+            closeSession(MQTT_ASYNC_CONNECTION_LOST);
+            return false;
+        }
+        bool busy = false;
+        int budget = 1024;
+        while (budget-- > 0 && client->available() > 0) {
+            int b = client->read();
+            if (b < 0) break;
+            busy = true;
+            lastRx = millis();
+            if (reader.feed((uint8_t)b)) {
+                handleFrame();
+                if (st.load() == MQTT_SESSION_IDLE) return false;
+            }
+        }
+        unsigned long now = millis();
+        if (st.load() == MQTT_SESSION_WAIT_CONNACK) {
+            if ((long)(now - connackDeadline) > 0) closeSession(MQTT_ASYNC_CONNECTION_TIMEOUT);
+            return busy;
+        }
+        busy |= flushTx();
+        if (st.load() != MQTT_SESSION_CONNECTED) return false;
+        retryInflight(now, false);
+        if (keepAliveMs > 0) {
+            if (pingOutstanding && now - lastRx > keepAliveMs) {
+                closeSession(MQTT_ASYNC_CONNECTION_TIMEOUT);
+                return false;
+            }
+            if (!pingOutstanding && (now - lastTx >= keepAliveMs || now - lastRx >= keepAliveMs)) {
+                uint8_t pkt[2];
+                if (writeAll(pkt, mqttEncodePingreq(pkt))) pingOutstanding = true;
+            }
+        }
+        return busy;
+    }
+
+    bool flushTx() {
+        bool busy = false;
+        for (int i = 0; i < 8 && st.load() == MQTT_SESSION_CONNECTED; ++i) {
+            size_t size = 0;
+            uint8_t* item = (uint8_t*)xRingbufferReceive(txRing, &size, 0);
+            if (!item) break;
+            busy = true;
+            uint8_t qos = item[0];
+            uint8_t version = item[1];
+            uint16_t id = (uint16_t)((item[3] << 8) | item[4]);
+            const uint8_t* pkt = item + TX_ITEM_HEADER;
+            size_t pktLen = size - TX_ITEM_HEADER;
+            if (item[2] != endpoint) {
+                // Queued for a broker we no longer talk to
+                if ((pkt[0] >> 4) == MQTT_PKT_PUBLISH) discardPublish(qos);
+            } else if ((pkt[0] >> 4) == MQTT_PKT_PUBLISH) {
+                if (qos == 1) trackInflight(id, pkt, pktLen, version);
+                if (!writePublish(pkt, pktLen, version)) {
+                    if (qos == 1) releaseInflight(id, false);
+                    else discarded++;
+                }
+            } else if (version == sessionVersion) {
+                writeAll(pkt, pktLen);
+            }
+            // else: a SUBSCRIBE/UNSUBSCRIBE encoded for the previous session's protocol level;
+            // the handler subscribes afresh for the new session
+            vRingbufferReturnItem(txRing, item);
+        }
+        return busy;
+    }
+
+    void trackInflight(uint16_t id, const uint8_t* pkt, size_t len, uint8_t version) {
+        for (size_t i = 0; i < MQTT_ASYNC_INFLIGHT_WINDOW; ++i) {
+            if (inflight[i].packetId == 0) {
+                inflight[i].data = (uint8_t*)malloc(len);
+                if (!inflight[i].data) break;
+                memcpy(inflight[i].data, pkt, len);
+                inflight[i].packetId = id;
+                inflight[i].length = (uint16_t)len;
+                inflight[i].version = version;
+                inflight[i].endpoint = endpoint;
+                inflight[i].sentMs = millis();
+                return;
+            }
+        }
+        inflightReserved--; // could not track; sent once as best effort
+    }
+
+    void discardPublish(uint8_t qos) {
+        if (qos == 1) inflightReserved--;
+        discarded++;
+    }
+
+    // Resend unacknowledged QoS 1 publishes with DUP set (on timeout, or all of them after
+    // reconnect). The window belongs to one broker: after a switch to another one its
+    // messages are dropped rather than delivered to a broker that never took them.
+    void retryInflight(unsigned long now, bool all) {
+        for (size_t i = 0; i < MQTT_ASYNC_INFLIGHT_WINDOW && st.load() == MQTT_SESSION_CONNECTED; ++i) {
+            InflightSlot& s = inflight[i];
+            if (s.packetId == 0) continue;
+            if (s.endpoint != endpoint) {
+                releaseInflight(s.packetId, false);
+                continue;
+            }
+            if (!all && now - s.sentMs < MQTT_ASYNC_RETRY_MS) continue;
+            s.data[0] |= 0x08;
+            s.sentMs = now;
+            retransmits++;
+            if (!writePublish(s.data, s.length, s.version)) releaseInflight(s.packetId, false);
+        }
+    }
+
+    // Queued and in-flight publishes are stored as encoded for the session they were queued
+    // in, always with the full topic. Anything that does not fit the current session as-is
+    // is re-encoded here, per write: a protocol level that changed across the reconnect
+    // (MQTT 5 toggled, or refused and retried as 3.1.1), and topic alias substitution.
+    // Returns false if the packet could not be re-encoded and was not sent.
+    bool writePublish(const uint8_t* pkt, size_t len, uint8_t version) {
+        bool v5 = sessionVersion == MQTT_PROTOCOL_V5;
+        bool sameLayout = version == sessionVersion;
+        if (sameLayout && (!v5 || brokerAliasMax == 0)) {
+            writeAll(pkt, len);
+            return true;
+        }
+        uint32_t bodyLen = 0;
+        size_t n = mqttReadVarInt(pkt + 1, len - 1, bodyLen);
+        MqttPublishView v;
+        if (len > sizeof(txScratch) || n == 0 || 1 + n + bodyLen != len ||
+            !mqttParsePublish(pkt[0] & 0x0F, pkt + 1 + n, bodyLen, v, version == MQTT_PROTOCOL_V5)) {
+            if (!sameLayout) return false;
+            writeAll(pkt, len);
+            return true;
+        }
+        if (!v5) {
+            size_t out = mqttEncodePublish(txScratch, sizeof(txScratch), v.topic, v.topicLen, v.payload,
+                                           v.payloadLen, v.qos, v.retain, v.packetId, (pkt[0] & 0x08) != 0,
+                                           nullptr);
+            if (out == 0) return false;
+            writeAll(txScratch, out);
+            return true;
+        }
+        bool aliasable = brokerAliasMax > 0 && v.topicLen > 0 && v.topicLen < MQTT_ASYNC_ALIAS_TOPIC_BYTES;
+        uint16_t alias = 0;
+        bool known = false;
+        for (uint16_t i = 0; aliasable && i < aliasCount; ++i) {
+            if (aliasTopicLen[i] == v.topicLen && memcmp(aliasTopics[i], v.topic, v.topicLen) == 0) {
+                alias = i + 1;
+                known = true;
+                break;
+            }
+        }
+        if (aliasable && !known && aliasCount < brokerAliasMax) {
+            uint32_t slot = aliasCount;
+            memcpy(aliasTopics[slot], v.topic, v.topicLen);
+            aliasTopicLen[slot] = (uint8_t)v.topicLen;
+            aliasCount = slot + 1;
+            alias = (uint16_t)(slot + 1);
+        }
+        if (alias == 0 && sameLayout) {
+            writeAll(pkt, len);
+            return true;
+        }
+        // First use sends topic + alias to establish the mapping; later uses send the alias only
+        MqttPublishProps props = { alias, v.expirySec };
+        size_t out = mqttEncodePublish(txScratch, sizeof(txScratch), v.topic, known ? 0 : v.topicLen,
+                                       v.payload, v.payloadLen, v.qos, v.retain, v.packetId,
+                                       (pkt[0] & 0x08) != 0, &props);
+        if (out == 0) {
+            if (!sameLayout) return false;
+            writeAll(pkt, len);
+            return true;
+        }
+        if (out < len) aliasBytesSaved += (uint32_t)(len - out);
+        writeAll(txScratch, out);
+        return true;
+    }
+
+    void handleFrame() {
+        const uint8_t* body = reader.body();
+        size_t len = reader.length();
+        switch (reader.type()) {
+            case MQTT_PKT_CONNACK: {
+                bool v5 = options.protocolVersion == MQTT_PROTOCOL_V5;
+                MqttConnack ack;
+                if (!mqttParseConnack(body, len, v5, ack)) {
+                    closeSession(MQTT_ASYNC_CONNECT_FAILED);
+                } else if (ack.reasonCode == 0) {
+                    sessionVersion = options.protocolVersion;
+                    resumed = ack.sessionPresent;
+                    brokerAliasMax = ack.topicAliasMax < MQTT_ASYNC_TOPIC_ALIASES ? ack.topicAliasMax : MQTT_ASYNC_TOPIC_ALIASES;
+                    aliasCount = 0;
+                    inflightLimit = ack.receiveMax < MQTT_ASYNC_INFLIGHT_WINDOW ? ack.receiveMax : MQTT_ASYNC_INFLIGHT_WINDOW;
+                    // Not over a disconnect() that came in while waiting for the CONNACK
+                    if (!st.advance(MQTT_SESSION_WAIT_CONNACK, MQTT_SESSION_CONNECTED)) break;
+                    lastState = MQTT_ASYNC_CONNECTED;
+                    retryInflight(millis(), true);
+                } else {
+                    // 0x01 (3.1.1 "unacceptable protocol") or 0x84 (MQTT 5 "unsupported protocol")
+                    if (v5 && (ack.reasonCode == 0x01 || ack.reasonCode == 0x84)) v5Rejected = true;
+                    closeSession(ack.reasonCode);
+                }
+                break;
+            }
+            case MQTT_PKT_PUBLISH: {
+                MqttPublishView v;
+                if (!mqttParsePublish(reader.flags(), body, len, v, sessionVersion == MQTT_PROTOCOL_V5)) break;
+                if (v.topicLen == 0) break; // inbound aliases were not negotiated
+                bool delivered = deliver(v);
+                if (v.qos == 1 && delivered) {
+                    uint8_t pkt[4];
+                    writeAll(pkt, mqttEncodePuback(pkt, v.packetId));
+                }
+                break;
+            }
+            case MQTT_PKT_PUBACK:
+                if (len >= 2) releaseInflight(mqttReadU16(body), true);
+                break;
+            case MQTT_PKT_SUBACK: {
+                if (subscribesPending > 0) subscribesPending--;
+                size_t pos = 2;
+                if (sessionVersion == MQTT_PROTOCOL_V5) {
+                    uint32_t propLen = 0;
+                    size_t n = mqttReadVarInt(body + 2, len > 2 ? len - 2 : 0, propLen);
+                    if (n == 0) break;
+                    pos += n + propLen;
+                }
+                for (size_t i = pos; i < len; ++i) {
+                    if (body[i] >= 0x80) subscribeFailures++;
+                }
+                break;
+            }
+            case MQTT_PKT_PINGRESP:
+                pingOutstanding = false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Free a window slot: acknowledged by the broker, or given up
+    void releaseInflight(uint16_t id, bool ack) {
+        for (size_t i = 0; i < MQTT_ASYNC_INFLIGHT_WINDOW; ++i) {
+            if (inflight[i].packetId == id) {
+                free(inflight[i].data);
+                inflight[i].data = nullptr;
+                inflight[i].packetId = 0;
+                inflightReserved--;
+                if (ack) acked++;
+                else discarded++;
+                return;
+            }
+        }
+    }
+
+    // Hand a received PUBLISH to the main loop as [u16 topicLen][topic]['\0'][payload]
+    bool deliver(const MqttPublishView& v) {
+        size_t itemLen = 2 + v.topicLen + 1 + v.payloadLen;
+        void* mem = nullptr;
+        if (xRingbufferSendAcquire(rxRing, &mem, itemLen, 0) != pdTRUE) {
+            // Main loop is behind: the message is lost. It is not acknowledged, but brokers do
+            // not redeliver within a session; one holding a persistent session sends it again
+            // after the next reconnect.
+            rxDropped++;
+            return false;
+        }
+        uint8_t* item = (uint8_t*)mem;
+        item[0] = (uint8_t)(v.topicLen >> 8);
+        item[1] = (uint8_t)(v.topicLen & 0xFF);
+        memcpy(item + 2, v.topic, v.topicLen);
+        item[2 + v.topicLen] = '\0';
+        memcpy(item + 2 + v.topicLen + 1, v.payload, v.payloadLen);
+        xRingbufferSendComplete(rxRing, mem);
+        return true;
+    }
+};
+
+#endif // ESP32
+
+#endif // MQTT_ASYNC_TRANSPORT_H
@@ -0,0 +1,490 @@
+#ifndef MQTT_CODEC_H
+#define MQTT_CODEC_H
+
+// Minimal MQTT 3.1.1 / 5.0 packet codec used by the asynchronous transport. Works on byte
+// buffers only; test/test_mqtt_codec.cpp and test_mqtt5_codec.cpp cover it.
+// MQTT 5 support covers what the gateway uses: topic aliases, subscription options
+// (No Local) and message expiry; other properties are skipped when parsing.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+enum MqttPacketType : uint8_t {
+    MQTT_PKT_CONNECT = 1,
+    MQTT_PKT_CONNACK = 2,
+    MQTT_PKT_PUBLISH = 3,
+    MQTT_PKT_PUBACK = 4,
+    MQTT_PKT_SUBSCRIBE = 8,
+    MQTT_PKT_SUBACK = 9,
+    MQTT_PKT_UNSUBSCRIBE = 10,
+    MQTT_PKT_UNSUBACK = 11,
+    MQTT_PKT_PINGREQ = 12,
+    MQTT_PKT_PINGRESP = 13,
+    MQTT_PKT_DISCONNECT = 14
+};
+
+#define MQTT_PROTOCOL_V311 4
+#define MQTT_PROTOCOL_V5 5
+
+// MQTT 5 property identifiers used by the gateway
+#define MQTT_PROP_MESSAGE_EXPIRY 0x02
+#define MQTT_PROP_SESSION_EXPIRY 0x11
+#define MQTT_PROP_RECEIVE_MAXIMUM 0x21
+#define MQTT_PROP_TOPIC_ALIAS_MAXIMUM 0x22
+#define MQTT_PROP_TOPIC_ALIAS 0x23
+#define MQTT_PROP_MAXIMUM_PACKET_SIZE 0x27
+
+// SUBSCRIBE options byte: bits 0-1 QoS, then MQTT 5 flags (ignored by 3.1.1 encoders)
+#define MQTT_SUB_NO_LOCAL 0x04
+#define MQTT_SUB_RETAIN_AS_PUBLISHED 0x08
+
+// Space reserved ahead of a packet body for the fixed header (1 type byte + up to 4 length bytes)
+#define MQTT_FIXED_HEADER_MAX 5
+
+struct MqttConnectOptions {
+    const char* clientId;
+    const char* username;      // nullptr or "" for none
+    const char* password;
+    const char* willTopic;     // nullptr for no will
+    const char* willPayload;
+    uint8_t willQos;
+    bool willRetain;
+    bool cleanSession;
+    uint16_t keepAliveSec;
+    uint8_t protocolVersion;   // MQTT_PROTOCOL_V311 (default when 0) or MQTT_PROTOCOL_V5
+    uint16_t topicAliasMax;    // MQTT 5: aliases we accept from the broker (0 = none)
+    uint32_t sessionExpirySec; // MQTT 5: how long the broker keeps a non-clean session (0 = ends on disconnect)
+};
+
+// MQTT 5 PUBLISH properties; passing a non-null pointer selects the MQTT 5 layout
+struct MqttPublishProps {
+    uint16_t topicAlias;       // 0 = none
+    uint32_t expirySec;        // 0 = never expires
+};
+
+// Bounds-checked append-only writer; overflow is sticky and checked once at the end
+struct MqttWriter {
+    uint8_t* buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+
+    MqttWriter(uint8_t* b, size_t c) : buf(b), cap(c), len(0), overflow(false) {}
+
+    void u8(uint8_t v) {
+        if (len + 1 > cap) { overflow = true; return; }
+        buf[len++] = v;
+    }
+    void u16(uint16_t v) {
+        u8((uint8_t)(v >> 8));
+        u8((uint8_t)(v & 0xFF));
+    }
+    void bytes(const void* data, size_t n) {
+        if (len + n > cap) { overflow = true; return; }
+        memcpy(buf + len, data, n);
+        len += n;
+    }
+    void str(const char* s) {
+        size_t n = s ? strlen(s) : 0;
+        u16((uint16_t)n);
+        if (n) bytes(s, n);
+    }
+};
+
+inline size_t mqttVarIntSize(uint32_t v) {
+    return v < 128 ? 1 : v < 16384 ? 2 : v < 2097152 ? 3 : 4;
+}
+
+inline size_t mqttWriteVarInt(uint8_t* out, uint32_t v) {
+    size_t n = 0;
+    do {
+        uint8_t b = (uint8_t)(v % 128);
+        v /= 128;
+        if (v > 0) b |= 0x80;
+        out[n++] = b;
+    } while (v > 0 && n < 4);
+    return n;
+}
+
+// Decode a variable byte integer; returns bytes consumed or 0 if truncated/malformed
+inline size_t mqttReadVarInt(const uint8_t* p, size_t len, uint32_t& value) {
+    value = 0;
+    uint32_t multiplier = 1;
+    for (size_t i = 0; i < len && i < 4; ++i) {
+        value += (uint32_t)(p[i] & 0x7F) * multiplier;
+        if ((p[i] & 0x80) == 0) return i + 1;
+        multiplier *= 128;
+    }
+    return 0;
+}
+
+inline void mqttWriterVarInt(MqttWriter& w, uint32_t v) {
+    uint8_t tmp[4];
+    w.bytes(tmp, mqttWriteVarInt(tmp, v));
+}
+
+// Walk an MQTT 5 property block, calling fn(id, value) for integer properties.
+// String/binary properties are skipped. Returns false on a malformed block.
+template <typename Fn>
+inline bool mqttWalkProps(const uint8_t* p, size_t len, Fn fn) {
+    size_t pos = 0;
+    while (pos < len) {
+        uint8_t id = p[pos++];
+        uint32_t value = 0;
+        switch (id) {
+            case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+                if (pos + 1 > len) return false;
+                value = p[pos];
+                pos += 1;
+                break;
+            case 0x13: case 0x21: case 0x22: case 0x23:
+                if (pos + 2 > len) return false;
+                value = (uint32_t)((p[pos] << 8) | p[pos + 1]);
+                pos += 2;
+                break;
+            case 0x02: case 0x11: case 0x18: case 0x27:
+                if (pos + 4 > len) return false;
+                value = ((uint32_t)p[pos] << 24) | ((uint32_t)p[pos + 1] << 16) |
+                        ((uint32_t)p[pos + 2] << 8) | p[pos + 3];
+                pos += 4;
+                break;
+            case 0x0B: {
+                size_t n = mqttReadVarInt(p + pos, len - pos, value);
+                if (n == 0) return false;
+                pos += n;
+                break;
+            }
+            case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16:
+            case 0x1A: case 0x1C: case 0x1F: {
+                if (pos + 2 > len) return false;
+                pos += 2 + (size_t)((p[pos] << 8) | p[pos + 1]);
+                if (pos > len) return false;
+                continue;
+            }
+            case 0x26: // user property: two strings
+                for (int k = 0; k < 2; ++k) {
+                    if (pos + 2 > len) return false;
+                    pos += 2 + (size_t)((p[pos] << 8) | p[pos + 1]);
+                    if (pos > len) return false;
+                }
+                continue;
+            default:
+                return false;
+        }
+        fn(id, value);
+    }
+    return true;
+}
+
+// Body was written at buf + MQTT_FIXED_HEADER_MAX; slide it down behind the real fixed header.
+// Returns the total packet length, or 0 if the writer overflowed.
+inline size_t mqttFinishPacket(MqttWriter& w, uint8_t typeAndFlags) {
+    if (w.overflow || w.len < MQTT_FIXED_HEADER_MAX) return 0;
+    size_t bodyLen = w.len - MQTT_FIXED_HEADER_MAX;
+    uint8_t hdr[MQTT_FIXED_HEADER_MAX];
+    hdr[0] = typeAndFlags;
+    size_t hdrLen = 1 + mqttWriteVarInt(hdr + 1, (uint32_t)bodyLen);
+    memmove(w.buf + hdrLen, w.buf + MQTT_FIXED_HEADER_MAX, bodyLen);
+    memcpy(w.buf, hdr, hdrLen);
+    return hdrLen + bodyLen;
+}
+
+inline size_t mqttEncodeConnect(uint8_t* buf, size_t cap, const MqttConnectOptions& o) {
+    MqttWriter w(buf, cap);
+    w.len = MQTT_FIXED_HEADER_MAX;
+    if (cap < MQTT_FIXED_HEADER_MAX) return 0;
+    bool v5 = o.protocolVersion == MQTT_PROTOCOL_V5;
+    w.str("MQTT");
+    w.u8(v5 ? MQTT_PROTOCOL_V5 : MQTT_PROTOCOL_V311);
+    bool hasUser = o.username && o.username[0] != '\0';
+    bool hasWill = o.willTopic && o.willTopic[0] != '\0';
+    uint8_t flags = 0;
+    if (o.cleanSession) flags |= 0x02;
+    if (hasWill) {
+        flags |= 0x04;
+        flags |= (uint8_t)((o.willQos & 0x03) << 3);
+        if (o.willRetain) flags |= 0x20;
+    }
+    if (hasUser) {
+        flags |= 0x80;
+        if (o.password) flags |= 0x40;
+    }
+    w.u8(flags);
+    w.u16(o.keepAliveSec);
+    if (v5) {
+        w.u8((o.topicAliasMax ? 3 : 0) + (o.sessionExpirySec ? 5 : 0));
+        if (o.sessionExpirySec) {
+            w.u8(MQTT_PROP_SESSION_EXPIRY);
+            w.u16((uint16_t)(o.sessionExpirySec >> 16));
+            w.u16((uint16_t)(o.sessionExpirySec & 0xFFFF));
+        }
+        if (o.topicAliasMax) {
+            w.u8(MQTT_PROP_TOPIC_ALIAS_MAXIMUM);
+            w.u16(o.topicAliasMax);
+        }
+    }
+    w.str(o.clientId);
+    if (hasWill) {
+        if (v5) w.u8(0); // no will properties
+        w.str(o.willTopic);
+        w.str(o.willPayload ? o.willPayload : "");
+    }
+    if (hasUser) {
+        w.str(o.username);
+        if (o.password) w.str(o.password);
+    }
+    return mqttFinishPacket(w, MQTT_PKT_CONNECT << 4);
+}
+
+inline size_t mqttPublishPropsSize(const MqttPublishProps& p) {
+    return (p.topicAlias ? 3 : 0) + (p.expirySec ? 5 : 0);
+}
+
+// Exact encoded size of a PUBLISH, used to reserve ring-buffer space before encoding in place
+inline size_t mqttPublishSize(size_t topicLen, size_t payloadLen, uint8_t qos,
+                              const MqttPublishProps* props = nullptr) {
+    size_t body = 2 + topicLen + (qos > 0 ? 2 : 0) + payloadLen;
+    if (props) {
+        size_t propLen = mqttPublishPropsSize(*props);
+        body += mqttVarIntSize((uint32_t)propLen) + propLen;
+    }
+    return 1 + mqttVarIntSize((uint32_t)body) + body;
+}
+
+// topicLen is explicit so an alias-only MQTT 5 publish can pass an empty topic
+inline size_t mqttEncodePublish(uint8_t* buf, size_t cap, const char* topic, size_t topicLen,
+                                const uint8_t* payload, size_t payloadLen, uint8_t qos, bool retain,
+                                uint16_t packetId, bool dup, const MqttPublishProps* props = nullptr) {
+    MqttWriter w(buf, cap);
+    w.len = MQTT_FIXED_HEADER_MAX;
+    if (cap < MQTT_FIXED_HEADER_MAX) return 0;
+    w.u16((uint16_t)topicLen);
+    if (topicLen) w.bytes(topic, topicLen);
+    if (qos > 0) w.u16(packetId);
+    if (props) {
+        mqttWriterVarInt(w, (uint32_t)mqttPublishPropsSize(*props));
+        if (props->expirySec) {
+            w.u8(MQTT_PROP_MESSAGE_EXPIRY);
+            w.u16((uint16_t)(props->expirySec >> 16));
+            w.u16((uint16_t)(props->expirySec & 0xFFFF));
+        }
+        if (props->topicAlias) {
+            w.u8(MQTT_PROP_TOPIC_ALIAS);
+            w.u16(props->topicAlias);
+        }
+    }
+    if (payloadLen) w.bytes(payload, payloadLen);
+    uint8_t flags = (uint8_t)((qos & 0x03) << 1);
+    if (retain) flags |= 0x01;
+    if (dup) flags |= 0x08;
+    return mqttFinishPacket(w, (uint8_t)((MQTT_PKT_PUBLISH << 4) | flags));
+}
+
+// options[i] is the QoS, OR'd with MQTT_SUB_* flags when v5 is set
+inline size_t mqttEncodeSubscribe(uint8_t* buf, size_t cap, uint16_t packetId,
+                                  const char* const* topics, const uint8_t* options, size_t count,
+                                  bool v5 = false) {
+    MqttWriter w(buf, cap);
+    w.len = MQTT_FIXED_HEADER_MAX;
+    if (cap < MQTT_FIXED_HEADER_MAX) return 0;
+    w.u16(packetId);
+    if (v5) w.u8(0); // no subscribe properties
+    for (size_t i = 0; i < count; ++i) {
+        w.str(topics[i]);
+        uint8_t opt = options ? options[i] : 0;
+        w.u8(v5 ? (uint8_t)(opt & 0x3F) : (uint8_t)(opt & 0x03));
+    }
+    return mqttFinishPacket(w, (MQTT_PKT_SUBSCRIBE << 4) | 0x02);
+}
+
+inline size_t mqttEncodeUnsubscribe(uint8_t* buf, size_t cap, uint16_t packetId,
+                                    const char* const* topics, size_t count, bool v5 = false) {
+    MqttWriter w(buf, cap);
+    w.len = MQTT_FIXED_HEADER_MAX;
+    if (cap < MQTT_FIXED_HEADER_MAX) return 0;
+    w.u16(packetId);
+    if (v5) w.u8(0); // no unsubscribe properties
+    for (size_t i = 0; i < count; ++i) {
+        w.str(topics[i]);
+    }
+    return mqttFinishPacket(w, (MQTT_PKT_UNSUBSCRIBE << 4) | 0x02);
+}
+
+// PUBACK, PINGREQ and DISCONNECT are fixed-size; callers pass at least 4 bytes.
+// The 2-byte PUBACK body is also valid MQTT 5 (reason code omitted means success).
+inline size_t mqttEncodePuback(uint8_t* buf, uint16_t packetId) {
+    buf[0] = MQTT_PKT_PUBACK << 4;
+    buf[1] = 2;
+    buf[2] = (uint8_t)(packetId >> 8);
+    buf[3] = (uint8_t)(packetId & 0xFF);
+    return 4;
+}
+
+inline size_t mqttEncodePingreq(uint8_t* buf) {
+    buf[0] = MQTT_PKT_PINGREQ << 4;
+    buf[1] = 0;
+    return 2;
+}
+
+inline size_t mqttEncodeDisconnect(uint8_t* buf) {
+    buf[0] = MQTT_PKT_DISCONNECT << 4;
+    buf[1] = 0;
+    return 2;
+}
+
+// Incremental frame reader: feed bytes as they arrive, returns true when a packet is complete.
+// Packets larger than the buffer are skipped and counted rather than truncated.
+class MqttFrameReader {
+public:
+    MqttFrameReader(uint8_t* buffer, size_t capacity)
+        : buf(buffer), cap(capacity) { reset(); }
+
+    void reset() {
+        stage = STAGE_HEADER;
+        header = 0;
+        remaining = 0;
+        multiplier = 1;
+        lenBytes = 0;
+        bodyLen = 0;
+        skipping = false;
+    }
+
+    bool feed(uint8_t b) {
+        switch (stage) {
+            case STAGE_HEADER:
+                header = b;
+                remaining = 0;
+                multiplier = 1;
+                lenBytes = 0;
+                bodyLen = 0;
+                skipping = false;
+                stage = STAGE_LENGTH;
+                return false;
+            case STAGE_LENGTH:
+                remaining += (uint32_t)(b & 0x7F) * multiplier;
+                multiplier *= 128;
+                lenBytes++;
+                if (b & 0x80) {
+                    if (lenBytes >= 4) { malformed++; reset(); }
+                    return false;
+                }
+                skipping = remaining > cap;
+                if (skipping) oversized++;
+                if (remaining == 0) {
+                    stage = STAGE_HEADER;
+                    return true;
+                }
+                stage = STAGE_BODY;
+                return false;
+            case STAGE_BODY:
+                if (!skipping) buf[bodyLen] = b;
+                bodyLen++;
+                if (bodyLen >= remaining) {
+                    stage = STAGE_HEADER;
+                    if (skipping) return false;
+                    return true;
+                }
+                return false;
+        }
+        return false;
+    }
+
+    uint8_t type() const { return header >> 4; }
+    uint8_t flags() const { return header & 0x0F; }
+    const uint8_t* body() const { return buf; }
+    size_t length() const { return bodyLen; }
+
+    uint32_t oversized = 0;
+    uint32_t malformed = 0;
+
+private:
+    enum Stage : uint8_t { STAGE_HEADER, STAGE_LENGTH, STAGE_BODY };
+    uint8_t* buf;
+    size_t cap;
+    Stage stage;
+    uint8_t header;
+    uint32_t remaining;
+    uint32_t multiplier;
+    uint8_t lenBytes;
+    uint32_t bodyLen;
+    bool skipping;
+};
+
+inline uint16_t mqttReadU16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+struct MqttPublishView {
+    const char* topic;     // not NUL-terminated
+    uint16_t topicLen;
+    uint16_t packetId;     // 0 for QoS 0
+    uint8_t qos;
+    bool retain;
+    const uint8_t* payload;
+    size_t payloadLen;
+    uint16_t topicAlias;   // MQTT 5 only
+    uint32_t expirySec;    // MQTT 5 only; remaining lifetime as forwarded by the broker
+};
+
+inline bool mqttParsePublish(uint8_t flags, const uint8_t* body, size_t len, MqttPublishView& out,
+                             bool v5 = false) {
+    if (len < 2) return false;
+    out.qos = (flags >> 1) & 0x03;
+    out.retain = (flags & 0x01) != 0;
+    out.topicLen = mqttReadU16(body);
+    size_t pos = 2 + out.topicLen;
+    if (pos > len || out.qos > 2) return false;
+    out.topic = (const char*)(body + 2);
+    out.packetId = 0;
+    if (out.qos > 0) {
+        if (pos + 2 > len) return false;
+        out.packetId = mqttReadU16(body + pos);
+        pos += 2;
+    }
+    out.topicAlias = 0;
+    out.expirySec = 0;
+    if (v5) {
+        uint32_t propLen = 0;
+        size_t n = mqttReadVarInt(body + pos, len - pos, propLen);
+        if (n == 0 || pos + n + propLen > len) return false;
+        pos += n;
+        bool ok = mqttWalkProps(body + pos, propLen, [&out](uint8_t id, uint32_t value) {
+            if (id == MQTT_PROP_TOPIC_ALIAS) out.topicAlias = (uint16_t)value;
+            else if (id == MQTT_PROP_MESSAGE_EXPIRY) out.expirySec = value;
+        });
+        if (!ok) return false;
+        pos += propLen;
+    }
+    out.payload = body + pos;
+    out.payloadLen = len - pos;
+    return true;
+}
+
+struct MqttConnack {
+    bool sessionPresent;
+    uint8_t reasonCode;        // 0 = accepted (3.1.1 return code or MQTT 5 reason code)
+    uint16_t topicAliasMax;    // MQTT 5: aliases the broker accepts from us
+    uint16_t receiveMax;       // MQTT 5: broker's QoS 1/2 flow-control window (65535 if absent)
+    uint32_t maxPacketSize;    // MQTT 5: 0 if absent (no limit)
+};
+
+inline bool mqttParseConnack(const uint8_t* body, size_t len, bool v5, MqttConnack& out) {
+    if (len < 2) return false;
+    out.sessionPresent = (body[0] & 0x01) != 0;
+    out.reasonCode = body[1];
+    out.topicAliasMax = 0;
+    out.receiveMax = 65535;
+    out.maxPacketSize = 0;
+    if (!v5 || len == 2) return true;
+    uint32_t propLen = 0;
+    size_t n = mqttReadVarInt(body + 2, len - 2, propLen);
+    if (n == 0 || 2 + n + propLen > len) return false;
+    return mqttWalkProps(body + 2 + n, propLen, [&out](uint8_t id, uint32_t value) {
+        if (id == MQTT_PROP_TOPIC_ALIAS_MAXIMUM) out.topicAliasMax = (uint16_t)value;
+        else if (id == MQTT_PROP_RECEIVE_MAXIMUM) out.receiveMax = (uint16_t)value;
+        else if (id == MQTT_PROP_MAXIMUM_PACKET_SIZE) out.maxPacketSize = value;
+    });
+}
+
+#endif // MQTT_CODEC_H
@@ -7,122 +7,378 @@
 #include <Ethernet.h>
 #else
 #include <WiFi.h>
-#include <WiFiClientSecure.h>
+#include "broker_client.h"
 #endif
 #include <PubSubClient.h>
 #include "ca_cert.h"
 #include <time.h>
 #include <ArduinoJson.h>
 #include "config.h"
+#include "config_snapshot.h"
+#include "serial_protocol.h"
+#include "outbound_queue.h"
+#include "broker_failover.h"
+#include "mqtt_transport.h"
+#include "mqtt_async_transport.h"
+#include "topic_router.h"
+#include "bridge_decoder.h"
+#include "bridge_scheduler.h"
+#include "bridge_election.h"
+#include "broker_endpoint.h"
+#include "latency_probe.h"
+#include "pipeline_timing.h"
+#include "boot_timing.h"
+#include "log.h"
+
+// Connectivity state machine timings
+#define LINK_WIFI_TIMEOUT_MS       15000UL
+#define LINK_TIME_SYNC_TIMEOUT_MS  10000UL
+#define LINK_MQTT_TIMEOUT_MS       15000UL
+#define LINK_BACKOFF_BASE_MS       1000UL
+#define LINK_BACKOFF_MAX_MS        60000UL
+#define LINK_DEGRADED_AFTER        3       // consecutive failed cycles before reporting degraded
+#define MQTT_SESSION_EXPIRY_SEC    86400UL // MQTT 5: how long the broker holds a persistent session
+#define MQTT_STATS_DOC_BYTES       4096    // stats document pool, on the heap (serializes to about 2 KB)
+#define MQTT_PUBSUB_BUFFER_BYTES   4096    // PubSubClient packet buffer; a stats publish must fit
+
+// Uplink state, advanced one small step per loop() so RF handling never waits on the network
+enum LinkState : uint8_t {
+    LINK_IDLE,
+    LINK_WIFI_CONNECTING,
+    LINK_TIME_SYNC,
+    LINK_MQTT_CONNECTING,
+    LINK_ONLINE,
+    LINK_BACKOFF,
+    LINK_DEGRADED          // repeated failures: RF-only, uplink traffic buffered, retrying at capped backoff
+};
+
+enum LinkPhase : uint8_t {
+    LINK_PHASE_WIFI,
+    LINK_PHASE_TIME,
+    LINK_PHASE_MQTT,
+    LINK_PHASE_COUNT
+};
+
+struct LinkPhaseStats {
+    uint32_t attempts;
+    uint32_t failures;
+    uint32_t lastMs;
+    uint32_t maxMs;
+};
+
+// Breakdown of the most recent broker (re)connect
+struct ReconnectTimings {
+    uint32_t dnsMs;
+    uint32_t tcpMs;
+    uint32_t tlsMs;
+    uint32_t connectMs;     // CONNECT sent -> CONNACK
+    uint32_t subscribeMs;   // first SUBSCRIBE -> last SUBACK (0 when the session was resumed)
+    uint32_t totalMs;       // MQTT phase start -> subscriptions acknowledged
+    bool dnsCached;
+    bool tlsResumed;
+    bool sessionResumed;    // broker kept our subscriptions, none were re-sent
+};
+
+struct LinkStats {
+    LinkState state;
+    uint32_t stateAgeMs;
+    uint32_t consecutiveFailures;
+    uint32_t backoffMs;        // delay chosen for the current/last retry
+    uint32_t sessions;         // broker sessions established since boot
+    uint32_t lastOutageMs;     // length of the last offline period
+    uint32_t sessionsResumed;  // sessions where resubscription was skipped
+    uint32_t fullSubscribeMs;  // last complete resubscription, for comparison with resumed ones
+    LinkPhaseStats phases[LINK_PHASE_COUNT];
+    ReconnectTimings reconnect;
+};
+
+inline const char* linkStateName(LinkState s) {
+    switch (s) {
+        case LINK_IDLE: return "idle";
+        case LINK_WIFI_CONNECTING: return "wifi";
+        case LINK_TIME_SYNC: return "time";
+        case LINK_MQTT_CONNECTING: return "mqtt";
+        case LINK_ONLINE: return "online";
+        case LINK_BACKOFF: return "backoff";
+        case LINK_DEGRADED: return "degraded";
+    }
+    return "?";
+}
 
 // Forward declarations
 class MQTTHandler;
 
 // Callback types
 typedef std::function<void(const uint8_t* payload, size_t length)> MQTTMessageCallback;
+typedef std::function<void(const GatewayConfig& next, bool save)> ConfigCommandCallback;
+
+// Inbound route tags
+enum MQTTRouteTag : uint8_t {
+    ROUTE_CMD_SEND,
+    ROUTE_CMD_RESTART,
+    ROUTE_CMD_BRIDGE_LIMITS,
+    ROUTE_CMD_INTEREST,
+    ROUTE_CMD_CONFIG,
+    ROUTE_BRIDGE_RAW,
+    ROUTE_BRIDGE_MESSAGES,
+    ROUTE_BRIDGE_ADVERTS,
+    ROUTE_PEER_TELEMETRY,
+    ROUTE_ELECTION_RANK,
+    ROUTE_ELECTION_CLAIM,
+    ROUTE_PROBE
+};
 
 class MQTTHandler {
 public:
-    MQTTHandler(GatewayConfig& cfg) 
-        : config(cfg)
+    MQTTHandler(ConfigSnapshots& configs) 
+        : snapshots(configs)
 #ifdef USE_ETHERNET
-        , mqttClient(ethClient)
+        , pubSubTransport(ethClient)
 #else
-        , wifiClient(), secureClient(), mqttClient(wifiClient)
+        , brokerClient(), pubSubTransport(brokerClient)
+#endif
+        , transport(&pubSubTransport)
+#ifdef ESP32
+        , asyncTransport(nullptr)
+#endif
+        , linkState(LINK_IDLE), stateSince(0), phaseStart(0), attemptStart(0), nextAttemptAt(0)
+        , offlineSince(0), consecutiveFailures(0), backoffMs(0), sessions(0), lastOutageMs(0)
+        , attemptQueued(false), mqttViaIp(false), messageCallback(nullptr), configCallback(nullptr)
+        , bootTimer(nullptr), pipelineTimer(nullptr) {
+        memset(phaseStats, 0, sizeof(phaseStats));
+        memset(&reconnect, 0, sizeof(reconnect));
+    }
+
+    ~MQTTHandler() {
+#ifdef ESP32
+        delete asyncTransport;
 #endif
-        , lastReconnectAttempt(0), messageCallback(nullptr) {}
+    }
     
     bool begin() {
-        if (!config.mqtt.enabled) {
+        if (!config().mqtt.enabled) {
             return false;
         }
 
+        // Frames heard before the first connect are held like any other outage
+        outbound.begin();
+
 #ifdef USE_ETHERNET
         // Initialize Ethernet via DHCP; generate a stable locally-administered MAC from nodeId
         byte mac[6];
         mac[0] = 0x02; // locally administered, unicast
         mac[1] = 0x00;
-        mac[2] = (byte)((config.repeater.nodeId >> 24) & 0xFF);
-        mac[3] = (byte)((config.repeater.nodeId >> 16) & 0xFF);
-        mac[4] = (byte)((config.repeater.nodeId >> 8) & 0xFF);
-        mac[5] = (byte)(config.repeater.nodeId & 0xFF);
+        mac[2] = (byte)((config().repeater.nodeId >> 24) & 0xFF);
+        mac[3] = (byte)((config().repeater.nodeId >> 16) & 0xFF);
+        mac[4] = (byte)((config().repeater.nodeId >> 8) & 0xFF);
+        mac[5] = (byte)(config().repeater.nodeId & 0xFF);
         Ethernet.begin(mac);
         // Force non-TLS for Ethernet path
-        config.mqtt.useTLS = false;
+        if (config().mqtt.useTLS) {
+            snapshots.update([](GatewayConfig& c) { c.mqtt.useTLS = false; });
+        }
 #else
-        if (!config.wifi.enabled) return false;
-        if (!connectWiFi()) return false;
-        // Optionally configure TLS
-        if (config.mqtt.useTLS) {
-            if (config.mqtt.useCustomCA && config.mqtt.caCert[0] != '\0') {
-                secureClient.setCACert(config.mqtt.caCert);
+        if (!config().wifi.enabled) return false;
+#ifdef ESP32
+        // Event-driven transport with its own I/O task; PubSubClient remains the fallback
+        if (config().mqtt.asyncTransport && !asyncTransport) {
+            asyncTransport = new AsyncMQTTTransport(brokerClient);
+            if (asyncTransport->start()) {
+                transport = asyncTransport;
             } else {
-                secureClient.setCACert(MQTT_CA_CERT);
+                LOG_WARN("⚠ Async MQTT transport unavailable, using PubSubClient");
+                delete asyncTransport;
+                asyncTransport = nullptr;
             }
-            if (config.mqtt.insecureTLS) {
-                secureClient.setInsecure();
-            }
-            mqttClient.setClient(secureClient);
-        } else {
-            mqttClient.setClient(wifiClient);
         }
+#endif
+        configureTls();
+        transport->setClient(brokerClient);
 #endif
         // Prefer hostname; if certificate CN/SAN does not match hostname (common when CN is an IP),
-        // we'll retry with the resolved IP address inside connectMQTT().
-        mqttClient.setServer(config.mqtt.server, config.mqtt.port);
-        mqttClient.setCallback([this](char* topic, byte* payload, unsigned int length) {
+        // the MQTT phase retries once with the resolved IP address.
+        transport->setServer(config().mqtt.server, config().mqtt.port);
+        adoptInterest();
+        bridgeQueue.setLimits(config().mqtt.bridgeRatePerMin, config().mqtt.bridgeBurst);
+        election.setSelf(config().mqtt.clientId);
+        transport->setCallback([this](char* topic, byte* payload, unsigned int length) {
             this->handleMQTTMessage(topic, payload, length);
         });
-        mqttClient.setBufferSize(2048);  // Allow larger JSON payloads
-        // Improve connection robustness
-        mqttClient.setKeepAlive(60);     // Increase keepalive to 60s
-        mqttClient.setSocketTimeout(10); // Allow more time for TLS handshake/ops
-        
-        return connectMQTT();
+#if defined(ESP32) && !defined(USE_ETHERNET)
+        beginEndpoints();
+#endif
+        // Room for the stats document, 60s keepalive, and more time for TLS handshake/ops. Only
+        // when PubSubClient carries the session: its buffer is a heap allocation of its own
+        if (transport == &pubSubTransport) pubSubTransport.configure(MQTT_PUBSUB_BUFFER_BYTES, 60, 10);
+        LOG_INFO("MQTT transport: %s", transport->name());
+
+        // WiFi, time sync and broker connect all proceed from loop()
+        offlineSince = millis();
+        startCycle();
+        return true;
     }
-    
+
     void loop() {
-#ifndef USE_ETHERNET
-        if (WiFi.status() != WL_CONNECTED) {
-            Serial.println(F("WiFi disconnected, reconnecting..."));
-            connectWiFi();
-            return;
-        }
+        stepLink();
+        transport->loop();
+        serviceBridgeQueue();
+        announceRank();
+        serviceProbe();
+        finishSubscribeTiming();
+        if (interestDirty) applyInterest();
+
+#if defined(ESP32) && !defined(USE_ETHERNET)
+        serviceEndpoints();
 #endif
-        
-        // Handle MQTT reconnection
-        if (!mqttClient.connected()) {
-            unsigned long now = millis();
-            if (now - lastReconnectAttempt > 5000) {
-                lastReconnectAttempt = now;
-                if (connectMQTT()) {
-                    lastReconnectAttempt = 0;
-                }
-            }
-        } else {
-            mqttClient.loop();
+
+        // Drain anything captured while the broker was unreachable (to the standby in its place)
+        MQTTTransport* up = uplink();
+        if (up && (linkState == LINK_ONLINE || up != transport) && !outbound.isEmpty()) {
+            outbound.replay([this, up](const char* topic, const char* payload, size_t length, bool retain) {
+                return up->connected() &&
+                       up->publish(topic, (const uint8_t*)payload, length, retain, 1,
+                                   config().mqtt.messageExpirySec);
+            });
         }
     }
     
     bool isConnected() {
-        return mqttClient.connected();
+        return uplink() != nullptr;
+    }
+
+    const char* transportName() const {
+        return transport->name();
+    }
+
+    uint8_t protocolVersion() const {
+        return transport->protocolVersion();
+    }
+
+    LatencyReport getLatency() const {
+        LatencyReport r = probe.report();
+#ifndef USE_ETHERNET
+        r.writeUs = brokerClient.writeLatency();
+        r.writeStalls = brokerClient.writeStallCount();
+#endif
+        return r;
+    }
+
+    OutboundQueueStats getQueueStats() {
+        return outbound.getStats();
+    }
+
+    // Per-source MQTT->RF limits; takes effect immediately for every source. Publishes a new
+    // configuration version so every reader sees the same limits.
+    void setBridgeLimits(uint16_t framesPerMin, uint8_t burstFrames) {
+        if (burstFrames == 0) burstFrames = 1;
+        snapshots.update([=](GatewayConfig& c) {
+            c.mqtt.bridgeRatePerMin = framesPerMin;
+            c.mqtt.bridgeBurst = burstFrames;
+        });
+        bridgeQueue.setLimits(config().mqtt.bridgeRatePerMin, config().mqtt.bridgeBurst);
+    }
+
+    size_t getBridgeSources(BridgeSourceStats* out, size_t max) const {
+        return bridgeQueue.getSources(out, max);
+    }
+
+    // Change the bridge interest set; applied from loop() as an incremental
+    // SUBSCRIBE/UNSUBSCRIBE diff against the current subscriptions
+    void setInterest(const char* regions, uint8_t topics) {
+        // Same normalisation as the serial menu: uppercase, no spaces
+        char normalized[sizeof(config().mqtt.interestRegions)];
+        size_t n = 0;
+        for (const char* p = regions; *p && n < sizeof(normalized) - 1; ++p) {
+            if (*p != ' ') normalized[n++] = (char)toupper((unsigned char)*p);
+        }
+        normalized[n] = '\0';
+        snapshots.update([&](GatewayConfig& c) {
+            memcpy(c.mqtt.interestRegions, normalized, n + 1);
+            if (topics) c.mqtt.interestTopics = topics;
+        });
+        interestDirty = true;
+    }
+
+    // Apply changed settings (configChanges() bits) to a running handler; the current snapshot
+    // already holds the new values. Broker and WiFi changes restart the connection cycle at once, without
+    // backoff; topic changes only start a new MQTT session so onSessionStarted() subscribes
+    // afresh. Both reconnect in the background from loop(). New TLS settings reach the broker
+    // client once the transport has let go of it (see stepLink).
+    void reconfigure(uint16_t changes) {
+        if (changes & CONFIG_CHANGE_BRIDGE_LIMITS) {
+            bridgeQueue.setLimits(config().mqtt.bridgeRatePerMin, config().mqtt.bridgeBurst);
+        }
+        if (changes & (CONFIG_CHANGE_WIFI | CONFIG_CHANGE_BROKER | CONFIG_CHANGE_TOPICS)) {
+#ifndef USE_ETHERNET
+            if (changes & CONFIG_CHANGE_BROKER) tlsResetPending = true;
+#endif
+            election.setSelf(config().mqtt.clientId);
+            adoptInterest();
+            restartLink((changes & CONFIG_CHANGE_WIFI) != 0);
+        } else if (changes & CONFIG_CHANGE_INTEREST) {
+            interestDirty = true;
+        }
+    }
+
+    // Settings pushed over MQTT (commands/config) are handed to the application, which applies
+    // them outside the transport's message dispatch
+    void setConfigCallback(ConfigCommandCallback callback) {
+        configCallback = callback;
+    }
+
+    // Start-up timing: the first broker session is recorded into it and it is reported in stats
+    void setBootTimer(BootTimer* timer) {
+        bootTimer = timer;
+    }
+
+    // Per-stage receive/repeat histograms, reported in stats
+    void setPipelineTimer(const PipelineTimer* timer) {
+        pipelineTimer = timer;
+    }
+
+    // RF reception quality feeds this gateway's rank in the bridging election
+    void noteRfReception(float snr) {
+        election.noteRfSample(snr);
+    }
+
+    BridgeElectionStats getElectionStats() const {
+        return election.getStats(millis());
+    }
+
+    LinkState getLinkState() const {
+        return linkState;
+    }
+
+    LinkStats getLinkStats() const {
+        LinkStats s;
+        s.state = linkState;
+        s.stateAgeMs = millis() - stateSince;
+        s.consecutiveFailures = consecutiveFailures;
+        s.backoffMs = backoffMs;
+        s.sessions = sessions;
+        s.lastOutageMs = lastOutageMs;
+        s.sessionsResumed = sessionsResumed;
+        s.fullSubscribeMs = fullSubscribeMs;
+        memcpy(s.phases, phaseStats, sizeof(phaseStats));
+        s.reconnect = reconnect;
+        return s;
     }
     
     // Publish raw LoRa packet
     void publishRawPacket(const uint8_t* data, size_t length, int rssi, float snr) {
-        if (!config.mqtt.publishRaw || !mqttClient.connected()) {
+        if (!config().mqtt.publishRaw) {
             return;
         }
         
         char topic[128];
-        snprintf(topic, sizeof(topic), "%s/raw", config.mqtt.topicPrefix);
+        snprintf(topic, sizeof(topic), "%s/raw", config().mqtt.topicPrefix);
         
         // Create JSON payload
         StaticJsonDocument<512> doc;
         doc["timestamp"] = millis();
         doc["rssi"] = rssi;
         doc["snr"] = snr;
-        doc["gateway"] = config.mqtt.clientId;
+        doc["gateway"] = config().mqtt.clientId;
         
         // Convert data to hex string
         char hexStr[length * 2 + 1];
@@ -136,18 +392,18 @@ public:
         String output;
         serializeJson(doc, output);
         
-        mqttClient.publish(topic, output.c_str(), false);
+        publishMessage(topic, output, false, true);
     }
     
     // Publish decoded message
     void publishDecodedMessage(uint32_t fromId, uint32_t toId, const char* message, 
                               uint8_t messageType, int rssi, float snr, uint8_t hopCount) {
-        if (!config.mqtt.publishDecoded || !mqttClient.connected()) {
+        if (!config().mqtt.publishDecoded) {
             return;
         }
         
         char topic[128];
-        snprintf(topic, sizeof(topic), "%s/messages", config.mqtt.topicPrefix);
+        snprintf(topic, sizeof(topic), "%s/messages", config().mqtt.topicPrefix);
         
         StaticJsonDocument<1024> doc;
         doc["timestamp"] = millis();
@@ -158,48 +414,89 @@ public:
         doc["rssi"] = rssi;
         doc["snr"] = snr;
         doc["hops"] = hopCount;
-        doc["gateway"] = config.mqtt.clientId;
+        doc["gateway"] = config().mqtt.clientId;
         
         String output;
         serializeJson(doc, output);
         
-        mqttClient.publish(topic, output.c_str(), false);
+        publishMessage(topic, output, false, true);
     }
     
+    static void addPercentiles(JsonObject o, const LatencyPercentiles& p) {
+        o["p50"] = p.p50;
+        o["p90"] = p.p90;
+        o["p99"] = p.p99;
+        o["max"] = p.max;
+        o["n"] = p.samples;
+    }
+
+    static void addPipeline(JsonObject o, const PipelineTimer& timer) {
+        for (uint8_t i = 0; i < PIPE_STAGE_COUNT; ++i) {
+            const LatencyHistogram& h = timer.stage(i);
+            JsonObject stage = o.createNestedObject(pipelineStageName(i));
+            addPercentiles(stage, h.percentiles());
+            stage["mean"] = h.mean();
+        }
+    }
+
     // Publish node info
     void publishNodeInfo(uint32_t nodeId, const char* nodeName, bool online) {
-        if (!mqttClient.connected()) {
+        if (!uplink()) {
             return;
         }
         
         char topic[128];
-        snprintf(topic, sizeof(topic), "%s/nodes/%08X", config.mqtt.topicPrefix, nodeId);
+        snprintf(topic, sizeof(topic), "%s/nodes/%08X", config().mqtt.topicPrefix, nodeId);
         
         StaticJsonDocument<256> doc;
         doc["nodeId"] = nodeId;
         doc["name"] = nodeName;
         doc["online"] = online;
         doc["timestamp"] = millis();
-        doc["gateway"] = config.mqtt.clientId;
+        doc["gateway"] = config().mqtt.clientId;
         
         String output;
         serializeJson(doc, output);
         
-        mqttClient.publish(topic, output.c_str(), true);  // Retain node info
+        publishMessage(topic, output, true, false);  // Retain node info
     }
     
-    // Publish gateway statistics
+    // Publish gateway statistics. The document is too big for the loop task's stack and,
+    // serialized, close to what a transport takes in one packet, so the size is checked
+    // rather than having the publish fail silently.
     void publishStats(uint32_t packetsReceived, uint32_t packetsSent, 
                      uint32_t packetsForwarded, uint32_t packetsFailed) {
-        if (!mqttClient.connected()) {
+        MQTTTransport* up = uplink();
+        if (!up) {
             return;
         }
         
         char topic[128];
         snprintf(topic, sizeof(topic), "%s/gateway/%s/stats", 
-                config.mqtt.topicPrefix, config.mqtt.clientId);
+                config().mqtt.topicPrefix, config().mqtt.clientId);
         
-        StaticJsonDocument<512> doc;
+        DynamicJsonDocument doc(MQTT_STATS_DOC_BYTES);
+        if (doc.capacity() == 0) {
+            LOG_WARN("⚠ Stats not published (out of memory)");
+            return;
+        }
+        buildStats(doc, packetsReceived, packetsSent, packetsForwarded, packetsFailed);
+        
+        String output;
+        serializeJson(doc, output);
+        
+        size_t packet = mqttPublishSize(strlen(topic), output.length(), 0);
+        if (packet > up->maxPacketSize()) {
+            LOG_WARN("⚠ Stats not published: %u byte packet, transport limit %u",
+                     (unsigned)packet, (unsigned)up->maxPacketSize());
+            return;
+        }
+        publishMessage(topic, output, false, false);
+    }
+
+    // Statistics document shared by the stats topic and the serial "stats --json" command
+    void buildStats(JsonDocument& doc, uint32_t packetsReceived, uint32_t packetsSent,
+                    uint32_t packetsForwarded, uint32_t packetsFailed) {
         doc["timestamp"] = millis();
         doc["uptime"] = millis() / 1000;
         doc["packetsReceived"] = packetsReceived;
@@ -216,29 +513,143 @@ public:
 #else
         doc["freeHeap"] = 0;
 #endif
-        
-        String output;
-        serializeJson(doc, output);
-        
-        mqttClient.publish(topic, output.c_str(), false);
+        OutboundQueueStats q = outbound.getStats();
+        JsonObject queue = doc.createNestedObject("queue");
+        queue["depth"] = q.depth;
+        queue["spillBytes"] = q.spillBytes;
+        queue["replayRate"] = q.replayRate;
+        queue["replayed"] = q.replayed;
+        queue["dropped"] = q.dropped;
+        JsonObject link = doc.createNestedObject("link");
+        link["state"] = linkStateName(linkState);
+        link["sessions"] = sessions;
+        link["lastOutageMs"] = lastOutageMs;
+        link["wifiMs"] = phaseStats[LINK_PHASE_WIFI].lastMs;
+        link["timeMs"] = phaseStats[LINK_PHASE_TIME].lastMs;
+        link["mqttMs"] = phaseStats[LINK_PHASE_MQTT].lastMs;
+        link["mqttFailures"] = phaseStats[LINK_PHASE_MQTT].failures;
+        JsonObject rc = link.createNestedObject("reconnect");
+        rc["dnsMs"] = reconnect.dnsMs;
+        rc["tcpMs"] = reconnect.tcpMs;
+        rc["tlsMs"] = reconnect.tlsMs;
+        rc["connectMs"] = reconnect.connectMs;
+        rc["subscribeMs"] = reconnect.subscribeMs;
+        rc["totalMs"] = reconnect.totalMs;
+        rc["dnsCached"] = reconnect.dnsCached;
+        rc["tlsResumed"] = reconnect.tlsResumed;
+        rc["sessionResumed"] = reconnect.sessionResumed;
+        rc["sessionsResumed"] = sessionsResumed;
+        rc["fullSubscribeMs"] = fullSubscribeMs;
+#ifndef USE_ETHERNET
+        if (config().mqtt.useTLS) {
+            BrokerTlsStats t = brokerClient.tlsStatistics();
+            JsonObject tls = link.createNestedObject("tls");
+            tls["profile"] = tlsProfileName(config().mqtt.tlsProfile);
+            tls["suite"] = t.suite;
+            tls["full"] = t.fullHandshakes;
+            tls["resumed"] = t.resumedHandshakes;
+            tls["failures"] = t.failures;
+            tls["lastMs"] = t.lastMs;
+            tls["fullAvgMs"] = t.fullAvgMs;
+            tls["fullMaxMs"] = t.fullMaxMs;
+            tls["resumedAvgMs"] = t.resumedAvgMs;
+            tls["heapBytes"] = t.heapHeld;
+            tls["recordBytes"] = t.recordPayload;
+        }
+#endif
+#if defined(ESP32) && !defined(USE_ETHERNET)
+        if (config().mqtt.brokerMode != BROKER_MODE_SINGLE) {
+            link["brokerMode"] = brokerModeName(config().mqtt.brokerMode);
+            link["failovers"] = standby.failoverCount();
+            JsonArray brokers = link.createNestedArray("brokers");
+            for (size_t i = 0; i < MQTT_EXTRA_BROKERS; ++i) {
+                if (!endpoints[i].active()) continue;
+                BrokerEndpointStats e = endpoints[i].getStats();
+                JsonObject b = brokers.createNestedObject();
+                b["server"] = endpoints[i].server();
+                b["state"] = endpointStateName(e.state);
+                b["uplink"] = standby.standbyIndex() == (int)i;
+                b["sessions"] = e.sessions;
+                b["published"] = e.published;
+                b["queued"] = e.queued;
+                b["dropped"] = e.dropped;
+            }
+        }
+#endif
+        LatencyReport lat = getLatency();
+        JsonObject latency = doc.createNestedObject("latency");
+        addPercentiles(latency.createNestedObject("rttMs"), lat.rttMs);
+        addPercentiles(latency.createNestedObject("publishUs"), lat.publishUs);
+        addPercentiles(latency.createNestedObject("writeUs"), lat.writeUs);
+        latency["writeStalls"] = lat.writeStalls;
+        latency["probesSent"] = lat.probesSent;
+        latency["probesLost"] = lat.probesLost;
+        if (bootTimer) {
+            const BootReport& b = bootTimer->get();
+            JsonObject boot = doc.createNestedObject("boot");
+            boot["reset"] = resetReasonName(b.resetReason);
+            boot["rxReadyMs"] = b.rxReadyUs / 1000;
+            boot["uplinkMs"] = b.uplinkMs;
+            JsonObject phases = boot.createNestedObject("phasesMs");
+            for (uint8_t i = 0; i < BOOT_PHASE_COUNT; ++i) phases[bootPhaseName(i)] = b.phaseUs[i] / 1000;
+        }
+        if (pipelineTimer) addPipeline(doc.createNestedObject("pipeline"), *pipelineTimer);
+        JsonObject bridge = doc.createNestedObject("bridge");
+        bridge["echoes"] = bridgeEchoes;
+        bridge["malformed"] = bridgeMalformed;
+        bridge["filters"] = bridgeFilterCount;
+        bridge["queued"] = bridgeQueue.queued();
+        bridge["dropped"] = bridgeQueue.totalDropped();
+        BridgeSourceStats sources[8];
+        size_t sourceCount = bridgeQueue.getSources(sources, 8);
+        JsonArray perSource = bridge.createNestedArray("sources");
+        for (size_t i = 0; i < sourceCount; ++i) {
+            JsonObject src = perSource.createNestedObject();
+            src["id"] = sources[i].id;
+            src["sent"] = sources[i].sent;
+            src["rateDropped"] = sources[i].rateDropped;
+            src["queueDropped"] = sources[i].queueDropped;
+        }
+        if (config().mqtt.bridgeElection) {
+            BridgeElectionStats e = election.getStats(millis());
+            JsonObject elect = bridge.createNestedObject("election");
+            elect["rank"] = e.rank;
+            elect["position"] = e.position;
+            elect["peers"] = e.peers;
+            elect["transmitted"] = e.transmitted;
+            elect["fallbacks"] = e.fallbacks;
+            elect["suppressed"] = e.suppressed;
+        }
     }
     
     // Publish neighbor list
     void publishNeighbors(const NeighborInfo* neighbors, size_t count) {
-        if (!mqttClient.connected()) {
+        if (!uplink()) {
             return;
         }
         
         char topic[128];
         snprintf(topic, sizeof(topic), "%s/gateway/%s/neighbors", 
-                config.mqtt.topicPrefix, config.mqtt.clientId);
+                config().mqtt.topicPrefix, config().mqtt.clientId);
         
         StaticJsonDocument<2048> doc;
+        buildNeighbors(doc, config(), neighbors, count);
+        
+        String output;
+        serializeJson(doc, output);
+        
+        publishMessage(topic, output, false, false);
+    }
+
+    // Neighbour document for the neighbors topic and the serial "neighbours --json" command;
+    // static so the console can report neighbours with MQTT disabled
+    static void buildNeighbors(JsonDocument& doc, const GatewayConfig& cfg, const NeighborInfo* neighbors,
+                               size_t count) {
         doc["timestamp"] = millis();
-        doc["gateway"] = config.mqtt.clientId;
+        doc["gateway"] = cfg.mqtt.clientId;
         doc["count"] = count;
-        doc["gatewayLat"] = config.location.latitude;
-        doc["gatewayLon"] = config.location.longitude;
+        doc["gatewayLat"] = cfg.location.latitude;
+        doc["gatewayLon"] = cfg.location.longitude;
         
         JsonArray neighborsArray = doc.createNestedArray("neighbors");
         for (size_t i = 0; i < count; i++) {
@@ -251,22 +662,17 @@ public:
             neighbor["longitude"] = neighbors[i].longitude;
             neighbor["lastSeen"] = neighbors[i].lastSeenMs;
         }
-        
-        String output;
-        serializeJson(doc, output);
-        
-        mqttClient.publish(topic, output.c_str(), false);
     }
 
     // Publish gateway status
     void publishGatewayStatus(bool online) {
-        if (!mqttClient.connected()) {
+        if (!uplink()) {
             return;
         }
         
         char topic[128];
         snprintf(topic, sizeof(topic), "%s/gateway/%s/status", 
-                config.mqtt.topicPrefix, config.mqtt.clientId);
+                config().mqtt.topicPrefix, config().mqtt.clientId);
         
         StaticJsonDocument<384> doc;
         doc["online"] = online;
@@ -279,22 +685,19 @@ public:
         doc["rssi"] = 0;
 #endif
         // Include GPS location
-        doc["latitude"] = config.location.latitude;
-        doc["longitude"] = config.location.longitude;
+        doc["latitude"] = config().location.latitude;
+        doc["longitude"] = config().location.longitude;
         
         String output;
         serializeJson(doc, output);
         
-        mqttClient.publish(topic, output.c_str(), true);  // Retain status
+        publishMessage(topic, output, true, false);  // Retain status
     }
 
     // Publish an advert event for visibility/debugging in MQTT
     void publishAdvert(uint32_t nodeId, const char* nodeName, float latitude, float longitude) {
-        if (!mqttClient.connected()) {
-            return;
-        }
         char topic[128];
-        snprintf(topic, sizeof(topic), "%s/adverts", config.mqtt.topicPrefix);
+        snprintf(topic, sizeof(topic), "%s/adverts", config().mqtt.topicPrefix);
 
         StaticJsonDocument<384> doc;
         doc["timestamp"] = millis();
@@ -302,11 +705,11 @@ public:
         doc["name"] = nodeName;
         doc["lat"] = latitude;
         doc["lon"] = longitude;
-        doc["gateway"] = config.mqtt.clientId;
+        doc["gateway"] = config().mqtt.clientId;
 
         String output;
         serializeJson(doc, output);
-        mqttClient.publish(topic, output.c_str(), false);
+        publishMessage(topic, output, false, true);
     }
     
     // Set callback for incoming MQTT messages that should be sent to LoRa
@@ -315,354 +718,1130 @@ public:
     }
     
 private:
-    GatewayConfig& config;
+    // Settings are read through the current snapshot on every use, never cached, so a newly
+    // published version takes effect on the next read. All handler code runs on the loop task,
+    // inside the loop's read guard.
+    ConfigSnapshots& snapshots;
+
+    const GatewayConfig& config() const { return snapshots.config(); }
+
 #ifdef USE_ETHERNET
     EthernetClient ethClient;
 #else
-    WiFiClient wifiClient;
-    WiFiClientSecure secureClient;
+    BrokerClient brokerClient;
+#endif
+    PubSubTransport pubSubTransport;
+    MQTTTransport* transport;
+#ifdef ESP32
+    AsyncMQTTTransport* asyncTransport;
 #endif
-    PubSubClient mqttClient;
-    unsigned long lastReconnectAttempt;
+    LinkState linkState;
+    unsigned long stateSince;
+    unsigned long phaseStart;
+    unsigned long attemptStart;
+    unsigned long nextAttemptAt;
+    unsigned long offlineSince;
+    uint32_t consecutiveFailures;
+    uint32_t backoffMs;
+    uint32_t sessions;
+    uint32_t lastOutageMs;
+    bool attemptQueued;       // next MQTT step launches a connect attempt
+    bool mqttViaIp;           // current attempt targets the resolved broker IP
+    bool tlsResetPending = false;   // broker settings changed; reset TLS before the next attempt
+    LinkPhaseStats phaseStats[LINK_PHASE_COUNT];
+    ReconnectTimings reconnect;
+    unsigned long subscribeStart = 0;
+    bool subscribeTiming = false;
+    uint32_t sessionSignature = 0;  // subscription set held by the broker's stored session
+    uint32_t sessionsResumed = 0;
+    uint32_t fullSubscribeMs = 0;
     MQTTMessageCallback messageCallback;
+    ConfigCommandCallback configCallback;
+    BootTimer* bootTimer;
+    const PipelineTimer* pipelineTimer;
+    OutboundQueue outbound;
+    TopicRouter router;
+    BridgeScheduler bridgeQueue;
+    BridgeElection election;
+    LatencyProbe probe;
+#if defined(ESP32) && !defined(USE_ETHERNET)
+    BrokerEndpoint endpoints[MQTT_EXTRA_BROKERS];
+    StandbySelector standby;     // endpoint carrying the uplink in standby mode
+#endif
+    char appliedRegions[96] = "";  // interest set behind the current subscriptions and routes
+    uint8_t appliedTopics = 0;
+    bool interestDirty = false;
+    size_t bridgeFilterCount = 0;
+    unsigned long lastRankAnnounce = 0;
+    uint32_t bridgeEchoes = 0;     // own publishes seen again on bridge topics
+    uint32_t bridgeMalformed = 0;
+    // Last-will buffers outlive connect() because the async transport copies them later
+    char willTopic[128];
+    char willPayload[96];
+
+    // Single publish path. Store-and-forward messages (RF traffic) are queued while the
+    // broker is unreachable, and also while a backlog exists so replay stays in order.
+    // They are sent at QoS 1 where the transport supports it, with an MQTT 5 expiry so other
+    // gateways never bridge them to RF long after capture; everything else is QoS 0.
+    bool publishMessage(const char* topic, const String& payload, bool retain, bool storeAndForward) {
+        const uint8_t* data = (const uint8_t*)payload.c_str();
+#if defined(ESP32) && !defined(USE_ETHERNET)
+        // Fan-out copies go to each endpoint's own queue first, so a backlog there never
+        // holds up the primary
+        if (config().mqtt.brokerMode == BROKER_MODE_FANOUT) {
+            for (size_t i = 0; i < MQTT_EXTRA_BROKERS; ++i) {
+                endpoints[i].publish(topic, data, payload.length(), retain, storeAndForward, config().mqtt.messageExpirySec);
+            }
+        }
+#endif
+        MQTTTransport* up = uplink();
+        return publishOrQueue(outbound, up != nullptr, topic, payload.c_str(), payload.length(), retain,
+                              storeAndForward, [&](uint8_t qos) {
+                                  return timedPublish(up, topic, data, payload.length(), retain, qos,
+                                                      qos ? config().mqtt.messageExpirySec : 0);
+                              });
+    }
+
+    // Time spent handing a publish to the transport: a ring copy for the async transport,
+    // the whole socket write for PubSubClient
+    bool timedPublish(MQTTTransport* t, const char* topic, const uint8_t* data, size_t length, bool retain,
+                      uint8_t qos, uint32_t expirySec) {
+        uint32_t t0 = micros();
+        bool ok = t->publish(topic, data, length, retain, qos, expirySec);
+        probe.notePublish(micros() - t0);
+        return ok;
+    }
+
+    // Where the uplink goes right now: the primary while it is connected, otherwise the
+    // standby endpoint that took over. Checked per publish, so a standby carries traffic
+    // from the first publish after the primary drops.
+    MQTTTransport* uplink() {
+        if (transport->connected()) return transport;
+#if defined(ESP32) && !defined(USE_ETHERNET)
+        if (config().mqtt.brokerMode == BROKER_MODE_STANDBY) {
+            int carrier = firstUsableEndpoint(MQTT_EXTRA_BROKERS, [this](size_t i) {
+                return endpoints[i].online() && endpoints[i].session()->connected();
+            });
+            if (carrier >= 0) return endpoints[carrier].session();
+        }
+#endif
+        return nullptr;
+    }
+
+#ifndef USE_ETHERNET
+    // Optionally configure TLS; the broker client resumes the previous TLS session on reconnect
+    void configureTls() {
+        brokerClient.setTls(config().mqtt.useTLS);
+        if (config().mqtt.useTLS) {
+            int8_t caSlot = caSlotFor(CERT_SLOT_PRIMARY);
+            if (caSlot >= 0) {
+                brokerClient.setCASlot((uint8_t)caSlot);
+            } else {
+                brokerClient.setCACert(MQTT_CA_CERT);
+            }
+            brokerClient.setInsecure(config().mqtt.insecureTLS);
+            brokerClient.setTlsProfile(config().mqtt.tlsProfile, config().mqtt.tlsMaxFragment);
+        }
+    }
+
+    // CA for a broker's TLS: its own stored CA, else the primary's custom CA, else the built-in
+    // one (-1). Resolved once at startup; the certificate itself is read at each handshake.
+    int8_t caSlotFor(uint8_t slot) {
+        CertStore certs;
+        if (slot != CERT_SLOT_PRIMARY && certs.has(slot)) return (int8_t)slot;
+        if (!config().mqtt.useCustomCA) return -1;
+        if (certs.has(CERT_SLOT_PRIMARY)) return CERT_SLOT_PRIMARY;
+        if (slot == CERT_SLOT_PRIMARY) LOG_WARN("⚠ Custom CA enabled but none stored, using the built-in CA");
+        return -1;
+    }
+#endif
+
+#if defined(ESP32) && !defined(USE_ETHERNET)
+    void beginEndpoints() {
+        if (config().mqtt.brokerMode == BROKER_MODE_SINGLE) return;
+        if (!asyncTransport) {
+            LOG_WARN("⚠ Additional brokers need the async transport, ignoring them");
+            return;
+        }
+        for (size_t i = 0; i < MQTT_EXTRA_BROKERS; ++i) {
+            const BrokerEndpointConfig& b = config().mqtt.extraBrokers[i];
+            if (!b.enabled) continue;
+            if (endpoints[i].begin(b, caSlotFor((uint8_t)(i + 1)), MQTT_CA_CERT, config().mqtt.clientId, (uint8_t)(i + 2),
+                                   [this](char* topic, byte* payload, unsigned int length) {
+                                       this->handleMQTTMessage(topic, payload, length);
+                                   })) {
+                LOG_INFO("✓ MQTT broker %s added (%s)", b.server, brokerModeName(config().mqtt.brokerMode));
+            } else {
+                LOG_WARN("⚠ MQTT broker %s unavailable", b.server);
+            }
+        }
+    }
+
+    // Drive every endpoint and, in standby mode, move the subscriptions to the first online
+    // endpoint while the primary is down and back once it returns
+    void serviceEndpoints() {
+        if (config().mqtt.brokerMode == BROKER_MODE_SINGLE) return;
+        bool up = wifiUp();
+        MqttConnectOptions base;
+        bool due = false;
+        for (size_t i = 0; i < MQTT_EXTRA_BROKERS; ++i) due |= endpoints[i].connectDue(up);
+        if (due) buildConnectOptions(base);
+        for (size_t i = 0; i < MQTT_EXTRA_BROKERS; ++i) endpoints[i].loop(up, base);
+        if (config().mqtt.brokerMode != BROKER_MODE_STANDBY) return;
+
+        bool primaryUp = linkState == LINK_ONLINE && transport->connected();
+        if (!standby.update(primaryUp, MQTT_EXTRA_BROKERS, [this](size_t i) { return endpoints[i].online(); })) {
+            return;
+        }
+        int released = standby.releasedIndex();
+        if (released >= 0 && endpoints[released].online()) moveSubscriptions(endpoints[released].session(), false);
+        if (standby.standbyIndex() >= 0) {
+            BrokerEndpoint& e = endpoints[standby.standbyIndex()];
+            LOG_WARN("⚠ Uplink failed over to %s", e.server());
+            moveSubscriptions(e.session(), true);
+            publishGatewayStatus(true);
+        } else if (linkState == LINK_ONLINE) {
+            LOG_INFO("✓ Uplink back on the primary broker");
+        }
+    }
+
+    // Command, bridge and election filters for a standby that carries (or stops carrying)
+    // the uplink
+    void moveSubscriptions(MQTTTransport* t, bool subscribe) {
+        MQTTFilterBatch batch(t, !subscribe);
+        if (config().mqtt.subscribeCommands) {
+            uint8_t cmdQos = config().mqtt.persistentSession ? 1 : 0;
+            forEachCommandFilter([&](const char* filter) { batch.add(filter, cmdQos); });
+        }
+        if (config().mqtt.bridgeAll) {
+            forEachBridgeFilter(appliedRegions, appliedTopics, [&](const char* filter, uint8_t) {
+                batch.add(filter, MQTT_SUB_NO_LOCAL);
+            });
+            if (config().mqtt.bridgeElection) {
+                char electTopic[128];
+                snprintf(electTopic, sizeof(electTopic), "%s/bridge/+", config().mqtt.topicPrefix);
+                batch.add(electTopic, MQTT_SUB_NO_LOCAL);
+                if (subscribe) lastRankAnnounce = millis() - ELECTION_ANNOUNCE_MS; // announce straight away
+            }
+        }
+        batch.flush();
+    }
+#endif
     
-    bool connectWiFi() {
+    bool wifiUp() {
 #ifdef USE_ETHERNET
         return true;
 #else
-        if (WiFi.status() == WL_CONNECTED) {
-            return true;
+        return WiFi.status() == WL_CONNECTED;
+#endif
+    }
+
+    bool timeIsValid() {
+        return time(nullptr) > 1609459200; // any time after 2021-01-01 means SNTP has run
+    }
+
+    void setLinkState(LinkState next) {
+        linkState = next;
+        stateSince = millis();
+    }
+
+    void beginPhase(LinkPhase phase) {
+        phaseStats[phase].attempts++;
+        phaseStart = millis();
+    }
+
+    void endPhase(LinkPhase phase, bool ok) {
+        uint32_t elapsed = millis() - phaseStart;
+        phaseStats[phase].lastMs = elapsed;
+        if (elapsed > phaseStats[phase].maxMs) phaseStats[phase].maxMs = elapsed;
+        if (!ok) phaseStats[phase].failures++;
+    }
+
+    // Start a connection cycle from whichever phase is still missing
+    void startCycle() {
+#ifndef USE_ETHERNET
+        if (!wifiUp()) {
+            LOG_INFO("\nConnecting to WiFi: %s", config().wifi.ssid);
+            WiFi.mode(WIFI_STA);
+            WiFi.begin(config().wifi.ssid, config().wifi.password);
+            beginPhase(LINK_PHASE_WIFI);
+            setLinkState(LINK_WIFI_CONNECTING);
+            return;
         }
-        
-        Serial.print(F("\nConnecting to WiFi: "));
-        Serial.println(config.wifi.ssid);
-        
-        WiFi.mode(WIFI_STA);
-        WiFi.begin(config.wifi.ssid, config.wifi.password);
-        
-        int attempts = 0;
-        while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-            delay(500);
-            Serial.print(F("."));
-            attempts++;
+#endif
+        startTimeOrMqtt();
+    }
+
+    void startTimeOrMqtt() {
+#ifdef ESP32
+        // TLS certificate validation needs a wall clock; configTime() only kicks off SNTP
+        if (config().mqtt.useTLS && !timeIsValid()) {
+            LOG_INFO("Setting time via NTP for TLS...");
+            long gmtOffset = (long)config().clock.timezoneMinutes * 60;
+            const char* ntp = (config().clock.ntpServer[0] != '\0') ? config().clock.ntpServer : "pool.ntp.org";
+            configTime(gmtOffset, 0, ntp);
+            beginPhase(LINK_PHASE_TIME);
+            setLinkState(LINK_TIME_SYNC);
+            return;
         }
-        
-        if (WiFi.status() == WL_CONNECTED) {
-            Serial.println(F("\n✓ WiFi connected"));
-            Serial.print(F("IP: "));
-            Serial.println(WiFi.localIP());
-            // Reduce chance of missed MQTT keepalives under load
-            WiFi.setSleep(false);
-            WiFi.setAutoReconnect(true);
-
-            // Ensure system time is set for TLS validation
-            if (config.mqtt.useTLS) {
-                setupSystemTimeIfNeeded();
+#endif
+        startMqtt();
+    }
+
+    void startMqtt() {
+        LOG_INFO("Connecting to MQTT: %s", config().mqtt.server);
+        // A previous cycle may have left the transport pointed at the resolved IP
+        transport->setServer(config().mqtt.server, config().mqtt.port);
+        mqttViaIp = false;
+        attemptQueued = true;
+        beginPhase(LINK_PHASE_MQTT);
+        setLinkState(LINK_MQTT_CONNECTING);
+    }
+
+    // Exponential backoff with jitter; after LINK_DEGRADED_AFTER failed cycles the link is
+    // reported degraded but keeps retrying at the capped interval
+    void failCycle() {
+        consecutiveFailures++;
+        scheduleRetry();
+        if (consecutiveFailures >= LINK_DEGRADED_AFTER) {
+            if (consecutiveFailures == LINK_DEGRADED_AFTER) {
+                LOG_WARN("⚠ Uplink degraded: RF-only, buffering uplink traffic; retry in %.1fs", backoffMs / 1000.0f);
             }
-            return true;
+            setLinkState(LINK_DEGRADED);
         } else {
-            Serial.println(F("\n✗ WiFi connection failed"));
-            return false;
+            setLinkState(LINK_BACKOFF);
+        }
+    }
+
+    void scheduleRetry() {
+        uint32_t shift = consecutiveFailures < 16 ? consecutiveFailures : 16;
+        uint32_t ceiling = LINK_BACKOFF_BASE_MS << shift;
+        if (ceiling > LINK_BACKOFF_MAX_MS) ceiling = LINK_BACKOFF_MAX_MS;
+        // Half fixed, half random so gateways that lost the same broker do not retry in lockstep
+        backoffMs = ceiling / 2 + (uint32_t)random((long)(ceiling / 2) + 1);
+        nextAttemptAt = millis() + backoffMs;
+    }
+
+    // Drop the session (and the WiFi association when its credentials changed) and start a
+    // fresh connection cycle; traffic meanwhile goes to the outbound queue as in any outage
+    void restartLink(bool rejoinWifi) {
+        if (linkState == LINK_ONLINE) offlineSince = millis();
+        transport->disconnect();
+        consecutiveFailures = 0;
+        backoffMs = 0;
+#ifndef USE_ETHERNET
+        if (rejoinWifi) {
+            WiFi.disconnect();
+            LOG_INFO("\nConnecting to WiFi: %s", config().wifi.ssid);
+            WiFi.mode(WIFI_STA);
+            WiFi.begin(config().wifi.ssid, config().wifi.password);
+            beginPhase(LINK_PHASE_WIFI);
+            setLinkState(LINK_WIFI_CONNECTING);
+            return;
         }
 #endif
+        startCycle();
     }
-    
-    bool connectMQTT() {
-        if (mqttClient.connected()) {
-            return true;
+
+    void goOffline() {
+        offlineSince = millis();
+        consecutiveFailures = 0;
+        scheduleRetry();
+        setLinkState(LINK_BACKOFF);
+    }
+
+    void goOnline() {
+        bool wasDegraded = consecutiveFailures >= LINK_DEGRADED_AFTER;
+        lastOutageMs = millis() - offlineSince;
+        consecutiveFailures = 0;
+        backoffMs = 0;
+        sessions++;
+        probe.reset();
+        if (bootTimer) bootTimer->noteUplink(millis());
+        setLinkState(LINK_ONLINE);
+        LOG_INFO(mqttViaIp ? "✓ MQTT connected via IP" : "✓ MQTT connected");
+        if (wasDegraded) {
+            LOG_INFO("✓ Uplink restored after %lus", (unsigned long)(lastOutageMs / 1000));
         }
-        
-        Serial.print(F("Connecting to MQTT: "));
-        Serial.println(config.mqtt.server);
-        
+        onSessionStarted();
+    }
+
+    // One bounded step of the connectivity state machine. Nothing here waits: WiFi.begin()
+    // and configTime() return immediately, and the async transport connects on its own task.
+    // With the PubSubClient fallback a launched attempt still blocks for its socket timeout.
+    void stepLink() {
+        unsigned long now = millis();
+        switch (linkState) {
+            case LINK_IDLE:
+                return;
+
+            case LINK_WIFI_CONNECTING:
+#ifndef USE_ETHERNET
+                if (wifiUp()) {
+                    endPhase(LINK_PHASE_WIFI, true);
+                    LOG_INFO("✓ WiFi connected, IP: %s", WiFi.localIP().toString().c_str());
+                    // Reduce chance of missed MQTT keepalives under load
+                    WiFi.setSleep(false);
+                    WiFi.setAutoReconnect(true);
+                    startTimeOrMqtt();
+                } else if (now - phaseStart > LINK_WIFI_TIMEOUT_MS) {
+                    endPhase(LINK_PHASE_WIFI, false);
+                    LOG_WARN("✗ WiFi connection failed");
+                    failCycle();
+                }
+#endif
+                return;
+
+            case LINK_TIME_SYNC:
+                if (timeIsValid()) {
+                    endPhase(LINK_PHASE_TIME, true);
+                    LOG_INFO("✓ Time set");
+                    startTimeOrMqtt();
+                } else if (now - phaseStart > LINK_TIME_SYNC_TIMEOUT_MS) {
+                    endPhase(LINK_PHASE_TIME, false);
+                    LOG_WARN("⚠ Failed to set time, TLS may fail");
+                    startMqtt();
+                } else if (!wifiUp()) {
+                    endPhase(LINK_PHASE_TIME, false);
+                    failCycle();
+                }
+                return;
+
+            case LINK_MQTT_CONNECTING:
+                if (!wifiUp()) {
+                    endPhase(LINK_PHASE_MQTT, false);
+                    failCycle();
+                    return;
+                }
+                if (attemptQueued) {
+                    // After restartLink() the async I/O task may still be closing the old
+                    // session, possibly inside its connect or handshake on brokerClient; the
+                    // attempt (and any TLS reconfiguration) waits until it has let go
+                    if (!transport->idle()) {
+                        // Asked again on every pass, so a session that came up after the
+                        // first request (or missed it) is still closed
+                        transport->disconnect();
+                        if (now - phaseStart > LINK_MQTT_TIMEOUT_MS) {
+                            LOG_WARN("✗ MQTT transport did not stop for the new session");
+                            endPhase(LINK_PHASE_MQTT, false);
+                            failCycle();
+                        }
+                        return;
+                    }
+#ifndef USE_ETHERNET
+                    if (tlsResetPending) {
+                        configureTls();
+                        brokerClient.clearSession();
+                        tlsResetPending = false;
+                    }
+#endif
+                    attemptQueued = false;
+                    attemptStart = now;
+                    MqttConnectOptions options;
+                    buildConnectOptions(options);
+                    transport->connect(options);
+                    return;
+                }
+                if (transport->connected()) {
+                    recordConnectTimings(now);
+                    endPhase(LINK_PHASE_MQTT, true);
+                    goOnline();
+                    return;
+                }
+                if (transport->connecting()) {
+                    if (now - attemptStart > LINK_MQTT_TIMEOUT_MS) {
+                        LOG_WARN("✗ MQTT connect timed out");
+                        transport->disconnect();
+                        endPhase(LINK_PHASE_MQTT, false);
+                        failCycle();
+                    }
+                    return;
+                }
+                LOG_WARN("✗ MQTT connection failed, rc=%d", transport->state());
+#ifndef USE_ETHERNET
+                // Some deployments use a certificate whose CN is the broker IP (not DNS name).
+                // Retry once by resolving the hostname and connecting via IP address so hostname
+                // verification aligns with the certificate or is omitted by the stack.
+                if (config().mqtt.useTLS && !mqttViaIp) {
+                    IPAddress brokerIp;
+                    bool cached = false;
+                    if (brokerClient.resolver().resolve(config().mqtt.server, brokerIp, cached)) {
+                        LOG_INFO("Retrying MQTT via resolved IP: %s", brokerIp.toString().c_str());
+                        transport->setServer(brokerIp, config().mqtt.port);
+                        mqttViaIp = true;
+                        attemptQueued = true;
+                        return;
+                    }
+                }
+#endif
+                endPhase(LINK_PHASE_MQTT, false);
+                failCycle();
+                return;
+
+            case LINK_ONLINE:
+                if (!wifiUp()) {
+                    LOG_WARN("WiFi disconnected, reconnecting...");
+                    goOffline();
+                } else if (!transport->connected()) {
+                    LOG_WARN("⚠ MQTT connection lost, rc=%d", transport->state());
+                    goOffline();
+                }
+                return;
+
+            case LINK_BACKOFF:
+            case LINK_DEGRADED:
+                if ((long)(now - nextAttemptAt) >= 0) {
+                    startCycle();
+                }
+                return;
+        }
+    }
+
+    // Split the successful attempt into socket phases (measured by the broker client) and
+    // the MQTT CONNECT exchange, which is whatever remains of the attempt
+    void recordConnectTimings(unsigned long now) {
+        memset(&reconnect, 0, sizeof(reconnect));
+#ifndef USE_ETHERNET
+        const BrokerConnectTimings& t = brokerClient.lastTimings();
+        reconnect.dnsMs = t.dnsMs;
+        reconnect.tcpMs = t.tcpMs;
+        reconnect.tlsMs = t.tlsMs;
+        reconnect.dnsCached = t.dnsCached;
+        reconnect.tlsResumed = t.tlsResumed;
+#endif
+        uint32_t attemptMs = now - attemptStart;
+        uint32_t socketMs = reconnect.dnsMs + reconnect.tcpMs + reconnect.tlsMs;
+        reconnect.connectMs = attemptMs > socketMs ? attemptMs - socketMs : 0;
+        reconnect.totalMs = now - phaseStart;
+    }
+
+    void finishSubscribeTiming() {
+        if (!subscribeTiming) return;
+        if (linkState != LINK_ONLINE) {
+            subscribeTiming = false;
+            return;
+        }
+        if (transport->pendingSubscribes() > 0) return;
+        subscribeTiming = false;
+        reconnect.subscribeMs = reconnect.sessionResumed ? 0 : millis() - subscribeStart;
+        reconnect.totalMs += reconnect.subscribeMs;
+        if (!reconnect.sessionResumed) fullSubscribeMs = reconnect.subscribeMs;
+        // Two records: a log record carries at most LOG_MAX_ARGS arguments
+        LOG_INFO("Reconnect (ms): dns %lu%s, tcp %lu, tls %lu%s, connect %lu",
+                 (unsigned long)reconnect.dnsMs, reconnect.dnsCached ? " (cached)" : "",
+                 (unsigned long)reconnect.tcpMs, (unsigned long)reconnect.tlsMs,
+                 reconnect.tlsResumed ? " (resumed)" : "", (unsigned long)reconnect.connectMs);
+        LOG_INFO("Reconnect (ms): subscribe %lu%s, total %lu", (unsigned long)reconnect.subscribeMs,
+                 reconnect.sessionResumed ? " (session kept)" : "", (unsigned long)reconnect.totalMs);
+    }
+
+    void buildConnectOptions(MqttConnectOptions& options) {
         // Prepare last will message
-        char willTopic[128];
         snprintf(willTopic, sizeof(willTopic), "%s/gateway/%s/status", 
-                config.mqtt.topicPrefix, config.mqtt.clientId);
+                config().mqtt.topicPrefix, config().mqtt.clientId);
         
         StaticJsonDocument<128> willDoc;
         willDoc["online"] = false;
         willDoc["timestamp"] = millis();
-        String willPayload;
-        serializeJson(willDoc, willPayload);
+        serializeJson(willDoc, willPayload, sizeof(willPayload));
         
-        bool connected = false;
-        if (strlen(config.mqtt.username) > 0) {
-            connected = mqttClient.connect(
-                config.mqtt.clientId,
-                config.mqtt.username,
-                config.mqtt.password,
-                willTopic,
-                1,
-                true,
-                willPayload.c_str()
-            );
-        } else {
-            connected = mqttClient.connect(
-                config.mqtt.clientId,
-                willTopic,
-                1,
-                true,
-                willPayload.c_str()
-            );
+        options.clientId = config().mqtt.clientId;
+        options.username = config().mqtt.username;
+        options.password = config().mqtt.password;
+        options.willTopic = willTopic;
+        options.willPayload = willPayload;
+        options.willQos = 1;
+        options.willRetain = true;
+        // A persistent session needs the same client id every time; it is derived from the
+        // node name at boot, so it only changes when the node is renamed
+        options.cleanSession = !config().mqtt.persistentSession;
+        options.keepAliveSec = 60;
+        options.protocolVersion = config().mqtt.mqtt5 ? MQTT_PROTOCOL_V5 : MQTT_PROTOCOL_V311;
+        options.topicAliasMax = 0;
+        options.sessionExpirySec = config().mqtt.persistentSession ? MQTT_SESSION_EXPIRY_SEC : 0;
+    }
+
+    // Subscriptions and online status for a freshly established session
+    void onSessionStarted() {
+        subscribeStart = millis();
+        subscribeTiming = true;
+        if (config().mqtt.bridgeAll && interestDirty) adoptInterest();
+        // A resumed persistent session still holds every subscription, and commands sent while
+        // we were away are queued behind the CONNACK; only resubscribe if the set changed
+        if (config().mqtt.persistentSession && transport->sessionPresent() &&
+            sessionSignature != 0 && sessionSignature == subscriptionSignature()) {
+            reconnect.sessionResumed = true;
+            sessionsResumed++;
+            LOG_INFO("✓ MQTT session resumed, subscriptions kept");
+            if (config().mqtt.bridgeAll && config().mqtt.bridgeElection) {
+                lastRankAnnounce = millis() - ELECTION_ANNOUNCE_MS;
+            }
+            publishGatewayStatus(true);
+            return;
+        }
+        // QoS 1 lets the broker queue commands for a persistent session while we are offline
+        uint8_t cmdQos = config().mqtt.persistentSession ? 1 : 0;
+        if (config().mqtt.subscribeCommands) {
+            forEachCommandFilter([&](const char* filter) {
+                transport->subscribe(filter, cmdQos);
+                LOG_INFO("Subscribed to: %s", filter);
+            });
+        }
+        // Latency probe echoes; No Local would suppress exactly the message we wait for
+        char probeFilter[128];
+        probeTopic(probeFilter, sizeof(probeFilter));
+        transport->subscribe(probeFilter, 0);
+        // Optionally subscribe to bridge topics under hierarchical prefix. No Local (MQTT 5)
+        // keeps our own publishes from being echoed back; the gateway-id check below remains
+        // for 3.1.1 sessions.
+        if (config().mqtt.bridgeAll) {
+            // Every bridge filter in as few SUBSCRIBE packets as possible
+            MQTTFilterBatch batch(transport, false);
+            forEachBridgeFilter(appliedRegions, appliedTopics, [&](const char* filter, uint8_t) {
+                batch.add(filter, MQTT_SUB_NO_LOCAL);
+            });
+            batch.flush();
+            LOG_INFO("Subscribed to %u bridge filters in %u packet(s)",
+                     (unsigned)batch.filtersSent(), (unsigned)batch.packetsSent());
+            if (!batch.succeeded()) LOG_WARN("⚠ Some bridge subscriptions failed");
+            // Election traffic stays within our own prefix: only gateways bridging the same
+            // region compete for the same frames
+            if (config().mqtt.bridgeElection) {
+                char electTopic[128];
+                snprintf(electTopic, sizeof(electTopic), "%s/bridge/+", config().mqtt.topicPrefix);
+                transport->subscribe(electTopic, 0, true);
+                LOG_INFO("Subscribed to: %s", electTopic);
+                lastRankAnnounce = millis() - ELECTION_ANNOUNCE_MS; // announce straight away
+            }
         }
+        sessionSignature = subscriptionSignature();
         
-        if (connected) {
-            Serial.println(F("✓ MQTT connected"));
-            
-            // Subscribe to command topics including sub-regions when region is empty
-            if (config.mqtt.subscribeCommands) {
-                char cmdTopic[128];
-                snprintf(cmdTopic, sizeof(cmdTopic), "%s/commands/#", config.mqtt.topicPrefix);
-                mqttClient.subscribe(cmdTopic);
-                Serial.print(F("Subscribed to: "));
-                Serial.println(cmdTopic);
-                if (config.mqtt.region[0] == '\0') {
-                    // When no region is specified, also accept one-level deeper regions
-                    char cmdWildcard1[128];
-                    snprintf(cmdWildcard1, sizeof(cmdWildcard1), "%s/+/commands/#", config.mqtt.topicPrefix);
-                    mqttClient.subscribe(cmdWildcard1);
-                    Serial.print(F("Subscribed to: "));
-                    Serial.println(cmdWildcard1);
-                    // And two-levels deeper (country and region absent)
-                    char cmdWildcard2[128];
-                    snprintf(cmdWildcard2, sizeof(cmdWildcard2), "%s/+/+/commands/#", config.mqtt.topicPrefix);
-                    mqttClient.subscribe(cmdWildcard2);
-                    Serial.print(F("Subscribed to: "));
-                    Serial.println(cmdWildcard2);
+        // Publish online status
+        publishGatewayStatus(true);
+    }
+    
+    // Replayed store-and-forward frames carry their capture age; brokers without MQTT 5
+    // expiry deliver them regardless, so apply the same limit before bridging to RF
+    bool isStaleBridgeFrame(const BridgeFields& f) {
+        uint32_t ageMs = 0;
+        if (config().mqtt.messageExpirySec == 0 || !bridgeParseU32(f[BF_CAPTURED_AGE], ageMs)) return false;
+        return ageMs / 1000UL > config().mqtt.messageExpirySec;
+    }
+
+    // Common front half of every bridged payload: scan once, drop our own echoes and
+    // stale replays, then charge the publishing gateway's token bucket before anything is
+    // decoded. Returns the reserved frame, or nullptr if the message is not bridged.
+    BridgeFrame* admitBridged(const uint8_t* payload, size_t length, BridgeFields& f) {
+        if (!messageCallback) return nullptr;
+        BridgeScanResult r = bridgeScan((const char*)payload, length, config().mqtt.clientId, f);
+        if (r == BRIDGE_SELF) {
+            bridgeEchoes++;
+            return nullptr;
+        }
+        if (r != BRIDGE_OK) {
+            bridgeMalformed++;
+            return nullptr;
+        }
+        if (isStaleBridgeFrame(f)) return nullptr;
+        const JsonSpan& gw = f[BF_GATEWAY];
+        bool named = gw.isString && gw.len > 0;
+        return bridgeQueue.admit(named ? gw.p : "?", named ? gw.len : 1, millis());
+    }
+
+    // Scopes bridged for an interest set: our own prefix, then either every child region
+    // ("*", only meaningful without a region of our own) or the listed regions. Listed
+    // regions sit under our country, so they are siblings when we have a region and
+    // children when we do not.
+    template<typename F>
+    void forEachInterestScope(const char* regions, F fn) {
+        fn(config().mqtt.topicPrefix);
+        char scope[112];
+        if (strcmp(regions, "*") == 0) {
+            if (config().mqtt.region[0] == '\0') {
+                snprintf(scope, sizeof(scope), "%s/+", config().mqtt.topicPrefix);
+                fn(scope);
+                snprintf(scope, sizeof(scope), "%s/+/+", config().mqtt.topicPrefix);
+                fn(scope);
+            }
+            return;
+        }
+        int parentLen = (int)strlen(config().mqtt.topicPrefix);
+        const char* slash = strrchr(config().mqtt.topicPrefix, '/');
+        if (config().mqtt.region[0] != '\0' && slash) parentLen = (int)(slash - config().mqtt.topicPrefix);
+        const char* p = regions;
+        uint8_t listed = 0;
+        while (*p && listed < INTEREST_MAX_REGIONS) {
+            const char* end = strchr(p, ',');
+            int len = end ? (int)(end - p) : (int)strlen(p);
+            if (len > 0 && !(len == 1 && *p == '-')) {
+                snprintf(scope, sizeof(scope), "%.*s/%.*s", parentLen, config().mqtt.topicPrefix, len, p);
+                if (strcmp(scope, config().mqtt.topicPrefix) != 0) {
+                    fn(scope);
+                    listed++;
                 }
             }
-            // Optionally subscribe to bridge topics under hierarchical prefix
-            if (config.mqtt.bridgeAll) {
-                // Topics that should be bridged over RF
-                const char* bridgeTopics[] = { "raw", "messages", "status", "stats", "floods", "adverts" };
-                for (size_t i = 0; i < sizeof(bridgeTopics)/sizeof(bridgeTopics[0]); ++i) {
-                    char exact[128];
-                    snprintf(exact, sizeof(exact), "%s/%s", config.mqtt.topicPrefix, bridgeTopics[i]);
-                    mqttClient.subscribe(exact);
-                    Serial.print(F("Subscribed to: "));
-                    Serial.println(exact);
-                    if (config.mqtt.region[0] == '\0') {
-                        // parent only: include one and two-level deeper children
-                        char oneLevel[128];
-                        snprintf(oneLevel, sizeof(oneLevel), "%s/+/%s", config.mqtt.topicPrefix, bridgeTopics[i]);
-                        mqttClient.subscribe(oneLevel);
-                        Serial.print(F("Subscribed to: "));
-                        Serial.println(oneLevel);
-                        char twoLevel[128];
-                        snprintf(twoLevel, sizeof(twoLevel), "%s/+/+/%s", config.mqtt.topicPrefix, bridgeTopics[i]);
-                        mqttClient.subscribe(twoLevel);
-                        Serial.print(F("Subscribed to: "));
-                        Serial.println(twoLevel);
-                    }
+            if (!end) break;
+            p = end + 1;
+        }
+    }
+
+    // fn(filter, topic class index) for every scope/class pair of an interest set
+    template<typename F>
+    void forEachBridgeFilter(const char* regions, uint8_t topics, F fn) {
+        forEachInterestScope(regions, [&](const char* scope) {
+            char filter[112];
+            for (uint8_t i = 0; i < INTEREST_TOPIC_COUNT; ++i) {
+                if (!(topics & (1 << i))) continue;
+                snprintf(filter, sizeof(filter), "%s/%s", scope, INTEREST_TOPIC_NAMES[i]);
+                fn(filter, i);
+            }
+        });
+    }
+
+    bool isBridgeFilter(const char* regions, uint8_t topics, const char* filter) {
+        bool found = false;
+        forEachBridgeFilter(regions, topics, [&](const char* f, uint8_t) {
+            if (!found && strcmp(f, filter) == 0) found = true;
+        });
+        return found;
+    }
+
+    // Command topics, including sub-regions when region is empty
+    template<typename F>
+    void forEachCommandFilter(F fn) {
+        char filter[128];
+        snprintf(filter, sizeof(filter), "%s/commands/#", config().mqtt.topicPrefix);
+        fn(filter);
+        if (config().mqtt.region[0] == '\0') {
+            // When no region is specified, also accept one- and two-level deeper regions
+            snprintf(filter, sizeof(filter), "%s/+/commands/#", config().mqtt.topicPrefix);
+            fn(filter);
+            snprintf(filter, sizeof(filter), "%s/+/+/commands/#", config().mqtt.topicPrefix);
+            fn(filter);
+        }
+    }
+
+    // Identity of everything onSessionStarted() subscribes to (FNV-1a over the inputs), so a
+    // resumed session is only trusted if it was built from the same settings
+    uint32_t subscriptionSignature() const {
+        uint32_t h = 2166136261UL;
+        auto mix = [&h](const char* str) {
+            for (const char* c = str; ; ++c) {
+                h ^= (uint8_t)*c;
+                h *= 16777619UL;
+                if (*c == '\0') break;
+            }
+        };
+        char flags[8];
+        snprintf(flags, sizeof(flags), "%d%d%d%d%02x", config().mqtt.subscribeCommands, config().mqtt.bridgeAll,
+                 config().mqtt.bridgeElection, config().mqtt.persistentSession, appliedTopics);
+        mix(flags);
+        mix(config().mqtt.topicPrefix);
+        mix(config().mqtt.region);
+        mix(appliedRegions);
+        return h ? h : 1;
+    }
+
+    // Make the configured interest set current and recompile routes to match
+    void adoptInterest() {
+        interestDirty = false;
+        strncpy(appliedRegions, config().mqtt.interestRegions, sizeof(appliedRegions) - 1);
+        appliedRegions[sizeof(appliedRegions) - 1] = '\0';
+        appliedTopics = config().mqtt.interestTopics;
+        bridgeFilterCount = 0;
+        forEachBridgeFilter(appliedRegions, appliedTopics, [this](const char*, uint8_t) { bridgeFilterCount++; });
+        buildRoutes();
+    }
+
+    // Runtime change: unsubscribe what left the set, subscribe what joined it. Offline, the
+    // next session subscribes to the new set from scratch.
+    void applyInterest() {
+        if (!config().mqtt.bridgeAll ||
+            (strcmp(appliedRegions, config().mqtt.interestRegions) == 0 && appliedTopics == config().mqtt.interestTopics)) {
+            interestDirty = false;
+            return;
+        }
+        if (linkState == LINK_ONLINE && transport->connected()) {
+            MQTTFilterBatch removed(transport, true);
+            forEachBridgeFilter(appliedRegions, appliedTopics, [&](const char* filter, uint8_t) {
+                if (!isBridgeFilter(config().mqtt.interestRegions, config().mqtt.interestTopics, filter)) {
+                    removed.add(filter, 0);
                 }
+            });
+            removed.flush();
+            MQTTFilterBatch added(transport, false);
+            forEachBridgeFilter(config().mqtt.interestRegions, config().mqtt.interestTopics, [&](const char* filter, uint8_t) {
+                if (!isBridgeFilter(appliedRegions, appliedTopics, filter)) added.add(filter, MQTT_SUB_NO_LOCAL);
+            });
+            added.flush();
+            LOG_INFO("Bridge interest updated: +%u -%u filters",
+                     (unsigned)added.filtersSent(), (unsigned)removed.filtersSent());
+            adoptInterest();
+            sessionSignature = subscriptionSignature();
+            return;
+        }
+        adoptInterest();
+    }
+
+    // Queue a decoded frame. With the election on, frames a peer already claimed are
+    // dropped and the rest are held for our place in the ranking.
+    void commitBridged(BridgeFrame* frame) {
+        if (!config().mqtt.bridgeElection) {
+            bridgeQueue.commit(frame);
+            return;
+        }
+        unsigned long now = millis();
+        if (election.isClaimed(BridgeElection::frameKey(frame->data, frame->length), now)) {
+            election.noteSuppressed();
+            bridgeQueue.abort(frame);
+            return;
+        }
+        unsigned long holdoff = election.holdoffMs(now, config().mqtt.bridgeFallbackMs);
+        bridgeQueue.commit(frame, holdoff ? now + holdoff : 0);
+    }
+
+    // The RF side: at most one bridged frame per loop(), taken round-robin across sources
+    void serviceBridgeQueue() {
+        unsigned long now = millis();
+        BridgeFrame* frame = bridgeQueue.next(now);
+        if (!frame) return;
+        if (config().mqtt.bridgeElection) {
+            uint32_t key = BridgeElection::frameKey(frame->data, frame->length);
+            if (election.isClaimed(key, now)) {
+                // A better-ranked gateway transmitted it while we were holding it
+                election.noteSuppressed();
+                bridgeQueue.release(frame);
+                return;
             }
-            
-            // Publish online status
-            publishGatewayStatus(true);
-            
-            return true;
-        } else {
-            Serial.print(F("✗ MQTT connection failed, rc="));
-            Serial.println(mqttClient.state());
-            // If TLS is enabled but time might not be set yet, attempt time sync once
-            if (config.mqtt.useTLS) {
+            election.noteClaim(key, now);
+            election.noteTransmitted(election.position(now) > 0);
+            publishClaim(key);
+        }
+        if (messageCallback) messageCallback(frame->data, frame->length);
+        bridgeQueue.release(frame);
+    }
+
+    // Ephemeral (QoS 0, not retained) claim so peers holding the same frame drop it
+    // Claims and rank announcements follow the uplink, so a gateway running on its standby
+    // broker (which also carries its bridge subscriptions) keeps taking part in the election
+    void publishClaim(uint32_t key) {
+        MQTTTransport* up = uplink();
+        if (!up) return;
+        char topic[128];
+        char payload[96];
+        snprintf(topic, sizeof(topic), "%s/bridge/claim", config().mqtt.topicPrefix);
+        int n = snprintf(payload, sizeof(payload), "{\"gateway\":\"%s\",\"key\":%lu}",
+                         config().mqtt.clientId, (unsigned long)key);
+        up->publish(topic, (const uint8_t*)payload, (size_t)n, false, 0, ELECTION_CLAIM_TTL_MS / 1000UL);
+    }
+
+    void announceRank() {
+        if (!config().mqtt.bridgeAll || !config().mqtt.bridgeElection) return;
+        unsigned long now = millis();
+        if (now - lastRankAnnounce < ELECTION_ANNOUNCE_MS) return;
+        MQTTTransport* up = uplink();
+        if (!up) return;
+        lastRankAnnounce = now;
+        char topic[128];
+        char payload[96];
+        snprintf(topic, sizeof(topic), "%s/bridge/rank", config().mqtt.topicPrefix);
+        int n = snprintf(payload, sizeof(payload), "{\"gateway\":\"%s\",\"rank\":%u}",
+                         config().mqtt.clientId, (unsigned)election.rank());
+        up->publish(topic, (const uint8_t*)payload, (size_t)n, false, 0, ELECTION_PEER_TTL_MS / 1000UL);
+    }
+
+    void probeTopic(char* out, size_t size) {
+        snprintf(out, size, "%s/gateway/%s/probe", config().mqtt.topicPrefix, config().mqtt.clientId);
+    }
+
+    // Round-trip probe over the primary session; the echo arrives through the router
+    void serviceProbe() {
+        if (linkState != LINK_ONLINE || !transport->connected()) return;
+        unsigned long now = millis();
+        uint32_t seq = probe.poll(now);
+        if (seq == 0) return;
+        char topic[128];
+        char payload[32];
+        probeTopic(topic, sizeof(topic));
+        int n = snprintf(payload, sizeof(payload), "{\"seq\":%lu}", (unsigned long)seq);
+        if (transport->publish(topic, (const uint8_t*)payload, (size_t)n, false, 0)) probe.noteSent(now);
+    }
+
+    void handleProbe(const uint8_t* payload, size_t length) {
+        StaticJsonDocument<64> doc;
+        if (deserializeJson(doc, payload, length) != DeserializationError::Ok) return;
+        probe.noteEcho(doc["seq"] | 0UL, millis());
+    }
+
+    // { "lora": { "frequency": 916.575, "bandwidth": 62.5, "spreadingFactor": 7, "codingRate": 8,
+    //            "txPower": 20, "syncWord": 18, "crc": true },
+    //   "mqtt": { "server": "...", "port": 8883, "username": "...", "password": "...", "tls": true },
+    //   "save": true }
+    // Absent fields keep their current value; without "save" the change lasts until reboot
+    void handleConfigCommand(uint8_t* payload, size_t length) {
+        if (!configCallback) return;
+        StaticJsonDocument<512> doc;
+        if (deserializeJson(doc, payload, length) != DeserializationError::Ok) {
+            LOG_WARN("⚠ Config command ignored: invalid JSON");
+            return;
+        }
+        // Heap copy: the whole configuration does not belong on the loop stack next to the document
+        GatewayConfig* next = new (std::nothrow) GatewayConfig(config());
+        if (!next) return;
+        // Every field goes through the console's key table, so a command can set nothing the
+        // '@set' command would refuse; one bad field rejects the whole command
+        const char* rejectedKey = nullptr;
+        const char* error = nullptr;
+        for (size_t i = 0; i < sizeof(CONFIG_COMMAND_FIELDS) / sizeof(CONFIG_COMMAND_FIELDS[0]) && !rejectedKey; ++i) {
+            const ConfigCommandField& f = CONFIG_COMMAND_FIELDS[i];
+            JsonVariantConst value = doc[f.section][f.field];
+            if (!value.isNull() && !applyConfigField(*next, f.key, value, error)) rejectedKey = f.key;
+        }
 #ifndef USE_ETHERNET
-                setupSystemTimeIfNeeded();
-                // Some deployments use a certificate whose CN is the broker IP (not DNS name).
-                // Retry once by resolving the hostname and connecting via IP address so hostname
-                // verification aligns with the certificate or is omitted by the stack.
-                IPAddress brokerIp;
-                if (WiFi.hostByName(config.mqtt.server, brokerIp)) {
-                    Serial.print(F("Retrying MQTT via resolved IP: "));
-                    Serial.println(brokerIp);
-                    mqttClient.setServer(brokerIp, config.mqtt.port);
-                    bool ipConnected = false;
-                    if (strlen(config.mqtt.username) > 0) {
-                        ipConnected = mqttClient.connect(
-                            config.mqtt.clientId,
-                            config.mqtt.username,
-                            config.mqtt.password,
-                            willTopic,
-                            1,
-                            true,
-                            willPayload.c_str()
-                        );
-                    } else {
-                        ipConnected = mqttClient.connect(
-                            config.mqtt.clientId,
-                            willTopic,
-                            1,
-                            true,
-                            willPayload.c_str()
-                        );
-                    }
-                    if (ipConnected) {
-                        Serial.println(F("✓ MQTT connected via IP"));
-                        // Restore hostname for future operations/subscriptions
-                        mqttClient.setServer(config.mqtt.server, config.mqtt.port);
-                        // Publish online status
-                        publishGatewayStatus(true);
-                        // Subscribe after connection (re-run minimal subscription for commands)
-                        if (config.mqtt.subscribeCommands) {
-                            char cmdTopic[128];
-                            snprintf(cmdTopic, sizeof(cmdTopic), "%s/commands/#", config.mqtt.topicPrefix);
-                            mqttClient.subscribe(cmdTopic);
-                            Serial.print(F("Subscribed to: "));
-                            Serial.println(cmdTopic);
-                        }
-                        return true;
-                    }
-                }
+        if (!rejectedKey && next->mqtt.useTLS && !config().mqtt.useTLS && next->mqtt.useCustomCA &&
+            !CertStore().has(CERT_SLOT_PRIMARY)) {
+            rejectedKey = "mqtt.useTLS";
+            error = "custom CA enabled but none stored";
+        }
 #endif
-            }
+        if (rejectedKey) {
+            LOG_WARN("⚠ Config command rejected: %s %s", rejectedKey, error);
+            delete next;
+            return;
+        }
+        LOG_INFO("Config command received via MQTT");
+        configCallback(*next, doc["save"] | false);
+        delete next;
+    }
+
+    struct ConfigCommandField {
+        const char* section;
+        const char* field;
+        const char* key;        // CONFIG_KEYS name
+    };
+
+    static constexpr ConfigCommandField CONFIG_COMMAND_FIELDS[] = {
+        { "lora", "frequency", "lora.frequency" },
+        { "lora", "bandwidth", "lora.bandwidth" },
+        { "lora", "spreadingFactor", "lora.spreadingFactor" },
+        { "lora", "codingRate", "lora.codingRate" },
+        { "lora", "txPower", "lora.txPower" },
+        { "lora", "syncWord", "lora.syncWord" },
+        { "lora", "crc", "lora.enableCRC" },
+        { "mqtt", "server", "mqtt.server" },
+        { "mqtt", "port", "mqtt.port" },
+        { "mqtt", "username", "mqtt.username" },
+        { "mqtt", "password", "mqtt.password" },
+        { "mqtt", "tls", "mqtt.useTLS" },
+    };
+
+    // One JSON value into cfg as its text form, checked like an '@set' value. An empty string
+    // means "keep": a broker change never blanks the server or credentials.
+    static bool applyConfigField(GatewayConfig& cfg, const char* name, JsonVariantConst value, const char*& error) {
+        const ConfigKey* key = findConfigKey(name);
+        char text[32];
+        if (!key) {
+            error = "unknown key";
+            return false;
+        }
+        if (value.is<const char*>()) {
+            const char* s = value.as<const char*>();
+            if (s[0] == '\0') return true;
+            return setConfigValue(cfg, *key, s, error);
+        }
+        if (value.is<bool>()) {
+            snprintf(text, sizeof(text), "%s", value.as<bool>() ? "true" : "false");
+        } else if (value.is<long>()) {
+            snprintf(text, sizeof(text), "%ld", value.as<long>());
+        } else if (value.is<double>()) {
+            snprintf(text, sizeof(text), "%.7g", value.as<double>());
+        } else {
+            error = "expected a value";
             return false;
         }
+        return setConfigValue(cfg, *key, text, error);
     }
-    
-    void handleMQTTMessage(char* topic, byte* payload, unsigned int length) {
-        Serial.print(F("MQTT message received: "));
-        Serial.println(topic);
-        
-        // Parse topic to determine action
-        String topicStr = String(topic);
-        String prefix = String(config.mqtt.topicPrefix) + "/commands/";
-        String subPrefix = String(config.mqtt.topicPrefix) + "/"; // allows {prefix}/{child}/commands/
-
-        // Accept commands when:
-        // 1) Exact: {prefix}/commands/...
-        // 2) Parent with one child: {prefix}/{child}/commands/...
-        // 3) Parent with two children: {prefix}/{child}/{child}/commands/...
-        bool isCommand = false;
-        if (topicStr.startsWith(prefix)) {
-            isCommand = true;
-        } else if (config.mqtt.region[0] == '\0' && topicStr.startsWith(subPrefix)) {
-            int firstSlashAfter = topicStr.indexOf('/', subPrefix.length());
-            if (firstSlashAfter > 0) {
-                // Check for /commands/ at either {prefix}/{x}/commands/ or {prefix}/{x}/{y}/commands/
-                int posCommands = topicStr.indexOf("/commands/", subPrefix.length());
-                if (posCommands == firstSlashAfter || (posCommands > firstSlashAfter && topicStr.indexOf('/', firstSlashAfter + 1) == posCommands)) {
-                    isCommand = true;
-                }
+
+    // Rank announcements and claims share the bridge scanner; our own are filtered as echoes
+    void handleElection(uint8_t tag, const uint8_t* payload, size_t length) {
+        BridgeFields f;
+        BridgeScanResult r = bridgeScan((const char*)payload, length, config().mqtt.clientId, f);
+        if (r != BRIDGE_OK) return;
+        const JsonSpan& gw = f[BF_GATEWAY];
+        uint32_t value = 0;
+        if (!gw.isString || gw.len == 0) return;
+        if (tag == ROUTE_ELECTION_RANK) {
+            if (bridgeParseU32(f[BF_RANK], value)) {
+                election.notePeer(gw.p, gw.len, (uint16_t)(value > 0xFFFF ? 0xFFFF : value), millis());
             }
+        } else if (bridgeParseU32(f[BF_KEY], value) && value != 0) {
+            election.noteClaim(value, millis());
         }
+    }
 
-        if (isCommand) {
-            // Compute command segment after the '/commands/' marker
-            int idx = topicStr.indexOf("/commands/");
-            String command = topicStr.substring(idx + 10);
-            
-            if (command == "send" && messageCallback) {
+    // Compile inbound routes for the current prefix; mirrors the subscriptions made in
+    // onSessionStarted(). Adding a bridge topic is one routeScoped() line.
+    void buildRoutes() {
+        router.clear();
+        char probePattern[128];
+        probeTopic(probePattern, sizeof(probePattern));
+        router.add(probePattern, ROUTE_PROBE, [this](const TopicMatch&, uint8_t* payload, size_t length) {
+            handleProbe(payload, length);
+        });
+        if (config().mqtt.subscribeCommands) {
+            routeScoped("commands/send", ROUTE_CMD_SEND, [this](const TopicMatch&, uint8_t* payload, size_t length) {
                 // Forward message to LoRa via callback
-                messageCallback(payload, length);
-            } else if (command == "restart") {
-                Serial.println(F("Restart command received via MQTT"));
+                if (messageCallback) messageCallback(payload, length);
+            });
+            routeScoped("commands/restart", ROUTE_CMD_RESTART, [](const TopicMatch&, uint8_t*, size_t) {
+                LOG_INFO("Restart command received via MQTT");
                 delay(1000);
                 ESP.restart();
-            }
-        } else if (config.mqtt.bridgeAll && (topicStr == String(config.mqtt.topicPrefix) + "/raw" || topicStr.endsWith("/raw"))) {
-            // Expect JSON with { data: hex, gateway?: string }
-            StaticJsonDocument<1024> doc;
-            DeserializationError err = deserializeJson(doc, payload, length);
-            if (err == DeserializationError::Ok && messageCallback) {
-                const char* gw = doc["gateway"] | "";
-                if (strcmp(gw, config.mqtt.clientId) == 0) {
-                    return; // drop self
-                }
-                const char* hex = doc["data"] | nullptr;
-                if (hex) {
-                    size_t hexLen = strlen(hex);
-                    size_t outLen = hexLen / 2;
-                    if (outLen > 0 && outLen <= 512) {
-                        uint8_t buf[512];
-                        size_t j = 0;
-                        for (size_t i = 0; i + 1 < hexLen && j < outLen; i += 2, j++) {
-                            char hi = hex[i];
-                            char lo = hex[i + 1];
-                            uint8_t v = 0;
-                            auto cvt = [](char c) -> uint8_t {
-                                if (c >= '0' && c <= '9') return (uint8_t)(c - '0');
-                                if (c >= 'a' && c <= 'f') return (uint8_t)(10 + c - 'a');
-                                if (c >= 'A' && c <= 'F') return (uint8_t)(10 + c - 'A');
-                                return 0xFF;
-                            };
-                            uint8_t vh = cvt(hi);
-                            uint8_t vl = cvt(lo);
-                            if (vh == 0xFF || vl == 0xFF) { j = 0; break; }
-                            v = (uint8_t)((vh << 4) | vl);
-                            buf[j] = v;
-                        }
-                        if (j == outLen) {
-                            messageCallback(buf, outLen);
-                        }
-                    }
-                }
-            }
-        } else if (config.mqtt.bridgeAll && (topicStr == String(config.mqtt.topicPrefix) + "/messages" || topicStr.endsWith("/messages"))) {
-            // Expect JSON with { message: string, gateway?: string }
-            StaticJsonDocument<1024> doc;
-            DeserializationError err = deserializeJson(doc, payload, length);
-            if (err == DeserializationError::Ok && messageCallback) {
-                const char* gw = doc["gateway"] | "";
-                if (strcmp(gw, config.mqtt.clientId) == 0) {
-                    return; // drop self
-                }
-                const char* text = doc["message"] | nullptr;
-                if (text) {
-                    messageCallback((const uint8_t*)text, strlen(text));
-                }
-            }
-        } else if (config.mqtt.bridgeAll && (topicStr == String(config.mqtt.topicPrefix) + "/adverts" || topicStr.endsWith("/adverts"))) {
-            // Expect JSON with { nodeId, name, lat, lon, gateway? }
-            StaticJsonDocument<1024> doc;
-            DeserializationError err = deserializeJson(doc, payload, length);
-            if (err == DeserializationError::Ok && messageCallback) {
-                const char* gw = doc["gateway"] | "";
-                if (strcmp(gw, config.mqtt.clientId) == 0) {
-                    return; // drop self
-                }
-                uint32_t nodeId = doc["nodeId"] | 0u;
-                const char* name = doc["name"] | "";
-                double latD = doc["lat"] | 0.0;
-                double lonD = doc["lon"] | 0.0;
-                // Enforce access control denylist for bridged adverts
-                if (config.access.denyEnabled && nodeId != 0) {
-                    for (uint8_t i = 0; i < config.access.denyCount && i < (sizeof(config.access.denylist)/sizeof(config.access.denylist[0])); ++i) {
-                        if (config.access.denylist[i] == nodeId) {
-                            return; // blocked node, do not bridge over RF
-                        }
-                    }
+            });
+            routeScoped("commands/bridge-limits", ROUTE_CMD_BRIDGE_LIMITS, [this](const TopicMatch&, uint8_t* payload, size_t length) {
+                // { "ratePerMin": N, "burst": M } - runtime only, save from the menu to persist
+                StaticJsonDocument<128> doc;
+                if (deserializeJson(doc, payload, length) != DeserializationError::Ok) return;
+                setBridgeLimits(doc["ratePerMin"] | config().mqtt.bridgeRatePerMin,
+                                doc["burst"] | config().mqtt.bridgeBurst);
+                LOG_INFO("Bridge limits set via MQTT: %u/min, burst %u",
+                         (unsigned)config().mqtt.bridgeRatePerMin, (unsigned)config().mqtt.bridgeBurst);
+            });
+            routeScoped("commands/interest", ROUTE_CMD_INTEREST, [this](const TopicMatch&, uint8_t* payload, size_t length) {
+                // { "regions": "NSW,VIC", "topics": "raw,adverts" } - runtime only
+                StaticJsonDocument<256> doc;
+                if (deserializeJson(doc, payload, length) != DeserializationError::Ok) return;
+                const char* regions = doc["regions"] | (const char*)config().mqtt.interestRegions;
+                const char* topics = doc["topics"] | "";
+                setInterest(regions, parseInterestTopics(topics));
+            });
+            routeScoped("commands/config", ROUTE_CMD_CONFIG, [this](const TopicMatch&, uint8_t* payload, size_t length) {
+                handleConfigCommand(payload, length);
+            });
+        }
+        if (config().mqtt.bridgeAll) {
+            bool ok = true;
+            forEachBridgeFilter(appliedRegions, appliedTopics, [&](const char* filter, uint8_t topicClass) {
+                switch (topicClass) {
+                    case 0:
+                        ok &= router.add(filter, ROUTE_BRIDGE_RAW, [this](const TopicMatch&, uint8_t* payload, size_t length) {
+                            handleBridgedRaw(payload, length);
+                        });
+                        break;
+                    case 1:
+                        ok &= router.add(filter, ROUTE_BRIDGE_MESSAGES, [this](const TopicMatch&, uint8_t* payload, size_t length) {
+                            handleBridgedMessage(payload, length);
+                        });
+                        break;
+                    case 5:
+                        ok &= router.add(filter, ROUTE_BRIDGE_ADVERTS, [this](const TopicMatch&, uint8_t* payload, size_t length) {
+                            handleBridgedAdvert(payload, length);
+                        });
+                        break;
+                    default:
+                        // Peer gateway telemetry is observed (counted) but never rebroadcast over RF
+                        ok &= router.add(filter, ROUTE_PEER_TELEMETRY, nullptr);
+                        break;
                 }
-                // Compose ADVERT line as used on RF
-                char advertLine[160];
-                snprintf(advertLine, sizeof(advertLine), "ADVERT %08X %s %.6f %.6f",
-                         nodeId, name, latD, lonD);
-                messageCallback((const uint8_t*)advertLine, strlen(advertLine));
+            });
+            if (!ok) LOG_WARN("⚠ Topic route table full, some bridge filters are not routed");
+            if (config().mqtt.bridgeElection) {
+                char pattern[128];
+                snprintf(pattern, sizeof(pattern), "%s/bridge/rank", config().mqtt.topicPrefix);
+                router.add(pattern, ROUTE_ELECTION_RANK, [this](const TopicMatch& m, uint8_t* payload, size_t length) {
+                    handleElection(m.tag, payload, length);
+                });
+                snprintf(pattern, sizeof(pattern), "%s/bridge/claim", config().mqtt.topicPrefix);
+                router.add(pattern, ROUTE_ELECTION_CLAIM, [this](const TopicMatch& m, uint8_t* payload, size_t length) {
+                    handleElection(m.tag, payload, length);
+                });
             }
         }
     }
 
-    void setupSystemTimeIfNeeded() {
-#ifdef ESP32
-        struct tm timeinfo = {};
-        if (getLocalTime(&timeinfo)) {
+    // {prefix}/{suffix}, plus one and two child levels when no region narrows the prefix
+    void routeScoped(const char* suffix, uint8_t tag, TopicHandler handler) {
+        char pattern[128];
+        snprintf(pattern, sizeof(pattern), "%s/%s", config().mqtt.topicPrefix, suffix);
+        bool ok = router.add(pattern, tag, handler);
+        if (config().mqtt.region[0] == '\0') {
+            snprintf(pattern, sizeof(pattern), "%s/+/%s", config().mqtt.topicPrefix, suffix);
+            ok &= router.add(pattern, tag, handler);
+            snprintf(pattern, sizeof(pattern), "%s/+/+/%s", config().mqtt.topicPrefix, suffix);
+            ok &= router.add(pattern, tag, handler);
+        }
+        if (!ok) {
+            LOG_WARN("⚠ Topic route table full, not routing: %s", suffix);
+        }
+    }
+
+    void handleMQTTMessage(char* topic, byte* payload, unsigned int length) {
+        LOG_DEBUG("MQTT message received: %s", topic);
+        router.dispatch(topic, payload, length);
+    }
+
+    void handleBridgedRaw(uint8_t* payload, size_t length) {
+        // Expect JSON with { data: hex, gateway?: string }
+        BridgeFields f;
+        BridgeFrame* frame = admitBridged(payload, length, f);
+        if (!frame) return;
+        int n = bridgeHexDecode(f[BF_DATA], frame->data, sizeof(frame->data));
+        if (n <= 0) {
+            bridgeMalformed++;
+            bridgeQueue.abort(frame);
             return;
         }
-        Serial.println(F("Setting time via NTP for TLS..."));
-        long gmtOffset = (long)config.clock.timezoneMinutes * 60;
-        const char* ntp = (config.clock.ntpServer[0] != '\0') ? config.clock.ntpServer : "pool.ntp.org";
-        configTime(gmtOffset, 0, ntp);
-        const unsigned long start = millis();
-        while (!getLocalTime(&timeinfo) && millis() - start < 10000UL) {
-            delay(200);
-            Serial.print('.');
-        }
-        if (getLocalTime(&timeinfo)) {
-            Serial.println(F("\n✓ Time set"));
-        } else {
-            Serial.println(F("\n⚠ Failed to set time, TLS may fail"));
+        frame->length = (uint16_t)n;
+        commitBridged(frame);
+    }
+
+    void handleBridgedMessage(uint8_t* payload, size_t length) {
+        // Expect JSON with { message: string, gateway?: string }
+        BridgeFields f;
+        BridgeFrame* frame = admitBridged(payload, length, f);
+        if (!frame) return;
+        int n = bridgeUnescape(f[BF_MESSAGE], (char*)frame->data, sizeof(frame->data));
+        if (n <= 0) {
+            if (n < 0) bridgeMalformed++;
+            bridgeQueue.abort(frame);
+            return;
         }
-#endif
+        frame->length = (uint16_t)n;
+        commitBridged(frame);
+    }
+
+    void handleBridgedAdvert(uint8_t* payload, size_t length) {
+        // Expect JSON with { nodeId, name, lat, lon, gateway? }
+        BridgeFields f;
+        BridgeFrame* frame = admitBridged(payload, length, f);
+        if (!frame) return;
+        uint32_t nodeId = 0;
+        bridgeParseU32(f[BF_NODE_ID], nodeId);
+        // Enforce access control denylist for bridged adverts
+        if (config().access.denyEnabled && nodeId != 0) {
+            for (uint8_t i = 0; i < config().access.denyCount && i < (sizeof(config().access.denylist)/sizeof(config().access.denylist[0])); ++i) {
+                if (config().access.denylist[i] == nodeId) {
+                    bridgeQueue.abort(frame);
+                    return; // blocked node, do not bridge over RF
+                }
+            }
+        }
+        char name[64];
+        int nameLen = f.has(BF_NAME) ? bridgeUnescape(f[BF_NAME], name, sizeof(name) - 1) : 0;
+        name[nameLen > 0 ? nameLen : 0] = '\0';
+        double latD = 0.0;
+        double lonD = 0.0;
+        bridgeParseDouble(f[BF_LAT], latD);
+        bridgeParseDouble(f[BF_LON], lonD);
+        // Compose ADVERT line as used on RF
+        int n = snprintf((char*)frame->data, sizeof(frame->data), "ADVERT %08X %s %.6f %.6f",
+                         nodeId, name, latD, lonD);
+        if (n <= 0) {
+            bridgeQueue.abort(frame);
+            return;
+        }
+        frame->length = (uint16_t)(n < (int)sizeof(frame->data) ? n : (int)sizeof(frame->data) - 1);
+        commitBridged(frame);
     }
 };
 
@@ -0,0 +1,51 @@
+#ifndef MQTT_SESSION_STATE_H
+#define MQTT_SESSION_STATE_H
+
+// Session state of the async MQTT transport, written from two tasks: the main loop asks for
+// a connect or a disconnect, the network task moves the handshake along. The network task
+// only advances with a compare-and-swap from the step it expects, so a disconnect requested
+// while a TCP/TLS connect or the CONNACK wait is in progress is never overwritten; the task
+// finds it on its next pass and closes the session. Plain C++ (std::atomic only), tested by
+// test/test_mqtt_session_state.cpp.
+
+#include <stdint.h>
+#include <atomic>
+
+enum MqttSessionStep : uint8_t {
+    MQTT_SESSION_IDLE,
+    MQTT_SESSION_REQ_CONNECT,       // loop: connect() queued, the task has not started yet
+    MQTT_SESSION_CONNECTING,        // task: TCP/TLS connect running
+    MQTT_SESSION_WAIT_CONNACK,      // task: CONNECT sent
+    MQTT_SESSION_CONNECTED,
+    MQTT_SESSION_REQ_DISCONNECT     // loop: disconnect() queued, the task closes the socket
+};
+
+class MqttSessionState {
+public:
+    MqttSessionState() : step(MQTT_SESSION_IDLE) {}
+
+    uint8_t load() const { return step.load(); }
+
+    // Main loop: start a session from idle
+    bool requestConnect() { return advance(MQTT_SESSION_IDLE, MQTT_SESSION_REQ_CONNECT); }
+
+    // Main loop: close whatever is open or opening; false when already idle
+    bool requestDisconnect() {
+        uint8_t s = step.load();
+        while (s != MQTT_SESSION_IDLE) {
+            if (step.compare_exchange_weak(s, MQTT_SESSION_REQ_DISCONNECT)) return true;
+        }
+        return false;
+    }
+
+    // Network task: from -> to, unless the loop changed the step in the meantime
+    bool advance(uint8_t from, uint8_t to) { return step.compare_exchange_strong(from, to); }
+
+    // Network task: the socket is closed
+    void closed() { step.store(MQTT_SESSION_IDLE); }
+
+private:
+    std::atomic<uint8_t> step;
+};
+
+#endif // MQTT_SESSION_STATE_H
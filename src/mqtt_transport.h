@@ -0,0 +1,200 @@
+#ifndef MQTT_TRANSPORT_H
+#define MQTT_TRANSPORT_H
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include "mqtt_codec.h"
+
+typedef std::function<void(char* topic, uint8_t* payload, unsigned int length)> MQTTInboundCallback;
+
+enum MQTTConnectResult : uint8_t {
+    MQTT_CONNECT_OK,       // session established
+    MQTT_CONNECT_PENDING,  // attempt running in the background; poll connected()
+    MQTT_CONNECT_FAILED
+};
+
+// Transport abstraction behind MQTTHandler. Implementations own the socket and the
+// protocol state; the handler only builds topics/payloads and decides what to send.
+class MQTTTransport {
+public:
+    virtual ~MQTTTransport() {}
+
+    virtual const char* name() const = 0;
+    virtual void setClient(Client& client) = 0;
+    virtual void setServer(const char* host, uint16_t port) = 0;
+    virtual void setServer(IPAddress ip, uint16_t port) = 0;
+    virtual void setCallback(MQTTInboundCallback cb) = 0;
+
+    virtual MQTTConnectResult connect(const MqttConnectOptions& options) = 0;
+    virtual bool connecting() { return false; }
+    virtual bool connected() = 0;
+    virtual void disconnect() = 0;
+    // No session and no attempt or teardown in progress, so the network client under the
+    // transport may be reconfigured. Synchronous transports are idle whenever disconnected.
+    virtual bool idle() { return !connected(); }
+
+    // Returns false when the message could not be accepted (offline or backpressure).
+    // expirySec is an MQTT 5 message expiry; 3.1.1 transports ignore it.
+    virtual bool publish(const char* topic, const uint8_t* payload, size_t length, bool retain, uint8_t qos,
+                         uint32_t expirySec = 0) = 0;
+    // noLocal (MQTT 5) stops the broker echoing our own publishes back on this subscription
+    virtual bool subscribe(const char* topic, uint8_t qos, bool noLocal = false) = 0;
+    virtual bool unsubscribe(const char* topic) = 0;
+
+    // Several filters at once; options are QoS | MQTT_SUB_* flags per filter. Transports
+    // that can put them in a single SUBSCRIBE/UNSUBSCRIBE packet override these.
+    virtual bool subscribeMany(const char* const* topics, const uint8_t* options, size_t count) {
+        bool ok = true;
+        for (size_t i = 0; i < count; ++i) {
+            ok &= subscribe(topics[i], options[i] & 0x03, (options[i] & MQTT_SUB_NO_LOCAL) != 0);
+        }
+        return ok;
+    }
+
+    virtual bool unsubscribeMany(const char* const* topics, size_t count) {
+        bool ok = true;
+        for (size_t i = 0; i < count; ++i) ok &= unsubscribe(topics[i]);
+        return ok;
+    }
+
+    // Largest encoded packet the transport accepts in one publish()
+    virtual size_t maxPacketSize() = 0;
+
+    // SUBSCRIBE packets still waiting for their SUBACK; transports that do not track
+    // acknowledgements report 0 once the packets are written
+    virtual uint32_t pendingSubscribes() const { return 0; }
+
+    // Whether the broker resumed a stored session at the last CONNACK (subscriptions and
+    // queued messages survived); transports that cannot tell report false
+    virtual bool sessionPresent() const { return false; }
+
+    // Protocol level of the current (or last) session
+    virtual uint8_t protocolVersion() const { return MQTT_PROTOCOL_V311; }
+
+    // Service the connection and dispatch inbound messages on the caller's thread
+    virtual void loop() = 0;
+    virtual int state() = 0;
+};
+
+// Collects topic filters and sends them as few SUBSCRIBE/UNSUBSCRIBE packets as the
+// transport allows; flush() sends whatever is left
+#define MQTT_FILTER_BATCH 8
+#define MQTT_FILTER_BATCH_BYTES 900   // stays inside the async transport's 1 KB control packet
+
+class MQTTFilterBatch {
+public:
+    MQTTFilterBatch(MQTTTransport* t, bool unsubscribing)
+        : transport(t), unsub(unsubscribing), count(0), bytes(0), sent(0), packets(0), ok(true) {}
+
+    void add(const char* filter, uint8_t options) {
+        size_t n = strlen(filter);
+        if (n >= sizeof(topics[0])) {
+            ok = false;
+            return;
+        }
+        if (count == MQTT_FILTER_BATCH || bytes + n + 3 > MQTT_FILTER_BATCH_BYTES) flush();
+        memcpy(topics[count], filter, n + 1);
+        ptrs[count] = topics[count];
+        opts[count] = options;
+        count++;
+        bytes += n + 3;
+    }
+
+    void flush() {
+        if (count == 0) return;
+        ok &= unsub ? transport->unsubscribeMany(ptrs, count) : transport->subscribeMany(ptrs, opts, count);
+        sent += count;
+        packets++;
+        count = 0;
+        bytes = 0;
+    }
+
+    size_t filtersSent() const { return sent; }
+    size_t packetsSent() const { return packets; }
+    bool succeeded() const { return ok; }
+
+private:
+    MQTTTransport* transport;
+    bool unsub;
+    char topics[MQTT_FILTER_BATCH][112];
+    const char* ptrs[MQTT_FILTER_BATCH];
+    uint8_t opts[MQTT_FILTER_BATCH];
+    size_t count;
+    size_t bytes;
+    size_t sent;
+    size_t packets;
+    bool ok;
+};
+
+// Blocking fallback built on PubSubClient (MQTT 3.1.1, QoS 0 publish only)
+class PubSubTransport : public MQTTTransport {
+public:
+    PubSubTransport(Client& client) : mqttClient(client) { host[0] = '\0'; }
+
+    const char* name() const override { return "pubsubclient"; }
+
+    void setClient(Client& client) override { mqttClient.setClient(client); }
+    // PubSubClient keeps the pointer, so the name is copied; the caller's string may be a
+    // configuration snapshot that is reclaimed after the next settings change
+    void setServer(const char* h, uint16_t port) override {
+        strncpy(host, h ? h : "", sizeof(host) - 1);
+        host[sizeof(host) - 1] = '\0';
+        mqttClient.setServer(host, port);
+    }
+    void setServer(IPAddress ip, uint16_t port) override { mqttClient.setServer(ip, port); }
+
+    void setCallback(MQTTInboundCallback cb) override {
+        mqttClient.setCallback([cb](char* topic, byte* payload, unsigned int length) {
+            if (cb) cb(topic, payload, length);
+        });
+    }
+
+    void configure(uint16_t bufferSize, uint16_t keepAliveSec, uint16_t socketTimeoutSec) {
+        mqttClient.setBufferSize(bufferSize);
+        mqttClient.setKeepAlive(keepAliveSec);
+        mqttClient.setSocketTimeout(socketTimeoutSec);
+    }
+
+    MQTTConnectResult connect(const MqttConnectOptions& o) override {
+        bool hasUser = o.username && o.username[0] != '\0';
+        bool ok = mqttClient.connect(
+            o.clientId,
+            hasUser ? o.username : nullptr,
+            hasUser ? o.password : nullptr,
+            o.willTopic,
+            o.willQos,
+            o.willRetain,
+            o.willPayload,
+            o.cleanSession
+        );
+        return ok ? MQTT_CONNECT_OK : MQTT_CONNECT_FAILED;
+    }
+
+    bool connected() override { return mqttClient.connected(); }
+    void disconnect() override { mqttClient.disconnect(); }
+
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retain, uint8_t qos,
+                 uint32_t expirySec = 0) override {
+        (void)qos;
+        (void)expirySec;
+        return mqttClient.publish(topic, payload, length, retain);
+    }
+
+    bool subscribe(const char* topic, uint8_t qos, bool noLocal = false) override {
+        (void)noLocal;
+        return mqttClient.subscribe(topic, qos);
+    }
+
+    bool unsubscribe(const char* topic) override { return mqttClient.unsubscribe(topic); }
+
+    void loop() override { mqttClient.loop(); }
+    int state() override { return mqttClient.state(); }
+    // PubSubClient keeps room for the longest fixed header in its buffer
+    size_t maxPacketSize() override { return mqttClient.getBufferSize() - MQTT_MAX_HEADER_SIZE; }
+
+private:
+    PubSubClient mqttClient;
+    char host[128];
+};
+
+#endif // MQTT_TRANSPORT_H
@@ -0,0 +1,386 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <Arduino.h>
+#include <time.h>
+#ifdef ESP32
+#include <LittleFS.h>
+#endif
+
+// RAM tier: fixed slots sized for a full 255-byte frame as hex inside the raw JSON envelope
+#define OUTBOUND_RAM_SLOTS 12
+#define OUTBOUND_MAX_TOPIC 96
+#define OUTBOUND_MAX_PAYLOAD 704
+
+// Spill tier: append-only segment files on LittleFS, oldest segment dropped when full
+#define OUTBOUND_SPILL_DIR "/obq"
+#define OUTBOUND_SEGMENT_BYTES 16384
+#define OUTBOUND_MAX_SEGMENTS 8
+
+// Replay pacing once the broker is reachable again
+#define OUTBOUND_REPLAY_PER_SEC 5
+
+struct OutboundMessage {
+    uint32_t capturedMs;     // millis() when the frame was heard
+    uint32_t capturedEpoch;  // wall clock seconds, 0 when time was not set
+    uint16_t payloadLen;
+    bool retain;
+    char topic[OUTBOUND_MAX_TOPIC];
+    char payload[OUTBOUND_MAX_PAYLOAD];
+};
+
+struct OutboundQueueStats {
+    uint32_t depth;          // messages waiting (RAM + spill)
+    uint32_t ramDepth;
+    uint32_t spillDepth;
+    uint32_t spillBytes;     // bytes currently held in spill segments
+    uint32_t enqueued;
+    uint32_t replayed;
+    uint32_t dropped;
+    float replayRate;        // messages per second over the last second
+};
+
+// Callback used to hand a replayed message to the transport; return false to stop replay
+typedef std::function<bool(const char* topic, const char* payload, size_t length, bool retain)> OutboundPublishFn;
+
+// Bounded store-and-forward queue for publishes made while the broker is unreachable.
+// Order is preserved: once anything has spilled, new messages also go to the spill log
+// until it drains, and the RAM tier is refilled from the oldest spilled record.
+class OutboundQueue {
+public:
+    OutboundQueue()
+        : ramHead(0), ramCount(0), spillReady(false), spillHeadSeq(0), spillHeadOffset(0),
+          spillTailSeq(0), spillTailBytes(0), spillCount(0), spillBytes(0),
+          enqueuedTotal(0), replayedTotal(0), droppedTotal(0),
+          replayTokens(OUTBOUND_REPLAY_PER_SEC), lastTokenRefill(0),
+          rateWindowStart(0), rateWindowCount(0), replayRate(0.0f) {}
+
+    // Mount LittleFS and clear spill segments left from a previous boot (their millis() are meaningless now)
+    void begin() {
+#ifdef ESP32
+        // Mount and clear once per boot: a temporary handler (menu quick test) must not wipe the live log
+        static int8_t mountState = -1;
+        if (mountState >= 0) {
+            spillReady = mountState == 1;
+            return;
+        }
+        mountState = 0;
+        if (!LittleFS.begin(true)) {
+            Serial.println(F("⚠ LittleFS unavailable, outbound queue is RAM-only"));
+            return;
+        }
+        if (!LittleFS.exists(OUTBOUND_SPILL_DIR)) {
+            LittleFS.mkdir(OUTBOUND_SPILL_DIR);
+        }
+        File dir = LittleFS.open(OUTBOUND_SPILL_DIR);
+        if (dir && dir.isDirectory()) {
+            File f = dir.openNextFile();
+            while (f) {
+                char path[48];
+                snprintf(path, sizeof(path), "%s/%s", OUTBOUND_SPILL_DIR, baseName(f.name()));
+                f.close();
+                LittleFS.remove(path);
+                f = dir.openNextFile();
+            }
+        }
+        mountState = 1;
+        spillReady = true;
+#endif
+    }
+
+    bool isEmpty() const { return ramCount == 0 && spillCount == 0; }
+
+    // Queue a publish; returns false if it had to be dropped
+    bool enqueue(const char* topic, const char* payload, size_t length, bool retain) {
+        if (!topic || !payload) return false;
+        if (strlen(topic) >= OUTBOUND_MAX_TOPIC || length >= OUTBOUND_MAX_PAYLOAD) {
+            droppedTotal++;
+            return false;
+        }
+        OutboundMessage* slot = nullptr;
+        OutboundMessage spillMsg;
+        // Keep FIFO order: RAM only accepts new messages while nothing is waiting on flash
+        if (spillCount == 0 && ramCount < OUTBOUND_RAM_SLOTS) {
+            slot = &ram[(ramHead + ramCount) % OUTBOUND_RAM_SLOTS];
+        } else {
+            slot = &spillMsg;
+        }
+        slot->capturedMs = millis();
+        time_t nowEpoch = time(nullptr);
+        slot->capturedEpoch = (nowEpoch > 1600000000) ? (uint32_t)nowEpoch : 0;
+        slot->retain = retain;
+        slot->payloadLen = (uint16_t)length;
+        strncpy(slot->topic, topic, sizeof(slot->topic) - 1);
+        slot->topic[sizeof(slot->topic) - 1] = '\0';
+        memcpy(slot->payload, payload, length);
+        slot->payload[length] = '\0';
+
+        if (slot != &spillMsg) {
+            ramCount++;
+        } else if (!spillAppend(spillMsg)) {
+            droppedTotal++;
+            return false;
+        }
+        enqueuedTotal++;
+        return true;
+    }
+
+    // Replay queued messages in order, paced by a token bucket. Call only while connected.
+    void replay(const OutboundPublishFn& publish) {
+        unsigned long now = millis();
+        refillTokens(now);
+        while (replayTokens > 0 && !isEmpty()) {
+            if (ramCount == 0) {
+                refillFromSpill();
+                if (ramCount == 0) break;
+            }
+            OutboundMessage& msg = ram[ramHead];
+            if (!publishReplayed(msg, now, publish)) {
+                break; // transport refused; keep the message for the next attempt
+            }
+            ramHead = (ramHead + 1) % OUTBOUND_RAM_SLOTS;
+            ramCount--;
+            replayTokens--;
+            replayedTotal++;
+            rateWindowCount++;
+        }
+        if (ramCount < OUTBOUND_RAM_SLOTS && spillCount > 0) {
+            refillFromSpill();
+        }
+    }
+
+    OutboundQueueStats getStats() {
+        updateRate(millis());
+        OutboundQueueStats s;
+        s.ramDepth = ramCount;
+        s.spillDepth = spillCount;
+        s.depth = ramCount + spillCount;
+        s.spillBytes = spillBytes;
+        s.enqueued = enqueuedTotal;
+        s.replayed = replayedTotal;
+        s.dropped = droppedTotal;
+        s.replayRate = replayRate;
+        return s;
+    }
+
+private:
+    OutboundMessage ram[OUTBOUND_RAM_SLOTS];
+    size_t ramHead;
+    size_t ramCount;
+
+    // Spill log: records are [u16 topicLen][u16 payloadLen][u32 capturedMs][u32 epoch][u8 retain][topic][payload]
+    bool spillReady;
+    uint32_t spillHeadSeq;     // segment currently being read
+    uint32_t spillHeadOffset;  // read offset inside the head segment
+    uint32_t spillTailSeq;     // segment currently being appended
+    uint32_t spillTailBytes;
+    uint32_t spillCount;
+    uint32_t spillBytes;
+
+    uint32_t enqueuedTotal;
+    uint32_t replayedTotal;
+    uint32_t droppedTotal;
+
+    uint32_t replayTokens;
+    unsigned long lastTokenRefill;
+    unsigned long rateWindowStart;
+    uint32_t rateWindowCount;
+    float replayRate;
+
+    static const size_t SPILL_HEADER_BYTES = 13;
+
+    static const char* baseName(const char* name) {
+        const char* slash = strrchr(name, '/');
+        return slash ? slash + 1 : name;
+    }
+
+    static void segmentPath(uint32_t seq, char* out, size_t outSize) {
+        snprintf(out, outSize, "%s/%08lu.seg", OUTBOUND_SPILL_DIR, (unsigned long)seq);
+    }
+
+    void refillTokens(unsigned long now) {
+        unsigned long elapsed = now - lastTokenRefill;
+        if (elapsed >= 1000UL / OUTBOUND_REPLAY_PER_SEC) {
+            uint32_t add = (uint32_t)(elapsed * OUTBOUND_REPLAY_PER_SEC / 1000UL);
+            replayTokens = min<uint32_t>(OUTBOUND_REPLAY_PER_SEC, replayTokens + add);
+            lastTokenRefill = now;
+        }
+        updateRate(now);
+    }
+
+    void updateRate(unsigned long now) {
+        unsigned long elapsed = now - rateWindowStart;
+        if (elapsed >= 1000UL) {
+            replayRate = (float)rateWindowCount * 1000.0f / (float)elapsed;
+            rateWindowCount = 0;
+            rateWindowStart = now;
+        }
+    }
+
+    // Re-emit the stored JSON with replay markers spliced in after the opening brace
+    bool publishReplayed(const OutboundMessage& msg, unsigned long now, const OutboundPublishFn& publish) {
+        if (msg.payloadLen < 2 || msg.payload[0] != '{') {
+            return publish(msg.topic, msg.payload, msg.payloadLen, msg.retain);
+        }
+        char marked[OUTBOUND_MAX_PAYLOAD + 96];
+        int n;
+        if (msg.capturedEpoch != 0) {
+            n = snprintf(marked, sizeof(marked), "{\"replayed\":true,\"capturedAgeMs\":%lu,\"capturedAt\":%lu%s",
+                         (unsigned long)(now - msg.capturedMs), (unsigned long)msg.capturedEpoch,
+                         msg.payload[1] == '}' ? "" : ",");
+        } else {
+            n = snprintf(marked, sizeof(marked), "{\"replayed\":true,\"capturedAgeMs\":%lu%s",
+                         (unsigned long)(now - msg.capturedMs), msg.payload[1] == '}' ? "" : ",");
+        }
+        if (n <= 0 || (size_t)n + msg.payloadLen > sizeof(marked)) {
+            return publish(msg.topic, msg.payload, msg.payloadLen, msg.retain);
+        }
+        memcpy(marked + n, msg.payload + 1, msg.payloadLen - 1);
+        size_t total = (size_t)n + msg.payloadLen - 1;
+        marked[total] = '\0';
+        return publish(msg.topic, marked, total, msg.retain);
+    }
+
+    bool spillAppend(const OutboundMessage& msg) {
+#ifdef ESP32
+        if (!spillReady) return false;
+        uint16_t topicLen = (uint16_t)strlen(msg.topic);
+        uint32_t recordBytes = SPILL_HEADER_BYTES + topicLen + msg.payloadLen;
+        if (spillCount == 0) {
+            // Fresh log: restart numbering so segment names stay short-lived
+            spillHeadSeq = spillTailSeq = 0;
+            spillHeadOffset = 0;
+            spillTailBytes = 0;
+            char stale[48];
+            segmentPath(0, stale, sizeof(stale));
+            LittleFS.remove(stale);
+        } else if (spillTailBytes + recordBytes > OUTBOUND_SEGMENT_BYTES) {
+            spillTailSeq++;
+            spillTailBytes = 0;
+        }
+        // Bounded: discard the oldest segment rather than grow without limit
+        while (spillTailSeq - spillHeadSeq >= OUTBOUND_MAX_SEGMENTS) {
+            dropHeadSegment();
+        }
+        char path[48];
+        segmentPath(spillTailSeq, path, sizeof(path));
+        File f = LittleFS.open(path, FILE_APPEND, true);
+        if (!f) return false;
+        uint8_t hdr[SPILL_HEADER_BYTES];
+        hdr[0] = (uint8_t)(topicLen & 0xFF);
+        hdr[1] = (uint8_t)(topicLen >> 8);
+        hdr[2] = (uint8_t)(msg.payloadLen & 0xFF);
+        hdr[3] = (uint8_t)(msg.payloadLen >> 8);
+        memcpy(&hdr[4], &msg.capturedMs, 4);
+        memcpy(&hdr[8], &msg.capturedEpoch, 4);
+        hdr[12] = msg.retain ? 1 : 0;
+        bool ok = f.write(hdr, sizeof(hdr)) == sizeof(hdr)
+               && f.write((const uint8_t*)msg.topic, topicLen) == topicLen
+               && f.write((const uint8_t*)msg.payload, msg.payloadLen) == msg.payloadLen;
+        f.close();
+        if (!ok) return false;
+        spillTailBytes += recordBytes;
+        spillBytes += recordBytes;
+        spillCount++;
+        return true;
+#else
+        (void)msg;
+        return false;
+#endif
+    }
+
+    // Move the oldest spilled records into free RAM slots
+    void refillFromSpill() {
+#ifdef ESP32
+        while (spillCount > 0 && ramCount < OUTBOUND_RAM_SLOTS) {
+            char path[48];
+            segmentPath(spillHeadSeq, path, sizeof(path));
+            File f = LittleFS.open(path, FILE_READ);
+            if (!f || spillHeadOffset >= f.size()) {
+                if (f) f.close();
+                if (spillHeadSeq == spillTailSeq) {
+                    // Accounting drifted from the files; reset rather than spin
+                    spillCount = 0;
+                    spillBytes = 0;
+                    return;
+                }
+                LittleFS.remove(path);
+                spillHeadSeq++;
+                spillHeadOffset = 0;
+                continue;
+            }
+            f.seek(spillHeadOffset);
+            while (spillCount > 0 && ramCount < OUTBOUND_RAM_SLOTS && f.available()) {
+                uint8_t hdr[SPILL_HEADER_BYTES];
+                if (f.read(hdr, sizeof(hdr)) != sizeof(hdr)) break;
+                uint16_t topicLen = (uint16_t)(hdr[0] | (hdr[1] << 8));
+                uint16_t payloadLen = (uint16_t)(hdr[2] | (hdr[3] << 8));
+                uint32_t recordBytes = SPILL_HEADER_BYTES + topicLen + payloadLen;
+                OutboundMessage& slot = ram[(ramHead + ramCount) % OUTBOUND_RAM_SLOTS];
+                bool valid = topicLen < sizeof(slot.topic) && payloadLen < sizeof(slot.payload);
+                if (valid) {
+                    memcpy(&slot.capturedMs, &hdr[4], 4);
+                    memcpy(&slot.capturedEpoch, &hdr[8], 4);
+                    slot.retain = hdr[12] != 0;
+                    slot.payloadLen = payloadLen;
+                    valid = f.read((uint8_t*)slot.topic, topicLen) == topicLen
+                         && f.read((uint8_t*)slot.payload, payloadLen) == payloadLen;
+                    slot.topic[topicLen] = '\0';
+                    slot.payload[payloadLen] = '\0';
+                }
+                if (!valid) {
+                    // Corrupt record: abandon the rest of this segment
+                    spillHeadOffset = f.size();
+                    break;
+                }
+                spillHeadOffset += recordBytes;
+                spillBytes = (spillBytes > recordBytes) ? spillBytes - recordBytes : 0;
+                spillCount--;
+                ramCount++;
+            }
+            bool segmentDone = spillHeadOffset >= f.size();
+            f.close();
+            if (segmentDone && spillHeadSeq != spillTailSeq) {
+                LittleFS.remove(path);
+                spillHeadSeq++;
+                spillHeadOffset = 0;
+            } else if (segmentDone && spillCount == 0) {
+                LittleFS.remove(path);
+                spillHeadOffset = 0;
+                spillTailBytes = 0;
+            }
+            if (!segmentDone) break;
+        }
+#endif
+    }
+
+    void dropHeadSegment() {
+#ifdef ESP32
+        char path[48];
+        segmentPath(spillHeadSeq, path, sizeof(path));
+        File f = LittleFS.open(path, FILE_READ);
+        uint32_t dropped = 0;
+        uint32_t droppedBytes = 0;
+        if (f) {
+            f.seek(spillHeadOffset);
+            uint8_t hdr[SPILL_HEADER_BYTES];
+            while (f.read(hdr, sizeof(hdr)) == sizeof(hdr)) {
+                uint16_t topicLen = (uint16_t)(hdr[0] | (hdr[1] << 8));
+                uint16_t payloadLen = (uint16_t)(hdr[2] | (hdr[3] << 8));
+                if (!f.seek(f.position() + topicLen + payloadLen)) break;
+                dropped++;
+                droppedBytes += SPILL_HEADER_BYTES + topicLen + payloadLen;
+            }
+            f.close();
+        }
+        LittleFS.remove(path);
+        spillCount = (spillCount > dropped) ? spillCount - dropped : 0;
+        spillBytes = (spillBytes > droppedBytes) ? spillBytes - droppedBytes : 0;
+        droppedTotal += dropped;
+        spillHeadSeq++;
+        spillHeadOffset = 0;
+#endif
+    }
+};
+
+#endif // OUTBOUND_QUEUE_H
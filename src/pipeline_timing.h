@@ -0,0 +1,178 @@
+#ifndef PIPELINE_TIMING_H
+#define PIPELINE_TIMING_H
+
+// Where the time goes between the radio interrupt and the end of a frame's handling. Each
+// received frame is stamped at the ISR, after readData, after decoding, once MQTT has taken
+// it, and around the repeat transmission; the gap between consecutive stamps feeds one
+// histogram per stage, and the ISR-to-done total feeds another.
+//
+// Histograms use fixed log-scale buckets in the style of HdrHistogram: values below 16 us
+// are exact, above that every power of two is split into 8 sub-buckets, so a reported
+// percentile is at most 12.5% above the true value, up to 2^24 us (16.7 s); an overflow
+// bucket of its own catches everything longer. Recording is a couple of shifts and an
+// increment; no allocation, no sorting. test/test_pipeline_timing.cpp holds the buckets to
+// that bound.
+
+#include <stdint.h>
+#include <string.h>
+#include "latency_probe.h"
+
+#define HISTOGRAM_LINEAR 16                 // values below this get a bucket each
+#define HISTOGRAM_SUB_BITS 3                // 8 sub-buckets per power of two
+#define HISTOGRAM_MAX_BITS 24               // values from 2^24 us go to the overflow bucket
+#define HISTOGRAM_OVERFLOW (HISTOGRAM_LINEAR + (HISTOGRAM_MAX_BITS - 4) * (1 << HISTOGRAM_SUB_BITS))
+#define HISTOGRAM_BUCKETS (HISTOGRAM_OVERFLOW + 1)
+#define HISTOGRAM_DECAY_COUNT 65536UL       // halve all buckets once this many samples are held
+
+class LatencyHistogram {
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset() {
+        memset(buckets, 0, sizeof(buckets));
+        count = 0;
+        sum = 0;
+        maxValue = 0;
+    }
+
+    void add(uint32_t us) {
+        buckets[bucketOf(us)]++;
+        sum += us;
+        if (us > maxValue) maxValue = us;
+        if (++count >= HISTOGRAM_DECAY_COUNT) decay();
+    }
+
+    uint32_t samples() const { return count; }
+    uint32_t mean() const { return count ? (uint32_t)(sum / count) : 0; }
+
+    // Percentiles report the upper bound of the bucket holding the rank (never above the
+    // largest value seen); samples is the number of values currently held
+    LatencyPercentiles percentiles() const {
+        LatencyPercentiles p;
+        memset(&p, 0, sizeof(p));
+        if (count == 0) return p;
+        p.samples = count;
+        p.p50 = valueAt(rank(50));
+        p.p90 = valueAt(rank(90));
+        p.p99 = valueAt(rank(99));
+        p.max = maxValue;
+        return p;
+    }
+
+    static size_t bucketOf(uint32_t v) {
+        if (v < HISTOGRAM_LINEAR) return v;
+        if (v >= (1UL << HISTOGRAM_MAX_BITS)) return HISTOGRAM_OVERFLOW;
+        uint8_t e = 31 - __builtin_clz(v);
+        size_t sub = (v >> (e - HISTOGRAM_SUB_BITS)) & ((1 << HISTOGRAM_SUB_BITS) - 1);
+        return HISTOGRAM_LINEAR + (size_t)(e - 4) * (1 << HISTOGRAM_SUB_BITS) + sub;
+    }
+
+    // Largest value that lands in the bucket
+    static uint32_t bucketTop(size_t b) {
+        if (b < HISTOGRAM_LINEAR) return (uint32_t)b;
+        if (b >= HISTOGRAM_OVERFLOW) return UINT32_MAX;
+        size_t i = b - HISTOGRAM_LINEAR;
+        uint8_t e = (uint8_t)(4 + i / (1 << HISTOGRAM_SUB_BITS));
+        uint32_t sub = (uint32_t)(i % (1 << HISTOGRAM_SUB_BITS));
+        uint32_t width = 1UL << (e - HISTOGRAM_SUB_BITS);
+        return (1UL << e) + (sub + 1) * width - 1;
+    }
+
+private:
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint64_t sum;
+    uint32_t maxValue;      // since the last reset; decay keeps it
+
+    // Nearest-rank, 1-based
+    uint32_t rank(uint32_t pct) const {
+        uint32_t r = (uint32_t)(((uint64_t)pct * count + 99) / 100);
+        return r == 0 ? 1 : r;
+    }
+
+    uint32_t valueAt(uint32_t r) const {
+        uint32_t seen = 0;
+        for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen >= r) {
+                uint32_t top = bucketTop(b);
+                return top < maxValue ? top : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+    // Older traffic fades out so the percentiles follow the current load
+    void decay() {
+        count = 0;
+        for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+            buckets[b] >>= 1;
+            count += buckets[b];
+        }
+        sum >>= 1;
+    }
+};
+
+enum PipelineStage : uint8_t {
+    PIPE_READ,          // radio interrupt to frame read: loop latency, readData, RSSI/SNR
+    PIPE_DECODE,        // read to decoded: capture record, ADVERT parse, neighbour update
+    PIPE_PUBLISH,       // decoded to accepted by MQTT (queued or handed to the IO task)
+    PIPE_REPEAT_WAIT,   // previous stamp to repeat TX start: dedup check and collision delay
+    PIPE_REPEAT_TX,     // repeat TX start to end: air time of the blocking transmit
+    PIPE_TOTAL,         // radio interrupt to done, whatever path the frame took
+    PIPE_STAGE_COUNT
+};
+
+inline const char* pipelineStageName(uint8_t stage) {
+    switch (stage) {
+        case PIPE_READ: return "read";
+        case PIPE_DECODE: return "decode";
+        case PIPE_PUBLISH: return "publish";
+        case PIPE_REPEAT_WAIT: return "repeatWait";
+        case PIPE_REPEAT_TX: return "repeatTx";
+        case PIPE_TOTAL: return "total";
+    }
+    return "?";
+}
+
+// One frame in flight at a time (the loop handles frames one after another). Stages a frame
+// skips, such as the repeat for a duplicate, are not recorded; the next stamp then covers
+// the gap. Stamps outside a frame (a downlink transmission, say) are ignored.
+class PipelineTimer {
+public:
+    PipelineTimer() : startUs(0), lastUs(0), open(false) {}
+
+    void begin(int64_t irqUs) {
+        startUs = irqUs;
+        lastUs = irqUs;
+        open = true;
+    }
+
+    void mark(uint8_t stage, int64_t nowUs) {
+        if (!open) return;
+        stages[stage].add(elapsed(lastUs, nowUs));
+        lastUs = nowUs;
+    }
+
+    void finish(int64_t nowUs) {
+        if (!open) return;
+        stages[PIPE_TOTAL].add(elapsed(startUs, nowUs));
+        open = false;
+    }
+
+    const LatencyHistogram& stage(uint8_t s) const { return stages[s]; }
+
+private:
+    LatencyHistogram stages[PIPE_STAGE_COUNT];
+    int64_t startUs;
+    int64_t lastUs;
+    bool open;
+
+    static uint32_t elapsed(int64_t from, int64_t to) {
+        if (to <= from) return 0;
+        int64_t d = to - from;
+        return d > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+    }
+};
+
+#endif // PIPELINE_TIMING_H
@@ -6,9 +6,12 @@
 #include <WiFiClient.h>
 #include "config.h"
 #include "settings_manager.h"
+#include "cert_store.h"
 #include "mqtt_handler.h"
 #include <time.h>
 
+#define QUICK_TEST_TIMEOUT_MS 40000UL
+
 // Provided by main.cpp to print runtime data
 void printTelemetryToSerial();
 void printNeighboursToSerial();
@@ -19,6 +22,23 @@ public:
         : config(cfg), settingsManager(settings) {}
 
     void setOnExitCallback(void (*cb)()) { onExitCallback = cb; }
+
+    // Run while the menu waits on the operator, so RX, repeating and the uplink keep going
+    void setIdleCallback(void (*cb)()) { idleCallback = cb; }
+
+    // Puts the saved draft into effect for the quick test and returns the running MQTT
+    // handler (nullptr if none), whose link the test then watches
+    void setQuickTestCallback(MQTTHandler* (*cb)()) { quickTestCallback = cb; }
+
+    // Write the CA edits staged in the draft to the certificate store. Returns true if a
+    // stored CA changed since the last call (here or on save), so the broker is reconnected
+    // with it when the draft is applied.
+    bool commitCaEdits() {
+        storeCaEdits();
+        bool changed = caChanged;
+        caChanged = false;
+        return changed;
+    }
     
     void begin() {
         Serial.println(F("\n╔════════════════════════════════════════════════════════╗"));
@@ -26,7 +46,14 @@ public:
         Serial.println(F("╚════════════════════════════════════════════════════════╝"));
     }
     
-    void showMainMenu() {
+    // The banner is about 5 KB of serial output, half a second at 115200 baud in which the
+    // radio is not serviced; it is shown when the menu is opened, not after every submenu
+    void showMainMenu(bool withBanner = true) {
+        if (withBanner) printBanner();
+        printMenuBox();
+    }
+
+    void printBanner() {
         Serial.println(F("\n"));
         Serial.println(F("@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@"));
         Serial.println(F("@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@"));
@@ -79,7 +106,9 @@ public:
         Serial.println(F("@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@"));
         Serial.println(F("@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@"));
         Serial.println(F("@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@"));
-        
+    }
+
+    void printMenuBox() {
         Serial.println(F("\n┌────────────────────────────────────────────────────────┐"));
         Serial.println(F("│ MAIN MENU                                              │"));
         Serial.println(F("├────────────────────────────────────────────────────────┤"));
@@ -137,15 +166,46 @@ public:
                     break;
             }
             
-            showMainMenu();
+            showMainMenu(false);
         }
     }
     
 private:
+    // CA certificate edits held with the draft until it is saved or applied
+    enum CaEdit : uint8_t { CA_KEEP, CA_STORE, CA_REMOVE };
+    struct StagedCa {
+        uint8_t edit;
+        uint8_t* der;       // heap, CA_STORE only
+        size_t length;
+    };
+
     GatewayConfig& config;
     SettingsManager& settingsManager;
     WiFiClient netClient;
     void (*onExitCallback)() = nullptr;
+    void (*idleCallback)() = nullptr;
+    MQTTHandler* (*quickTestCallback)() = nullptr;
+    StagedCa stagedCa[CERT_SLOTS] = {};
+    bool caChanged = false;         // a stored CA changed since the last commitCaEdits()
+
+    // One slice of background work while waiting; without a callback just sleep briefly
+    void idle() {
+        if (idleCallback) {
+            idleCallback();
+            yield();
+        } else {
+            delay(10);
+        }
+    }
+
+    void waitForInput() {
+        while (!Serial.available()) idle();
+    }
+
+    void idleFor(unsigned long ms) {
+        unsigned long start = millis();
+        while (millis() - start < ms) idle();
+    }
 
     // UI helpers for consistent boxed output (match main.cpp)
     static const int BOX_CONTENT_WIDTH = 54; // content width excluding the single spaces adjacent to the bars
@@ -166,11 +226,12 @@ private:
         printBoxLine(line);
     }
     
-    // Internal helper to read a line with live echo and optional masking; handles CR, LF, CRLF, and backspace
+    // Internal helper to read a line with live echo and optional masking; handles CR, LF, CRLF, and backspace.
+    // Characters are handled as they arrive; in between, the gateway runs through idle().
     String readLineInternal(bool maskEcho) {
         String input;
         while (true) {
-            while (!Serial.available()) delay(10);
+            waitForInput();
             char c = (char)Serial.read();
             if (c == '\r' || c == '\n') {
                 // Swallow optional following \n in CRLF
@@ -253,7 +314,6 @@ private:
             Serial.print(F("  ")); Serial.print(count + 1); Serial.println(F(") (Custom)"));
         }
         Serial.print(F("Select [")); Serial.print(current.length() ? current : String("(none)")); Serial.print(F("): "));
-        while (!Serial.available()) delay(10);
         String input = readLineRaw();
         if (input.length() == 0) return current; // keep existing
         int sel = input.toInt();
@@ -332,6 +392,112 @@ private:
         Serial.println(F("✓ WiFi configuration updated"));
     }
     
+    // Read a pasted PEM CA and hold it, converted to DER, with the draft; it reaches the
+    // certificate store when the draft is saved or applied (commitCaEdits)
+    void readCa(uint8_t slot) {
+        Serial.println(F("Paste PEM CA certificate below, end with a single line 'ENDCA':"));
+        // Read multiple lines until ENDCA
+        String pem;
+        while (true) {
+            String line = readLineRaw();
+            if (line == "ENDCA") break;
+            pem += line + "\n";
+        }
+        uint8_t* der = new (std::nothrow) uint8_t[CERT_MAX_BYTES];
+        size_t length = der ? pemToDer(pem.c_str(), der, CERT_MAX_BYTES) : 0;
+        if (length == 0 || derCertLength(der, length) == 0) {
+            delete[] der;
+            Serial.println(F("✗ No valid certificate found, CA not changed"));
+            return;
+        }
+        // Keep only what the certificate needs, not the whole conversion buffer
+        uint8_t* staged = new (std::nothrow) uint8_t[length];
+        if (!staged) {
+            delete[] der;
+            Serial.println(F("✗ Out of memory, CA not changed"));
+            return;
+        }
+        memcpy(staged, der, length);
+        delete[] der;
+        stageCa(slot, CA_STORE, staged, length);
+        Serial.printf("✓ CA accepted (%u bytes DER), stored when the configuration is saved or applied\n", (unsigned)length);
+    }
+
+    void stageCa(uint8_t slot, uint8_t edit, uint8_t* der = nullptr, size_t length = 0) {
+        StagedCa& ca = stagedCa[slot];
+        delete[] ca.der;
+        ca.edit = edit;
+        ca.der = der;
+        ca.length = length;
+    }
+
+    // Whether a slot holds a CA once the draft is applied
+    bool caPresent(uint8_t slot) {
+        if (stagedCa[slot].edit == CA_STORE) return true;
+        if (stagedCa[slot].edit == CA_REMOVE) return false;
+        return CertStore().has(slot);
+    }
+
+    void storeCaEdits() {
+        CertStore certs;
+        for (uint8_t slot = 0; slot < CERT_SLOTS; ++slot) {
+            StagedCa& ca = stagedCa[slot];
+            if (ca.edit == CA_STORE) {
+                if (certs.storeDer(slot, ca.der, ca.length)) {
+                    caChanged = true;
+                } else {
+                    Serial.printf("✗ CA for broker %u could not be stored\n", (unsigned)(slot + 1));
+                }
+            } else if (ca.edit == CA_REMOVE) {
+                certs.remove(slot);
+                caChanged = true;
+            }
+            stageCa(slot, CA_KEEP);
+        }
+    }
+
+    size_t caSize(uint8_t slot) {
+        if (stagedCa[slot].edit == CA_STORE) return stagedCa[slot].length;
+        if (stagedCa[slot].edit == CA_REMOVE) return 0;
+        return CertStore().size(slot);
+    }
+
+    void configureExtraBroker(uint8_t index) {
+        BrokerEndpointConfig& b = config.mqtt.extraBrokers[index];
+        char prompt[48];
+        snprintf(prompt, sizeof(prompt), "Broker %u server (blank = none)", (unsigned)(index + 2));
+        String server = readLine(prompt, String(b.server));
+        strncpy(b.server, server.c_str(), sizeof(b.server) - 1);
+        b.server[sizeof(b.server) - 1] = '\0';
+        b.enabled = b.server[0] != '\0';
+        if (!b.enabled) return;
+        b.port = readInt("  Port", b.port);
+        b.useTLS = readBool("  Enable TLS (y/n)", b.useTLS);
+        if (b.useTLS) {
+            b.insecureTLS = readBool("  Allow insecure TLS (y/n)", b.insecureTLS);
+            String profile = readLine("  TLS profile (default/fast/ecdsa)", String(tlsProfileName(b.tlsProfile)));
+            for (uint8_t i = 0; i < TLS_PROFILE_COUNT; ++i) {
+                if (profile.equalsIgnoreCase(TLS_PROFILE_NAMES[i])) b.tlsProfile = i;
+            }
+            // Without its own CA the broker is verified like the primary one
+            uint8_t slot = index + 1;
+            bool stored = caPresent(slot);
+            if (readBool("  Own CA for this broker (y/n)", stored)) {
+                if (!stored || readBool("  Replace stored CA (y/n)", false)) readCa(slot);
+            } else if (stored) {
+                stageCa(slot, CA_REMOVE);
+            }
+        }
+        String user = readLine("  Username", String(b.username));
+        strncpy(b.username, user.c_str(), sizeof(b.username) - 1);
+        b.username[sizeof(b.username) - 1] = '\0';
+        String pass = readLineMasked("  Password", "********");
+        if (pass != "********") {
+            strncpy(b.password, pass.c_str(), sizeof(b.password) - 1);
+            b.password[sizeof(b.password) - 1] = '\0';
+        }
+    }
+
     void configureMQTT() {
         Serial.println(F("\n┌── MQTT Configuration ──────────────────────────────────┐"));
         
@@ -412,6 +578,37 @@ private:
             config.mqtt.publishRaw = readBool("Publish raw packets (y/n)", config.mqtt.publishRaw);
             config.mqtt.publishDecoded = readBool("Publish decoded messages (y/n)", config.mqtt.publishDecoded);
             config.mqtt.subscribeCommands = readBool("Subscribe to commands (y/n)", config.mqtt.subscribeCommands);
+            config.mqtt.bridgeRatePerMin = (uint16_t)readInt("Bridge limit per source gateway (frames/min, 0=off)", config.mqtt.bridgeRatePerMin);
+            config.mqtt.bridgeBurst = (uint8_t)readInt("Bridge burst per source gateway (frames)", config.mqtt.bridgeBurst);
+            if (config.mqtt.bridgeAll) {
+                // Bridge interest: which neighbouring/child regions and topic classes to receive
+                String regions = readLine("Bridge regions (* = all child regions, - = own only, or e.g. NSW,ACT)",
+                                          config.mqtt.interestRegions[0] ? String(config.mqtt.interestRegions) : String("-"));
+                regions.toUpperCase();
+                regions.replace(" ", "");
+                if (regions == "-") regions = "";
+                strncpy(config.mqtt.interestRegions, regions.c_str(), sizeof(config.mqtt.interestRegions) - 1);
+                config.mqtt.interestRegions[sizeof(config.mqtt.interestRegions) - 1] = '\0';
+                char topics[64];
+                formatInterestTopics(config.mqtt.interestTopics, topics, sizeof(topics));
+                String classes = readLine("Bridge topic classes (raw,messages,status,stats,floods,adverts)", String(topics));
+                uint8_t mask = parseInterestTopics(classes.c_str());
+                if (mask == 0) {
+                    Serial.println(F("⚠ No known topic classes entered, keeping previous set"));
+                } else {
+                    config.mqtt.interestTopics = mask;
+                }
+            }
+            config.mqtt.bridgeElection = readBool("Coordinate bridging with same-region gateways (y/n)", config.mqtt.bridgeElection);
+            if (config.mqtt.bridgeElection) {
+                config.mqtt.bridgeFallbackMs = (uint16_t)readInt("Bridge fallback per better-ranked gateway (ms)", config.mqtt.bridgeFallbackMs);
+            }
+            config.mqtt.persistentSession = readBool("Persistent MQTT session (keep subscriptions and queued commands) (y/n)", config.mqtt.persistentSession);
+            config.mqtt.asyncTransport = readBool("Use async MQTT transport (y/n)", config.mqtt.asyncTransport);
+            if (config.mqtt.asyncTransport) {
+                config.mqtt.mqtt5 = readBool("Use MQTT 5 (y/n)", config.mqtt.mqtt5);
+                config.mqtt.messageExpirySec = (uint16_t)readInt("Bridged message expiry (seconds, 0=never)", config.mqtt.messageExpirySec);
+            }
 
             // Custom CA management
             Serial.println(F("\nTLS CA Options:"));
@@ -421,19 +618,30 @@ private:
                 // Optional: allow insecure TLS for testing when broker uses self-signed/unknown chain
                 config.mqtt.insecureTLS = readBool("Allow insecure TLS (skip cert validation) (y/n)", config.mqtt.insecureTLS);
             }
+            if (config.mqtt.useTLS) {
+                String profile = readLine("TLS profile (default/fast/ecdsa)", String(tlsProfileName(config.mqtt.tlsProfile)));
+                for (uint8_t i = 0; i < TLS_PROFILE_COUNT; ++i) {
+                    if (profile.equalsIgnoreCase(TLS_PROFILE_NAMES[i])) config.mqtt.tlsProfile = i;
+                }
+                int frag = readInt("TLS max fragment (0/512/1024/2048/4096)", config.mqtt.tlsMaxFragment);
+                config.mqtt.tlsMaxFragment = (frag == 512 || frag == 1024 || frag == 2048 || frag == 4096) ? (uint16_t)frag : 0;
+            }
             if (config.mqtt.useCustomCA) {
-                Serial.println(F("Paste PEM CA certificate below, end with a single line 'ENDCA':"));
-                // Read multiple lines until ENDCA
-                String pem;
-                while (true) {
-                while (!Serial.available()) delay(10);
-                String line = readLineRaw();
-                    if (line == "ENDCA") break;
-                    pem += line + "\n";
+                if (!caPresent(CERT_SLOT_PRIMARY) || readBool("Replace stored CA (y/n)", false)) {
+                    readCa(CERT_SLOT_PRIMARY);
+                }
+            }
+
+            // Additional brokers (async transport only)
+            if (config.mqtt.asyncTransport) {
+                Serial.println(F("\nAdditional Brokers:"));
+                String mode = readLine("Broker mode (single/fanout/standby)", String(brokerModeName(config.mqtt.brokerMode)));
+                for (uint8_t i = 0; i < BROKER_MODE_COUNT; ++i) {
+                    if (mode.equalsIgnoreCase(BROKER_MODE_NAMES[i])) config.mqtt.brokerMode = i;
+                }
+                for (uint8_t i = 0; config.mqtt.brokerMode != BROKER_MODE_SINGLE && i < MQTT_EXTRA_BROKERS; ++i) {
+                    configureExtraBroker(i);
                 }
-                strncpy(config.mqtt.caCert, pem.c_str(), sizeof(config.mqtt.caCert) - 1);
-                config.mqtt.caCert[sizeof(config.mqtt.caCert) - 1] = '\0';
-                Serial.println(F("✓ Custom CA saved (volatile until you Save Configuration)"));
             }
         }
         
@@ -486,11 +694,11 @@ private:
             configTime(gmtOffset, 0, config.clock.ntpServer);
             struct tm timeinfo = {};
             const unsigned long start = millis();
-            while (!getLocalTime(&timeinfo) && millis() - start < 10000UL) {
-                delay(200);
+            while (!getLocalTime(&timeinfo, 0) && millis() - start < 10000UL) {
+                idleFor(200);
                 Serial.print('.');
             }
-            if (getLocalTime(&timeinfo)) {
+            if (getLocalTime(&timeinfo, 0)) {
                 Serial.println(F("\n✓ Time synced"));
             } else {
                 Serial.println(F("\n⚠ Failed to sync time"));
@@ -566,6 +774,10 @@ private:
         Serial.printf("║   Server: %-46s ║\n", config.mqtt.server);
         Serial.printf("║   Port: %-48d║\n", config.mqtt.port);
         Serial.printf("║   TLS: %-50s║\n", config.mqtt.useTLS ? "Enabled" : "Disabled");
+        if (config.mqtt.useTLS) {
+            Serial.printf("║   TLS Profile: %-41s ║\n", (String(tlsProfileName(config.mqtt.tlsProfile)) + ", max fragment " +
+                          (config.mqtt.tlsMaxFragment ? String(config.mqtt.tlsMaxFragment) : String("default"))).c_str());
+        }
         Serial.printf("║   Username: %-44s ║\n", config.mqtt.username);
         Serial.printf("║   Client ID: %-43s ║\n", config.mqtt.clientId);
         Serial.printf("║   Base Prefix: %-42s ║\n", config.mqtt.basePrefix);
@@ -574,7 +786,26 @@ private:
         Serial.printf("║   Topic Prefix: %-40s ║\n", config.mqtt.topicPrefix);
         Serial.printf("║   Publish Raw: %-41s ║\n", config.mqtt.publishRaw ? "Yes" : "No");
         Serial.printf("║   Publish Decoded: %-37s ║\n", config.mqtt.publishDecoded ? "Yes" : "No");
-        Serial.printf("║   TLS Custom CA: %-39s ║\n", config.mqtt.useCustomCA ? "Yes" : "No");
+        Serial.printf("║   TLS Custom CA: %-39s ║\n", config.mqtt.useCustomCA ?
+                      (String("Yes, ") + String((unsigned)caSize(CERT_SLOT_PRIMARY)) +
+                       (stagedCa[CERT_SLOT_PRIMARY].edit == CA_STORE ? " bytes, not saved" : " bytes stored")).c_str() : "No");
+        Serial.printf("║   Transport: %-43s ║\n", config.mqtt.asyncTransport ? "Async (QoS 1)" : "PubSubClient");
+        Serial.printf("║   Protocol: %-44s ║\n", (config.mqtt.asyncTransport && config.mqtt.mqtt5) ? "MQTT 5 (3.1.1 fallback)" : "MQTT 3.1.1");
+        Serial.printf("║   Session: %-45s ║\n", config.mqtt.persistentSession ? "Persistent" : "Clean");
+        Serial.printf("║   Broker Mode: %-41s ║\n", brokerModeName(config.mqtt.brokerMode));
+        for (uint8_t i = 0; config.mqtt.brokerMode != BROKER_MODE_SINGLE && i < MQTT_EXTRA_BROKERS; ++i) {
+            const BrokerEndpointConfig& b = config.mqtt.extraBrokers[i];
+            if (!b.enabled) continue;
+            Serial.printf("║   Broker %u: %-44s ║\n", (unsigned)(i + 2),
+                          (String(b.server) + ":" + String(b.port) + (b.useTLS ? " TLS" : "")).c_str());
+        }
+        Serial.printf("║   Message Expiry: %-38s ║\n", (String(config.mqtt.messageExpirySec) + " s").c_str());
+        Serial.printf("║   Bridge Limit: %-40s ║\n", (String(config.mqtt.bridgeRatePerMin) + "/min, burst " + String(config.mqtt.bridgeBurst)).c_str());
+        char interestTopics[64];
+        formatInterestTopics(config.mqtt.interestTopics, interestTopics, sizeof(interestTopics));
+        Serial.printf("║   Bridge Regions: %-38s ║\n", config.mqtt.interestRegions[0] ? config.mqtt.interestRegions : "(own prefix only)");
+        Serial.printf("║   Bridge Topics: %-39s ║\n", interestTopics);
+        Serial.printf("║   Bridge Election: %-37s ║\n", config.mqtt.bridgeElection ? (String("Yes, fallback ") + String(config.mqtt.bridgeFallbackMs) + " ms").c_str() : "No");
         
         // LoRa
         Serial.println(F("╠════════════════════════════════════════════════════════╣"));
@@ -620,7 +851,9 @@ private:
     }
     
     void saveConfiguration() {
-        Serial.print(F("\nSaving configuration... "));
+        Serial.println(F("\nSaving configuration..."));
+        // The certificates go in with the settings that refer to them
+        storeCaEdits();
         if (settingsManager.saveConfig(config)) {
             Serial.println(F("✓ Done!"));
             // Offer to run an immediate connectivity + MQTT publish test
@@ -630,12 +863,13 @@ private:
                     Serial.println(F("⚠ WiFi or MQTT is disabled; skipping quick test"));
                 } else {
                     Serial.println(F("\n┌── Quick Test: WiFi + MQTT ───────────────────────────────┐"));
-                    // Use the existing MQTT handler which encapsulates WiFi/TLS/MQTT logic
-                    MQTTHandler tester(config);
-                    if (tester.begin()) {
+                    // The running handler is tested with the saved settings, not a second client:
+                    // one with the same client ID would take over the gateway's broker session
+                    MQTTHandler* live = quickTestCallback ? quickTestCallback() : nullptr;
+                    if (live && waitForUplink(live)) {
                         Serial.println(F("✓ Connected to MQTT broker"));
                         // Publish a retained online status so the user can immediately see traffic
-                        tester.publishGatewayStatus(true);
+                        live->publishGatewayStatus(true);
                         char statusTopic[128];
                         snprintf(statusTopic, sizeof(statusTopic), "%s/gateway/%s/status", config.mqtt.topicPrefix, config.mqtt.clientId);
                         Serial.print(F("Published status to: "));
@@ -658,15 +892,36 @@ private:
         }
     }
     
+    // Follow the live link, servicing the gateway meanwhile, until it is online or its
+    // connection cycle fails; each state change is shown as the handler's own log is held
+    bool waitForUplink(MQTTHandler* live) {
+        unsigned long start = millis();
+        LinkState shown = LINK_IDLE;
+        while (millis() - start < QUICK_TEST_TIMEOUT_MS) {
+            LinkStats link = live->getLinkStats();
+            if (link.state != shown) {
+                shown = link.state;
+                Serial.printf("  Link: %s\n", linkStateName(shown));
+            }
+            if (link.state == LINK_ONLINE) return true;
+            if (link.consecutiveFailures > 0) return false;
+            idle();
+        }
+        Serial.println(F("  Link: timed out"));
+        return false;
+    }
+
     void resetToDefaults() {
         Serial.print(F("\n⚠ Reset to factory defaults? (y/n): "));
-        while (!Serial.available()) delay(10);
         String input = readLineRaw();
         input.toLowerCase();
         
         if (input == "y" || input == "yes") {
             config = getDefaultConfig();
             settingsManager.clearConfig();
+            // The stored certificates went with the saved settings
+            for (uint8_t slot = 0; slot < CERT_SLOTS; ++slot) stageCa(slot, CA_KEEP);
+            caChanged = true;
             Serial.println(F("✓ Configuration reset to defaults"));
             Serial.println(F("⚠ Don't forget to save!"));
         } else {
@@ -676,7 +931,6 @@ private:
     
     void restartDevice() {
         Serial.print(F("\n⚠ Restart device now? (y/n): "));
-        while (!Serial.available()) delay(10);
         String input = readLineRaw();
         input.toLowerCase();
         
@@ -0,0 +1,576 @@
+#ifndef SERIAL_PROTOCOL_H
+#define SERIAL_PROTOCOL_H
+
+// Line-based command protocol on the console for scripts, next to the single-key commands and
+// the interactive menu. A command line starts with '@' and ends with a newline:
+//
+//   @get [key ...]                 current values; every key when none are given
+//   @set key=value [key=value ...] validate all, then apply them together as one configuration
+//   @save                          write the running configuration to flash
+//   @stats --json                  counters, uplink and latency figures
+//   @neighbours --json             neighbour table
+//   @sniff on [baud] | off         binary capture stream of RX/TX frames (sniffer.h)
+//   @help                          commands and keys
+//
+// Every command line gets exactly one reply line, "@OK {json}" or "@ERR {json}" (the object
+// then carries an "error" string), written in one piece so live log lines never split it.
+// Keys are the GatewayConfig field paths from config.h ("lora.frequency", "wifi.ssid"); a
+// value with spaces is double-quoted, with \" and \\ as escapes. Plain C++ with no Arduino
+// calls, so the parser, the key table and the replies can be exercised on a Linux host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "config.h"
+
+#define HOST_COMMAND_PREFIX '@'
+#define HOST_LINE_MAX 512
+#define HOST_LINE_TIMEOUT_MS 2000   // a partial command line is dropped after this much silence
+#define HOST_MAX_ARGS 24
+#define HOST_REPLY_MAX 4096
+#define HOST_REPLY_DEPTH 8
+
+// Collects one '@' command line from the console without blocking
+class HostLineReader {
+public:
+    HostLineReader() : length(0), reading(false), overflow(false), lastMs(0) { buffer[0] = '\0'; }
+
+    // Inside a command line: every further character belongs to it
+    bool active() const { return reading; }
+
+    // Feed one character; true when a complete line is ready in line(). The prefix starts a
+    // new line, '\r' is ignored and an empty line is dropped.
+    bool feed(char c, uint32_t nowMs) {
+        lastMs = nowMs;
+        if (!reading) {
+            if (c != HOST_COMMAND_PREFIX) return false;
+            reading = true;
+            overflow = false;
+            length = 0;
+            return false;
+        }
+        if (c == '\r') return false;
+        if (c == '\n') {
+            reading = false;
+            buffer[length] = '\0';
+            return length > 0 || overflow;
+        }
+        if (length < HOST_LINE_MAX - 1) {
+            buffer[length++] = c;
+        } else {
+            overflow = true;
+        }
+        return false;
+    }
+
+    // Drop a line whose newline never came, so the single-key commands work again
+    void expire(uint32_t nowMs) {
+        if (reading && nowMs - lastMs > HOST_LINE_TIMEOUT_MS) reading = false;
+    }
+
+    // Longer than HOST_LINE_MAX; the line holds only the start of it
+    bool overflowed() const { return overflow; }
+
+    char* line() { return buffer; }
+
+private:
+    char buffer[HOST_LINE_MAX];
+    size_t length;
+    bool reading;
+    bool overflow;
+    uint32_t lastMs;
+};
+
+// Split line in place into whitespace-separated arguments; double quotes group spaces and may
+// sit anywhere in an argument (key="My Network"). Returns the argument count, or -1 for an
+// unterminated quote or more than maxArgs arguments.
+inline int splitHostArgs(char* line, char* argv[], int maxArgs) {
+    int argc = 0;
+    char* in = line;
+    while (*in) {
+        while (*in == ' ' || *in == '\t') ++in;
+        if (!*in) break;
+        if (argc == maxArgs) return -1;
+        char* out = in;
+        argv[argc++] = out;
+        bool quoted = false;
+        while (*in && (quoted || (*in != ' ' && *in != '\t'))) {
+            if (*in == '"') {
+                quoted = !quoted;
+                ++in;
+            } else if (quoted && *in == '\\' && (in[1] == '"' || in[1] == '\\')) {
+                *out++ = in[1];
+                in += 2;
+            } else {
+                *out++ = *in++;
+            }
+        }
+        if (quoted) return -1;
+        bool end = *in == '\0';
+        *out = '\0';
+        if (!end) ++in;
+    }
+    return argc;
+}
+
+// One reply line: "@OK " or "@ERR ", a JSON value and a newline. Keys and array items get
+// their separators automatically. Text that does not fit marks the reply truncated.
+class HostReply {
+public:
+    HostReply(char* buffer, size_t size) : buffer(buffer), size(size) { reset(true); }
+
+    void reset(bool ok) {
+        length = 0;
+        depth = 0;
+        first = 0;
+        truncated = false;
+        pendingValue = false;
+        append(ok ? "@OK " : "@ERR ");
+    }
+
+    void open() { separate(); append("{"); push(); }
+    void close() { depth--; append("}"); }
+    void openArray() { separate(); append("["); push(); }
+    void closeArray() { depth--; append("]"); }
+
+    void key(const char* name) {
+        separate();
+        quote(name);
+        append(":");
+        pendingValue = true;
+    }
+
+    void string(const char* s) { separate(); quote(s); }
+    void number(uint32_t n) { char t[12]; snprintf(t, sizeof(t), "%lu", (unsigned long)n); raw(t); }
+    void boolean(bool b) { raw(b ? "true" : "false"); }
+
+    // Already-encoded JSON (a number, or a document serialized elsewhere)
+    void raw(const char* json) { separate(); append(json); }
+
+    // Room for serializing straight into the reply; advance() by what was written
+    char* tail() { return buffer + length; }
+    size_t room() const { return length + 2 < size ? size - length - 2 : 0; }
+    void advance(size_t n) {
+        if (n >= room()) truncated = true;
+        else length += n;
+    }
+
+    // Terminate the line; false when something did not fit
+    bool finish() {
+        if (length + 2 > size) truncated = true;
+        if (truncated) return false;
+        buffer[length++] = '\n';
+        buffer[length] = '\0';
+        return true;
+    }
+
+    const char* text() const { return buffer; }
+    size_t textLength() const { return length; }
+
+private:
+    char* buffer;
+    size_t size;
+    size_t length;
+    uint8_t depth;
+    uint8_t first;              // bit per nesting level: nothing written at that level yet
+    bool truncated;
+    bool pendingValue;          // a key was written, its value needs no separator
+
+    void push() {
+        if (depth < HOST_REPLY_DEPTH) first |= (uint8_t)(1 << depth);
+        depth++;
+    }
+
+    void separate() {
+        if (pendingValue) {
+            pendingValue = false;
+            return;
+        }
+        if (depth == 0 || depth > HOST_REPLY_DEPTH) return;
+        uint8_t bit = (uint8_t)(1 << (depth - 1));
+        if (first & bit) first &= (uint8_t)~bit;
+        else append(",");
+    }
+
+    void append(const char* s) {
+        size_t n = strlen(s);
+        if (length + n + 2 > size) {
+            truncated = true;
+            return;
+        }
+        memcpy(buffer + length, s, n);
+        length += n;
+    }
+
+    void quote(const char* s) {
+        append("\"");
+        char esc[8];
+        for (; *s; ++s) {
+            unsigned char c = (unsigned char)*s;
+            if (c == '"' || c == '\\') {
+                esc[0] = '\\';
+                esc[1] = (char)c;
+                esc[2] = '\0';
+            } else if (c < 0x20) {
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+            } else {
+                esc[0] = (char)c;
+                esc[1] = '\0';
+            }
+            append(esc);
+        }
+        append("\"");
+    }
+};
+
+// Settable configuration values, addressed by their path in GatewayConfig
+enum ConfigKeyType : uint8_t {
+    CONFIG_KEY_STRING,
+    CONFIG_KEY_BOOL,
+    CONFIG_KEY_UINT,        // 1, 2 or 4 bytes; decimal or 0x hex
+    CONFIG_KEY_INT,
+    CONFIG_KEY_FLOAT,
+    CONFIG_KEY_TLS_PROFILE, // name from TLS_PROFILE_NAMES or its index
+    CONFIG_KEY_BROKER_MODE, // name from BROKER_MODE_NAMES or its index
+    CONFIG_KEY_TOPICS,      // "raw,adverts", INTEREST_TOPIC_NAMES
+    CONFIG_KEY_FRAGMENT     // TLS max fragment: 0, 512, 1024, 2048 or 4096
+};
+
+#define CONFIG_KEY_SECRET      0x01 // read back as "***" when set
+#define CONFIG_KEY_READ_ONLY   0x02
+#define CONFIG_KEY_PREFIX      0x04 // part of mqtt.topicPrefix, which is derived again
+#define CONFIG_KEY_NODE_NAME   0x08 // mqtt.clientId follows the node name, as in the menu
+
+struct ConfigKey {
+    const char* name;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t offset;
+    uint16_t size;
+    float min;              // numeric range, unchecked when min == max
+    float max;
+};
+
+#define CONFIG_KEY(path, type, flags, min, max) \
+    { #path, type, flags, (uint16_t)offsetof(GatewayConfig, path), \
+      (uint16_t)sizeof(((GatewayConfig*)nullptr)->path), min, max }
+
+static const ConfigKey CONFIG_KEYS[] = {
+    CONFIG_KEY(wifi.enabled, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(wifi.ssid, CONFIG_KEY_STRING, 0, 0, 0),
+    CONFIG_KEY(wifi.password, CONFIG_KEY_STRING, CONFIG_KEY_SECRET, 0, 0),
+    CONFIG_KEY(mqtt.enabled, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.server, CONFIG_KEY_STRING, 0, 0, 0),
+    CONFIG_KEY(mqtt.port, CONFIG_KEY_UINT, 0, 1, 65535),
+    CONFIG_KEY(mqtt.username, CONFIG_KEY_STRING, 0, 0, 0),
+    CONFIG_KEY(mqtt.password, CONFIG_KEY_STRING, CONFIG_KEY_SECRET, 0, 0),
+    CONFIG_KEY(mqtt.clientId, CONFIG_KEY_STRING, 0, 0, 0),
+    CONFIG_KEY(mqtt.basePrefix, CONFIG_KEY_STRING, CONFIG_KEY_PREFIX, 0, 0),
+    CONFIG_KEY(mqtt.country, CONFIG_KEY_STRING, CONFIG_KEY_PREFIX, 0, 0),
+    CONFIG_KEY(mqtt.region, CONFIG_KEY_STRING, CONFIG_KEY_PREFIX, 0, 0),
+    CONFIG_KEY(mqtt.topicPrefix, CONFIG_KEY_STRING, CONFIG_KEY_READ_ONLY, 0, 0),
+    CONFIG_KEY(mqtt.useTLS, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.insecureTLS, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.tlsProfile, CONFIG_KEY_TLS_PROFILE, 0, 0, 0),
+    CONFIG_KEY(mqtt.tlsMaxFragment, CONFIG_KEY_FRAGMENT, 0, 0, 0),
+    CONFIG_KEY(mqtt.useCustomCA, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.publishRaw, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.publishDecoded, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.subscribeCommands, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.bridgeAll, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.asyncTransport, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.mqtt5, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.persistentSession, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.messageExpirySec, CONFIG_KEY_UINT, 0, 0, 0),
+    CONFIG_KEY(mqtt.bridgeRatePerMin, CONFIG_KEY_UINT, 0, 0, 0),
+    CONFIG_KEY(mqtt.bridgeBurst, CONFIG_KEY_UINT, 0, 1, 255),
+    CONFIG_KEY(mqtt.bridgeElection, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(mqtt.bridgeFallbackMs, CONFIG_KEY_UINT, 0, 0, 0),
+    CONFIG_KEY(mqtt.interestRegions, CONFIG_KEY_STRING, 0, 0, 0),
+    CONFIG_KEY(mqtt.interestTopics, CONFIG_KEY_TOPICS, 0, 0, 0),
+    CONFIG_KEY(mqtt.brokerMode, CONFIG_KEY_BROKER_MODE, 0, 0, 0),
+    CONFIG_KEY(lora.frequency, CONFIG_KEY_FLOAT, 0, 137.0f, 1020.0f),
+    CONFIG_KEY(lora.bandwidth, CONFIG_KEY_FLOAT, 0, 7.8f, 500.0f),
+    CONFIG_KEY(lora.spreadingFactor, CONFIG_KEY_UINT, 0, 5, 12),
+    CONFIG_KEY(lora.codingRate, CONFIG_KEY_UINT, 0, 5, 8),
+    CONFIG_KEY(lora.txPower, CONFIG_KEY_UINT, 0, 2, 22),
+    CONFIG_KEY(lora.syncWord, CONFIG_KEY_UINT, 0, 0, 0),
+    CONFIG_KEY(lora.enableCRC, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(repeater.nodeName, CONFIG_KEY_STRING, CONFIG_KEY_NODE_NAME, 0, 0),
+    CONFIG_KEY(repeater.nodeId, CONFIG_KEY_UINT, 0, 0, 0),
+    CONFIG_KEY(repeater.maxHops, CONFIG_KEY_UINT, 0, 0, 0),
+    CONFIG_KEY(repeater.autoAck, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(repeater.broadcastEnabled, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(repeater.routeTimeout, CONFIG_KEY_UINT, 0, 0, 0),
+    CONFIG_KEY(security.guestPassword, CONFIG_KEY_STRING, CONFIG_KEY_SECRET, 0, 0),
+    CONFIG_KEY(security.adminPassword, CONFIG_KEY_STRING, CONFIG_KEY_SECRET, 0, 0),
+    CONFIG_KEY(access.denyEnabled, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(discovery.advertEnabled, CONFIG_KEY_BOOL, 0, 0, 0),
+    CONFIG_KEY(discovery.advertIntervalSec, CONFIG_KEY_UINT, 0, 10, 65535),
+    CONFIG_KEY(location.latitude, CONFIG_KEY_FLOAT, 0, -90.0f, 90.0f),
+    CONFIG_KEY(location.longitude, CONFIG_KEY_FLOAT, 0, -180.0f, 180.0f),
+    CONFIG_KEY(clock.ntpServer, CONFIG_KEY_STRING, 0, 0, 0),
+    CONFIG_KEY(clock.timezoneMinutes, CONFIG_KEY_INT, 0, -720, 840),
+    CONFIG_KEY(clock.autoSync, CONFIG_KEY_BOOL, 0, 0, 0),
+};
+
+#define CONFIG_KEY_COUNT (sizeof(CONFIG_KEYS) / sizeof(CONFIG_KEYS[0]))
+
+inline const ConfigKey* findConfigKey(const char* name) {
+    for (size_t i = 0; i < CONFIG_KEY_COUNT; ++i) {
+        if (strcasecmp(CONFIG_KEYS[i].name, name) == 0) return &CONFIG_KEYS[i];
+    }
+    return nullptr;
+}
+
+inline uint32_t readConfigUint(const uint8_t* at, uint16_t size) {
+    if (size == 1) return *at;
+    if (size == 2) { uint16_t v; memcpy(&v, at, 2); return v; }
+    uint32_t v;
+    memcpy(&v, at, 4);
+    return v;
+}
+
+inline int32_t readConfigInt(const uint8_t* at, uint16_t size) {
+    if (size == 1) return (int8_t)*at;
+    if (size == 2) { int16_t v; memcpy(&v, at, 2); return v; }
+    int32_t v;
+    memcpy(&v, at, 4);
+    return v;
+}
+
+// Write the value of key in cfg as JSON into reply
+inline void configValueToJson(const GatewayConfig& cfg, const ConfigKey& key, HostReply& reply) {
+    const uint8_t* at = (const uint8_t*)&cfg + key.offset;
+    char t[32];
+    switch (key.type) {
+        case CONFIG_KEY_STRING:
+            if ((key.flags & CONFIG_KEY_SECRET) && at[0] != '\0') reply.string("***");
+            else reply.string((const char*)at);
+            return;
+        case CONFIG_KEY_BOOL:
+            reply.boolean(*(const bool*)at);
+            return;
+        case CONFIG_KEY_UINT:
+        case CONFIG_KEY_FRAGMENT:
+            reply.number(readConfigUint(at, key.size));
+            return;
+        case CONFIG_KEY_INT:
+            snprintf(t, sizeof(t), "%ld", (long)readConfigInt(at, key.size));
+            reply.raw(t);
+            return;
+        case CONFIG_KEY_FLOAT: {
+            float f;
+            memcpy(&f, at, sizeof(f));
+            snprintf(t, sizeof(t), "%.7g", (double)f);
+            reply.raw(t);
+            return;
+        }
+        case CONFIG_KEY_TLS_PROFILE:
+            reply.string(tlsProfileName(*at));
+            return;
+        case CONFIG_KEY_BROKER_MODE:
+            reply.string(brokerModeName(*at));
+            return;
+        case CONFIG_KEY_TOPICS:
+            formatInterestTopics(*at, t, sizeof(t));
+            reply.string(t);
+            return;
+    }
+    reply.raw("null");
+}
+
+// Index of text in names (case-insensitive), or text itself when it is a valid index
+inline int parseConfigName(const char* text, const char* const* names, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (strcasecmp(text, names[i]) == 0) return i;
+    }
+    char* end;
+    long n = strtol(text, &end, 10);
+    return (*text && *end == '\0' && n >= 0 && n < count) ? (int)n : -1;
+}
+
+// Parse text into key in cfg. False with a reason in error when the value is rejected, in
+// which case cfg is unchanged.
+inline bool setConfigValue(GatewayConfig& cfg, const ConfigKey& key, const char* text, const char*& error) {
+    uint8_t* at = (uint8_t*)&cfg + key.offset;
+    char* end = nullptr;
+    bool ranged = key.min != key.max;
+    if (key.flags & CONFIG_KEY_READ_ONLY) {
+        error = "read-only";
+        return false;
+    }
+    switch (key.type) {
+        case CONFIG_KEY_STRING: {
+            size_t n = strlen(text);
+            if (n >= key.size) {
+                error = "too long";
+                return false;
+            }
+            memcpy(at, text, n + 1);
+            break;
+        }
+        case CONFIG_KEY_BOOL: {
+            bool v;
+            if (!strcasecmp(text, "true") || !strcasecmp(text, "yes") || !strcasecmp(text, "on") || !strcmp(text, "1")) {
+                v = true;
+            } else if (!strcasecmp(text, "false") || !strcasecmp(text, "no") || !strcasecmp(text, "off") || !strcmp(text, "0")) {
+                v = false;
+            } else {
+                error = "expected true or false";
+                return false;
+            }
+            *(bool*)at = v;
+            break;
+        }
+        case CONFIG_KEY_UINT:
+        case CONFIG_KEY_FRAGMENT: {
+            unsigned long v = strtoul(text, &end, 0);
+            uint32_t limit = key.size == 1 ? 0xFFu : key.size == 2 ? 0xFFFFu : 0xFFFFFFFFu;
+            if (!*text || *end != '\0' || text[0] == '-' || v > limit) {
+                error = "expected an unsigned number";
+                return false;
+            }
+            if ((ranged && (v < key.min || v > key.max)) ||
+                (key.type == CONFIG_KEY_FRAGMENT && v != 0 && v != 512 && v != 1024 && v != 2048 && v != 4096)) {
+                error = "out of range";
+                return false;
+            }
+            if (key.size == 1) *at = (uint8_t)v;
+            else if (key.size == 2) { uint16_t w = (uint16_t)v; memcpy(at, &w, 2); }
+            else { uint32_t w = (uint32_t)v; memcpy(at, &w, 4); }
+            break;
+        }
+        case CONFIG_KEY_INT: {
+            long v = strtol(text, &end, 0);
+            long lo = key.size == 1 ? -128L : key.size == 2 ? -32768L : (long)INT32_MIN;
+            long hi = key.size == 1 ? 127L : key.size == 2 ? 32767L : (long)INT32_MAX;
+            if (!*text || *end != '\0' || v < lo || v > hi) {
+                error = "expected a number";
+                return false;
+            }
+            if (ranged && (v < key.min || v > key.max)) {
+                error = "out of range";
+                return false;
+            }
+            if (key.size == 1) *(int8_t*)at = (int8_t)v;
+            else if (key.size == 2) { int16_t w = (int16_t)v; memcpy(at, &w, 2); }
+            else { int32_t w = (int32_t)v; memcpy(at, &w, 4); }
+            break;
+        }
+        case CONFIG_KEY_FLOAT: {
+            float v = strtof(text, &end);
+            if (!*text || *end != '\0' || !isfinite(v)) {
+                error = "expected a number";
+                return false;
+            }
+            if (ranged && (v < key.min || v > key.max)) {
+                error = "out of range";
+                return false;
+            }
+            memcpy(at, &v, sizeof(v));
+            break;
+        }
+        case CONFIG_KEY_TLS_PROFILE:
+        case CONFIG_KEY_BROKER_MODE: {
+            int v = key.type == CONFIG_KEY_TLS_PROFILE ? parseConfigName(text, TLS_PROFILE_NAMES, TLS_PROFILE_COUNT)
+                                                       : parseConfigName(text, BROKER_MODE_NAMES, BROKER_MODE_COUNT);
+            if (v < 0) {
+                error = "unknown name";
+                return false;
+            }
+            *at = (uint8_t)v;
+            break;
+        }
+        case CONFIG_KEY_TOPICS: {
+            uint8_t mask = parseInterestTopics(text);
+            // Every name must be known: the mask has as many topics as the list has entries
+            int listed = 0;
+            for (const char* p = text; *p;) {
+                while (*p == ' ' || *p == ',') ++p;
+                if (!*p) break;
+                listed++;
+                while (*p && *p != ' ' && *p != ',') ++p;
+            }
+            int known = 0;
+            for (uint8_t i = 0; i < INTEREST_TOPIC_COUNT; ++i) known += (mask >> i) & 1;
+            if (listed != known) {
+                error = "unknown topic class";
+                return false;
+            }
+            *at = mask;
+            break;
+        }
+        default:
+            error = "unsupported";
+            return false;
+    }
+    if (key.flags & CONFIG_KEY_PREFIX) {
+        deriveTopicPrefix(cfg.mqtt, cfg.mqtt.topicPrefix, sizeof(cfg.mqtt.topicPrefix));
+    }
+    if (key.flags & CONFIG_KEY_NODE_NAME) {
+        deriveClientIdFromNodeName(cfg.repeater.nodeName, cfg.mqtt.clientId, sizeof(cfg.mqtt.clientId));
+    }
+    return true;
+}
+
+// "@ERR {"error":"...","key":"..."}"; key may be null
+inline void hostError(HostReply& reply, const char* error, const char* key = nullptr) {
+    reply.reset(false);
+    reply.open();
+    reply.key("error");
+    reply.string(error);
+    if (key) {
+        reply.key("key");
+        reply.string(key);
+    }
+    reply.close();
+}
+
+// "get [key ...]": the listed keys, or every key, as one object; unknown keys fail the whole get
+inline void hostGetConfig(HostReply& reply, const GatewayConfig& cfg, int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (!findConfigKey(argv[i])) {
+            hostError(reply, "unknown key", argv[i]);
+            return;
+        }
+    }
+    reply.open();
+    size_t count = argc > 1 ? (size_t)(argc - 1) : CONFIG_KEY_COUNT;
+    for (size_t i = 0; i < count; ++i) {
+        const ConfigKey* key = argc > 1 ? findConfigKey(argv[i + 1]) : &CONFIG_KEYS[i];
+        reply.key(key->name);
+        configValueToJson(cfg, *key, reply);
+    }
+    reply.close();
+}
+
+// "set key=value ...": every pair into draft; false with the @ERR written at the first bad one,
+// after which draft is partly changed and the caller drops it
+inline bool hostParseSet(HostReply& reply, GatewayConfig& draft, int argc, char** argv) {
+    if (argc < 2) {
+        hostError(reply, "usage: set key=value ...");
+        return false;
+    }
+    for (int i = 1; i < argc; ++i) {
+        char* eq = strchr(argv[i], '=');
+        if (!eq) {
+            hostError(reply, "expected key=value", argv[i]);
+            return false;
+        }
+        *eq = '\0';
+        const ConfigKey* key = findConfigKey(argv[i]);
+        const char* error = "unknown key";
+        if (!key || !setConfigValue(draft, *key, eq + 1, error)) {
+            hostError(reply, error, argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif // SERIAL_PROTOCOL_H
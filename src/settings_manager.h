@@ -3,11 +3,43 @@
 
 #include <Arduino.h>
 #include <Preferences.h>
+#include <new>
 #include "config.h"
+#include "config_store.h"
+#include "cert_store.h"
 
+enum ConfigSource : uint8_t {
+    CONFIG_SOURCE_NONE,         // nothing stored; defaults in use
+    CONFIG_SOURCE_BLOB,
+    CONFIG_SOURCE_LEGACY        // converted from the old key-per-field layout
+};
+
+struct SettingsLoadStats {
+    ConfigSource source;
+    uint16_t version;           // blob version it was stored in
+    uint32_t us;
+};
+
+struct SettingsSaveStats {
+    uint32_t saves;
+    uint32_t writes;            // saves that wrote the blob
+    uint32_t unchanged;         // saves skipped because nothing differed from flash
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint32_t failures;
+};
+
+// The configuration lives in one CRC-checked blob (see config_store.h). The record last read or
+// written is kept as a shadow, so saving an unchanged configuration writes nothing. Older
+// firmware stored one key per field; those are read once, converted, and left in place.
+// CA certificates live in the certificate store, not in the record.
 class SettingsManager {
 public:
-    SettingsManager() : prefs() {}
+    SettingsManager() : prefs(), shadowValid(false) {
+        memset(&record, 0, sizeof(record));
+        memset(&loadStats, 0, sizeof(loadStats));
+        memset(&saveStats, 0, sizeof(saveStats));
+    }
     
     bool begin() {
         return prefs.begin(CONFIG_NAMESPACE, false);
@@ -18,93 +50,144 @@ public:
     }
     
     bool saveConfig(const GatewayConfig& config) {
-        prefs.begin(CONFIG_NAMESPACE, false);
-        
-        // Save magic number to indicate valid config
-        prefs.putUInt("magic", config.magic);
-        
-        // WiFi settings
-        prefs.putString("wifi_ssid", config.wifi.ssid);
-        prefs.putString("wifi_pass", config.wifi.password);
-        prefs.putBool("wifi_en", config.wifi.enabled);
-        
-        // MQTT settings
-        prefs.putString("mqtt_srv", config.mqtt.server);
-        prefs.putUShort("mqtt_port", config.mqtt.port);
-        prefs.putString("mqtt_user", config.mqtt.username);
-        prefs.putString("mqtt_pass", config.mqtt.password);
-        prefs.putString("mqtt_id", config.mqtt.clientId);
-        // Persist hierarchical topic fields
-        prefs.putString("mqtt_base", config.mqtt.basePrefix);
-        prefs.putString("mqtt_country", config.mqtt.country);
-        prefs.putString("mqtt_region", config.mqtt.region);
-        // Also persist effective prefix for compatibility
-        prefs.putString("mqtt_pfx", config.mqtt.topicPrefix);
-        prefs.putBool("mqtt_tls", config.mqtt.useTLS);
-        prefs.putBool("mqtt_tls_insec", config.mqtt.insecureTLS);
-        prefs.putBool("mqtt_en", config.mqtt.enabled);
-        prefs.putBool("mqtt_raw", config.mqtt.publishRaw);
-        prefs.putBool("mqtt_dec", config.mqtt.publishDecoded);
-        prefs.putBool("mqtt_cmd", config.mqtt.subscribeCommands);
-        prefs.putBool("mqtt_bridge", config.mqtt.bridgeAll);
-        prefs.putBool("mqtt_custca", config.mqtt.useCustomCA);
-        prefs.putString("mqtt_cacert", config.mqtt.caCert);
-        
-        // LoRa settings
-        prefs.putFloat("lora_freq", config.lora.frequency);
-        prefs.putFloat("lora_bw", config.lora.bandwidth);
-        prefs.putUChar("lora_sf", config.lora.spreadingFactor);
-        prefs.putUChar("lora_cr", config.lora.codingRate);
-        prefs.putUChar("lora_pwr", config.lora.txPower);
-        prefs.putUChar("lora_sw", config.lora.syncWord);
-        prefs.putBool("lora_crc", config.lora.enableCRC);
-        
-        // Repeater settings
-        prefs.putString("rep_name", config.repeater.nodeName);
-        prefs.putUInt("rep_id", config.repeater.nodeId);
-        prefs.putUChar("rep_hops", config.repeater.maxHops);
-        prefs.putBool("rep_ack", config.repeater.autoAck);
-        prefs.putBool("rep_bc", config.repeater.broadcastEnabled);
-        prefs.putUShort("rep_tout", config.repeater.routeTimeout);
-
-        // Security
-        prefs.putString("sec_guest", config.security.guestPassword);
-        prefs.putString("sec_admin", config.security.adminPassword);
-
-        // Access control (denylist)
-        prefs.putBool("ac_deny_en", config.access.denyEnabled);
-        prefs.putUChar("ac_deny_cnt", config.access.denyCount);
-        // Store up to 16 denylist entries
-        for (uint8_t i = 0; i < config.access.denyCount && i < 16; ++i) {
-            char key[16];
-            snprintf(key, sizeof(key), "ac_dn_%02u", i);
-            prefs.putUInt(key, config.access.denylist[i]);
+        unsigned long started = micros();
+        saveStats.saves++;
+        if (shadowValid && memcmp(&record.config, &config, sizeof(config)) == 0) {
+            saveStats.unchanged++;
+            Serial.println(F("✓ Settings unchanged, nothing written"));
+            return true;
         }
-
-        // Discovery
-        prefs.putBool("disc_en", config.discovery.advertEnabled);
-        prefs.putUShort("disc_int", config.discovery.advertIntervalSec);
-
-        // Location
-        prefs.putFloat("loc_lat", config.location.latitude);
-        prefs.putFloat("loc_lon", config.location.longitude);
-
-        // Clock
-        prefs.putString("clk_ntp", config.clock.ntpServer);
-        prefs.putShort("clk_tz", config.clock.timezoneMinutes);
-        prefs.putBool("clk_auto", config.clock.autoSync);
-        
+        record.config = config;
+        sealConfigRecord(record);
+        prefs.begin(CONFIG_NAMESPACE, false);
+        size_t written = prefs.putBytes(CONFIG_BLOB_KEY, &record, sizeof(record));
         prefs.end();
+        uint32_t elapsed = micros() - started;
+        saveStats.lastUs = elapsed;
+        if (elapsed > saveStats.maxUs) saveStats.maxUs = elapsed;
+        if (written != sizeof(record)) {
+            // Unknown what flash holds now; the next save writes again
+            shadowValid = false;
+            saveStats.failures++;
+            Serial.println(F("✗ Settings save failed"));
+            return false;
+        }
+        shadowValid = true;
+        saveStats.writes++;
+        Serial.printf("✓ Settings saved: %u bytes, v%u (%lu ms)\n", (unsigned)sizeof(record),
+                      (unsigned)CONFIG_BLOB_VERSION, (unsigned long)(elapsed / 1000));
         return true;
     }
     
     bool loadConfig(GatewayConfig& config) {
+        unsigned long started = micros();
         prefs.begin(CONFIG_NAMESPACE, true);
+        bool loaded = readBlob(config);
+        bool converted = false;
+        if (!loaded) {
+            loaded = converted = readLegacyKeys(config);
+        }
+        prefs.end();
+        if (!loaded) {
+            loadStats.source = CONFIG_SOURCE_NONE;
+            loadStats.us = micros() - started;
+            return false;
+        }
         
+        // Build effective prefix
+        deriveTopicPrefix(config.mqtt, config.mqtt.topicPrefix, sizeof(config.mqtt.topicPrefix));
+        // Ensure MQTT Client ID follows the repeater node name
+        deriveClientIdFromNodeName(config.repeater.nodeName, config.mqtt.clientId, sizeof(config.mqtt.clientId));
+        
+        loadStats.us = micros() - started;
+        if (converted) {
+            loadStats.source = CONFIG_SOURCE_LEGACY;
+            loadStats.version = 0;
+            Serial.printf("✓ Settings read from per-key storage in %lu ms, converting to blob v%u\n",
+                          (unsigned long)(loadStats.us / 1000), (unsigned)CONFIG_BLOB_VERSION);
+            shadowValid = false;
+            saveConfig(config);
+        } else {
+            loadStats.source = CONFIG_SOURCE_BLOB;
+            Serial.printf("✓ Settings loaded: blob v%u, %u bytes in %lu us\n", (unsigned)loadStats.version,
+                          (unsigned)sizeof(record), (unsigned long)loadStats.us);
+            if (loadStats.version != CONFIG_BLOB_VERSION) {
+                shadowValid = false;
+                saveConfig(config);
+            } else {
+                record.config = config;
+                shadowValid = true;
+            }
+        }
+        return true;
+    }
+    
+    void clearConfig() {
+        prefs.begin(CONFIG_NAMESPACE, false);
+        prefs.clear();
+        prefs.end();
+        CertStore().clear();
+        shadowValid = false;
+    }
+
+    const SettingsLoadStats& getLoadStats() const { return loadStats; }
+    const SettingsSaveStats& getSaveStats() const { return saveStats; }
+    
+private:
+    Preferences prefs;
+    ConfigRecord record;        // last record read or written; config is the shadow when shadowValid
+    bool shadowValid;
+    SettingsLoadStats loadStats;
+    SettingsSaveStats saveStats;
+
+    // The current layout reads straight into the record; anything else goes through a scratch
+    // buffer big enough for the migrations to grow it to the current size
+    bool readBlob(GatewayConfig& config) {
+        size_t length = prefs.getBytesLength(CONFIG_BLOB_KEY);
+        if (length == 0) return false;
+        if (length > CONFIG_BLOB_MAX) {
+            Serial.printf("⚠ Stored settings blob too large (%u bytes), ignoring it\n", (unsigned)length);
+            return false;
+        }
+        uint8_t* buffer = (uint8_t*)&record;
+        size_t capacity = sizeof(record);
+        uint8_t* scratch = nullptr;
+        ConfigMigrationContext ctx = { nullptr, 0 };
+        if (length != sizeof(record)) {
+            capacity = length + sizeof(GatewayConfig);
+            scratch = new (std::nothrow) uint8_t[capacity];
+            ctx.caPem = new (std::nothrow) char[CONFIG_V1_CA_BYTES + 1];
+            if (!scratch || !ctx.caPem) {
+                delete[] scratch;
+                delete[] ctx.caPem;
+                return false;
+            }
+            ctx.caPemSize = CONFIG_V1_CA_BYTES + 1;
+            ctx.caPem[0] = '\0';
+            buffer = scratch;
+        }
+        ConfigBlobResult result = CONFIG_BLOB_CORRUPT;
+        if (prefs.getBytes(CONFIG_BLOB_KEY, buffer, length) == length) {
+            result = openConfigBlob(buffer, length, capacity, config, loadStats.version, ctx);
+        }
+        delete[] scratch;
+        if (result == CONFIG_BLOB_MIGRATED && ctx.caPem && ctx.caPem[0] != '\0') {
+            moveLegacyCa(ctx.caPem);
+        }
+        delete[] ctx.caPem;
+        if (result != CONFIG_BLOB_OK && result != CONFIG_BLOB_MIGRATED) {
+            Serial.printf("⚠ Stored settings blob rejected (%s)\n", configBlobResultName(result));
+            shadowValid = false;
+            return false;
+        }
+        return true;
+    }
+
+    // Key-per-field layout written by firmware before the blob existed
+    bool readLegacyKeys(GatewayConfig& config) {
         // Check if config exists
         uint32_t magic = prefs.getUInt("magic", 0);
         if (magic != CONFIG_MAGIC) {
-            prefs.end();
             return false;
         }
         
@@ -154,13 +237,6 @@ public:
             config.mqtt.country[sizeof(config.mqtt.country) - 1] = '\0';
             strncpy(config.mqtt.region, region.c_str(), sizeof(config.mqtt.region) - 1);
             config.mqtt.region[sizeof(config.mqtt.region) - 1] = '\0';
-            // Persist migrated fields
-            prefs.end();
-            prefs.begin(CONFIG_NAMESPACE, false);
-            prefs.putString("mqtt_base", config.mqtt.basePrefix);
-            prefs.putString("mqtt_country", config.mqtt.country);
-            prefs.putString("mqtt_region", config.mqtt.region);
-            prefs.begin(CONFIG_NAMESPACE, true);
         } else {
             strncpy(config.mqtt.basePrefix, (loadedBase.length() ? loadedBase : String(DEFAULT_MQTT_TOPIC_PREFIX)).c_str(), sizeof(config.mqtt.basePrefix) - 1);
             config.mqtt.basePrefix[sizeof(config.mqtt.basePrefix) - 1] = '\0';
@@ -169,18 +245,56 @@ public:
             strncpy(config.mqtt.region, prefs.getString("mqtt_region", "").c_str(), sizeof(config.mqtt.region) - 1);
             config.mqtt.region[sizeof(config.mqtt.region) - 1] = '\0';
         }
-        // Build effective prefix
-        deriveTopicPrefix(config.mqtt, config.mqtt.topicPrefix, sizeof(config.mqtt.topicPrefix));
         config.mqtt.useTLS = prefs.getBool("mqtt_tls", false);
         config.mqtt.insecureTLS = prefs.getBool("mqtt_tls_insec", false);
+        config.mqtt.tlsProfile = prefs.getUChar("tls_profile", DEFAULT_TLS_PROFILE);
+        if (config.mqtt.tlsProfile >= TLS_PROFILE_COUNT) config.mqtt.tlsProfile = DEFAULT_TLS_PROFILE;
+        config.mqtt.tlsMaxFragment = prefs.getUShort("tls_frag", 0);
         config.mqtt.enabled = prefs.getBool("mqtt_en", false);
         config.mqtt.publishRaw = prefs.getBool("mqtt_raw", true);
         config.mqtt.publishDecoded = prefs.getBool("mqtt_dec", true);
         config.mqtt.subscribeCommands = prefs.getBool("mqtt_cmd", true);
         config.mqtt.bridgeAll = prefs.getBool("mqtt_bridge", true);
         config.mqtt.useCustomCA = prefs.getBool("mqtt_custca", false);
-        strncpy(config.mqtt.caCert, prefs.getString("mqtt_cacert", "").c_str(), sizeof(config.mqtt.caCert) - 1);
-        config.mqtt.caCert[sizeof(config.mqtt.caCert) - 1] = '\0';
+        config.mqtt.asyncTransport = prefs.getBool("mqtt_async", true);
+        config.mqtt.mqtt5 = prefs.getBool("mqtt_v5", true);
+        config.mqtt.persistentSession = prefs.getBool("mqtt_persist", false);
+        config.mqtt.brokerMode = prefs.getUChar("br_mode", BROKER_MODE_SINGLE);
+        if (config.mqtt.brokerMode >= BROKER_MODE_COUNT) config.mqtt.brokerMode = BROKER_MODE_SINGLE;
+        for (uint8_t i = 0; i < MQTT_EXTRA_BROKERS; ++i) {
+            BrokerEndpointConfig& b = config.mqtt.extraBrokers[i];
+            char key[16];
+            snprintf(key, sizeof(key), "b%u_en", i);
+            b.enabled = prefs.getBool(key, false);
+            snprintf(key, sizeof(key), "b%u_srv", i);
+            strncpy(b.server, prefs.getString(key, "").c_str(), sizeof(b.server) - 1);
+            b.server[sizeof(b.server) - 1] = '\0';
+            snprintf(key, sizeof(key), "b%u_port", i);
+            b.port = prefs.getUShort(key, DEFAULT_MQTT_PORT);
+            snprintf(key, sizeof(key), "b%u_user", i);
+            strncpy(b.username, prefs.getString(key, "").c_str(), sizeof(b.username) - 1);
+            b.username[sizeof(b.username) - 1] = '\0';
+            snprintf(key, sizeof(key), "b%u_pass", i);
+            strncpy(b.password, prefs.getString(key, "").c_str(), sizeof(b.password) - 1);
+            b.password[sizeof(b.password) - 1] = '\0';
+            snprintf(key, sizeof(key), "b%u_tls", i);
+            b.useTLS = prefs.getBool(key, true);
+            snprintf(key, sizeof(key), "b%u_insec", i);
+            b.insecureTLS = prefs.getBool(key, false);
+            snprintf(key, sizeof(key), "b%u_prof", i);
+            b.tlsProfile = prefs.getUChar(key, DEFAULT_TLS_PROFILE);
+            if (b.tlsProfile >= TLS_PROFILE_COUNT) b.tlsProfile = DEFAULT_TLS_PROFILE;
+        }
+        config.mqtt.messageExpirySec = prefs.getUShort("mqtt_expiry", 120);
+        config.mqtt.bridgeRatePerMin = prefs.getUShort("br_rate", 12);
+        config.mqtt.bridgeBurst = prefs.getUChar("br_burst", 4);
+        config.mqtt.bridgeElection = prefs.getBool("br_elect", true);
+        config.mqtt.bridgeFallbackMs = prefs.getUShort("br_fallback", 1500);
+        strncpy(config.mqtt.interestRegions, prefs.getString("int_regions", DEFAULT_INTEREST_REGIONS).c_str(), sizeof(config.mqtt.interestRegions) - 1);
+        config.mqtt.interestRegions[sizeof(config.mqtt.interestRegions) - 1] = '\0';
+        config.mqtt.interestTopics = prefs.getUChar("int_topics", DEFAULT_INTEREST_TOPICS);
+        String legacyCa = prefs.getString("mqtt_cacert", "");
+        if (legacyCa.length() > 0) moveLegacyCa(legacyCa.c_str());
         
         // LoRa settings
         config.lora.frequency = prefs.getFloat("lora_freq", DEFAULT_LORA_FREQ);
@@ -233,22 +347,19 @@ public:
         config.clock.timezoneMinutes = prefs.getShort("clk_tz", 0);
         config.clock.autoSync = prefs.getBool("clk_auto", true);
         
-        // Ensure MQTT Client ID follows the repeater node name
-        deriveClientIdFromNodeName(config.repeater.nodeName, config.mqtt.clientId, sizeof(config.mqtt.clientId));
-        
-        prefs.end();
         return true;
     }
-    
-    void clearConfig() {
-        prefs.begin(CONFIG_NAMESPACE, false);
-        prefs.clear();
-        prefs.end();
+
+    // Older layouts kept the primary broker's CA in the configuration itself
+    void moveLegacyCa(const char* pem) {
+        CertStore certs;
+        if (certs.has(CERT_SLOT_PRIMARY)) return;
+        if (certs.storePem(CERT_SLOT_PRIMARY, pem)) {
+            Serial.printf("✓ Custom CA moved to the certificate store (%u bytes)\n", (unsigned)certs.size(CERT_SLOT_PRIMARY));
+        } else {
+            Serial.println(F("⚠ Stored custom CA could not be converted, re-enter it in the MQTT menu"));
+        }
     }
-    
-private:
-    Preferences prefs;
 };
 
 #endif // SETTINGS_MANAGER_H
-
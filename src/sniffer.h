@@ -0,0 +1,185 @@
+#ifndef SNIFFER_H
+#define SNIFFER_H
+
+// Binary capture stream of radio events for lab work: every received frame (CRC failures
+// included) and every transmission, untruncated, with RSSI, SNR and a microsecond timestamp,
+// written to the serial port instead of the human-readable log. Records are COBS-encoded with
+// a 0x00 delimiter on both sides, so a reader can join mid-stream and any stray console text
+// stays apart from the records around it; each carries a CRC-16 and a sequence number that
+// makes skipped records visible.
+//
+// Record layout (little-endian), before COBS encoding:
+//   u8 type   u8 flags   u16 seq   u64 uptimeUs   ...body...   u16 crc (CRC-16/CCITT-FALSE)
+//   SNIFFER_RX / SNIFFER_TX body:  i16 rssi (dBm)  i16 snr (0.25 dB)  u16 length  payload
+//   SNIFFER_INFO body:  u32 frequencyHz  u32 bandwidthHz  u8 sf  u8 cr  u8 syncWord  i8 txPower
+//                       i64 unixOffsetUs (wall clock at uptime 0, 0 if unsynced)  u32 nodeId
+//                       u32 dropped (records skipped because the port was busy)
+//
+// Plain C++ with no Arduino calls, so the encoder can be exercised on a Linux host; see
+// sniffer_capture.py for the decoder.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define SNIFFER_BAUD 921600             // default stream rate; the console returns to 115200 after
+#define SNIFFER_INFO_INTERVAL_MS 10000  // radio settings and clock are repeated this often
+#define SNIFFER_PAYLOAD_MAX 255
+#define SNIFFER_HEADER_BYTES 12
+#define SNIFFER_RECORD_MAX (SNIFFER_HEADER_BYTES + 6 + SNIFFER_PAYLOAD_MAX + 2)
+// COBS adds one byte per 254 plus the leading code byte; two more for the delimiters
+#define SNIFFER_FRAME_MAX (SNIFFER_RECORD_MAX + SNIFFER_RECORD_MAX / 254 + 3)
+
+enum SnifferRecordType : uint8_t {
+    SNIFFER_INFO = 0,
+    SNIFFER_RX = 1,
+    SNIFFER_TX = 2
+};
+
+#define SNIFFER_FLAG_CRC_ERROR  0x01    // RX: payload failed the LoRa CRC
+#define SNIFFER_FLAG_TX_FAILED  0x02    // TX: the radio reported an error
+#define SNIFFER_FLAG_CLOCK_SET  0x04    // INFO: unixOffsetUs is valid
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), bitwise; records are at most a few hundred bytes
+inline uint16_t snifferCrc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t b = 0; b < 8; ++b) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+// Consistent Overhead Byte Stuffing: out holds no zero bytes and ends with the 0x00
+// delimiter. out needs length + length / 254 + 2 bytes; returns the bytes written.
+inline size_t cobsEncode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t code = 0;            // where the current block's length byte goes
+    size_t o = 1;
+    uint8_t run = 1;
+    for (size_t i = 0; i < length; ++i) {
+        if (in[i] == 0) {
+            out[code] = run;
+            code = o++;
+            run = 1;
+            continue;
+        }
+        out[o++] = in[i];
+        if (++run == 0xFF) {
+            out[code] = run;
+            code = o++;
+            run = 1;
+        }
+    }
+    out[code] = run;
+    out[o++] = 0x00;
+    return o;
+}
+
+struct SnifferRadioInfo {
+    uint32_t frequencyHz;
+    uint32_t bandwidthHz;
+    uint8_t spreadingFactor;
+    uint8_t codingRate;
+    uint8_t syncWord;
+    int8_t txPower;
+    uint32_t nodeId;
+};
+
+struct SnifferStats {
+    uint32_t records;       // written to the port
+    uint32_t dropped;       // skipped because the port could not take them without waiting
+};
+
+// Builds framed records. The caller writes them out and reports the ones it had to skip,
+// which still use up a sequence number.
+class Sniffer {
+public:
+    Sniffer() : active(false), seq(0), lastInfoMs(0), lastInfoVersion(0) { memset(&stats, 0, sizeof(stats)); }
+
+    bool isActive() const { return active; }
+
+    void start() {
+        active = true;
+        lastInfoVersion = 0;
+    }
+
+    void stop() { active = false; }
+
+    // Frame for a received or transmitted payload into out (SNIFFER_FRAME_MAX bytes)
+    size_t packet(uint8_t type, uint8_t flags, uint64_t uptimeUs, int rssi, float snr, const uint8_t* data,
+                  size_t length, uint8_t* out) {
+        if (length > SNIFFER_PAYLOAD_MAX) length = SNIFFER_PAYLOAD_MAX;
+        uint8_t record[SNIFFER_RECORD_MAX];
+        size_t n = header(record, type, flags, uptimeUs);
+        n = put16(record, n, (uint16_t)(int16_t)rssi);
+        n = put16(record, n, (uint16_t)(int16_t)(snr * 4.0f + (snr < 0 ? -0.5f : 0.5f)));
+        n = put16(record, n, (uint16_t)length);
+        memcpy(record + n, data, length);
+        return seal(record, n + length, out);
+    }
+
+    // Radio settings and clock offset, so a capture can be read without knowing the setup
+    size_t info(const SnifferRadioInfo& radio, uint64_t uptimeUs, int64_t unixOffsetUs, uint8_t* out) {
+        uint8_t record[SNIFFER_RECORD_MAX];
+        size_t n = header(record, SNIFFER_INFO, unixOffsetUs ? SNIFFER_FLAG_CLOCK_SET : 0, uptimeUs);
+        n = put32(record, n, radio.frequencyHz);
+        n = put32(record, n, radio.bandwidthHz);
+        record[n++] = radio.spreadingFactor;
+        record[n++] = radio.codingRate;
+        record[n++] = radio.syncWord;
+        record[n++] = (uint8_t)radio.txPower;
+        n = put32(record, n, (uint32_t)(uint64_t)unixOffsetUs);
+        n = put32(record, n, (uint32_t)((uint64_t)unixOffsetUs >> 32));
+        n = put32(record, n, radio.nodeId);
+        n = put32(record, n, stats.dropped);
+        return seal(record, n, out);
+    }
+
+    // Whether an INFO record is due: after start(), when the configuration version changed
+    // or every SNIFFER_INFO_INTERVAL_MS
+    bool infoDue(uint32_t nowMs, uint32_t configVersion) {
+        if (lastInfoVersion == configVersion && nowMs - lastInfoMs < SNIFFER_INFO_INTERVAL_MS) return false;
+        lastInfoVersion = configVersion;
+        lastInfoMs = nowMs;
+        return true;
+    }
+
+    void noteWritten() { stats.records++; }
+    void noteDropped() { stats.dropped++; }
+
+    SnifferStats getStats() const { return stats; }
+
+private:
+    bool active;
+    uint16_t seq;
+    uint32_t lastInfoMs;
+    uint32_t lastInfoVersion;   // configuration version the last INFO described, 0 = none yet
+    SnifferStats stats;
+
+    size_t header(uint8_t* record, uint8_t type, uint8_t flags, uint64_t uptimeUs) {
+        record[0] = type;
+        record[1] = flags;
+        size_t n = put16(record, 2, seq++);
+        n = put32(record, n, (uint32_t)uptimeUs);
+        return put32(record, n, (uint32_t)(uptimeUs >> 32));
+    }
+
+    static size_t seal(uint8_t* record, size_t n, uint8_t* out) {
+        n = put16(record, n, snifferCrc16(record, n));
+        out[0] = 0x00;
+        return 1 + cobsEncode(record, n, out + 1);
+    }
+
+    static size_t put16(uint8_t* p, size_t n, uint16_t v) {
+        p[n] = (uint8_t)v;
+        p[n + 1] = (uint8_t)(v >> 8);
+        return n + 2;
+    }
+
+    static size_t put32(uint8_t* p, size_t n, uint32_t v) {
+        n = put16(p, n, (uint16_t)v);
+        return put16(p, n, (uint16_t)(v >> 16));
+    }
+};
+
+#endif // SNIFFER_H
@@ -0,0 +1,226 @@
+#ifndef TOPIC_ROUTER_H
+#define TOPIC_ROUTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <functional>
+
+// Inbound MQTT topic router. Patterns are compiled once into a small segment trie held in
+// fixed arrays; dispatch walks the topic in place (no String, no heap) and honours MQTT
+// '+' (one level) and trailing '#' (any remaining levels, including none) wildcards.
+// When several routes match, literal segments win over '+', and '+' over '#'.
+
+#define TOPIC_ROUTER_MAX_NODES 128
+#define TOPIC_ROUTER_MAX_ROUTES 64
+#define TOPIC_ROUTER_TEXT_BYTES 640   // literal segments, shared between routes with a common prefix
+
+struct TopicMatch {
+    const char* topic;
+    uint8_t tag;           // caller-defined route identifier
+    const char* tail;      // levels matched by a trailing '#', "" otherwise
+};
+
+// payload is mutable so handlers can parse JSON in place (zero-copy)
+typedef std::function<void(const TopicMatch& match, uint8_t* payload, size_t length)> TopicHandler;
+
+class TopicRouter {
+public:
+    TopicRouter() { clear(); }
+
+    void clear() {
+        nodeCount = 1; // node 0 is the root
+        routeCount = 0;
+        textUsed = 0;
+        unmatched = 0;
+        nodes[0].child = -1;
+        nodes[0].sibling = -1;
+        nodes[0].route = -1;
+        nodes[0].kind = SEG_LITERAL;
+        nodes[0].textLen = 0;
+        nodes[0].textOff = 0;
+    }
+
+    // Register a pattern such as "MESHCORE/AU/+/commands/send". Returns false if the
+    // pattern is malformed or the fixed tables are full; a rejected pattern leaves the tables
+    // as they were.
+    bool add(const char* pattern, uint8_t tag, TopicHandler handler) {
+        if (!pattern || !*pattern || routeCount >= TOPIC_ROUTER_MAX_ROUTES) return false;
+        // Check the whole pattern against the free space before inserting any of it
+        int16_t node = 0;
+        size_t newNodes = 0;
+        size_t newText = 0;
+        for (const char* p = pattern;;) {
+            size_t len;
+            uint8_t kind;
+            const char* end = segment(p, len, kind);
+            if ((kind == SEG_HASH && end) || len > 255) return false; // '#' must be the last level
+            if (node >= 0) node = findChild(node, p, len, kind);
+            if (node < 0) {
+                newNodes++;
+                if (kind == SEG_LITERAL) newText += len;
+            }
+            if (!end) break;
+            p = end + 1;
+        }
+        if (node >= 0 && nodes[node].route >= 0) return false; // duplicate pattern
+        if (nodeCount + newNodes > TOPIC_ROUTER_MAX_NODES || textUsed + newText > TOPIC_ROUTER_TEXT_BYTES) {
+            return false;
+        }
+
+        node = 0;
+        for (const char* p = pattern;;) {
+            size_t len;
+            uint8_t kind;
+            const char* end = segment(p, len, kind);
+            int16_t child = findChild(node, p, len, kind);
+            node = child >= 0 ? child : addChild(node, p, len, kind);
+            if (!end) break;
+            p = end + 1;
+        }
+        nodes[node].route = (int8_t)routeCount;
+        routes[routeCount].tag = tag;
+        routes[routeCount].handler = handler;
+        routes[routeCount].hits = 0;
+        routeCount++;
+        return true;
+    }
+
+    // Find the best route for topic and call its handler. Returns false if nothing matched.
+    bool dispatch(const char* topic, uint8_t* payload, size_t length) {
+        const char* tail = "";
+        int route = matchChildren(0, topic, tail);
+        if (route < 0) {
+            unmatched++;
+            return false;
+        }
+        Route& r = routes[route];
+        r.hits++;
+        if (r.handler) {
+            TopicMatch m = { topic, r.tag, tail };
+            r.handler(m, payload, length);
+        }
+        return true;
+    }
+
+    size_t routeTotal() const { return routeCount; }
+    uint32_t unmatchedCount() const { return unmatched; }
+
+    // Total dispatches for every route registered with this tag
+    uint32_t hitsForTag(uint8_t tag) const {
+        uint32_t total = 0;
+        for (size_t i = 0; i < routeCount; ++i) {
+            if (routes[i].tag == tag) total += routes[i].hits;
+        }
+        return total;
+    }
+
+private:
+    enum SegmentKind : uint8_t { SEG_LITERAL, SEG_PLUS, SEG_HASH };
+
+    struct Node {
+        uint16_t textOff;
+        uint8_t textLen;
+        uint8_t kind;
+        int16_t child;     // first child, -1 if none
+        int16_t sibling;   // next sibling, -1 if none
+        int8_t route;      // route index terminating here, -1 if none
+    };
+
+    struct Route {
+        uint8_t tag;
+        uint32_t hits;
+        TopicHandler handler;
+    };
+
+    Node nodes[TOPIC_ROUTER_MAX_NODES];
+    Route routes[TOPIC_ROUTER_MAX_ROUTES];
+    char text[TOPIC_ROUTER_TEXT_BYTES];
+    size_t nodeCount;
+    size_t routeCount;
+    size_t textUsed;
+    uint32_t unmatched;
+
+    // One pattern level starting at p: its length and kind; returns the '/' after it, or null
+    static const char* segment(const char* p, size_t& len, uint8_t& kind) {
+        const char* end = strchr(p, '/');
+        len = end ? (size_t)(end - p) : strlen(p);
+        kind = SEG_LITERAL;
+        if (len == 1 && p[0] == '+') kind = SEG_PLUS;
+        else if (len == 1 && p[0] == '#') kind = SEG_HASH;
+        return end;
+    }
+
+    int16_t findChild(int16_t parent, const char* seg, size_t len, uint8_t kind) const {
+        for (int16_t c = nodes[parent].child; c >= 0; c = nodes[c].sibling) {
+            const Node& n = nodes[c];
+            if (n.kind == kind &&
+                (kind != SEG_LITERAL || (n.textLen == len && memcmp(text + n.textOff, seg, len) == 0))) {
+                return c;
+            }
+        }
+        return -1;
+    }
+
+    // Append a child; add() has already checked there is room
+    int16_t addChild(int16_t parent, const char* seg, size_t len, uint8_t kind) {
+        int16_t idx = (int16_t)nodeCount++;
+        Node& n = nodes[idx];
+        n.kind = kind;
+        n.textLen = (uint8_t)(kind == SEG_LITERAL ? len : 0);
+        n.textOff = (uint16_t)textUsed;
+        if (kind == SEG_LITERAL) {
+            memcpy(text + textUsed, seg, len);
+            textUsed += len;
+        }
+        n.child = -1;
+        n.sibling = -1;
+        n.route = -1;
+        int16_t last = nodes[parent].child;
+        if (last < 0) {
+            nodes[parent].child = idx;
+        } else {
+            while (nodes[last].sibling >= 0) last = nodes[last].sibling;
+            nodes[last].sibling = idx;
+        }
+        return idx;
+    }
+
+    // A node reached at the end of the topic matches if it terminates a route, or if it
+    // has a '#' child ("a/#" also matches "a")
+    int routeAtEnd(int16_t node) const {
+        if (nodes[node].route >= 0) return nodes[node].route;
+        for (int16_t c = nodes[node].child; c >= 0; c = nodes[c].sibling) {
+            if (nodes[c].kind == SEG_HASH && nodes[c].route >= 0) return nodes[c].route;
+        }
+        return -1;
+    }
+
+    // Match the topic level starting at p against the children of parent
+    int matchChildren(int16_t parent, const char* p, const char*& tail) const {
+        const char* end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        for (uint8_t pass = SEG_LITERAL; pass <= SEG_HASH; ++pass) {
+            for (int16_t c = nodes[parent].child; c >= 0; c = nodes[c].sibling) {
+                const Node& n = nodes[c];
+                if (n.kind != pass) continue;
+                if (pass == SEG_HASH) {
+                    if (n.route >= 0) {
+                        tail = p;
+                        return n.route;
+                    }
+                    continue;
+                }
+                if (pass == SEG_LITERAL &&
+                    (n.textLen != len || memcmp(text + n.textOff, p, len) != 0)) {
+                    continue;
+                }
+                int r = end ? matchChildren(c, end + 1, tail) : routeAtEnd(c);
+                if (r >= 0) return r;
+            }
+        }
+        return -1;
+    }
+};
+
+#endif // TOPIC_ROUTER_H
@@ -0,0 +1,78 @@
+// Throughput of the bridged payload decoder on payloads shaped like the ones MQTTHandler
+// publishes: a short and a full-size /raw frame, a /messages text and an /advert, plus the
+// cost of rejecting our own echo. Run directly for numbers:
+//
+//   _gate_build/bench_bridge_decoder [iterations]
+//
+// ctest runs it with a small count only to keep it building and working.
+
+#include <chrono>
+#include <stdlib.h>
+#include <string>
+#include "test_support.h"
+#include "bridge_payloads.h"
+#include "bridge_decoder.h"
+
+struct BenchCase {
+    const char* name;
+    std::string payload;
+    const char* selfId;
+};
+
+// Decode the way the bridge callback does: scan, then the fields that kind of payload uses
+static int decode(const std::string& js, const char* selfId) {
+    BridgeFields f;
+    BridgeScanResult r = bridgeScan(js.data(), js.size(), selfId, f);
+    if (r != BRIDGE_OK) return r == BRIDGE_SELF ? 0 : -1;
+    if (f.has(BF_DATA)) {
+        BridgeFrame frame;
+        int n = bridgeHexDecode(f[BF_DATA], frame.data, sizeof(frame.data));
+        return n < 0 ? -1 : n;
+    }
+    if (f.has(BF_MESSAGE)) {
+        char text[256];
+        return bridgeUnescape(f[BF_MESSAGE], text, sizeof(text));
+    }
+    uint32_t nodeId;
+    double lat, lon;
+    char name[64];
+    if (!bridgeParseU32(f[BF_NODE_ID], nodeId) || !bridgeParseDouble(f[BF_LAT], lat) ||
+        !bridgeParseDouble(f[BF_LON], lon)) {
+        return -1;
+    }
+    return bridgeUnescape(f[BF_NAME], name, sizeof(name));
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    if (iterations < 1) iterations = 1;
+
+    uint8_t small[24];
+    uint8_t full[BRIDGE_FRAME_MAX - 71];    // a full MeshCore packet after the radio header
+    for (size_t i = 0; i < sizeof(small); ++i) small[i] = (uint8_t)(i * 13);
+    for (size_t i = 0; i < sizeof(full); ++i) full[i] = (uint8_t)(i * 29);
+    std::string raw = rawPayload("MeshCore-GW-7F3A21", full, sizeof(full));
+    BenchCase cases[] = {
+        { "raw 24 B", rawPayload("MeshCore-GW-7F3A21", small, sizeof(small)), "MeshCore-GW-0B19C4" },
+        { "raw 184 B", raw, "MeshCore-GW-0B19C4" },
+        { "message", messagePayload("MeshCore-GW-7F3A21",
+                                    "Heading up to the ridge now, signal is patchy. Will check in at the \"north\" "
+                                    "hut around 14:30 \xF0\x9F\x91\x8D"),
+          "MeshCore-GW-0B19C4" },
+        { "advert", advertPayload("MeshCore-GW-7F3A21", 0x7F3A2190, "Ridge Repeater (solar)"), "MeshCore-GW-0B19C4" },
+        { "own echo", raw, "MeshCore-GW-7F3A21" },
+    };
+
+    printf("%-10s %6s %10s %10s\n", "payload", "bytes", "ns/msg", "MB/s");
+    for (BenchCase& c : cases) {
+        CHECK(decode(c.payload, c.selfId) >= 0);
+        long sink = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (long i = 0; i < iterations; ++i) sink += decode(c.payload, c.selfId);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        double perMsg = ns / (double)iterations;
+        printf("%-10s %6zu %10.1f %10.1f%s\n", c.name, c.payload.size(), perMsg,
+               (double)c.payload.size() * 1e3 / perMsg, sink < 0 ? " (errors)" : "");
+    }
+    return testResult("bench_bridge_decoder");
+}
@@ -0,0 +1,79 @@
+#ifndef BRIDGE_PAYLOADS_H
+#define BRIDGE_PAYLOADS_H
+
+// Bridged payloads as MQTTHandler publishes them (publishRawPacket, publishDecodedMessage,
+// publishAdvert): same keys, same order, same number formatting as ArduinoJson produces.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+// Deterministic generator so fuzz failures reproduce from the printed seed
+struct TestRng {
+    uint64_t s;
+    explicit TestRng(uint64_t seed) : s(seed ? seed : 1) {}
+    uint32_t next() {
+        s ^= s << 13;
+        s ^= s >> 7;
+        s ^= s << 17;
+        return (uint32_t)(s >> 16);
+    }
+    uint32_t below(uint32_t n) { return n ? next() % n : 0; }
+};
+
+// JSON string escaping as serializeJson does it (control characters as \uXXXX)
+inline std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char u[8];
+                    snprintf(u, sizeof(u), "\\u%04x", c);
+                    out += u;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    return out;
+}
+
+inline std::string rawPayload(const char* gateway, const uint8_t* data, size_t length,
+                              uint32_t timestamp = 81234567, int rssi = -97, const char* snr = "7.25") {
+    std::string hex;
+    char b[3];
+    for (size_t i = 0; i < length; ++i) {
+        snprintf(b, sizeof(b), "%02X", data[i]);
+        hex += b;
+    }
+    char head[160];
+    snprintf(head, sizeof(head), "{\"timestamp\":%u,\"rssi\":%d,\"snr\":%s,\"gateway\":\"", timestamp, rssi, snr);
+    return std::string(head) + jsonEscape(gateway) + "\",\"data\":\"" + hex + "\",\"length\":" +
+           std::to_string(length) + "}";
+}
+
+inline std::string messagePayload(const char* gateway, const std::string& message,
+                                  uint32_t from = 0x1A2B3C4D, uint32_t to = 0xFFFFFFFF) {
+    char head[96];
+    snprintf(head, sizeof(head), "{\"timestamp\":81234567,\"from\":%u,\"to\":%u,\"message\":\"", from, to);
+    return std::string(head) + jsonEscape(message) + "\",\"type\":2,\"rssi\":-104,\"snr\":-3.5,\"hops\":2,\"gateway\":\"" +
+           jsonEscape(gateway) + "\"}";
+}
+
+inline std::string advertPayload(const char* gateway, uint32_t nodeId, const std::string& name,
+                                 const char* lat = "-33.8688", const char* lon = "151.2093") {
+    char head[80];
+    snprintf(head, sizeof(head), "{\"timestamp\":81234567,\"nodeId\":%u,\"name\":\"", nodeId);
+    return std::string(head) + jsonEscape(name) + "\",\"lat\":" + lat + ",\"lon\":" + lon + ",\"gateway\":\"" +
+           jsonEscape(gateway) + "\"}";
+}
+
+#endif // BRIDGE_PAYLOADS_H
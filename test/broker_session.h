@@ -0,0 +1,168 @@
+#ifndef BROKER_SESSION_H
+#define BROKER_SESSION_H
+
+// Blocking MQTT session over a POSIX socket for the broker tests. Packets are built and parsed
+// with the firmware's codec (src/mqtt_codec.h), so a real broker checks what the async
+// transport would put on the wire. The broker is MQTT_TEST_BROKER (host:port), by default a
+// mosquitto on 127.0.0.1:1883; tests that need a second one read MQTT_TEST_BROKER2.
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "mqtt_codec.h"
+
+#define BROKER_TIMEOUT_MS 5000
+
+struct BrokerAddress {
+    char host[128];
+    char port[8];
+};
+
+// The broker named by an environment variable, or 127.0.0.1 on defaultPort
+inline BrokerAddress testBroker(const char* var = "MQTT_TEST_BROKER", const char* defaultPort = "1883") {
+    BrokerAddress a;
+    snprintf(a.host, sizeof(a.host), "127.0.0.1");
+    snprintf(a.port, sizeof(a.port), "%s", defaultPort);
+    const char* env = getenv(var);
+    if (env && env[0]) {
+        snprintf(a.host, sizeof(a.host), "%s", env);
+        char* colon = strrchr(a.host, ':');
+        if (colon) {
+            *colon = '\0';
+            snprintf(a.port, sizeof(a.port), "%s", colon + 1);
+        }
+    }
+    return a;
+}
+
+class BrokerSession {
+public:
+    BrokerSession() : fd(-1), reader(frame, sizeof(frame)), v5(false) {}
+    ~BrokerSession() { close(); }
+
+    bool open() { return open(testBroker()); }
+
+    bool open(const BrokerAddress& a) {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res = nullptr;
+        if (getaddrinfo(a.host, a.port, &hints, &res) != 0) return false;
+        for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) continue;
+            if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(res);
+        if (fd < 0) return false;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        queuedCount = 0;
+        reader.reset();
+    }
+
+    bool isOpen() const { return fd >= 0; }
+
+    // CONNECT and wait for the CONNACK
+    bool connect(const MqttConnectOptions& o, MqttConnack& ack) {
+        v5 = o.protocolVersion == MQTT_PROTOCOL_V5;
+        uint8_t pkt[512];
+        if (!send(pkt, mqttEncodeConnect(pkt, sizeof(pkt), o))) return false;
+        if (!next(MQTT_PKT_CONNACK)) return false;
+        return mqttParseConnack(reader.body(), reader.length(), v5, ack) && ack.reasonCode == 0;
+    }
+
+    bool send(const uint8_t* pkt, size_t n) {
+        if (n == 0 || fd < 0) return false;
+        return ::send(fd, pkt, n, MSG_NOSIGNAL) == (ssize_t)n;
+    }
+
+    // Read until a packet of the given type arrives (others are dropped); false on timeout.
+    // PUBLISH packets received meanwhile are kept for takePublish().
+    bool next(uint8_t type, int timeoutMs = BROKER_TIMEOUT_MS) {
+        for (;;) {
+            if (!readFrame(timeoutMs)) return false;
+            if (reader.type() == MQTT_PKT_PUBLISH && type != MQTT_PKT_PUBLISH) {
+                keepPublish();
+                continue;
+            }
+            if (reader.type() == type) return true;
+        }
+    }
+
+    // The next inbound PUBLISH (already queued or read now); false if none within the timeout
+    bool takePublish(char* topic, size_t topicSize, char* payload, size_t payloadSize, MqttPublishView& v,
+                     int timeoutMs = BROKER_TIMEOUT_MS) {
+        if (queuedCount == 0) {
+            if (!next(MQTT_PKT_PUBLISH, timeoutMs)) return false;
+            keepPublish();
+        }
+        Kept& k = kept[0];
+        if (!mqttParsePublish(k.flags, k.body, k.length, v, v5)) return false;
+        copyOut(topic, topicSize, v.topic, v.topicLen);
+        copyOut(payload, payloadSize, (const char*)v.payload, v.payloadLen);
+        if (v.qos == 1) {
+            uint8_t ack[4];
+            send(ack, mqttEncodePuback(ack, v.packetId));
+        }
+        memmove(&kept[0], &kept[1], sizeof(Kept) * (queuedCount - 1));
+        queuedCount--;
+        return true;
+    }
+
+    const MqttFrameReader& last() const { return reader; }
+
+private:
+    struct Kept {
+        uint8_t flags;
+        uint8_t body[1024];
+        size_t length;
+    };
+
+    int fd;
+    uint8_t frame[4096];
+    MqttFrameReader reader;
+    bool v5;
+    Kept kept[8];
+    size_t queuedCount = 0;
+
+    bool readFrame(int timeoutMs) {
+        for (;;) {
+            pollfd p = { fd, POLLIN, 0 };
+            if (poll(&p, 1, timeoutMs) <= 0) return false;
+            uint8_t b;
+            if (recv(fd, &b, 1, 0) != 1) return false;
+            if (reader.feed(b)) return true;
+        }
+    }
+
+    void keepPublish() {
+        if (queuedCount >= 8 || reader.length() > sizeof(kept[0].body)) return;
+        Kept& k = kept[queuedCount++];
+        k.flags = reader.flags();
+        k.length = reader.length();
+        memcpy(k.body, reader.body(), k.length);
+    }
+
+    static void copyOut(char* out, size_t size, const char* data, size_t n) {
+        if (n >= size) n = size - 1;
+        memcpy(out, data, n);
+        out[n] = '\0';
+    }
+};
+
+#endif // BROKER_SESSION_H
@@ -0,0 +1,149 @@
+#ifndef ELECTION_GATEWAY_H
+#define ELECTION_GATEWAY_H
+
+// The bridging side of one gateway, for the election tests: the firmware's BridgeElection,
+// BridgeScheduler and bridge decoder wired together the way MQTTHandler does it
+// (handleBridgedRaw/commitBridged, serviceBridgeQueue, handleElection, announceRank and
+// publishClaim). MQTTHandler itself needs the Arduino runtime, so this mirrors its few lines
+// of glue; the transport is whatever the test plugs into publish.
+
+#include <stdio.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "bridge_decoder.h"
+#include "bridge_election.h"
+#include "bridge_scheduler.h"
+
+#define SIM_PREFIX "MESHCORE/SIM"
+
+// Every transmission in a run, by frame key: who put it on air and whether as a fallback
+struct AirLog {
+    struct Tx {
+        std::string gateway;
+        bool fallback;
+    };
+    std::map<uint32_t, std::vector<Tx>> byKey;
+
+    void note(uint32_t key, const char* gateway, bool fallback) { byKey[key].push_back({ gateway, fallback }); }
+    size_t count(uint32_t key) const {
+        auto it = byKey.find(key);
+        return it == byKey.end() ? 0 : it->second.size();
+    }
+};
+
+class ElectionGateway {
+public:
+    typedef std::function<void(const char* topic, const std::string& payload)> Publish;
+
+    ElectionGateway(const char* gatewayId, float snr, uint16_t fallbackMs, AirLog& air, Publish publish,
+                    const char* topicPrefix = SIM_PREFIX)
+        : id(gatewayId), prefix(topicPrefix), fallback(fallbackMs), log(air), pub(publish), lastAnnounce(0),
+          announced(false), alive(true) {
+        election.setSelf(gatewayId);
+        election.noteRfSample(snr);
+        queue.setLimits(0, 4);
+    }
+
+    const char* name() const { return id.c_str(); }
+    uint16_t rank() const { return election.rank(); }
+    BridgeElectionStats stats(unsigned long nowMs) const { return election.getStats(nowMs); }
+
+    // A dead gateway neither receives nor transmits nor announces
+    void kill() { alive = false; }
+    bool isAlive() const { return alive; }
+
+    void onMessage(const char* topic, const char* payload, size_t length, unsigned long nowMs) {
+        if (!alive || strncmp(topic, prefix.c_str(), prefix.size()) != 0) return;
+        const char* sub = topic + prefix.size();
+        if (strcmp(sub, "/raw") == 0) {
+            handleRaw(payload, length, nowMs);
+        } else if (strcmp(sub, "/bridge/rank") == 0) {
+            handleElection(true, payload, length, nowMs);
+        } else if (strcmp(sub, "/bridge/claim") == 0) {
+            handleElection(false, payload, length, nowMs);
+        }
+    }
+
+    // One loop() pass: announce when due, then at most one bridged frame
+    void service(unsigned long nowMs) {
+        if (!alive) return;
+        if (!announced || nowMs - lastAnnounce >= ELECTION_ANNOUNCE_MS) {
+            announced = true;
+            lastAnnounce = nowMs;
+            char payload[96];
+            snprintf(payload, sizeof(payload), "{\"gateway\":\"%s\",\"rank\":%u}", id.c_str(), (unsigned)election.rank());
+            pub((prefix + "/bridge/rank").c_str(), payload);
+        }
+        BridgeFrame* frame = queue.next(nowMs);
+        if (!frame) return;
+        uint32_t key = BridgeElection::frameKey(frame->data, frame->length);
+        if (election.isClaimed(key, nowMs)) {
+            election.noteSuppressed();
+            queue.release(frame);
+            return;
+        }
+        election.noteClaim(key, nowMs);
+        bool wasFallback = election.position(nowMs) > 0;
+        election.noteTransmitted(wasFallback);
+        char payload[96];
+        snprintf(payload, sizeof(payload), "{\"gateway\":\"%s\",\"key\":%lu}", id.c_str(), (unsigned long)key);
+        pub((prefix + "/bridge/claim").c_str(), payload);
+        log.note(key, id.c_str(), wasFallback);
+        queue.release(frame);
+    }
+
+    size_t queued() const { return queue.queued(); }
+
+private:
+    std::string id;
+    std::string prefix;
+    uint16_t fallback;
+    AirLog& log;
+    Publish pub;
+    BridgeElection election;
+    BridgeScheduler queue;
+    unsigned long lastAnnounce;
+    bool announced;
+    bool alive;
+
+    void handleRaw(const char* payload, size_t length, unsigned long nowMs) {
+        BridgeFields f;
+        if (bridgeScan(payload, length, id.c_str(), f) != BRIDGE_OK) return;
+        const JsonSpan& gw = f[BF_GATEWAY];
+        bool named = gw.isString && gw.len > 0;
+        BridgeFrame* frame = queue.admit(named ? gw.p : "?", named ? gw.len : 1, nowMs);
+        if (!frame) return;
+        int n = bridgeHexDecode(f[BF_DATA], frame->data, sizeof(frame->data));
+        if (n <= 0) {
+            queue.abort(frame);
+            return;
+        }
+        frame->length = (uint16_t)n;
+        if (election.isClaimed(BridgeElection::frameKey(frame->data, frame->length), nowMs)) {
+            election.noteSuppressed();
+            queue.abort(frame);
+            return;
+        }
+        unsigned long holdoff = election.holdoffMs(nowMs, fallback);
+        queue.commit(frame, holdoff ? nowMs + holdoff : 0);
+    }
+
+    void handleElection(bool rank, const char* payload, size_t length, unsigned long nowMs) {
+        BridgeFields f;
+        if (bridgeScan(payload, length, id.c_str(), f) != BRIDGE_OK) return;
+        const JsonSpan& gw = f[BF_GATEWAY];
+        uint32_t value = 0;
+        if (!gw.isString || gw.len == 0) return;
+        if (rank) {
+            if (bridgeParseU32(f[BF_RANK], value)) {
+                election.notePeer(gw.p, gw.len, (uint16_t)(value > 0xFFFF ? 0xFFFF : value), nowMs);
+            }
+        } else if (bridgeParseU32(f[BF_KEY], value) && value != 0) {
+            election.noteClaim(value, nowMs);
+        }
+    }
+};
+
+#endif // ELECTION_GATEWAY_H
@@ -0,0 +1,171 @@
+#ifndef FAILOVER_GATEWAY_H
+#define FAILOVER_GATEWAY_H
+
+// The uplink side of one gateway with extra brokers, for the failover tests. The decisions are
+// the firmware's own (src/broker_failover.h: endpoint backoff, publishOrQueue, standby
+// selection) around its OutboundQueue; what is left here is the wiring BrokerEndpoint and
+// MQTTHandler add around them with the async transport, which the host cannot run. The broker
+// connections are whatever the test plugs in as FailoverLink.
+
+#include <string>
+#include <vector>
+#include "config.h"
+#include "outbound_queue.h"
+#include "broker_failover.h"
+
+// One broker connection: the part of MQTTTransport the publish path uses
+class FailoverLink {
+public:
+    virtual ~FailoverLink() {}
+    virtual bool connect() = 0;
+    virtual bool connected() = 0;
+    virtual void disconnect() = 0;
+    virtual bool publish(const char* topic, const char* payload, size_t length, bool retain, uint8_t qos) = 0;
+    // Command and bridge filters on (true) or off; the tests only need to see which link has them
+    virtual void setSubscribed(bool on) { subscribed = on; }
+
+    bool subscribed = false;
+};
+
+// BrokerEndpoint: reconnects with backoff, queues store-and-forward traffic while down or
+// backed up, and replays its backlog once online
+class FailoverEndpoint {
+public:
+    explicit FailoverEndpoint(FailoverLink& l) : link(l), online(false), sessions(0), published(0) {}
+
+    void loop(unsigned long now) {
+        if (!online) {
+            if (!backoff.due(now)) return;
+            if (link.connect()) {
+                online = true;
+                backoff.succeeded();
+                sessions++;
+            } else {
+                retryLater(now);
+                return;
+            }
+        } else if (!link.connected()) {
+            retryLater(now);
+            return;
+        }
+        if (!backlog.isEmpty()) {
+            backlog.replay([this](const char* topic, const char* payload, size_t length, bool retain) {
+                if (!link.connected() || !link.publish(topic, payload, length, retain, 1)) return false;
+                published++;
+                return true;
+            });
+        }
+    }
+
+    bool publish(const char* topic, const char* payload, size_t length, bool retain, bool storeAndForward) {
+        return publishOrQueue(backlog, online, topic, payload, length, retain, storeAndForward, [&](uint8_t qos) {
+            if (!link.publish(topic, payload, length, retain, qos)) return false;
+            published++;
+            return true;
+        });
+    }
+
+    bool isOnline() const { return online; }
+    FailoverLink& session() { return link; }
+    uint32_t sessionCount() const { return sessions; }
+    uint32_t publishedCount() const { return published; }
+    OutboundQueueStats backlogStats() { return backlog.getStats(); }
+
+private:
+    FailoverLink& link;
+    OutboundQueue backlog;      // RAM-only, as on the device
+    bool online;
+    EndpointBackoff backoff;
+    uint32_t sessions;
+    uint32_t published;
+
+    void retryLater(unsigned long now) {
+        link.disconnect();
+        online = false;
+        backoff.failed(now);
+    }
+};
+
+class FailoverGateway {
+public:
+    // The primary reconnects on its own after a fixed delay; its backoff and link states are
+    // the handler's business and not what these tests look at
+    FailoverGateway(uint8_t brokerMode, FailoverLink& primaryLink, std::vector<FailoverLink*> extra,
+                    unsigned long primaryRetryMs = ENDPOINT_BACKOFF_BASE_MS)
+        : mode(brokerMode), primary(primaryLink), retryMs(primaryRetryMs), primaryNextAttempt(0) {
+        for (FailoverLink* l : extra) endpoints.emplace_back(*l);
+    }
+
+    // publishMessage: fan-out copies first, then the uplink, queueing while it is missing
+    bool publishMessage(const char* topic, const std::string& payload, bool storeAndForward) {
+        if (mode == BROKER_MODE_FANOUT) {
+            for (FailoverEndpoint& e : endpoints) e.publish(topic, payload.data(), payload.size(), false, storeAndForward);
+        }
+        FailoverLink* up = uplink();
+        return publishOrQueue(outbound, up != nullptr, topic, payload.data(), payload.size(), false, storeAndForward,
+                              [&](uint8_t qos) { return up->publish(topic, payload.data(), payload.size(), false, qos); });
+    }
+
+    // The primary while it is connected, otherwise (standby mode) the first online endpoint
+    FailoverLink* uplink() {
+        if (primary.connected()) return &primary;
+        if (mode == BROKER_MODE_STANDBY) {
+            int carrier = firstUsableEndpoint(endpoints.size(), [this](size_t i) {
+                return endpoints[i].isOnline() && endpoints[i].session().connected();
+            });
+            if (carrier >= 0) return &endpoints[carrier].session();
+        }
+        return nullptr;
+    }
+
+    // One loop() pass: primary reconnect, serviceEndpoints, then the backlog replay
+    void loop(unsigned long now) {
+        if (!primary.connected() && (long)(now - primaryNextAttempt) >= 0) {
+            primary.disconnect();
+            if (primary.connect()) {
+                primary.setSubscribed(true);
+            } else {
+                primaryNextAttempt = now + retryMs;
+            }
+        }
+        serviceEndpoints(now);
+        FailoverLink* up = uplink();
+        if (up && !outbound.isEmpty()) {
+            outbound.replay([up](const char* topic, const char* payload, size_t length, bool retain) {
+                return up->connected() && up->publish(topic, payload, length, retain, 1);
+            });
+        }
+    }
+
+    FailoverEndpoint& endpoint(size_t i) { return endpoints[i]; }
+    FailoverLink* standbyLink() {
+        return standby.standbyIndex() >= 0 ? &endpoints[standby.standbyIndex()].session() : nullptr;
+    }
+    uint32_t failoverCount() const { return standby.failoverCount(); }
+    OutboundQueueStats outboundStats() { return outbound.getStats(); }
+
+private:
+    uint8_t mode;
+    FailoverLink& primary;
+    unsigned long retryMs;
+    unsigned long primaryNextAttempt;
+    std::vector<FailoverEndpoint> endpoints;
+    StandbySelector standby;
+    OutboundQueue outbound;
+
+    void serviceEndpoints(unsigned long now) {
+        if (mode == BROKER_MODE_SINGLE) return;
+        for (FailoverEndpoint& e : endpoints) e.loop(now);
+        if (mode != BROKER_MODE_STANDBY) return;
+
+        if (!standby.update(primary.connected(), endpoints.size(),
+                            [this](size_t i) { return endpoints[i].isOnline(); })) {
+            return;
+        }
+        int released = standby.releasedIndex();
+        if (released >= 0 && endpoints[released].isOnline()) endpoints[released].session().setSubscribed(false);
+        if (standby.standbyIndex() >= 0) endpoints[standby.standbyIndex()].session().setSubscribed(true);
+    }
+};
+
+#endif // FAILOVER_GATEWAY_H
@@ -0,0 +1,156 @@
+// The gateway's console command path on a Linux host, for serial_console_pty.py: stdin and
+// stdout stand in for the UART, and get/set/save/help run through the firmware's line
+// reader, parser, key table, configuration snapshots and settings storage (on the in-memory
+// NVS). The dispatch mirrors checkSerialInput() and handleHostCommand() in main.cpp; stats,
+// neighbours and sniff need the radio and uplink and answer "unknown command" here.
+//
+// Like the board, it prints a log line every HOST_LOG_INTERVAL_MS and answers the single key
+// 's' with a status line, so a script has to pick its reply out of live output.
+
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include "serial_protocol.h"
+#include "config_snapshot.h"
+#include "settings_manager.h"
+
+#define HOST_LOG_INTERVAL_MS 50
+
+static ConfigSnapshots configSnapshots;
+static SettingsManager settingsManager;
+static HostLineReader hostLine;
+static char hostReplyBuffer[HOST_REPLY_MAX];
+
+static uint32_t nowMs() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)(t.tv_sec * 1000 + t.tv_nsec / 1000000);
+}
+
+static void writeOut(const char* text, size_t length) {
+    while (length) {
+        ssize_t n = write(STDOUT_FILENO, text, length);
+        if (n <= 0) exit(0);    // the other side of the pty is gone
+        text += n;
+        length -= (size_t)n;
+    }
+}
+
+static void writeLine(const char* format, ...) __attribute__((format(printf, 1, 2)));
+static void writeLine(const char* format, ...) {
+    char line[160];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line) - 2, format, args);
+    va_end(args);
+    n = std::min(n, (int)sizeof(line) - 3);
+    line[n++] = '\r';
+    line[n++] = '\n';
+    writeOut(line, (size_t)n);
+}
+
+static void hostSet(HostReply& reply, int argc, char** argv) {
+    GatewayConfig config = configSnapshots.config();
+    if (!hostParseSet(reply, config, argc, argv)) return;
+    uint16_t changes = configChanges(configSnapshots.config(), config);
+    if (!configSnapshots.publish(config)) {
+        hostError(reply, "not applied (out of memory)");
+        return;
+    }
+    reply.open();
+    reply.key("version");
+    reply.number(configSnapshots.version());
+    reply.key("restart");
+    reply.boolean(changes & CONFIG_CHANGE_RESTART);
+    reply.key("saved");
+    reply.boolean(false);
+    reply.close();
+}
+
+static void hostSave(HostReply& reply) {
+    if (!settingsManager.saveConfig(configSnapshots.config())) {
+        hostError(reply, "flash write failed");
+        return;
+    }
+    reply.open();
+    reply.key("saved");
+    reply.boolean(true);
+    reply.key("version");
+    reply.number(configSnapshots.version());
+    reply.close();
+}
+
+static void hostHelp(HostReply& reply) {
+    static const char* const commands[] = {"get", "set", "save", "help"};
+    reply.open();
+    reply.key("commands");
+    reply.openArray();
+    for (const char* command : commands) reply.string(command);
+    reply.closeArray();
+    reply.key("keys");
+    reply.openArray();
+    for (size_t i = 0; i < CONFIG_KEY_COUNT; ++i) reply.string(CONFIG_KEYS[i].name);
+    reply.closeArray();
+    reply.close();
+}
+
+static void handleHostCommand(char* line, bool overflowed) {
+    HostReply reply(hostReplyBuffer, sizeof(hostReplyBuffer));
+    char* argv[HOST_MAX_ARGS];
+    int argc = overflowed ? 0 : splitHostArgs(line, argv, HOST_MAX_ARGS);
+
+    if (overflowed) hostError(reply, "line too long");
+    else if (argc < 0) hostError(reply, "unterminated quote or too many arguments");
+    else if (argc == 0) hostError(reply, "empty command");
+    else if (!strcmp(argv[0], "get")) hostGetConfig(reply, configSnapshots.config(), argc, argv);
+    else if (!strcmp(argv[0], "set")) hostSet(reply, argc, argv);
+    else if (!strcmp(argv[0], "save")) hostSave(reply);
+    else if (!strcmp(argv[0], "help")) hostHelp(reply);
+    else hostError(reply, "unknown command", argv[0]);
+
+    if (!reply.finish()) {
+        hostError(reply, "reply too long");
+        reply.finish();
+    }
+    writeOut(reply.text(), reply.textLength());
+}
+
+static void checkSerialInput(const char* input, size_t length) {
+    hostLine.expire(nowMs());
+    for (size_t i = 0; i < length; ++i) {
+        char c = input[i];
+        if (c == HOST_COMMAND_PREFIX || hostLine.active()) {
+            if (hostLine.feed(c, nowMs())) handleHostCommand(hostLine.line(), hostLine.overflowed());
+            continue;
+        }
+        if (c == 's' || c == 'S') {
+            writeLine("📊 Status: config v%lu, uptime %lu ms", (unsigned long)configSnapshots.version(),
+                      (unsigned long)nowMs());
+        }
+    }
+}
+
+int main() {
+    GatewayConfig config = getDefaultConfig();
+    settingsManager.begin();
+    settingsManager.loadConfig(config);
+    configSnapshots.publish(config);
+    writeLine("✓ Console host ready");
+
+    uint32_t lastLog = nowMs();
+    uint32_t packets = 0;
+    for (;;) {
+        pollfd in = {STDIN_FILENO, POLLIN, 0};
+        if (poll(&in, 1, HOST_LOG_INTERVAL_MS) > 0) {
+            char input[256];
+            ssize_t n = read(STDIN_FILENO, input, sizeof(input));
+            if (n <= 0) return 0;
+            checkSerialInput(input, (size_t)n);
+        }
+        if (nowMs() - lastLog >= HOST_LOG_INTERVAL_MS) {
+            lastLog = nowMs();
+            writeLine("📡 LoRa RX: 42 bytes | RSSI: -97 dBm | SNR: 7.2 dB (#%lu)", (unsigned long)++packets);
+        }
+        Serial.take();    // settings messages stay off the console's stdout
+    }
+}
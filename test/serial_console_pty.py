@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Drive the console command protocol through a pseudo-terminal, the way a script drives the board.
+
+serial_console_host (the firmware's command path built for Linux) runs on the master side of
+a pty; gateway_serial.GatewaySerial opens the slave as its serial port. Checks get/set/save
+through the client, the errors it raises, and raw protocol cases a client would not send
+(overlong and unterminated lines, CRLF, a command mixed with single keys and log output).
+Prints the round-trip time of a set.
+
+Usage: python3 serial_console_pty.py <path to serial_console_host>
+Exits 77 (skipped) without pyserial or ptys.
+"""
+import json
+import os
+import subprocess
+import sys
+import time
+import tty
+
+SKIP = 77
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+try:
+    import pty
+    from gateway_serial import GatewayError, GatewaySerial
+except ImportError as e:
+    print(f'skipped: {e}')
+    sys.exit(SKIP)
+
+failures = 0
+checks = 0
+
+
+def check(ok, what):
+    global failures, checks
+    checks += 1
+    if not ok:
+        failures += 1
+        print(f'FAIL {what}', file=sys.stderr)
+
+
+def expect_error(gw, line, error, key=None):
+    try:
+        reply = gw.command(line)
+        check(False, f"'{line}' answered @OK {reply}")
+    except GatewayError as e:
+        check(e.reply.get('error') == error and e.reply.get('key') == key, f"'{line}': {e.reply}")
+
+
+def raw_reply(gw, data):
+    """Write bytes as they are and return the next @OK/@ERR line, skipping everything else"""
+    gw.ser.write(data)
+    deadline = time.time() + gw.timeout
+    while time.time() < deadline:
+        text = gw.ser.readline().decode('utf-8', errors='replace').strip()
+        if text.startswith('@OK ') or text.startswith('@ERR '):
+            tag, body = text.split(' ', 1)
+            return tag, json.loads(body)
+    raise TimeoutError(f'no reply to {data!r}')
+
+
+def run(gw):
+    values = gw.get()
+    check(values['lora.frequency'] == 915.8 and values['wifi.password'] == '', f'defaults: {values}')
+    check(len(gw.command('help')['keys']) == len(values), 'help lists every key')
+
+    reply = gw.set(**{'wifi.ssid': 'Trucell Signage', 'wifi.password': 'p"w\\x', 'lora.frequency': 916.575,
+                      'lora.syncWord': '0x34', 'mqtt.country': 'au', 'repeater.nodeName': 'My Node'})
+    check(reply['saved'] is False and reply['restart'] is False and reply['version'] == 2, f'set: {reply}')
+    values = gw.get('wifi.ssid', 'wifi.password', 'lora.frequency', 'lora.syncWord', 'mqtt.topicPrefix',
+                    'mqtt.clientId')
+    check(values == {'wifi.ssid': 'Trucell Signage', 'wifi.password': '***', 'lora.frequency': 916.575,
+                     'lora.syncWord': 52, 'mqtt.topicPrefix': 'MESHCORE/AU', 'mqtt.clientId': 'My_Node'},
+          f'get after set: {values}')
+
+    reply = gw.set(**{'mqtt.interestTopics': 'raw,adverts', 'mqtt.tlsProfile': 'ecdsa',
+                      'mqtt.tlsMaxFragment': 1024, 'clock.timezoneMinutes': -300, 'mqtt.brokerMode': 'standby'})
+    check(reply['restart'] is True and reply['version'] == 3, f'set that needs a reboot: {reply}')
+    values = gw.get('mqtt.interestTopics', 'mqtt.tlsProfile', 'mqtt.tlsMaxFragment', 'clock.timezoneMinutes',
+                    'mqtt.brokerMode')
+    check(values == {'mqtt.interestTopics': 'raw,adverts', 'mqtt.tlsProfile': 'ecdsa', 'mqtt.tlsMaxFragment': 1024,
+                     'clock.timezoneMinutes': -300, 'mqtt.brokerMode': 'standby'}, f'names and topics: {values}')
+
+    # A bad pair rejects the whole set
+    expect_error(gw, 'set lora.frequency=915 lora.spreadingFactor=13', 'out of range', 'lora.spreadingFactor')
+    check(gw.get('lora.frequency')['lora.frequency'] == 916.575, 'rejected set left the running config alone')
+    expect_error(gw, 'set mqtt.topicPrefix=x', 'read-only', 'mqtt.topicPrefix')
+    expect_error(gw, 'set mqtt.interestTopics=raw,bogus', 'unknown topic class', 'mqtt.interestTopics')
+    expect_error(gw, 'set mqtt.tlsMaxFragment=1000', 'out of range', 'mqtt.tlsMaxFragment')
+    expect_error(gw, 'set wifi.ssid', 'expected key=value', 'wifi.ssid')
+    expect_error(gw, 'get nope', 'unknown key', 'nope')
+    expect_error(gw, 'frobnicate', 'unknown command', 'frobnicate')
+    expect_error(gw, 'set mqtt.server="unterminated', 'unterminated quote or too many arguments')
+
+    value = 'a\\b"c\tq'
+    gw.set(**{'wifi.ssid': value})
+    check(gw.get('wifi.ssid')['wifi.ssid'] == value, 'escapes round trip')
+
+    reply = gw.save()
+    check(reply == {'saved': True, 'version': 4}, f'save: {reply}')
+
+    # What a client would not send
+    tag, reply = raw_reply(gw, b'@set wifi.ssid=' + b'x' * 700 + b'\n')
+    check(tag == '@ERR' and reply['error'] == 'line too long', f'overlong line: {reply}')
+    tag, reply = raw_reply(gw, b's@get lora.codingRate\r\ns')
+    check(tag == '@OK' and reply == {'lora.codingRate': 5}, f'CRLF between single keys: {reply}')
+    tag, reply = raw_reply(gw, b'@get mqtt.brokerMode\n@get lora.codingRate\n')
+    check(reply == {'mqtt.brokerMode': 'standby'}, f'first of two lines in one write: {reply}')
+    tag, reply = raw_reply(gw, b'')
+    check(reply == {'lora.codingRate': 5}, f'second of two lines in one write: {reply}')
+
+    started = time.perf_counter()
+    rounds = 200
+    for i in range(rounds):
+        gw.set(**{'lora.txPower': 2 + i % 20})
+    elapsed = time.perf_counter() - started
+    check(gw.get('lora.txPower')['lora.txPower'] == 2 + (rounds - 1) % 20, 'last set applied')
+    print(f'  set round trip over the pty: {elapsed / rounds * 1000:.2f} ms')
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__)
+        return 2
+    try:
+        master, slave = pty.openpty()
+    except OSError as e:
+        print(f'skipped: no pty ({e})')
+        return SKIP
+    # Raw before the console writes anything, so its output is not echoed back as input
+    tty.setraw(slave)
+    host = subprocess.Popen([sys.argv[1]], stdin=master, stdout=master)
+    os.close(master)
+    try:
+        with GatewaySerial(os.ttyname(slave), timeout=5.0) as gw:
+            run(gw)
+    finally:
+        host.kill()
+        host.wait()
+        os.close(slave)
+    if failures:
+        print(f'serial_console_pty: {failures} of {checks} checks failed', file=sys.stderr)
+        return 1
+    print(f'serial_console_pty: {checks} checks passed')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,168 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// The slice of the Arduino core the host tests need. Time is a virtual clock the test
+// advances with hostAdvanceMs(), so TTLs and timeouts can be checked without sleeping.
+// Serial keeps what the firmware prints and reads from input the test queues.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <string>
+#include "pgmspace.h"
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+inline unsigned long& hostClockMs() {
+    static unsigned long ms = 0;
+    return ms;
+}
+
+inline void hostSetMs(unsigned long ms) { hostClockMs() = ms; }
+inline void hostAdvanceMs(unsigned long ms) { hostClockMs() += ms; }
+
+inline unsigned long millis() { return hostClockMs(); }
+inline unsigned long micros() { return hostClockMs() * 1000UL; }
+inline void delay(unsigned long ms) { hostAdvanceMs(ms); }
+inline void yield() {}
+
+#define F(s) (s)
+
+// Arduino String over std::string, with the members the firmware uses
+class String {
+public:
+    String(const char* s = "") : str(s ? s : "") {}
+    String(const std::string& s) : str(s) {}
+    String(char c) : str(1, c) {}
+    String(int v) : str(std::to_string(v)) {}
+    String(unsigned v) : str(std::to_string(v)) {}
+    String(long v) : str(std::to_string(v)) {}
+    String(unsigned long v) : str(std::to_string(v)) {}
+
+    const char* c_str() const { return str.c_str(); }
+    unsigned length() const { return (unsigned)str.size(); }
+    bool reserve(unsigned n) {
+        str.reserve(n);
+        return true;
+    }
+    char operator[](unsigned i) const { return i < str.size() ? str[i] : '\0'; }
+
+    int indexOf(char c, unsigned from = 0) const { return found(str.find(c, from)); }
+    int indexOf(const char* s, unsigned from = 0) const { return found(str.find(s, from)); }
+    String substring(unsigned from) const { return from < str.size() ? String(str.substr(from)) : String(); }
+    String substring(unsigned from, unsigned to) const {
+        if (from > to) std::swap(from, to);
+        return from < str.size() ? String(str.substr(from, to - from)) : String();
+    }
+    bool startsWith(const String& s) const { return str.compare(0, s.str.size(), s.str) == 0; }
+    bool equals(const String& s) const { return str == s.str; }
+    void trim() {
+        size_t a = str.find_first_not_of(" \t\r\n");
+        size_t b = str.find_last_not_of(" \t\r\n");
+        str = a == std::string::npos ? std::string() : str.substr(a, b - a + 1);
+    }
+    long toInt() const { return atol(str.c_str()); }
+
+    String& operator+=(const String& s) {
+        str += s.str;
+        return *this;
+    }
+    String& operator+=(const char* s) {
+        str += s;
+        return *this;
+    }
+    String& operator+=(char c) {
+        str += c;
+        return *this;
+    }
+    bool concat(const char* s) {
+        str += s;
+        return true;
+    }
+    bool concat(char c) {
+        str += c;
+        return true;
+    }
+    friend String operator+(const String& a, const String& b) { return String(a.str + b.str); }
+    friend String operator+(const String& a, const char* b) { return String(a.str + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.str); }
+    bool operator==(const String& s) const { return str == s.str; }
+    bool operator==(const char* s) const { return str == s; }
+    bool operator!=(const String& s) const { return str != s.str; }
+    bool operator!=(const char* s) const { return str != s; }
+
+private:
+    std::string str;
+
+    static int found(size_t at) { return at == std::string::npos ? -1 : (int)at; }
+};
+
+// Serial: output is kept for the test to inspect (and echoed with HOST_SERIAL_ECHO set);
+// input is whatever the test queued with feed()
+class HostSerial {
+public:
+    std::string output;
+    std::deque<uint8_t> input;
+
+    void begin(unsigned long) {}
+    void feed(const char* s) { input.insert(input.end(), s, s + strlen(s)); }
+    void feed(const uint8_t* data, size_t length) { input.insert(input.end(), data, data + length); }
+    std::string take() {
+        std::string s;
+        s.swap(output);
+        return s;
+    }
+
+    int available() { return (int)input.size(); }
+    int peek() { return input.empty() ? -1 : input.front(); }
+    int read() {
+        if (input.empty()) return -1;
+        uint8_t b = input.front();
+        input.pop_front();
+        return b;
+    }
+    int availableForWrite() { return 4096; }
+    void flush() {}
+    explicit operator bool() const { return true; }
+
+    size_t write(uint8_t b) { return write(&b, 1); }
+    size_t write(const uint8_t* data, size_t length) {
+        output.append((const char*)data, length);
+        if (getenv("HOST_SERIAL_ECHO")) fwrite(data, 1, length, stdout);
+        return length;
+    }
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& v) { return print(v) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[1024];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (n <= 0) return 0;
+        return write((const uint8_t*)buffer, std::min((size_t)n, sizeof(buffer) - 1));
+    }
+};
+
+inline HostSerial Serial;
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,120 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+// In-memory NVS behind the Preferences API. Namespaces and keys follow the ESP32 limits
+// (15 characters), writes fail in read-only mode, and every call is counted so a test can
+// see how much NVS traffic a load or save costs.
+
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+#define HOST_NVS_KEY_MAX 15
+
+struct HostNvs {
+    std::map<std::string, std::map<std::string, std::vector<uint8_t>>> namespaces;
+    uint32_t reads = 0;         // get* and getBytesLength calls
+    uint32_t writes = 0;        // put* calls that stored something
+
+    void reset() {
+        namespaces.clear();
+        reads = writes = 0;
+    }
+};
+
+inline HostNvs& hostNvs() {
+    static HostNvs nvs;
+    return nvs;
+}
+
+class Preferences {
+public:
+    Preferences() : open(false), readOnly(true) {}
+    ~Preferences() { end(); }
+
+    bool begin(const char* name, bool readOnlyMode = false) {
+        if (!name || strlen(name) > HOST_NVS_KEY_MAX) return false;
+        ns = name;
+        open = true;
+        readOnly = readOnlyMode;
+        return true;
+    }
+    void end() { open = false; }
+
+    bool clear() {
+        if (!writable()) return false;
+        hostNvs().namespaces[ns].clear();
+        return true;
+    }
+    bool remove(const char* key) { return writable() && hostNvs().namespaces[ns].erase(key) > 0; }
+    bool isKey(const char* key) { return find(key) != nullptr; }
+
+    size_t putBytes(const char* key, const void* data, size_t length) { return put(key, data, length); }
+    size_t getBytesLength(const char* key) {
+        const std::vector<uint8_t>* v = find(key);
+        return v ? v->size() : 0;
+    }
+    size_t getBytes(const char* key, void* out, size_t size) {
+        const std::vector<uint8_t>* v = find(key);
+        if (!v || v->size() > size) return 0;
+        memcpy(out, v->data(), v->size());
+        return v->size();
+    }
+
+    size_t putString(const char* key, const char* value) { return put(key, value, strlen(value) + 1) ? strlen(value) : 0; }
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    String getString(const char* key, const String& fallback = String()) {
+        const std::vector<uint8_t>* v = find(key);
+        return v && !v->empty() ? String((const char*)v->data()) : fallback;
+    }
+
+    size_t putBool(const char* key, bool value) { return putValue(key, (uint8_t)value); }
+    size_t putUChar(const char* key, uint8_t value) { return putValue(key, value); }
+    size_t putShort(const char* key, int16_t value) { return putValue(key, value); }
+    size_t putUShort(const char* key, uint16_t value) { return putValue(key, value); }
+    size_t putUInt(const char* key, uint32_t value) { return putValue(key, value); }
+    size_t putFloat(const char* key, float value) { return putValue(key, value); }
+    bool getBool(const char* key, bool fallback = false) { return getValue<uint8_t>(key, fallback) != 0; }
+    uint8_t getUChar(const char* key, uint8_t fallback = 0) { return getValue(key, fallback); }
+    int16_t getShort(const char* key, int16_t fallback = 0) { return getValue(key, fallback); }
+    uint16_t getUShort(const char* key, uint16_t fallback = 0) { return getValue(key, fallback); }
+    uint32_t getUInt(const char* key, uint32_t fallback = 0) { return getValue(key, fallback); }
+    float getFloat(const char* key, float fallback = 0.0f) { return getValue(key, fallback); }
+
+private:
+    std::string ns;
+    bool open;
+    bool readOnly;
+
+    bool writable() const { return open && !readOnly; }
+
+    const std::vector<uint8_t>* find(const char* key) {
+        hostNvs().reads++;
+        if (!open || !key) return nullptr;
+        auto n = hostNvs().namespaces.find(ns);
+        if (n == hostNvs().namespaces.end()) return nullptr;
+        auto it = n->second.find(key);
+        return it == n->second.end() ? nullptr : &it->second;
+    }
+
+    size_t put(const char* key, const void* data, size_t length) {
+        if (!writable() || !key || strlen(key) > HOST_NVS_KEY_MAX) return 0;
+        hostNvs().writes++;
+        const uint8_t* p = (const uint8_t*)data;
+        hostNvs().namespaces[ns][key].assign(p, p + length);
+        return length;
+    }
+
+    template <typename T> size_t putValue(const char* key, T value) { return put(key, &value, sizeof(value)); }
+
+    template <typename T> T getValue(const char* key, T fallback) {
+        const std::vector<uint8_t>* v = find(key);
+        if (!v || v->size() != sizeof(T)) return fallback;
+        T value;
+        memcpy(&value, v->data(), sizeof(T));
+        return value;
+    }
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,61 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+// IPAddress and a WiFi object whose name lookups come from a table the test fills in
+
+#include <map>
+#include <string>
+#include "Arduino.h"
+
+class IPAddress {
+public:
+    IPAddress() : value(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : value((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+
+    // Dotted quad only, as the ESP32 core accepts
+    bool fromString(const char* s) {
+        uint32_t parts[4];
+        int n = 0;
+        for (const char* p = s; n < 4; ++n) {
+            if (*p < '0' || *p > '9') return false;
+            uint32_t v = 0;
+            while (*p >= '0' && *p <= '9') {
+                v = v * 10 + (uint32_t)(*p++ - '0');
+                if (v > 255) return false;
+            }
+            parts[n] = v;
+            if (n < 3 && *p++ != '.') return false;
+            if (n == 3 && *p != '\0') return false;
+        }
+        *this = IPAddress((uint8_t)parts[0], (uint8_t)parts[1], (uint8_t)parts[2], (uint8_t)parts[3]);
+        return true;
+    }
+
+    uint8_t operator[](int i) const { return (uint8_t)(value >> (8 * i)); }
+    bool operator==(const IPAddress& o) const { return value == o.value; }
+    bool operator!=(const IPAddress& o) const { return value != o.value; }
+
+private:
+    uint32_t value;
+};
+
+class HostWiFi {
+public:
+    std::map<std::string, IPAddress> hosts;    // names hostByName() can resolve
+    unsigned long lookupMs = 0;                // virtual time each lookup takes
+    uint32_t lookups = 0;
+
+    int hostByName(const char* name, IPAddress& out) {
+        lookups++;
+        hostAdvanceMs(lookupMs);
+        auto it = hosts.find(name);
+        if (it == hosts.end()) return 0;
+        out = it->second;
+        return 1;
+    }
+};
+
+inline HostWiFi WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,9 @@
+#ifndef HOST_PGMSPACE_H
+#define HOST_PGMSPACE_H
+
+// Flash and RAM are one address space on the ESP32 and on the host alike
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#endif // HOST_PGMSPACE_H
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Round trip of the sniffer stream: encoded by src/sniffer.h, decoded by sniffer_capture.py.
+
+Runs sniffer_stream to write a byte stream and the frames it holds, decodes the stream with
+'sniffer_capture.py --raw --tx', and reads the pcap back: every frame in order with its
+payload, LoRaTap radio fields and wall-clock timestamp, the skipped records reported as lost,
+and the console lines between frames kept apart.
+
+Usage: python3 sniffer_capture_check.py <path to sniffer_stream>
+"""
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+REPO = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+UNIX_OFFSET_US = 1700000000000000      # STREAM_UNIX_OFFSET_US in sniffer_stream.cpp
+LINKTYPE_LORATAP = 270
+
+failures = 0
+checks = 0
+
+
+def check(ok, what):
+    global failures, checks
+    checks += 1
+    if not ok:
+        failures += 1
+        print(f'FAIL {what}', file=sys.stderr)
+
+
+def read_pcap(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, _, _, _, _, _, linktype = struct.unpack_from('<IHHiIII', data)
+    check(magic == 0xA1B2C3D4 and linktype == LINKTYPE_LORATAP, f'pcap header {magic:08x} {linktype}')
+    records = []
+    pos = 24
+    while pos < len(data):
+        seconds, micros, length, _ = struct.unpack_from('<IIII', data, pos)
+        pos += 16
+        records.append((seconds * 1000000 + micros, data[pos:pos + length]))
+        pos += length
+    return records
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__)
+        return 2
+    with tempfile.TemporaryDirectory() as work:
+        stream = os.path.join(work, 'stream.bin')
+        expect = os.path.join(work, 'expect.txt')
+        pcap = os.path.join(work, 'capture.pcap')
+        subprocess.run([sys.argv[1], stream, expect], check=True)
+        result = subprocess.run([sys.executable, os.path.join(REPO, 'sniffer_capture.py'), '--raw', stream, pcap,
+                                 '--tx'], capture_output=True, text=True, check=True)
+        with open(expect) as f:
+            lines = [line.split() for line in f]
+        records = read_pcap(pcap)
+
+    lost = int(lines.pop()[1])
+    check(len(records) == len(lines), f'{len(records)} pcap records for {len(lines)} frames')
+    for n, ((when, data), fields) in enumerate(zip(records, lines)):
+        kind, flags, uptime_us, rssi, snr_q = (int(x) for x in fields[:5])
+        payload = bytes.fromhex(fields[5]) if len(fields) > 5 else b''
+        version, _, tap_length, freq, bw_steps, sf, rssi_byte, _, _, snr, sync = \
+            struct.unpack('>BBHIBBBBBbB', data[:15])
+        ok = (version == 0 and tap_length == 15 and freq == 915800000 and bw_steps == 2 and sf == 11 and
+              sync == 0x12 and rssi_byte == max(0, rssi + 139) and snr == snr_q and data[15:] == payload and
+              when == uptime_us + UNIX_OFFSET_US)
+        check(ok, f'frame {n} (type {kind}, flags {flags}, {len(payload)} bytes)')
+
+    summary = [line for line in result.stdout.splitlines() if ' records lost in ' in line]
+    check(len(summary) == 1 and f'{lost} records lost in {lost} gaps, 0 unreadable frames' in summary[0],
+          f'summary: {summary}')
+    console = [line for line in result.stdout.splitlines() if line.startswith('  console: ')]
+    check(console and all(line == '  console: @OK {"sniffer":true}' for line in console), f'console: {console[:3]}')
+
+    if failures:
+        print(f'sniffer_capture_check: {failures} of {checks} checks failed', file=sys.stderr)
+        return 1
+    print(f'sniffer_capture_check: {checks} checks passed ({len(records)} frames)')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,71 @@
+// Writes a sniffer byte stream for sniffer_capture_check.py, as the gateway would send it in
+// '@sniff on' mode: an INFO record with the clock set, RX and TX frames whose payloads are
+// mostly zeros and 0xFF (the COBS edge cases) or long zero-free runs, some records skipped
+// as if the port was busy, and console reply lines between frames.
+//
+// Usage: sniffer_stream <stream.bin> <expect.txt>
+// expect.txt has one line per frame the capture should write to the pcap (TX included):
+//   type flags uptimeUs rssi snrQuarterDb payloadHex
+// followed by "lost <n>" for the skipped records.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sniffer.h"
+
+#define STREAM_FRAMES 2000
+#define STREAM_UNIX_OFFSET_US 1700000000000000LL
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <stream.bin> <expect.txt>\n", argv[0]);
+        return 2;
+    }
+    FILE* stream = fopen(argv[1], "wb");
+    FILE* expect = fopen(argv[2], "w");
+    if (!stream || !expect) {
+        perror("open");
+        return 1;
+    }
+
+    Sniffer sniffer;
+    uint8_t frame[SNIFFER_FRAME_MAX];
+    sniffer.start();
+    SnifferRadioInfo radio = {915800000, 250000, 11, 5, 0x12, 20, 0xDEADBEEF};
+    fwrite(frame, 1, sniffer.info(radio, 1000, STREAM_UNIX_OFFSET_US, frame), stream);
+
+    srand(1);
+    int lost = 0;
+    for (int i = 0; i < STREAM_FRAMES; ++i) {
+        uint8_t payload[SNIFFER_PAYLOAD_MAX];
+        int length = i % 7 == 0 ? SNIFFER_PAYLOAD_MAX : i % 11 == 0 ? 0 : 1 + rand() % SNIFFER_PAYLOAD_MAX;
+        for (int j = 0; j < length; ++j) {
+            int k = rand() % 4;
+            payload[j] = k == 0 ? 0 : k == 1 ? 0xFF : (uint8_t)rand();
+            if (i % 5 == 0) payload[j] = 0;
+            if (i % 13 == 0) payload[j] = (uint8_t)(1 + j % 254);
+        }
+        uint8_t type = i % 9 == 0 ? SNIFFER_TX : SNIFFER_RX;
+        uint8_t flags = i % 17 == 0 ? (type == SNIFFER_TX ? SNIFFER_FLAG_TX_FAILED : SNIFFER_FLAG_CRC_ERROR) : 0;
+        int rssi = -(rand() % 150);
+        int snrQ = rand() % 161 - 80;           // quarter-dB steps, exact in a float
+        uint64_t uptimeUs = 2000000ULL + (uint64_t)i * 1000 + (uint64_t)(rand() % 1000);
+        size_t n = sniffer.packet(type, flags, uptimeUs, rssi, snrQ / 4.0f, payload, (size_t)length, frame);
+
+        if (i % 100 == 50) {
+            sniffer.noteDropped();              // the port was busy: skipped, sequence number used
+            lost++;
+            continue;
+        }
+        fwrite(frame, 1, n, stream);
+        sniffer.noteWritten();
+        fprintf(expect, "%d %d %llu %d %d ", type, flags, (unsigned long long)uptimeUs,
+                type == SNIFFER_TX ? 0 : rssi, type == SNIFFER_TX ? 0 : snrQ);
+        for (int j = 0; j < length; ++j) fprintf(expect, "%02x", payload[j]);
+        fputs("\n", expect);
+        if (i % 250 == 0) fputs("@OK {\"sniffer\":true}\r\n", stream);
+    }
+    fprintf(expect, "lost %d\n", lost);
+    fclose(stream);
+    fclose(expect);
+    return 0;
+}
@@ -0,0 +1,231 @@
+// Bridged payload decoding (src/bridge_decoder.h): the fields MQTTHandler reads, echo
+// rejection, hex and string decoding, and a deterministic fuzz pass over mutated payloads.
+// Build with -DHOST_TESTS_SANITIZE=ON to run the fuzz pass under ASan/UBSan.
+
+#include <stdlib.h>
+#include <string>
+#include "test_support.h"
+#include "bridge_payloads.h"
+#include "bridge_decoder.h"
+
+#define FUZZ_ITERATIONS 200000
+
+static bool spanIs(const JsonSpan& s, const char* text) {
+    return s.p && s.len == strlen(text) && memcmp(s.p, text, s.len) == 0;
+}
+
+static void testRaw() {
+    uint8_t frame[200];
+    for (size_t i = 0; i < sizeof(frame); ++i) frame[i] = (uint8_t)i;
+    std::string js = rawPayload("GW-ABC", frame, sizeof(frame));
+    BridgeFields f;
+    CHECK_EQ(bridgeScan(js.data(), js.size(), "GW-XYZ", f), BRIDGE_OK);
+    CHECK(spanIs(f[BF_GATEWAY], "GW-ABC"));
+    uint8_t out[BRIDGE_FRAME_MAX];
+    CHECK_EQ(bridgeHexDecode(f[BF_DATA], out, sizeof(out)), sizeof(frame));
+    CHECK(memcmp(out, frame, sizeof(frame)) == 0);
+    CHECK(!f.has(BF_MESSAGE));
+
+    // Our own echo is rejected, whether or not the gateway key comes first
+    CHECK_EQ(bridgeScan(js.data(), js.size(), "GW-ABC", f), BRIDGE_SELF);
+    std::string first = "{\"gateway\":\"GW-ABC\",\"data\":\"zz\"";    // rest never looked at
+    CHECK_EQ(bridgeScan(first.data(), first.size(), "GW-ABC", f), BRIDGE_SELF);
+    // A prefix of our id is someone else
+    CHECK_EQ(bridgeScan(js.data(), js.size(), "GW-AB", f), BRIDGE_OK);
+    CHECK_EQ(bridgeScan(js.data(), js.size(), nullptr, f), BRIDGE_OK);
+
+    // Frames the radio cannot send, odd lengths and non-hex digits
+    CHECK_EQ(bridgeScan(js.data(), js.size(), "x", f), BRIDGE_OK);
+    CHECK_EQ(bridgeHexDecode(f[BF_DATA], out, 100), -1);
+    const char* bad[] = { "{\"data\":\"ABC\"}", "{\"data\":\"0G\"}", "{\"data\":\"\"}", "{\"data\":12}" };
+    for (const char* b : bad) {
+        CHECK_EQ(bridgeScan(b, strlen(b), "x", f), BRIDGE_OK);
+        CHECK_EQ(bridgeHexDecode(f[BF_DATA], out, sizeof(out)), -1);
+    }
+    const char* lower = "{\"data\":\"a0fF\"}";
+    CHECK_EQ(bridgeScan(lower, strlen(lower), "x", f), BRIDGE_OK);
+    CHECK_EQ(bridgeHexDecode(f[BF_DATA], out, sizeof(out)), 2);
+    CHECK_EQ(out[0], 0xA0);
+    CHECK_EQ(out[1], 0xFF);
+}
+
+static void testMessage() {
+    std::string text = "hi \"there\" \\ tab\t nl\n caf\xC3\xA9 \xF0\x9F\x98\x80";
+    std::string js = messagePayload("GW-2", text);
+    BridgeFields f;
+    CHECK_EQ(bridgeScan(js.data(), js.size(), "GW-1", f), BRIDGE_OK);
+    char out[128];
+    int n = bridgeUnescape(f[BF_MESSAGE], out, sizeof(out));
+    CHECK_EQ(n, text.size());
+    CHECK(n >= 0 && memcmp(out, text.data(), text.size()) == 0);
+    CHECK(spanIs(f[BF_GATEWAY], "GW-2"));
+
+    // \u escapes, including a surrogate pair, come out as UTF-8
+    const char* esc = "{\"message\":\"\\u00e9\\ud83d\\ude00\\u0041\\/\"}";
+    CHECK_EQ(bridgeScan(esc, strlen(esc), "x", f), BRIDGE_OK);
+    n = bridgeUnescape(f[BF_MESSAGE], out, sizeof(out));
+    CHECK_EQ(n, 8);
+    CHECK(n == 8 && memcmp(out, "\xC3\xA9\xF0\x9F\x98\x80" "A/", 8) == 0);
+
+    // Too small an output, a dangling backslash and an unknown escape
+    CHECK_EQ(bridgeUnescape(f[BF_MESSAGE], out, 5), -1);
+    const char* bad[] = { "{\"message\":\"\\u12\"}", "{\"message\":\"\\q\"}" };
+    for (const char* b : bad) {
+        CHECK_EQ(bridgeScan(b, strlen(b), "x", f), BRIDGE_OK);
+        CHECK_EQ(bridgeUnescape(f[BF_MESSAGE], out, sizeof(out)), -1);
+    }
+}
+
+static void testAdvert() {
+    std::string js = advertPayload("GW-2", 305419896, "Summit \"North\"");
+    BridgeFields f;
+    CHECK_EQ(bridgeScan(js.data(), js.size(), "GW-1", f), BRIDGE_OK);
+    uint32_t nodeId = 0;
+    CHECK(bridgeParseU32(f[BF_NODE_ID], nodeId));
+    CHECK_EQ(nodeId, 305419896);
+    double lat = 0, lon = 0;
+    CHECK(bridgeParseDouble(f[BF_LAT], lat));
+    CHECK(bridgeParseDouble(f[BF_LON], lon));
+    CHECK(lat < -33.8687 && lat > -33.8689);
+    CHECK(lon > 151.2092 && lon < 151.2094);
+    char name[32];
+    int n = bridgeUnescape(f[BF_NAME], name, sizeof(name));
+    CHECK_EQ(n, 14);
+    CHECK(n == 14 && memcmp(name, "Summit \"North\"", 14) == 0);
+
+    // Numbers must be numbers, strings are not parsed as numbers
+    const char* quoted = "{\"nodeId\":\"12\",\"lat\":1e999x}";
+    CHECK_EQ(bridgeScan(quoted, strlen(quoted), "x", f), BRIDGE_OK);
+    CHECK(!bridgeParseU32(f[BF_NODE_ID], nodeId));
+    CHECK(!bridgeParseDouble(f[BF_LAT], lat));
+}
+
+static void testStructure() {
+    BridgeFields f;
+    // Whitespace, nested values skipped (with brackets inside strings), first key wins
+    const char* nested = " { \"extra\" : { \"a\" : [1, {\"b\":\"}]\"}] } ,\n\"data\":\"0102\", \"data\":\"FF\" } ";
+    CHECK_EQ(bridgeScan(nested, strlen(nested), "x", f), BRIDGE_OK);
+    CHECK(spanIs(f[BF_DATA], "0102"));
+    CHECK(!f.has(BF_GATEWAY));
+    CHECK_EQ(bridgeScan("{}", 2, "x", f), BRIDGE_OK);
+
+    const char* malformed[] = { "", "[]", "{", "{\"data\"}", "{\"data\":}", "{\"data\":\"01\"", "{\"data\":\"01\",}",
+                                "{\"data\":\"01\" \"x\":1}", "{data:1}", "{\"a\":\"unterminated}" };
+    for (const char* m : malformed) CHECK_EQ(bridgeScan(m, strlen(m), "x", f), BRIDGE_MALFORMED);
+
+    // Nesting beyond the skip limit is refused rather than recursed into
+    std::string deep = "{\"a\":" + std::string(40, '[') + std::string(40, ']') + "}";
+    CHECK_EQ(bridgeScan(deep.data(), deep.size(), "x", f), BRIDGE_MALFORMED);
+}
+
+// Spans must stay inside the scanned buffer whatever the input
+static bool spansInside(const BridgeFields& f, const char* buf, size_t len) {
+    for (size_t i = 0; i < BF_COUNT; ++i) {
+        const JsonSpan& s = f.f[i];
+        if (!s.p) continue;
+        if (s.p < buf || s.p + s.len > buf + len) return false;
+    }
+    return true;
+}
+
+// Random well-formed payloads decode back to what was encoded
+static void testRoundTrip(TestRng& rng) {
+    for (int i = 0; i < 2000; ++i) {
+        uint8_t frame[BRIDGE_FRAME_MAX];
+        size_t length = 1 + rng.below(BRIDGE_FRAME_MAX);
+        for (size_t k = 0; k < length; ++k) frame[k] = (uint8_t)rng.next();
+        std::string text;
+        size_t textLen = rng.below(160);
+        for (size_t k = 0; k < textLen; ++k) text += (char)(1 + rng.below(127));
+        std::string js = (i & 1) ? rawPayload("GW-R", frame, length) : messagePayload("GW-R", text);
+
+        char* buf = (char*)malloc(js.size());
+        memcpy(buf, js.data(), js.size());
+        BridgeFields f;
+        CHECK_EQ(bridgeScan(buf, js.size(), "GW-ME", f), BRIDGE_OK);
+        if (i & 1) {
+            uint8_t out[BRIDGE_FRAME_MAX];
+            CHECK_EQ(bridgeHexDecode(f[BF_DATA], out, sizeof(out)), length);
+            CHECK(memcmp(out, frame, length) == 0);
+        } else {
+            char out[256];
+            int n = bridgeUnescape(f[BF_MESSAGE], out, sizeof(out));
+            CHECK_EQ(n, text.size());
+            CHECK(n >= 0 && memcmp(out, text.data(), text.size()) == 0);
+        }
+        free(buf);
+    }
+}
+
+// Byte flips, deletions, insertions and truncation of realistic payloads. Each input gets an
+// exactly sized heap copy so an over-read shows up under ASan.
+static void testFuzz(TestRng& rng) {
+    uint8_t frame[184];
+    for (size_t i = 0; i < sizeof(frame); ++i) frame[i] = (uint8_t)(i * 7);
+    const std::string seeds[] = {
+        rawPayload("GW-ABC", frame, sizeof(frame)),
+        messagePayload("GW-ABC", "Meet at \"the hut\" \\ 10:30\n\xC3\xA9"),
+        advertPayload("GW-ABC", 0xDEADBEEF, "Repeater\tHill"),
+        "{\"message\":\"\\ud83d\\ude00\\u00e9\",\"x\":[{\"y\":\"]}\"}],\"gateway\":\"GW-ABC\"}",
+    };
+    const char tokens[] = "{}[]\",:\\u0 ";
+    size_t ok = 0, self = 0, malformed = 0;
+    for (int it = 0; it < FUZZ_ITERATIONS; ++it) {
+        std::string s = seeds[rng.below(4)];
+        uint32_t edits = 1 + rng.below(8);
+        for (uint32_t e = 0; e < edits && !s.empty(); ++e) {
+            size_t pos = rng.below((uint32_t)s.size());
+            switch (rng.below(4)) {
+                case 0: s[pos] = (char)rng.next(); break;
+                case 1: s.erase(pos, 1); break;
+                case 2: s.insert(pos, 1, tokens[rng.below(sizeof(tokens) - 1)]); break;
+                case 3: s.resize(pos); break;
+            }
+        }
+        char* buf = (char*)malloc(s.size() ? s.size() : 1);
+        memcpy(buf, s.data(), s.size());
+        BridgeFields f;
+        BridgeScanResult r = bridgeScan(buf, s.size(), "GW-ABC", f);
+        if (r == BRIDGE_OK) {
+            ok++;
+            if (!spansInside(f, buf, s.size())) {
+                CHECK(false);
+                fprintf(stderr, "  span outside input at iteration %d: %s\n", it, s.c_str());
+            }
+            uint8_t out[BRIDGE_FRAME_MAX];
+            char text[256];
+            uint32_t u;
+            double d;
+            bridgeHexDecode(f[BF_DATA], out, sizeof(out));
+            bridgeUnescape(f[BF_MESSAGE], text, sizeof(text));
+            bridgeUnescape(f[BF_NAME], text, 8);
+            bridgeUnescape(f[BF_GATEWAY], text, sizeof(text));
+            bridgeParseU32(f[BF_NODE_ID], u);
+            bridgeParseDouble(f[BF_LAT], d);
+            bridgeParseDouble(f[BF_LON], d);
+        } else if (r == BRIDGE_SELF) {
+            self++;
+        } else {
+            malformed++;
+        }
+        free(buf);
+    }
+    // Every outcome must actually be exercised
+    CHECK(ok > 0);
+    CHECK(self > 0);
+    CHECK(malformed > 0);
+    printf("fuzz: %d inputs, %zu ok, %zu self, %zu malformed\n", FUZZ_ITERATIONS, ok, self, malformed);
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = argc > 1 ? strtoull(argv[1], nullptr, 0) : 0x6D657368;
+    printf("seed 0x%llx\n", (unsigned long long)seed);
+    TestRng rng(seed);
+    testRaw();
+    testMessage();
+    testAdvert();
+    testStructure();
+    testRoundTrip(rng);
+    testFuzz(rng);
+    return testResult("test_bridge_decoder");
+}
@@ -0,0 +1,238 @@
+// Bridging election (src/bridge_election.h) with several gateways on a simulated broker:
+// virtual time, a per-message delivery delay and optional loss of claims. Each frame bridged
+// from MQTT should go on air once, from the best-ranked live gateway, with the next in line
+// covering for a dead winner or a lost claim.
+
+#include <deque>
+#include <memory>
+#include "test_support.h"
+#include "bridge_payloads.h"
+#include "election_gateway.h"
+
+#define SIM_FALLBACK_MS 300
+#define SIM_LATENCY_MS 40
+#define SIM_STEP_MS 5
+// Frames a gateway holds for its holdoff sit in that source's FIFO, so the last in line can
+// hold BRIDGE_QUEUE_PER_SOURCE frames per 3 * SIM_FALLBACK_MS; the per-source rate limit
+// keeps real traffic well below that
+#define SIM_FRAME_SPACING_MS 400
+
+// In-process broker: every publish reaches every gateway (the publisher included, which
+// filters it as an echo) after SIM_LATENCY_MS plus a little per-gateway skew
+class SimBroker {
+public:
+    std::vector<std::unique_ptr<ElectionGateway>> gateways;
+    AirLog air;
+    unsigned long now = 1000;
+    const char* dropClaimsFrom = nullptr;   // lose every claim this gateway publishes
+
+    ElectionGateway& add(const char* id, float snr) {
+        std::string self = id;
+        gateways.emplace_back(new ElectionGateway(id, snr, SIM_FALLBACK_MS, air,
+            [this, self](const char* topic, const std::string& payload) {
+                if (dropClaimsFrom && self == dropClaimsFrom && strstr(topic, "/claim")) return;
+                post(topic, payload);
+            }));
+        return *gateways.back();
+    }
+
+    void post(const char* topic, const std::string& payload) {
+        for (size_t i = 0; i < gateways.size(); ++i) {
+            queue.push_back({ now + SIM_LATENCY_MS + (unsigned long)i * 3, i, topic, payload });
+        }
+    }
+
+    void run(unsigned long ms) {
+        for (unsigned long end = now + ms; now < end; now += SIM_STEP_MS) {
+            for (auto it = queue.begin(); it != queue.end();) {
+                if ((long)(now - it->at) < 0) {
+                    ++it;
+                    continue;
+                }
+                gateways[it->to]->onMessage(it->topic.c_str(), it->payload.data(), it->payload.size(), now);
+                it = queue.erase(it);
+            }
+            for (auto& g : gateways) g->service(now);
+        }
+    }
+
+    // A frame some other gateway heard on RF and published to {prefix}/raw
+    uint32_t inject(uint32_t n) {
+        uint8_t frame[24];
+        for (size_t i = 0; i < sizeof(frame); ++i) frame[i] = (uint8_t)(n * 31 + i);
+        post(SIM_PREFIX "/raw", rawPayload("GW-ORIGIN", frame, sizeof(frame)));
+        return BridgeElection::frameKey(frame, sizeof(frame));
+    }
+
+private:
+    struct Pending {
+        unsigned long at;
+        size_t to;
+        std::string topic;
+        std::string payload;
+    };
+    std::deque<Pending> queue;
+};
+
+// Ranking, ties, expiry of peers and claims, and a full peer table
+static void testRanking() {
+    BridgeElection a, b, c;
+    a.setSelf("gwA");
+    b.setSelf("gwB");
+    c.setSelf("gwC");
+    a.noteRfSample(5);
+    b.noteRfSample(-3);
+    c.noteRfSample(5);
+    CHECK(a.rank() > b.rank());
+    CHECK_EQ(a.rank(), c.rank());
+
+    unsigned long t = 1000;
+    BridgeElection* all[] = { &a, &b, &c };
+    const char* ids[] = { "gwA", "gwB", "gwC" };
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            if (i != j) all[i]->notePeer(ids[j], 3, all[j]->rank(), t);
+        }
+    }
+    // Equal ranks are settled by the smaller id
+    CHECK_EQ(a.position(t), 0);
+    CHECK_EQ(c.position(t), 1);
+    CHECK_EQ(b.position(t), 2);
+    CHECK_EQ(b.holdoffMs(t, 1500), 3000);
+    CHECK_EQ(b.getStats(t).peers, 2);
+
+    // Peers that stop announcing drop out, and so does their place ahead of us
+    CHECK_EQ(b.position(t + ELECTION_PEER_TTL_MS - 1), 2);
+    CHECK_EQ(b.position(t + ELECTION_PEER_TTL_MS), 0);
+
+    CHECK(!a.isClaimed(42, t));
+    a.noteClaim(42, t);
+    CHECK(a.isClaimed(42, t + 10));
+    CHECK(!a.isClaimed(42, t + ELECTION_CLAIM_TTL_MS));
+    // The claim ring keeps the latest ELECTION_CLAIM_SLOTS keys
+    for (uint32_t k = 1; k <= ELECTION_CLAIM_SLOTS; ++k) a.noteClaim(1000 + k, t + k);
+    CHECK(!a.isClaimed(42, t + 100));
+    CHECK(a.isClaimed(1001, t + 100));
+
+    // More peers than table entries: the stalest are replaced, the table never overflows
+    for (int i = 0; i < 20; ++i) {
+        char id[8];
+        snprintf(id, sizeof(id), "p%d", i);
+        a.notePeer(id, strlen(id), 1, t + 1000 + i);
+    }
+    CHECK_EQ(a.getStats(t + 1100).peers, ELECTION_MAX_PEERS);
+    CHECK_EQ(a.position(t + 1100), 0);
+
+    // Overlong ids are cut to the table width rather than overrunning it
+    char longId[64];
+    memset(longId, 'z', sizeof(longId));
+    a.notePeer(longId, sizeof(longId), 65535, t + 2000);
+    CHECK_EQ(a.position(t + 2000), 1);
+}
+
+static void build(SimBroker& sim) {
+    sim.add("GW-BEST", 8.0f);
+    sim.add("GW-SECOND", 2.0f);
+    sim.add("GW-THIRD", -5.0f);
+    sim.add("GW-FOURTH", -12.0f);
+    sim.run(1000);    // rank announcements go round
+}
+
+static std::vector<uint32_t> injectFrames(SimBroker& sim, uint32_t first, uint32_t count) {
+    std::vector<uint32_t> keys;
+    for (uint32_t n = first; n < first + count; ++n) {
+        keys.push_back(sim.inject(n));
+        sim.run(SIM_FRAME_SPACING_MS);
+    }
+    sim.run(4 * SIM_FALLBACK_MS + 500);
+    return keys;
+}
+
+// All four alive: the best transmits every frame straight away, the rest stand down
+static void testAllAlive() {
+    SimBroker sim;
+    build(sim);
+    for (auto& g : sim.gateways) CHECK_EQ(g->stats(sim.now).peers, 3);
+    CHECK_EQ(sim.gateways[3]->stats(sim.now).position, 3);
+
+    std::vector<uint32_t> keys = injectFrames(sim, 0, 50);
+    for (uint32_t key : keys) {
+        CHECK_EQ(sim.air.count(key), 1);
+        if (sim.air.count(key) == 1) {
+            CHECK_STR(sim.air.byKey[key][0].gateway.c_str(), "GW-BEST");
+            CHECK(!sim.air.byKey[key][0].fallback);
+        }
+    }
+    CHECK_EQ(sim.gateways[0]->stats(sim.now).transmitted, 50);
+    for (size_t i = 1; i < 4; ++i) {
+        CHECK_EQ(sim.gateways[i]->stats(sim.now).transmitted, 0);
+        CHECK_EQ(sim.gateways[i]->stats(sim.now).suppressed, 50);
+        CHECK_EQ(sim.gateways[i]->queued(), 0);
+    }
+}
+
+// The best gateway dies: the second covers after one fallback interval, still once per frame.
+// Once the dead gateway's rank has expired the second transmits without waiting.
+static void testWinnerDies() {
+    SimBroker sim;
+    build(sim);
+    sim.gateways[0]->kill();
+    std::vector<uint32_t> keys = injectFrames(sim, 100, 20);
+    for (uint32_t key : keys) {
+        CHECK_EQ(sim.air.count(key), 1);
+        if (sim.air.count(key) == 1) {
+            CHECK_STR(sim.air.byKey[key][0].gateway.c_str(), "GW-SECOND");
+            CHECK(sim.air.byKey[key][0].fallback);
+        }
+    }
+    CHECK_EQ(sim.gateways[1]->stats(sim.now).fallbacks, 20);
+
+    sim.run(ELECTION_PEER_TTL_MS);
+    CHECK_EQ(sim.gateways[1]->stats(sim.now).position, 0);
+    CHECK_EQ(sim.gateways[1]->stats(sim.now).peers, 2);
+    keys = injectFrames(sim, 200, 10);
+    for (uint32_t key : keys) {
+        CHECK_EQ(sim.air.count(key), 1);
+        if (sim.air.count(key) == 1) {
+            CHECK_STR(sim.air.byKey[key][0].gateway.c_str(), "GW-SECOND");
+            CHECK(!sim.air.byKey[key][0].fallback);
+        }
+    }
+}
+
+// The winner's claims never arrive: the next in line sends a second copy, and its claim
+// keeps the two behind it quiet
+static void testLostClaims() {
+    SimBroker sim;
+    build(sim);
+    sim.dropClaimsFrom = "GW-BEST";
+    std::vector<uint32_t> keys = injectFrames(sim, 300, 20);
+    for (uint32_t key : keys) CHECK_EQ(sim.air.count(key), 2);
+    CHECK_EQ(sim.gateways[2]->stats(sim.now).transmitted, 0);
+    CHECK_EQ(sim.gateways[3]->stats(sim.now).transmitted, 0);
+}
+
+// The same frame arriving again after it went on air (republished by another region, say)
+// is dropped on admission by every gateway, the winner included
+static void testRepeatedFrame() {
+    SimBroker sim;
+    build(sim);
+    uint32_t key = sim.inject(400);
+    sim.run(200);
+    CHECK_EQ(sim.air.count(key), 1);
+    sim.inject(400);
+    sim.run(4 * SIM_FALLBACK_MS);
+    CHECK_EQ(sim.air.count(key), 1);
+    CHECK_EQ(sim.gateways[0]->stats(sim.now).suppressed, 1);
+    CHECK_EQ(sim.gateways[1]->stats(sim.now).suppressed, 2);
+    for (auto& g : sim.gateways) CHECK_EQ(g->queued(), 0);
+}
+
+int main() {
+    testRanking();
+    testAllAlive();
+    testWinnerDies();
+    testLostClaims();
+    testRepeatedFrame();
+    return testResult("test_bridge_election");
+}
@@ -0,0 +1,136 @@
+// Bridging election across three gateways that talk through a real broker, in real time:
+// every bridged frame goes on air once, from the best gateway, and from the next in line
+// after the best one disconnects. Skipped when no broker is reachable.
+
+#include <chrono>
+#include <memory>
+#include <unistd.h>
+#include "test_support.h"
+#include "broker_session.h"
+#include "bridge_payloads.h"
+#include "election_gateway.h"
+
+#define BROKER_FALLBACK_MS 300
+#define BROKER_FRAME_SPACING_MS 400
+
+static unsigned long nowMs() {
+    static auto start = std::chrono::steady_clock::now();
+    return 1000 + (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+struct Node {
+    BrokerSession session;
+    std::unique_ptr<ElectionGateway> gateway;
+};
+
+static bool connectSession(BrokerSession& s, const char* clientId) {
+    if (!s.open()) return false;
+    MqttConnectOptions o;
+    memset(&o, 0, sizeof(o));
+    o.clientId = clientId;
+    o.cleanSession = true;
+    o.keepAliveSec = 30;
+    MqttConnack ack = {};
+    return s.connect(o, ack);
+}
+
+static void publish(BrokerSession& s, const char* topic, const std::string& payload) {
+    uint8_t pkt[1024];
+    s.send(pkt, mqttEncodePublish(pkt, sizeof(pkt), topic, strlen(topic), (const uint8_t*)payload.data(),
+                                  payload.size(), 0, false, 0, false));
+}
+
+// Drain every session and run each gateway's loop until ms have passed
+static void run(Node* nodes, size_t count, unsigned long ms) {
+    unsigned long end = nowMs() + ms;
+    while ((long)(nowMs() - end) < 0) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!nodes[i].gateway->isAlive()) continue;
+            char topic[128];
+            char payload[1024];
+            MqttPublishView v;
+            while (nodes[i].session.takePublish(topic, sizeof(topic), payload, sizeof(payload), v, 0)) {
+                nodes[i].gateway->onMessage(topic, payload, v.payloadLen, nowMs());
+            }
+            nodes[i].gateway->service(nowMs());
+        }
+        usleep(2000);
+    }
+}
+
+static std::vector<uint32_t> injectFrames(BrokerSession& origin, const std::string& rawTopic, Node* nodes,
+                                          size_t count, uint32_t first, uint32_t frames) {
+    std::vector<uint32_t> keys;
+    for (uint32_t n = first; n < first + frames; ++n) {
+        uint8_t frame[24];
+        for (size_t i = 0; i < sizeof(frame); ++i) frame[i] = (uint8_t)(n * 31 + i);
+        publish(origin, rawTopic.c_str(), rawPayload("GW-ORIGIN", frame, sizeof(frame)));
+        keys.push_back(BridgeElection::frameKey(frame, sizeof(frame)));
+        run(nodes, count, BROKER_FRAME_SPACING_MS);
+    }
+    run(nodes, count, 3 * BROKER_FALLBACK_MS + 500);
+    return keys;
+}
+
+int main() {
+    int pid = (int)getpid();
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "meshcore-test/%d", pid);
+    std::string rawTopic = std::string(prefix) + "/raw";
+    std::string electTopic = std::string(prefix) + "/bridge/+";
+
+    BrokerSession origin;
+    char id[48];
+    snprintf(id, sizeof(id), "origin-test-%d", pid);
+    if (!connectSession(origin, id)) {
+        BrokerAddress a = testBroker();
+        printf("test_bridge_election_broker: no broker on %s:%s, skipped\n", a.host, a.port);
+        return TEST_SKIP;
+    }
+
+    AirLog air;
+    const char* names[] = { "GW-BEST", "GW-SECOND", "GW-THIRD" };
+    const float snr[] = { 8.0f, 2.0f, -5.0f };
+    Node nodes[3];
+    for (size_t i = 0; i < 3; ++i) {
+        snprintf(id, sizeof(id), "%s-%d", names[i], pid);
+        CHECK(connectSession(nodes[i].session, id));
+        BrokerSession* s = &nodes[i].session;
+        nodes[i].gateway.reset(new ElectionGateway(names[i], snr[i], BROKER_FALLBACK_MS, air,
+            [s](const char* topic, const std::string& payload) { publish(*s, topic, payload); }, prefix));
+        uint8_t pkt[256];
+        const char* topics[] = { rawTopic.c_str(), electTopic.c_str() };
+        const uint8_t options[] = { 0, 0 };
+        CHECK(s->send(pkt, mqttEncodeSubscribe(pkt, sizeof(pkt), 1, topics, options, 2)));
+        CHECK(s->next(MQTT_PKT_SUBACK));
+    }
+    if (testFailures()) return testResult("test_bridge_election_broker");
+
+    run(nodes, 3, 1000);    // rank announcements go round
+    for (Node& n : nodes) CHECK_EQ(n.gateway->stats(nowMs()).peers, 2);
+
+    std::vector<uint32_t> keys = injectFrames(origin, rawTopic, nodes, 3, 0, 10);
+    for (uint32_t key : keys) {
+        CHECK_EQ(air.count(key), 1);
+        if (air.count(key) == 1) CHECK_STR(air.byKey[key][0].gateway.c_str(), "GW-BEST");
+    }
+
+    // The best gateway drops off the broker; the second covers after one fallback interval
+    nodes[0].gateway->kill();
+    nodes[0].session.close();
+    keys = injectFrames(origin, rawTopic, nodes, 3, 100, 10);
+    for (uint32_t key : keys) {
+        CHECK_EQ(air.count(key), 1);
+        if (air.count(key) == 1) {
+            CHECK_STR(air.byKey[key][0].gateway.c_str(), "GW-SECOND");
+            CHECK(air.byKey[key][0].fallback);
+        }
+    }
+    CHECK_EQ(nodes[2].gateway->stats(nowMs()).transmitted, 0);
+
+    uint8_t pkt[4];
+    for (size_t i = 1; i < 3; ++i) nodes[i].session.send(pkt, mqttEncodeDisconnect(pkt));
+    origin.send(pkt, mqttEncodeDisconnect(pkt));
+    return testResult("test_bridge_election_broker");
+}
@@ -0,0 +1,210 @@
+// Extra brokers (src/broker_failover.h as BrokerEndpoint and MQTTHandler drive it) on in-process brokers that
+// can be stopped and started: in standby mode the uplink moves to the standby on the first
+// publish after the primary drops and back when it returns, without losing or repeating
+// store-and-forward traffic; in fan-out mode every broker gets every publish and a dead one
+// only backs up its own queue.
+
+#include "test_support.h"
+#include "failover_gateway.h"
+
+#define SIM_STEP_MS 10
+#define SIM_PUBLISH_MS 100
+#define SIM_TOPIC "MESHCORE/SIM/raw"
+#define SIM_STATUS_TOPIC "MESHCORE/SIM/status"
+
+struct SimBrokerHost {
+    bool running = true;
+    std::vector<std::string> received;     // payloads in arrival order
+
+    // Index of the message numbered n, or -1
+    int find(int n) const {
+        char key[24];
+        snprintf(key, sizeof(key), "\"n\":%d}", n);
+        for (size_t i = 0; i < received.size(); ++i) {
+            if (received[i].find(key) != std::string::npos) return (int)i;
+        }
+        return -1;
+    }
+};
+
+class SimLink : public FailoverLink {
+public:
+    explicit SimLink(SimBrokerHost& host) : broker(host), up(false) {}
+
+    bool connect() override { return up = broker.running; }
+    bool connected() override { return up && broker.running; }
+    void disconnect() override {
+        up = false;
+        subscribed = false;
+    }
+    bool publish(const char* topic, const char* payload, size_t length, bool retain, uint8_t qos) override {
+        if (!connected()) return false;
+        broker.received.push_back(std::string(payload, length));
+        return true;
+    }
+
+private:
+    SimBrokerHost& broker;
+    bool up;
+};
+
+static std::string message(int n) {
+    char payload[32];
+    snprintf(payload, sizeof(payload), "{\"n\":%d}", n);
+    return payload;
+}
+
+static void run(FailoverGateway& gw, unsigned long ms) {
+    for (unsigned long end = millis() + ms; millis() < end; hostAdvanceMs(SIM_STEP_MS)) gw.loop(millis());
+}
+
+// One store-and-forward publish per SIM_PUBLISH_MS, numbered first..first+count-1
+static void publishRun(FailoverGateway& gw, int first, int count) {
+    for (int n = first; n < first + count; ++n) {
+        CHECK(gw.publishMessage(SIM_TOPIC, message(n), true));
+        run(gw, SIM_PUBLISH_MS);
+    }
+}
+
+// Each message exactly once across the brokers, and in order on each
+static void checkDelivered(const SimBrokerHost* const* brokers, size_t count, int first, int last) {
+    for (int n = first; n <= last; ++n) {
+        int copies = 0;
+        for (size_t b = 0; b < count; ++b) copies += brokers[b]->find(n) >= 0 ? 1 : 0;
+        CHECK_EQ(copies, 1);
+    }
+    for (size_t b = 0; b < count; ++b) {
+        int prev = -1;
+        for (int n = first; n <= last; ++n) {
+            int at = brokers[b]->find(n);
+            if (at < 0) continue;
+            CHECK(at > prev);
+            prev = at;
+        }
+    }
+}
+
+static void testStandbyTakeover() {
+    hostSetMs(1000);
+    SimBrokerHost a, b;
+    SimLink primary(a), second(b);
+    FailoverGateway gw(BROKER_MODE_STANDBY, primary, { &second });
+    run(gw, 100);
+    CHECK(gw.uplink() == &primary);
+    CHECK(gw.endpoint(0).isOnline());
+    CHECK(!second.subscribed);
+
+    publishRun(gw, 0, 20);
+    a.running = false;
+    // The very next publish goes to the standby, with nothing held back in the queue
+    CHECK(gw.publishMessage(SIM_TOPIC, message(20), true));
+    CHECK_EQ(b.find(20), 0);
+    CHECK_EQ(gw.outboundStats().enqueued, 0);
+    run(gw, SIM_PUBLISH_MS);
+    CHECK_EQ(gw.failoverCount(), 1);
+    CHECK(gw.standbyLink() == &second);
+    CHECK(second.subscribed);
+    publishRun(gw, 21, 19);
+
+    // The primary returns: the uplink and the subscriptions move back
+    a.running = true;
+    run(gw, 2 * ENDPOINT_BACKOFF_BASE_MS);
+    CHECK(gw.uplink() == &primary);
+    CHECK(gw.standbyLink() == nullptr);
+    CHECK(!second.subscribed);
+    CHECK(primary.subscribed);
+    publishRun(gw, 40, 20);
+
+    const SimBrokerHost* brokers[] = { &a, &b };
+    checkDelivered(brokers, 2, 0, 59);
+    CHECK_EQ(a.received.size(), 40);
+    CHECK_EQ(b.received.size(), 20);
+    CHECK_EQ(gw.outboundStats().dropped, 0);
+}
+
+// Both brokers gone: the traffic waits in the handler's queue and is replayed, paced and
+// marked, to whichever comes back first
+static void testStandbyBothDown() {
+    hostSetMs(1000);
+    SimBrokerHost a, b;
+    SimLink primary(a), second(b);
+    FailoverGateway gw(BROKER_MODE_STANDBY, primary, { &second }, 30000);
+    run(gw, 100);
+    a.running = false;
+    b.running = false;
+    publishRun(gw, 0, 10);
+    CHECK(gw.uplink() == nullptr);
+    CHECK_EQ(gw.outboundStats().depth, 10);
+
+    b.running = true;
+    run(gw, 10000);
+    CHECK(gw.uplink() == &second);
+    CHECK(second.subscribed);
+    CHECK_EQ(gw.outboundStats().depth, 0);
+    CHECK_EQ(b.received.size(), 10);
+    const SimBrokerHost* brokers[] = { &b };
+    checkDelivered(brokers, 1, 0, 9);
+    for (const std::string& p : b.received) CHECK(p.find("\"replayed\":true") != std::string::npos);
+    CHECK(a.received.empty());
+}
+
+static void testFanout() {
+    hostSetMs(1000);
+    SimBrokerHost a, b, c;
+    SimLink primary(a), second(b), third(c);
+    FailoverGateway gw(BROKER_MODE_FANOUT, primary, { &second, &third });
+    run(gw, 100);
+    publishRun(gw, 0, 10);
+    for (SimBrokerHost* h : { &a, &b, &c }) CHECK_EQ(h->received.size(), 10);
+
+    // The third broker dies: its copies back up in its own queue, up to the RAM slots, and
+    // the other two carry on as before
+    c.running = false;
+    publishRun(gw, 10, 30);
+    CHECK(gw.publishMessage(SIM_STATUS_TOPIC, "{\"status\":\"online\"}", false));
+    CHECK_EQ(a.received.size(), 41);
+    CHECK_EQ(b.received.size(), 41);
+    CHECK_EQ(c.received.size(), 10);
+    OutboundQueueStats q = gw.endpoint(1).backlogStats();
+    CHECK_EQ(q.depth, OUTBOUND_RAM_SLOTS);
+    CHECK_EQ(q.dropped, 30 - OUTBOUND_RAM_SLOTS);
+    CHECK_EQ(q.enqueued, OUTBOUND_RAM_SLOTS);    // best-effort traffic is not queued
+    CHECK_EQ(gw.outboundStats().enqueued, 0);
+
+    // Back again: the oldest queued copies are replayed, in order
+    c.running = true;
+    run(gw, 70000);
+    CHECK_EQ(gw.endpoint(1).backlogStats().depth, 0);
+    CHECK_EQ(c.received.size(), 10 + OUTBOUND_RAM_SLOTS);
+    const SimBrokerHost* brokers[] = { &c };
+    checkDelivered(brokers, 1, 0, 9 + OUTBOUND_RAM_SLOTS);
+    CHECK_EQ(gw.endpoint(1).sessionCount(), 2);
+}
+
+// Reconnect delays double from the base up to the cap and start over after a session
+static void testBackoff() {
+    EndpointBackoff b;
+    b.reset(1000);
+    CHECK(b.due(1000));
+    unsigned long now = 1000;
+    const unsigned long expect[] = { 1000, 2000, 4000, 8000, 16000, 32000, 60000, 60000 };
+    for (unsigned long delayMs : expect) {
+        b.failed(now);
+        CHECK(!b.due(now + delayMs - 1));
+        CHECK(b.due(now + delayMs));
+        now += delayMs;
+    }
+    CHECK_EQ(b.failureCount(), 8);
+    b.succeeded();
+    b.failed(now);
+    CHECK(b.due(now + ENDPOINT_BACKOFF_BASE_MS));
+    CHECK(!b.due(now + ENDPOINT_BACKOFF_BASE_MS - 1));
+}
+
+int main() {
+    testBackoff();
+    testStandbyTakeover();
+    testStandbyBothDown();
+    testFanout();
+    return testResult("test_broker_failover");
+}
@@ -0,0 +1,192 @@
+// Standby and fan-out across two real brokers (MQTT_TEST_BROKER, and MQTT_TEST_BROKER2 or
+// 127.0.0.1:1884), each watched by its own subscriber. Stopping a broker is played by cutting
+// the gateway's connection to it and refusing reconnects, which is what the gateway sees when
+// the broker goes away; failover_watch.py does the same against a device with real broker
+// restarts. Skipped when either broker is unreachable.
+
+#include <chrono>
+#include <unistd.h>
+#include "test_support.h"
+#include "broker_session.h"
+#include "failover_gateway.h"
+
+#define WATCH_MS 1500
+
+static unsigned long nowMs() {
+    static auto start = std::chrono::steady_clock::now();
+    return 1000 + (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+static bool connectSession(BrokerSession& s, const BrokerAddress& a, const char* clientId) {
+    if (!s.open(a)) return false;
+    MqttConnectOptions o;
+    memset(&o, 0, sizeof(o));
+    o.clientId = clientId;
+    o.cleanSession = true;
+    o.keepAliveSec = 30;
+    MqttConnack ack = {};
+    if (s.connect(o, ack)) return true;
+    s.close();
+    return false;
+}
+
+class BrokerLink : public FailoverLink {
+public:
+    BrokerLink(const BrokerAddress& address, const char* clientId) : addr(address), id(clientId), packetId(0) {}
+
+    bool stopped = false;   // the broker is "down": the session is cut and reconnects fail
+
+    bool connect() override { return !stopped && (session.isOpen() || connectSession(session, addr, id.c_str())); }
+    bool connected() override { return !stopped && session.isOpen(); }
+    void disconnect() override {
+        session.close();
+        subscribed = false;
+    }
+    bool publish(const char* topic, const char* payload, size_t length, bool retain, uint8_t qos) override {
+        if (!connected()) return false;
+        uint8_t pkt[1024];
+        if (++packetId == 0) packetId = 1;
+        return session.send(pkt, mqttEncodePublish(pkt, sizeof(pkt), topic, strlen(topic), (const uint8_t*)payload,
+                                                   length, qos, retain, qos ? packetId : 0, false));
+    }
+
+    void stop() {
+        stopped = true;
+        session.close();
+    }
+
+private:
+    BrokerAddress addr;
+    std::string id;
+    BrokerSession session;
+    uint16_t packetId;
+};
+
+// Everything the watcher on one broker receives on the test topic, by message number
+struct Watcher {
+    BrokerSession session;
+    std::vector<int> numbers;
+
+    bool start(const BrokerAddress& a, const char* clientId, const char* topic) {
+        if (!connectSession(session, a, clientId)) return false;
+        uint8_t pkt[256];
+        const char* topics[] = { topic };
+        const uint8_t options[] = { 1 };
+        return session.send(pkt, mqttEncodeSubscribe(pkt, sizeof(pkt), 1, topics, options, 1)) &&
+               session.next(MQTT_PKT_SUBACK);
+    }
+
+    void drain() {
+        char topic[128];
+        char payload[1024];
+        MqttPublishView v;
+        while (session.takePublish(topic, sizeof(topic), payload, sizeof(payload), v, 0)) {
+            const char* n = strstr(payload, "\"n\":");
+            if (n) numbers.push_back(atoi(n + 4));
+        }
+    }
+
+    size_t count(int n) const { return (size_t)std::count(numbers.begin(), numbers.end(), n); }
+};
+
+static void run(FailoverGateway& gw, Watcher* watchers, size_t count, unsigned long ms) {
+    unsigned long end = nowMs() + ms;
+    while ((long)(nowMs() - end) < 0) {
+        hostSetMs(nowMs());
+        gw.loop(millis());
+        for (size_t i = 0; i < count; ++i) watchers[i].drain();
+        usleep(2000);
+    }
+}
+
+static void publishRun(FailoverGateway& gw, const char* topic, Watcher* watchers, size_t count, int first, int n) {
+    for (int i = first; i < first + n; ++i) {
+        char payload[32];
+        snprintf(payload, sizeof(payload), "{\"n\":%d}", i);
+        hostSetMs(nowMs());
+        CHECK(gw.publishMessage(topic, payload, true));
+        run(gw, watchers, count, 50);
+    }
+}
+
+static void testStandby(const BrokerAddress* brokers, const char* topic, int pid) {
+    char id[48];
+    snprintf(id, sizeof(id), "standby-gw-%d", pid);
+    BrokerLink primary(brokers[0], id);
+    snprintf(id, sizeof(id), "standby-gw-%d_b2", pid);
+    BrokerLink second(brokers[1], id);
+    Watcher watchers[2];
+    for (int i = 0; i < 2; ++i) {
+        snprintf(id, sizeof(id), "standby-watch%d-%d", i, pid);
+        CHECK(watchers[i].start(brokers[i], id, topic));
+    }
+    FailoverGateway gw(BROKER_MODE_STANDBY, primary, { &second });
+    run(gw, watchers, 2, 200);
+    CHECK(gw.uplink() == &primary);
+
+    publishRun(gw, topic, watchers, 2, 0, 10);
+    primary.stop();
+    publishRun(gw, topic, watchers, 2, 10, 10);
+    CHECK_EQ(gw.failoverCount(), 1);
+    CHECK(second.subscribed);
+    primary.stopped = false;
+    run(gw, watchers, 2, 2 * ENDPOINT_BACKOFF_BASE_MS);
+    CHECK(gw.uplink() == &primary);
+    publishRun(gw, topic, watchers, 2, 20, 10);
+    run(gw, watchers, 2, WATCH_MS);
+
+    for (int n = 0; n < 30; ++n) {
+        bool onPrimary = n < 10 || n >= 20;
+        CHECK_EQ(watchers[0].count(n), onPrimary ? 1 : 0);
+        CHECK_EQ(watchers[1].count(n), onPrimary ? 0 : 1);
+    }
+}
+
+static void testFanout(const BrokerAddress* brokers, const char* topic, int pid) {
+    char id[48];
+    snprintf(id, sizeof(id), "fanout-gw-%d", pid);
+    BrokerLink primary(brokers[0], id);
+    snprintf(id, sizeof(id), "fanout-gw-%d_b2", pid);
+    BrokerLink second(brokers[1], id);
+    Watcher watchers[2];
+    for (int i = 0; i < 2; ++i) {
+        snprintf(id, sizeof(id), "fanout-watch%d-%d", i, pid);
+        CHECK(watchers[i].start(brokers[i], id, topic));
+    }
+    FailoverGateway gw(BROKER_MODE_FANOUT, primary, { &second });
+    run(gw, watchers, 2, 200);
+
+    publishRun(gw, topic, watchers, 2, 0, 5);
+    // The second broker drops out for a while: the primary is unaffected, and the copies it
+    // missed are replayed once it is back
+    second.stop();
+    publishRun(gw, topic, watchers, 2, 5, 5);
+    second.stopped = false;
+    run(gw, watchers, 2, 4 * ENDPOINT_BACKOFF_BASE_MS + WATCH_MS);
+    CHECK_EQ(gw.endpoint(0).backlogStats().depth, 0);
+
+    for (int n = 0; n < 10; ++n) {
+        CHECK_EQ(watchers[0].count(n), 1);
+        CHECK_EQ(watchers[1].count(n), 1);
+    }
+    CHECK(std::is_sorted(watchers[1].numbers.begin(), watchers[1].numbers.end()));
+}
+
+int main() {
+    BrokerAddress brokers[2] = { testBroker(), testBroker("MQTT_TEST_BROKER2", "1884") };
+    for (const BrokerAddress& a : brokers) {
+        BrokerSession probe;
+        if (!connectSession(probe, a, "failover-probe")) {
+            printf("test_broker_failover_broker: no broker on %s:%s, skipped\n", a.host, a.port);
+            return TEST_SKIP;
+        }
+    }
+    int pid = (int)getpid();
+    char topic[64];
+    snprintf(topic, sizeof(topic), "meshcore-test/%d/raw", pid);
+    testStandby(brokers, topic, pid);
+    snprintf(topic, sizeof(topic), "meshcore-test/%d/fanout", pid);
+    testFanout(brokers, topic, pid);
+    return testResult("test_broker_failover_broker");
+}
@@ -0,0 +1,85 @@
+// Broker address cache (src/broker_resolver.h): lookups are reused for BROKER_DNS_TTL_MS,
+// redone for a new host, after a failure or an invalidate(), and literal addresses never
+// reach the resolver
+
+#include "test_support.h"
+#include "broker_resolver.h"
+
+static void testCache() {
+    hostSetMs(1000);
+    WiFi.hosts["broker.example"] = IPAddress(10, 0, 0, 5);
+    WiFi.lookupMs = 40;
+    BrokerResolver dns;
+    IPAddress ip;
+    bool cached = true;
+
+    CHECK(dns.resolve("broker.example", ip, cached));
+    CHECK(!cached);
+    CHECK(ip == IPAddress(10, 0, 0, 5));
+    CHECK_EQ(WiFi.lookups, 1);
+
+    // Reconnects within the TTL skip the lookup and its latency
+    hostAdvanceMs(BROKER_DNS_TTL_MS - 100);
+    unsigned long before = millis();
+    CHECK(dns.resolve("broker.example", ip, cached));
+    CHECK(cached);
+    CHECK_EQ(millis() - before, 0);
+    CHECK_EQ(WiFi.lookups, 1);
+    CHECK_EQ(dns.cacheHits(), 1);
+
+    // Expired: looked up again, and a changed record is picked up
+    WiFi.hosts["broker.example"] = IPAddress(10, 0, 0, 6);
+    hostAdvanceMs(100);
+    CHECK(dns.resolve("broker.example", ip, cached));
+    CHECK(!cached);
+    CHECK(ip == IPAddress(10, 0, 0, 6));
+    CHECK_EQ(WiFi.lookups, 2);
+    CHECK_EQ(dns.cacheMisses(), 2);
+
+    // A failed connect invalidates the entry
+    dns.invalidate();
+    CHECK(dns.resolve("broker.example", ip, cached));
+    CHECK(!cached);
+    CHECK_EQ(WiFi.lookups, 3);
+
+    // Another host is not served from the entry for the first
+    WiFi.hosts["backup.example"] = IPAddress(10, 0, 1, 1);
+    CHECK(dns.resolve("backup.example", ip, cached));
+    CHECK(!cached);
+    CHECK(ip == IPAddress(10, 0, 1, 1));
+    CHECK(dns.resolve("broker.example", ip, cached));
+    CHECK(!cached);
+    CHECK_EQ(WiFi.lookups, 5);
+}
+
+static void testLookupFailures() {
+    hostSetMs(5000);
+    WiFi.lookups = 0;
+    WiFi.hosts.clear();
+    WiFi.hosts["broker.example"] = IPAddress(10, 0, 0, 5);
+    BrokerResolver dns;
+    IPAddress ip;
+    bool cached = false;
+    CHECK(dns.resolve("broker.example", ip, cached));
+
+    // A failed lookup drops the cached entry rather than keeping a stale answer around
+    CHECK(!dns.resolve("gone.example", ip, cached));
+    CHECK(!cached);
+    CHECK(dns.resolve("broker.example", ip, cached));
+    CHECK(!cached);
+    CHECK_EQ(WiFi.lookups, 3);
+
+    // Literal addresses bypass both the cache and the resolver
+    CHECK(dns.resolve("192.168.1.20", ip, cached));
+    CHECK(!cached);
+    CHECK(ip == IPAddress(192, 168, 1, 20));
+    CHECK_EQ(WiFi.lookups, 3);
+    CHECK(!dns.resolve("192.168.1.256", ip, cached));    // not an address, and not a known name
+    CHECK_EQ(WiFi.lookups, 4);
+}
+
+int main() {
+    testCache();
+    testLookupFailures();
+    return testResult("test_broker_resolver");
+}
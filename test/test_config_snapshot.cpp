@@ -0,0 +1,186 @@
+// Configuration snapshots (src/config_snapshot.h): versions and copies on publish, a guard that
+// keeps its snapshot alive across publishes, a nested guard on the same slot leaving the outer
+// pin alone, publishes refused once CONFIG_RETIRED_MAX replaced snapshots are pinned, and a
+// reader thread taking guards while the writer publishes (build with HOST_TESTS_SANITIZE to
+// catch a snapshot freed under a reader).
+
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include "test_support.h"
+#include "config_snapshot.h"
+
+// Each snapshot the writer publishes is self-consistent: the server name spells the port
+static void stamp(GatewayConfig& c, uint32_t n) {
+    c.mqtt.port = (uint16_t)n;
+    snprintf(c.mqtt.server, sizeof(c.mqtt.server), "broker-%u.example", (unsigned)(uint16_t)n);
+}
+
+static bool consistent(const GatewayConfig& c) {
+    char expect[sizeof(c.mqtt.server)];
+    snprintf(expect, sizeof(expect), "broker-%u.example", (unsigned)c.mqtt.port);
+    return strcmp(c.mqtt.server, expect) == 0;
+}
+
+static void testPublish() {
+    ConfigSnapshots s;
+    CHECK_EQ(s.version(), 0);
+    CHECK(s.snapshot() == nullptr);
+    CHECK(!s.update([](GatewayConfig&) {}));
+
+    GatewayConfig c;
+    memset(&c, 0, sizeof(c));
+    stamp(c, 1883);
+    CHECK(s.publish(c));
+    CHECK_EQ(s.version(), 1);
+    stamp(c, 1);                            // publish() took a copy
+    CHECK_EQ(s.config().mqtt.port, 1883);
+
+    CHECK(s.update([](GatewayConfig& next) { stamp(next, 8883); }));
+    CHECK_EQ(s.version(), 2);
+    CHECK_EQ(s.config().mqtt.port, 8883);
+    CHECK(consistent(s.config()));
+    CHECK_EQ(s.pendingReclaim(), 0);        // nobody held the first one
+}
+
+static void testGuards() {
+    GatewayConfig c;
+    memset(&c, 0, sizeof(c));
+    stamp(c, 100);
+    ConfigSnapshots s(c);
+
+    {
+        ConfigReadGuard outer(s, CONFIG_READER_LOOP);
+        CHECK(!s.enter(CONFIG_READER_LOOP));    // the slot is held
+        CHECK(s.update([](GatewayConfig& next) { stamp(next, 101); }));
+        CHECK_EQ(outer->mqtt.port, 100);
+        CHECK_EQ(s.config().mqtt.port, 101);
+        CHECK_EQ(s.pendingReclaim(), 1);
+        {
+            // Nested on the same task: sees the current snapshot, and leaving it keeps the
+            // outer pin
+            ConfigReadGuard inner(s, CONFIG_READER_LOOP);
+            CHECK_EQ(inner->mqtt.port, 101);
+        }
+        s.reclaim();
+        CHECK_EQ(s.pendingReclaim(), 1);
+        CHECK_EQ(outer->mqtt.port, 100);
+        CHECK(consistent(*outer));
+
+        // Another task's guard does not hold the snapshot the loop pinned
+        ConfigReadGuard io(s, CONFIG_READER_IO);
+        CHECK_EQ(io->mqtt.port, 101);
+    }
+    s.reclaim();
+    CHECK_EQ(s.pendingReclaim(), 0);
+
+    // A guard holds the snapshot that was current when it was taken, until it is dropped
+    {
+        ConfigReadGuard late(s, CONFIG_READER_IO);
+        CHECK(s.update([](GatewayConfig& next) { stamp(next, 102); }));
+        CHECK_EQ(s.pendingReclaim(), 1);
+    }
+    CHECK(s.update([](GatewayConfig& next) { stamp(next, 103); }));
+    CHECK_EQ(s.pendingReclaim(), 0);
+}
+
+static void testRetiredLimit() {
+    GatewayConfig c;
+    memset(&c, 0, sizeof(c));
+    stamp(c, 1);
+    ConfigSnapshots s(c);
+
+    CHECK(s.enter(CONFIG_READER_IO));           // a reader stuck on the first snapshot
+    for (uint32_t n = 2; n < 2 + CONFIG_RETIRED_MAX; ++n) {
+        CHECK(s.update([n](GatewayConfig& next) { stamp(next, n); }));
+    }
+    CHECK_EQ(s.pendingReclaim(), CONFIG_RETIRED_MAX);
+    CHECK_EQ(s.version(), 1 + CONFIG_RETIRED_MAX);
+
+    // Refused, and the current configuration stays as it was
+    CHECK(!s.update([](GatewayConfig& next) { stamp(next, 999); }));
+    CHECK(!s.publish(c));
+    CHECK_EQ(s.version(), 1 + CONFIG_RETIRED_MAX);
+    CHECK_EQ(s.config().mqtt.port, 1 + CONFIG_RETIRED_MAX);
+
+    s.leave(CONFIG_READER_IO);
+    CHECK(s.update([](GatewayConfig& next) { stamp(next, 999); }));
+    CHECK_EQ(s.pendingReclaim(), 0);
+    CHECK_EQ(s.version(), 2 + CONFIG_RETIRED_MAX);
+    CHECK_EQ(s.config().mqtt.port, 999);
+}
+
+// The I/O task's side: guards taken and dropped in a loop, each read checked against the
+// snapshot it pinned
+struct ReaderCounts {
+    uint32_t reads = 0;
+    uint32_t held = 0;          // guards the writer published past while they were held
+    uint32_t torn = 0;
+    uint32_t backwards = 0;
+};
+
+static void reader(ConfigSnapshots& s, std::atomic<bool>& stop, ReaderCounts& n) {
+    uint32_t lastVersion = 0;
+    while (!stop.load()) {
+        {
+            ConfigReadGuard g(s, CONFIG_READER_IO);
+            uint32_t version = s.version();
+            if (!consistent(*g)) n.torn++;
+            std::this_thread::yield();
+            if (!consistent(*g)) n.torn++;
+            if (s.version() != version) n.held++;
+            if (version < lastVersion) n.backwards++;
+            lastVersion = version;
+            n.reads++;
+        }
+        std::this_thread::yield();
+    }
+}
+
+static void testConcurrentReader() {
+    GatewayConfig c;
+    memset(&c, 0, sizeof(c));
+    stamp(c, 0);
+    ConfigSnapshots s(c);
+    std::atomic<bool> stop(false);
+    ReaderCounts io;
+    std::thread task(reader, std::ref(s), std::ref(stop), std::ref(io));
+
+    const uint32_t publishes = 20000;
+    uint32_t refused = 0;
+    uint32_t torn = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+    for (uint32_t n = 1; n <= publishes && std::chrono::steady_clock::now() < deadline;) {
+        {
+            // The loop task reads too, under its own slot
+            ConfigReadGuard g(s, CONFIG_READER_LOOP);
+            if (!consistent(*g)) torn++;
+        }
+        if (s.update([n](GatewayConfig& next) { stamp(next, n); })) {
+            n++;
+        } else {
+            refused++;                          // the reader still pins the retired ones
+        }
+        std::this_thread::yield();
+    }
+    stop.store(true);
+    task.join();
+    s.reclaim();
+
+    CHECK_EQ(s.version(), 1 + publishes);
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(io.torn, 0);
+    CHECK_EQ(io.backwards, 0);
+    CHECK(io.held > 0);
+    CHECK_EQ(s.pendingReclaim(), 0);
+    printf("  %u publishes, %u reads (%u held across a publish), %u publishes refused while pinned\n",
+           (unsigned)publishes, (unsigned)io.reads, (unsigned)io.held, (unsigned)refused);
+}
+
+int main() {
+    testPublish();
+    testGuards();
+    testRetiredLimit();
+    testConcurrentReader();
+    return testResult("test_config_snapshot");
+}
@@ -0,0 +1,113 @@
+// Link latency telemetry (src/latency_probe.h): LatencyWindow's nearest-rank percentiles over
+// a partly filled and a wrapped window, and LatencyProbe's schedule, timeouts counted as lost,
+// and echoes that arrive late, twice or after a reconnect being ignored.
+
+#include "test_support.h"
+#include "latency_probe.h"
+
+static void testWindow() {
+    LatencyWindow w;
+    LatencyPercentiles p = w.percentiles();
+    CHECK_EQ(p.samples, 0);
+    CHECK_EQ(p.max, 0);
+
+    w.add(42);
+    p = w.percentiles();
+    CHECK_EQ(p.samples, 1);
+    CHECK_EQ(p.p50, 42);
+    CHECK_EQ(p.p99, 42);
+    CHECK_EQ(p.max, 42);
+
+    // 1..10 in scrambled order: ranks ceil(n * pct / 100)
+    LatencyWindow ten;
+    const uint32_t order[] = { 7, 3, 10, 1, 9, 5, 2, 8, 6, 4 };
+    for (uint32_t v : order) ten.add(v);
+    p = ten.percentiles();
+    CHECK_EQ(p.samples, 10);
+    CHECK_EQ(p.p50, 5);
+    CHECK_EQ(p.p90, 9);
+    CHECK_EQ(p.p99, 10);
+    CHECK_EQ(p.max, 10);
+
+    // Past LATENCY_WINDOW samples only the most recent are held: 37..100
+    LatencyWindow full;
+    for (uint32_t v = 1; v <= 100; ++v) full.add(v);
+    p = full.percentiles();
+    CHECK_EQ(p.samples, LATENCY_WINDOW);
+    CHECK_EQ(p.p50, 68);
+    CHECK_EQ(p.p90, 94);
+    CHECK_EQ(p.p99, 100);
+    CHECK_EQ(p.max, 100);
+
+    // An old outlier leaves the window once it is overwritten
+    LatencyWindow spike;
+    spike.add(100000);
+    for (int i = 0; i < LATENCY_WINDOW - 1; ++i) spike.add(10);
+    CHECK_EQ(spike.percentiles().max, 100000);
+    spike.add(10);
+    CHECK_EQ(spike.percentiles().max, 10);
+}
+
+static void testProbe() {
+    LatencyProbe probe;
+    // The first probe goes out at once, the next one an interval after it
+    CHECK_EQ(probe.poll(1000), 1);
+    probe.noteSent(1000);
+    CHECK_EQ(probe.poll(2000), 0);
+    probe.noteEcho(1, 1120);
+    CHECK_EQ(probe.poll(1000 + LATENCY_PROBE_INTERVAL_MS - 1), 0);
+    unsigned long t = 1000 + LATENCY_PROBE_INTERVAL_MS;
+    CHECK_EQ(probe.poll(t), 2);
+    probe.noteSent(t);
+
+    // No echo: still outstanding until the timeout, then lost
+    CHECK_EQ(probe.poll(t + LATENCY_PROBE_TIMEOUT_MS - 1), 0);
+    CHECK_EQ(probe.poll(t + LATENCY_PROBE_TIMEOUT_MS), 0);
+    CHECK_EQ(probe.report().probesLost, 1);
+    // Its echo turning up afterwards is not a sample
+    probe.noteEcho(2, t + LATENCY_PROBE_TIMEOUT_MS + 5);
+    CHECK_EQ(probe.report().rttMs.samples, 1);
+
+    t += LATENCY_PROBE_INTERVAL_MS;
+    CHECK_EQ(probe.poll(t), 3);
+    probe.noteSent(t);
+    probe.noteEcho(2, t + 10);              // late echo of the previous probe
+    probe.noteEcho(3, t + 80);
+    probe.noteEcho(3, t + 90);              // delivered twice
+    LatencyReport r = probe.report();
+    CHECK_EQ(r.probesSent, 3);
+    CHECK_EQ(r.probesLost, 1);
+    CHECK_EQ(r.rttMs.samples, 2);
+    CHECK_EQ(r.rttMs.p50, 80);
+    CHECK_EQ(r.rttMs.max, 120);
+
+    // A reconnect drops the probe in flight without counting it lost
+    t += LATENCY_PROBE_INTERVAL_MS;
+    CHECK_EQ(probe.poll(t), 4);
+    probe.noteSent(t);
+    probe.reset();
+    probe.noteEcho(4, t + 50);
+    t += LATENCY_PROBE_INTERVAL_MS;
+    CHECK_EQ(probe.poll(t), 5);
+    r = probe.report();
+    CHECK_EQ(r.probesLost, 1);
+    CHECK_EQ(r.rttMs.samples, 2);
+
+    // Probe 5 was never accepted by the transport: neither sent nor lost, and the next one is
+    // due on time
+    t += LATENCY_PROBE_INTERVAL_MS;
+    CHECK_EQ(probe.poll(t), 6);
+    CHECK_EQ(probe.report().probesSent, 4);
+
+    probe.notePublish(300);
+    probe.notePublish(100);
+    r = probe.report();
+    CHECK_EQ(r.publishUs.samples, 2);
+    CHECK_EQ(r.publishUs.max, 300);
+}
+
+int main() {
+    testWindow();
+    testProbe();
+    return testResult("test_latency_probe");
+}
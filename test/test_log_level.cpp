@@ -0,0 +1,29 @@
+// Levels above LOG_LEVEL compile to nothing (src/log.h): built here with LOG_LEVEL=2 (WARN), so
+// INFO/DEBUG/TRACE calls neither evaluate their arguments nor reach the ring
+
+#define LOG_LEVEL 2
+#include "test_support.h"
+#include "log.h"
+
+static int evaluated = 0;
+
+static int expensive() {
+    return ++evaluated;
+}
+
+int main() {
+    LOG_INFO("info %d", expensive());
+    LOG_DEBUG("debug %d", expensive());
+    LOG_TRACE("trace %d", expensive());
+    CHECK_EQ(evaluated, 0);
+    CHECK_EQ(logRing().getStats().written, 0);
+
+    LOG_ERROR("error %d", expensive());
+    LOG_WARN("warn %d", expensive());
+    CHECK_EQ(evaluated, 2);
+    CHECK_EQ(logRing().getStats().written, 2);
+    CHECK_EQ(logDrain(), 2);
+    std::string out = Serial.take();
+    CHECK_STR(out.c_str(), "error 1\r\nwarn 2\r\n");
+    return testResult("test_log_level");
+}
@@ -0,0 +1,116 @@
+// MQTT 5 behaviour the gateway relies on, checked against a real broker: No-Local keeps our
+// own publishes from coming back, topic aliases are resolved for other subscribers, and an
+// expired retained message is not delivered. Skipped when no broker is reachable.
+
+#include <unistd.h>
+#include "test_support.h"
+#include "broker_session.h"
+
+static bool connectV5(BrokerSession& s, const char* clientId, uint16_t aliasMax, MqttConnack& ack) {
+    if (!s.open()) return false;
+    MqttConnectOptions o;
+    memset(&o, 0, sizeof(o));
+    o.clientId = clientId;
+    o.cleanSession = true;
+    o.keepAliveSec = 30;
+    o.protocolVersion = MQTT_PROTOCOL_V5;
+    o.topicAliasMax = aliasMax;
+    return s.connect(o, ack);
+}
+
+static void subscribe(BrokerSession& s, uint16_t packetId, const char* filter, uint8_t options) {
+    uint8_t pkt[256];
+    const char* topics[] = { filter };
+    CHECK(s.send(pkt, mqttEncodeSubscribe(pkt, sizeof(pkt), packetId, topics, &options, 1, true)));
+    CHECK(s.next(MQTT_PKT_SUBACK));
+    // Packet id, property length (0 from mosquitto), one reason code
+    size_t len = s.last().length();
+    CHECK(len >= 4);
+    if (len >= 4) CHECK_EQ(s.last().body()[len - 1], options & 0x03);
+}
+
+static void publish(BrokerSession& s, const char* topic, size_t topicLen, const char* payload,
+                    uint16_t packetId, bool retain, const MqttPublishProps& props) {
+    uint8_t pkt[512];
+    CHECK(s.send(pkt, mqttEncodePublish(pkt, sizeof(pkt), topic, topicLen, (const uint8_t*)payload,
+                                        strlen(payload), 1, retain, packetId, false, &props)));
+    CHECK(s.next(MQTT_PKT_PUBACK));
+    CHECK_EQ(mqttReadU16(s.last().body()), packetId);
+    // Reason code, when the broker includes one: 0 success, 0x10 no matching subscribers
+    if (s.last().length() > 2) CHECK(s.last().body()[2] < 0x80);
+}
+
+int main() {
+    int pid = (int)getpid();
+    char id[32];
+    char filter[64];
+    char topic[64];
+    char expiring[64];
+    snprintf(filter, sizeof(filter), "meshcore-test/%d/#", pid);
+    snprintf(topic, sizeof(topic), "meshcore-test/%d/raw", pid);
+    snprintf(expiring, sizeof(expiring), "meshcore-test/%d/expiring", pid);
+
+    // The gateway: No-Local subscription on the prefix it also publishes to
+    BrokerSession gw;
+    MqttConnack ack = {};
+    snprintf(id, sizeof(id), "gw-test-%d", pid);
+    if (!connectV5(gw, id, 10, ack)) {
+        BrokerAddress a = testBroker();
+        printf("test_mqtt5_broker: no MQTT 5 broker on %s:%s, skipped\n", a.host, a.port);
+        return TEST_SKIP;
+    }
+    subscribe(gw, 1, filter, 1 | MQTT_SUB_NO_LOCAL);
+
+    // Another gateway in the region, subscribed normally and not accepting aliases
+    BrokerSession peer;
+    MqttConnack peerAck = {};
+    snprintf(id, sizeof(id), "peer-test-%d", pid);
+    CHECK(connectV5(peer, id, 0, peerAck));
+    subscribe(peer, 1, filter, 1);
+
+    // Establish an alias if the broker allows them, then publish by alias only
+    MqttPublishProps props = { 0, 0 };
+    if (ack.topicAliasMax >= 1) props.topicAlias = 1;
+    publish(gw, topic, strlen(topic), "first", 2, false, props);
+    if (props.topicAlias) publish(gw, topic, 0, "second", 3, false, props);
+    else publish(gw, topic, strlen(topic), "second", 3, false, props);
+    props.topicAlias = 0;
+    props.expirySec = 60;
+    publish(gw, topic, strlen(topic), "third", 4, false, props);
+
+    // The peer sees all three under the full topic; the alias is ours, not forwarded
+    const char* expected[] = { "first", "second", "third" };
+    for (const char* want : expected) {
+        char gotTopic[64] = "";
+        char gotPayload[64] = "";
+        MqttPublishView v = {};
+        CHECK(peer.takePublish(gotTopic, sizeof(gotTopic), gotPayload, sizeof(gotPayload), v));
+        CHECK_STR(gotTopic, topic);
+        CHECK_STR(gotPayload, want);
+        CHECK_EQ(v.topicAlias, 0);
+        if (strcmp(want, "third") == 0) CHECK(v.expirySec > 0 && v.expirySec <= 60);
+    }
+
+    // No-Local: none of it came back to the gateway
+    char gotTopic[64];
+    char gotPayload[64];
+    MqttPublishView v = {};
+    CHECK(!gw.takePublish(gotTopic, sizeof(gotTopic), gotPayload, sizeof(gotPayload), v, 500));
+
+    // A retained message that expires before anyone subscribes is never delivered
+    props.expirySec = 1;
+    publish(gw, expiring, strlen(expiring), "stale", 5, true, props);
+    sleep(2);
+    BrokerSession late;
+    MqttConnack lateAck = {};
+    snprintf(id, sizeof(id), "late-test-%d", pid);
+    CHECK(connectV5(late, id, 0, lateAck));
+    subscribe(late, 1, expiring, 1);
+    CHECK(!late.takePublish(gotTopic, sizeof(gotTopic), gotPayload, sizeof(gotPayload), v, 500));
+
+    uint8_t pkt[4];
+    gw.send(pkt, mqttEncodeDisconnect(pkt));
+    peer.send(pkt, mqttEncodeDisconnect(pkt));
+    late.send(pkt, mqttEncodeDisconnect(pkt));
+    return testResult("test_mqtt5_broker");
+}
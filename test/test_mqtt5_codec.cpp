@@ -0,0 +1,153 @@
+// MQTT 5 additions to the codec (src/mqtt_codec.h): CONNECT and PUBLISH properties, topic
+// aliases, subscription options and CONNACK properties
+
+#include "test_support.h"
+#include "mqtt_codec.h"
+
+// Body of a complete packet, for the parsers
+static const uint8_t* bodyOf(const uint8_t* pkt, size_t n, size_t& bodyLen) {
+    uint32_t len = 0;
+    size_t h = mqttReadVarInt(pkt + 1, n - 1, len);
+    bodyLen = len;
+    return pkt + 1 + h;
+}
+
+static void testConnect() {
+    uint8_t buf[256];
+    MqttConnectOptions o;
+    memset(&o, 0, sizeof(o));
+    o.clientId = "gw";
+    o.cleanSession = true;
+    o.keepAliveSec = 60;
+    o.protocolVersion = MQTT_PROTOCOL_V5;
+    o.topicAliasMax = 10;
+    size_t n = mqttEncodeConnect(buf, sizeof(buf), o);
+    static const uint8_t alias[] = { 0x10, 0x12, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x05, 0x02, 0x00, 0x3C,
+                                     0x03, 0x22, 0x00, 0x0A, 0x00, 0x02, 'g', 'w' };
+    CHECK_BYTES(buf, n, alias);
+
+    o.sessionExpirySec = 3600;
+    n = mqttEncodeConnect(buf, sizeof(buf), o);
+    static const uint8_t expiry[] = { 0x10, 0x17, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x05, 0x02, 0x00, 0x3C,
+                                      0x08, 0x11, 0x00, 0x00, 0x0E, 0x10, 0x22, 0x00, 0x0A,
+                                      0x00, 0x02, 'g', 'w' };
+    CHECK_BYTES(buf, n, expiry);
+
+    // The will gets an empty property block in front of its topic
+    o.sessionExpirySec = 0;
+    o.topicAliasMax = 0;
+    o.willTopic = "s";
+    o.willPayload = "0";
+    n = mqttEncodeConnect(buf, sizeof(buf), o);
+    static const uint8_t will[] = { 0x10, 0x16, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x05, 0x06, 0x00, 0x3C,
+                                    0x00, 0x00, 0x02, 'g', 'w', 0x00, 0x00, 0x01, 's', 0x00, 0x01, '0' };
+    CHECK_BYTES(buf, n, will);
+}
+
+static void testPublish() {
+    uint8_t buf[128];
+    const uint8_t hi[] = { 'h', 'i' };
+    MqttPublishProps props = { 3, 120 };
+    size_t n = mqttEncodePublish(buf, sizeof(buf), "a/b", 3, hi, 2, 1, false, 7, false, &props);
+    static const uint8_t full[] = { 0x32, 0x12, 0x00, 0x03, 'a', '/', 'b', 0x00, 0x07,
+                                    0x08, 0x02, 0x00, 0x00, 0x00, 0x78, 0x23, 0x00, 0x03, 'h', 'i' };
+    CHECK_BYTES(buf, n, full);
+    CHECK_EQ(n, mqttPublishSize(3, 2, 1, &props));
+
+    size_t bodyLen = 0;
+    const uint8_t* body = bodyOf(buf, n, bodyLen);
+    MqttPublishView v = {};
+    CHECK(mqttParsePublish(buf[0] & 0x0F, body, bodyLen, v, true));
+    CHECK_EQ(v.topicAlias, 3);
+    CHECK_EQ(v.expirySec, 120);
+    CHECK_EQ(v.packetId, 7);
+    CHECK_EQ(v.payloadLen, 2);
+    CHECK(memcmp(v.payload, "hi", 2) == 0);
+
+    // Once the alias is established the topic goes out empty
+    MqttPublishProps aliasOnly = { 3, 0 };
+    n = mqttEncodePublish(buf, sizeof(buf), "a/b", 0, hi, 2, 0, false, 0, false, &aliasOnly);
+    static const uint8_t alias[] = { 0x30, 0x08, 0x00, 0x00, 0x03, 0x23, 0x00, 0x03, 'h', 'i' };
+    CHECK_BYTES(buf, n, alias);
+    body = bodyOf(buf, n, bodyLen);
+    CHECK(mqttParsePublish(buf[0] & 0x0F, body, bodyLen, v, true));
+    CHECK_EQ(v.topicLen, 0);
+    CHECK_EQ(v.topicAlias, 3);
+
+    // No properties is still an (empty) property block
+    MqttPublishProps none = { 0, 0 };
+    n = mqttEncodePublish(buf, sizeof(buf), "a/b", 3, hi, 2, 0, false, 0, false, &none);
+    static const uint8_t empty[] = { 0x30, 0x08, 0x00, 0x03, 'a', '/', 'b', 0x00, 'h', 'i' };
+    CHECK_BYTES(buf, n, empty);
+
+    // Sizes stay exact with properties across the remaining-length boundaries
+    static uint8_t payload[20000];
+    static uint8_t big[20100];
+    const size_t sizes[] = { 0, 111, 112, 113, 16367, 16368, 20000 };
+    for (size_t size : sizes) {
+        n = mqttEncodePublish(big, sizeof(big), "t/x", 3, payload, size, 1, false, 1, false, &props);
+        CHECK(n > 0);
+        CHECK_EQ(n, mqttPublishSize(3, size, 1, &props));
+    }
+
+    // A property block running past the packet, or an unknown property, is rejected
+    const uint8_t overrun[] = { 0x00, 0x01, 'x', 0x09, 0x23, 0x00, 0x01 };
+    CHECK(!mqttParsePublish(0x00, overrun, sizeof(overrun), v, true));
+    const uint8_t unknown[] = { 0x00, 0x01, 'x', 0x02, 0x7F, 0x00 };
+    CHECK(!mqttParsePublish(0x00, unknown, sizeof(unknown), v, true));
+    // String and user properties are skipped over
+    const uint8_t strings[] = { 0x00, 0x01, 'x', 0x0E, 0x03, 0x00, 0x01, 'j', 0x26, 0x00, 0x01, 'k', 0x00, 0x01, 'v',
+                                0x23, 0x00, 0x05, 'p' };
+    CHECK(mqttParsePublish(0x00, strings, sizeof(strings), v, true));
+    CHECK_EQ(v.topicAlias, 5);
+    CHECK_EQ(v.payloadLen, 1);
+}
+
+static void testSubscribe() {
+    uint8_t buf[64];
+    const char* topics[] = { "x/#", "y/+" };
+    // Reserved bits above the retain handling are masked off
+    const uint8_t options[] = { 0xC0 | MQTT_SUB_NO_LOCAL | 1, MQTT_SUB_RETAIN_AS_PUBLISHED };
+    size_t n = mqttEncodeSubscribe(buf, sizeof(buf), 9, topics, options, 2, true);
+    static const uint8_t sub[] = { 0x82, 0x0F, 0x00, 0x09, 0x00, 0x00, 0x03, 'x', '/', '#', 0x05,
+                                   0x00, 0x03, 'y', '/', '+', 0x08 };
+    CHECK_BYTES(buf, n, sub);
+}
+
+static void testConnack() {
+    // Topic alias maximum, receive maximum, maximum QoS, maximum packet size, a user property
+    // and an assigned client identifier
+    const uint8_t ack[] = { 0x00, 0x00, 0x19, 0x22, 0x00, 0x0A, 0x21, 0x00, 0x14, 0x24, 0x01,
+                            0x27, 0x00, 0x01, 0x00, 0x00, 0x26, 0x00, 0x01, 'k', 0x00, 0x01, 'v',
+                            0x12, 0x00, 0x02, 'i', 'd' };
+    MqttConnack c = {};
+    CHECK(mqttParseConnack(ack, sizeof(ack), true, c));
+    CHECK_EQ(c.topicAliasMax, 10);
+    CHECK_EQ(c.receiveMax, 20);
+    CHECK_EQ(c.maxPacketSize, 65536);
+
+    // No properties: the defaults
+    const uint8_t bare[] = { 0x01, 0x00, 0x00 };
+    CHECK(mqttParseConnack(bare, sizeof(bare), true, c));
+    CHECK(c.sessionPresent);
+    CHECK_EQ(c.topicAliasMax, 0);
+    CHECK_EQ(c.receiveMax, 65535);
+    CHECK_EQ(c.maxPacketSize, 0);
+
+    // Refused, and a property block that overruns
+    const uint8_t refused[] = { 0x00, 0x87, 0x00 };
+    CHECK(mqttParseConnack(refused, sizeof(refused), true, c));
+    CHECK_EQ(c.reasonCode, 0x87);
+    const uint8_t overrun[] = { 0x00, 0x00, 0x05, 0x22, 0x00 };
+    CHECK(!mqttParseConnack(overrun, sizeof(overrun), true, c));
+    const uint8_t cut[] = { 0x00, 0x00, 0x02, 0x22, 0x00 };
+    CHECK(!mqttParseConnack(cut, sizeof(cut), true, c));
+}
+
+int main() {
+    testConnect();
+    testPublish();
+    testSubscribe();
+    testConnack();
+    return testResult("test_mqtt5_codec");
+}
@@ -0,0 +1,65 @@
+// MQTT 3.1.1 round trip against a real broker: the packets the firmware's codec builds must
+// be accepted, and what the broker sends back must parse. Skipped when no broker is reachable.
+
+#include <unistd.h>
+#include "test_support.h"
+#include "broker_session.h"
+
+int main() {
+    BrokerSession s;
+    if (!s.open()) {
+        BrokerAddress a = testBroker();
+        printf("test_mqtt_broker: no broker on %s:%s, skipped\n", a.host, a.port);
+        return TEST_SKIP;
+    }
+
+    char clientId[32];
+    char filter[64];
+    char topic[64];
+    snprintf(clientId, sizeof(clientId), "gw-test-%d", (int)getpid());
+    snprintf(filter, sizeof(filter), "meshcore-test/%d/#", (int)getpid());
+    snprintf(topic, sizeof(topic), "meshcore-test/%d/packets", (int)getpid());
+
+    MqttConnectOptions o;
+    memset(&o, 0, sizeof(o));
+    o.clientId = clientId;
+    o.cleanSession = true;
+    o.keepAliveSec = 30;
+    o.willTopic = topic;
+    o.willPayload = "offline";
+    MqttConnack ack = {};
+    CHECK(s.connect(o, ack));
+    CHECK(!ack.sessionPresent);
+
+    uint8_t pkt[512];
+    const char* topics[] = { filter };
+    const uint8_t options[] = { 1 };
+    CHECK(s.send(pkt, mqttEncodeSubscribe(pkt, sizeof(pkt), 1, topics, options, 1)));
+    CHECK(s.next(MQTT_PKT_SUBACK));
+    CHECK_EQ(s.last().length(), 3);
+    CHECK_EQ(s.last().body()[2], 1);    // granted QoS 1
+
+    const char* payload = "{\"type\":\"ADVERT\",\"rssi\":-97}";
+    CHECK(s.send(pkt, mqttEncodePublish(pkt, sizeof(pkt), topic, strlen(topic), (const uint8_t*)payload,
+                                        strlen(payload), 1, false, 2, false)));
+    CHECK(s.next(MQTT_PKT_PUBACK));
+    CHECK_EQ(mqttReadU16(s.last().body()), 2);
+
+    // Our own message comes back through the subscription
+    char gotTopic[64];
+    char gotPayload[128];
+    MqttPublishView v = {};
+    CHECK(s.takePublish(gotTopic, sizeof(gotTopic), gotPayload, sizeof(gotPayload), v));
+    CHECK_STR(gotTopic, topic);
+    CHECK_STR(gotPayload, payload);
+    CHECK_EQ(v.qos, 1);
+
+    CHECK(s.send(pkt, mqttEncodePingreq(pkt)));
+    CHECK(s.next(MQTT_PKT_PINGRESP));
+
+    const char* unsubTopics[] = { filter };
+    CHECK(s.send(pkt, mqttEncodeUnsubscribe(pkt, sizeof(pkt), 3, unsubTopics, 1)));
+    CHECK(s.next(MQTT_PKT_UNSUBACK));
+    CHECK(s.send(pkt, mqttEncodeDisconnect(pkt)));
+    return testResult("test_mqtt_broker");
+}
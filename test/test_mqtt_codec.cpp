@@ -0,0 +1,172 @@
+// MQTT 3.1.1 encoding and parsing (src/mqtt_codec.h) against hand-assembled packets
+
+#include "test_support.h"
+#include "mqtt_codec.h"
+
+static void testConnect() {
+    uint8_t buf[256];
+    MqttConnectOptions o;
+    memset(&o, 0, sizeof(o));
+    o.clientId = "gw";
+    o.cleanSession = true;
+    o.keepAliveSec = 60;
+    size_t n = mqttEncodeConnect(buf, sizeof(buf), o);
+    static const uint8_t plain[] = { 0x10, 0x0E, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, 0x00, 0x3C,
+                                     0x00, 0x02, 'g', 'w' };
+    CHECK_BYTES(buf, n, plain);
+
+    // Will (QoS 1, retained), username and password
+    o.willTopic = "s";
+    o.willPayload = "0";
+    o.willQos = 1;
+    o.willRetain = true;
+    o.username = "u";
+    o.password = "p";
+    n = mqttEncodeConnect(buf, sizeof(buf), o);
+    static const uint8_t full[] = { 0x10, 0x1A, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0xEE, 0x00, 0x3C,
+                                    0x00, 0x02, 'g', 'w', 0x00, 0x01, 's', 0x00, 0x01, '0',
+                                    0x00, 0x01, 'u', 0x00, 0x01, 'p' };
+    CHECK_BYTES(buf, n, full);
+
+    // An empty username sends neither username nor password
+    o.username = "";
+    n = mqttEncodeConnect(buf, sizeof(buf), o);
+    CHECK_EQ(buf[9], 0x2E);
+    CHECK_EQ(n, sizeof(full) - 6);
+
+    // Too small a buffer is reported, not truncated
+    CHECK_EQ(mqttEncodeConnect(buf, 12, o), 0);
+}
+
+static void testPublish() {
+    uint8_t buf[64];
+    const uint8_t hi[] = { 'h', 'i' };
+    size_t n = mqttEncodePublish(buf, sizeof(buf), "a/b", 3, hi, 2, 0, false, 0, false);
+    static const uint8_t qos0[] = { 0x30, 0x07, 0x00, 0x03, 'a', '/', 'b', 'h', 'i' };
+    CHECK_BYTES(buf, n, qos0);
+
+    n = mqttEncodePublish(buf, sizeof(buf), "a/b", 3, hi, 2, 1, true, 7, true);
+    static const uint8_t qos1[] = { 0x3B, 0x09, 0x00, 0x03, 'a', '/', 'b', 0x00, 0x07, 'h', 'i' };
+    CHECK_BYTES(buf, n, qos1);
+
+    MqttPublishView v = {};
+    CHECK(mqttParsePublish(buf[0] & 0x0F, buf + 2, n - 2, v));
+    CHECK_EQ(v.qos, 1);
+    CHECK(v.retain);
+    CHECK_EQ(v.packetId, 7);
+    CHECK_EQ(v.topicLen, 3);
+    CHECK(memcmp(v.topic, "a/b", 3) == 0);
+    CHECK_EQ(v.payloadLen, 2);
+    CHECK(memcmp(v.payload, "hi", 2) == 0);
+
+    // Truncated bodies are rejected
+    CHECK(!mqttParsePublish(0x02, buf + 2, 1, v));
+    CHECK(!mqttParsePublish(0x02, buf + 2, 6, v));
+}
+
+// mqttPublishSize must be exact: the async transport reserves ring space with it
+static void testPublishSize() {
+    static uint8_t payload[20000];
+    static uint8_t buf[20100];
+    const size_t sizes[] = { 0, 1, 116, 117, 118, 16370, 16371, 16380, 20000 };
+    for (size_t size : sizes) {
+        for (uint8_t qos = 0; qos <= 1; ++qos) {
+            size_t n = mqttEncodePublish(buf, sizeof(buf), "t/x", 3, payload, size, qos, false, 1, false);
+            CHECK(n > 0);
+            CHECK_EQ(n, mqttPublishSize(3, size, qos));
+        }
+    }
+}
+
+static void testSubscribe() {
+    uint8_t buf[64];
+    const char* topics[] = { "x/#", "y/+" };
+    // The MQTT 5 flags are dropped in the 3.1.1 layout
+    const uint8_t options[] = { 0, 1 | MQTT_SUB_NO_LOCAL };
+    size_t n = mqttEncodeSubscribe(buf, sizeof(buf), 9, topics, options, 2);
+    static const uint8_t sub[] = { 0x82, 0x0E, 0x00, 0x09, 0x00, 0x03, 'x', '/', '#', 0x00,
+                                   0x00, 0x03, 'y', '/', '+', 0x01 };
+    CHECK_BYTES(buf, n, sub);
+
+    n = mqttEncodeUnsubscribe(buf, sizeof(buf), 10, topics, 1);
+    static const uint8_t unsub[] = { 0xA2, 0x07, 0x00, 0x0A, 0x00, 0x03, 'x', '/', '#' };
+    CHECK_BYTES(buf, n, unsub);
+
+    n = mqttEncodePuback(buf, 0x1234);
+    static const uint8_t puback[] = { 0x40, 0x02, 0x12, 0x34 };
+    CHECK_BYTES(buf, n, puback);
+    n = mqttEncodePingreq(buf);
+    static const uint8_t ping[] = { 0xC0, 0x00 };
+    CHECK_BYTES(buf, n, ping);
+    n = mqttEncodeDisconnect(buf);
+    static const uint8_t disc[] = { 0xE0, 0x00 };
+    CHECK_BYTES(buf, n, disc);
+}
+
+static void testVarInt() {
+    const uint32_t values[] = { 0, 127, 128, 16383, 16384, 2097151, 2097152, 268435455 };
+    for (uint32_t value : values) {
+        uint8_t buf[4];
+        size_t n = mqttWriteVarInt(buf, value);
+        CHECK_EQ(n, mqttVarIntSize(value));
+        uint32_t back = 0;
+        CHECK_EQ(mqttReadVarInt(buf, n, back), n);
+        CHECK_EQ(back, value);
+        // One byte short is truncated, not a different value
+        if (n > 1) CHECK_EQ(mqttReadVarInt(buf, n - 1, back), 0);
+    }
+    const uint8_t tooLong[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    uint32_t value = 0;
+    CHECK_EQ(mqttReadVarInt(tooLong, sizeof(tooLong), value), 0);
+}
+
+// Byte-at-a-time framing, as the I/O task reads the socket; an oversized packet is skipped
+// and the reader picks up the next one
+static void testFrameReader() {
+    uint8_t stream[600];
+    size_t len = 0;
+    static uint8_t big[300];
+    const uint8_t hi[] = { 'h', 'i' };
+    len += mqttEncodePublish(stream + len, sizeof(stream) - len, "a/b", 3, hi, 2, 1, false, 5, false);
+    len += mqttEncodePublish(stream + len, sizeof(stream) - len, "big", 3, big, sizeof(big), 0, false, 0, false);
+    len += mqttEncodePingreq(stream + len);
+    const uint8_t connack[] = { 0x20, 0x02, 0x01, 0x00 };
+    memcpy(stream + len, connack, sizeof(connack));
+    len += sizeof(connack);
+
+    uint8_t frame[64];
+    MqttFrameReader reader(frame, sizeof(frame));
+    uint8_t types[8];
+    size_t frames = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (!reader.feed(stream[i])) continue;
+        if (frames < 8) types[frames] = reader.type();
+        frames++;
+        if (reader.type() == MQTT_PKT_PUBLISH) {
+            MqttPublishView v = {};
+            CHECK(mqttParsePublish(reader.flags(), reader.body(), reader.length(), v));
+            CHECK_EQ(v.packetId, 5);
+            CHECK_EQ(v.payloadLen, 2);
+        } else if (reader.type() == MQTT_PKT_CONNACK) {
+            MqttConnack ack = {};
+            CHECK(mqttParseConnack(reader.body(), reader.length(), false, ack));
+            CHECK(ack.sessionPresent);
+            CHECK_EQ(ack.reasonCode, 0);
+        }
+    }
+    CHECK_EQ(frames, 3);
+    CHECK_EQ(types[0], MQTT_PKT_PUBLISH);
+    CHECK_EQ(types[1], MQTT_PKT_PINGREQ);
+    CHECK_EQ(types[2], MQTT_PKT_CONNACK);
+    CHECK_EQ(reader.oversized, 1);
+}
+
+int main() {
+    testConnect();
+    testPublish();
+    testPublishSize();
+    testSubscribe();
+    testVarInt();
+    testFrameReader();
+    return testResult("test_mqtt_codec");
+}
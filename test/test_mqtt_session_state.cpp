@@ -0,0 +1,120 @@
+// Async transport session state (src/mqtt_session_state.h): a disconnect() that lands while
+// the network task is connecting or waiting for the CONNACK is not overwritten when the task
+// moves on, so the session always ends idle, the state restartLink() waits for. Single steps
+// first, then a network task thread against a loop that disconnects at random points.
+
+#include <chrono>
+#include <thread>
+#include "test_support.h"
+#include "mqtt_session_state.h"
+
+static void testSteps() {
+    MqttSessionState s;
+    CHECK(!s.requestDisconnect());
+    CHECK_EQ(s.load(), MQTT_SESSION_IDLE);
+
+    // Disconnect before the task picked up the connect
+    CHECK(s.requestConnect());
+    CHECK(!s.requestConnect());
+    CHECK(s.requestDisconnect());
+    CHECK(!s.advance(MQTT_SESSION_REQ_CONNECT, MQTT_SESSION_CONNECTING));
+    CHECK_EQ(s.load(), MQTT_SESSION_REQ_DISCONNECT);
+    s.closed();
+
+    // During the TCP/TLS connect
+    CHECK(s.requestConnect());
+    CHECK(s.advance(MQTT_SESSION_REQ_CONNECT, MQTT_SESSION_CONNECTING));
+    CHECK(s.requestDisconnect());
+    CHECK(!s.advance(MQTT_SESSION_CONNECTING, MQTT_SESSION_WAIT_CONNACK));
+    CHECK_EQ(s.load(), MQTT_SESSION_REQ_DISCONNECT);
+    s.closed();
+
+    // While waiting for the CONNACK
+    CHECK(s.requestConnect());
+    CHECK(s.advance(MQTT_SESSION_REQ_CONNECT, MQTT_SESSION_CONNECTING));
+    CHECK(s.advance(MQTT_SESSION_CONNECTING, MQTT_SESSION_WAIT_CONNACK));
+    CHECK(s.requestDisconnect());
+    CHECK(!s.advance(MQTT_SESSION_WAIT_CONNACK, MQTT_SESSION_CONNECTED));
+    CHECK_EQ(s.load(), MQTT_SESSION_REQ_DISCONNECT);
+    CHECK(s.requestDisconnect());       // asked again: still one pending request
+    CHECK_EQ(s.load(), MQTT_SESSION_REQ_DISCONNECT);
+    s.closed();
+    CHECK_EQ(s.load(), MQTT_SESSION_IDLE);
+}
+
+// A blocking call on the task: other threads get to run meanwhile
+static void work(int n) {
+    for (int i = 0; i < n; ++i) std::this_thread::yield();
+}
+
+// The task's side, the same steps as AsyncMQTTTransport::run()/openSession()/handleFrame()
+static void networkTask(MqttSessionState& s, std::atomic<bool>& stop) {
+    uint32_t seed = 12345;
+    auto next = [&seed](int range) {
+        seed = seed * 1103515245u + 12345u;
+        return (int)((seed >> 8) % (uint32_t)range);
+    };
+    while (!stop.load()) {
+        switch (s.load()) {
+            case MQTT_SESSION_REQ_CONNECT:
+                if (!s.advance(MQTT_SESSION_REQ_CONNECT, MQTT_SESSION_CONNECTING)) break;
+                work(1 + next(20));                                     // TCP/TLS connect
+                if (s.load() != MQTT_SESSION_CONNECTING) {
+                    s.closed();
+                    break;
+                }
+                work(next(3));                                          // CONNECT written
+                s.advance(MQTT_SESSION_CONNECTING, MQTT_SESSION_WAIT_CONNACK);
+                break;
+            case MQTT_SESSION_WAIT_CONNACK:
+                work(1 + next(20));
+                s.advance(MQTT_SESSION_WAIT_CONNACK, MQTT_SESSION_CONNECTED);
+                break;
+            case MQTT_SESSION_REQ_DISCONNECT:
+                s.closed();
+                break;
+            default:
+                std::this_thread::yield();
+                break;
+        }
+    }
+}
+
+static void testConcurrentDisconnect() {
+    MqttSessionState s;
+    std::atomic<bool> stop(false);
+    std::thread task(networkTask, std::ref(s), std::ref(stop));
+
+    // Each round waits for the task to reach a given step (or pass it), then disconnects
+    const int rounds = 20000;
+    int stuck = 0;
+    uint32_t landed[MQTT_SESSION_REQ_DISCONNECT + 1] = {};
+    for (int i = 0; i < rounds && !stuck; ++i) {
+        uint8_t target = (uint8_t)(MQTT_SESSION_REQ_CONNECT + i % 4);
+        CHECK(s.requestConnect());
+        while (s.load() < target) std::this_thread::yield();
+        landed[s.load()]++;
+        s.requestDisconnect();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (s.load() != MQTT_SESSION_IDLE && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        if (s.load() != MQTT_SESSION_IDLE) stuck++;
+    }
+    stop.store(true);
+    task.join();
+    CHECK_EQ(stuck, 0);
+    // The disconnects hit every step of the handshake
+    CHECK(landed[MQTT_SESSION_CONNECTING] > 0);
+    CHECK(landed[MQTT_SESSION_WAIT_CONNACK] > 0);
+    CHECK(landed[MQTT_SESSION_CONNECTED] > 0);
+    printf("  disconnect landed in: request %u, connecting %u, connack wait %u, connected %u\n",
+           landed[MQTT_SESSION_REQ_CONNECT], landed[MQTT_SESSION_CONNECTING], landed[MQTT_SESSION_WAIT_CONNACK],
+           landed[MQTT_SESSION_CONNECTED]);
+}
+
+int main() {
+    testSteps();
+    testConcurrentDisconnect();
+    return testResult("test_mqtt_session_state");
+}
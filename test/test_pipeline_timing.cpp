@@ -0,0 +1,192 @@
+// Pipeline latency histograms (src/pipeline_timing.h): bucket boundaries around the linear
+// range and the top of the log range, the overflow bucket, percentiles within the stated
+// 12.5% of the true nearest-rank value, decay halving the counts without losing track of
+// them, and PipelineTimer's stage stamps.
+
+#include <algorithm>
+#include <vector>
+#include "test_support.h"
+#include "pipeline_timing.h"
+
+static void testBuckets() {
+    // Exact below 16 us, then 8 sub-buckets per power of two (2 us wide from 16 to 31)
+    CHECK_EQ(LatencyHistogram::bucketOf(0), 0);
+    CHECK_EQ(LatencyHistogram::bucketOf(15), 15);
+    CHECK_EQ(LatencyHistogram::bucketTop(15), 15);
+    CHECK_EQ(LatencyHistogram::bucketOf(16), 16);
+    CHECK_EQ(LatencyHistogram::bucketOf(17), 16);
+    CHECK_EQ(LatencyHistogram::bucketTop(16), 17);
+    CHECK_EQ(LatencyHistogram::bucketOf(18), 17);
+    CHECK_EQ(LatencyHistogram::bucketOf(31), 23);
+    CHECK_EQ(LatencyHistogram::bucketOf(32), 24);
+
+    // The last regular bucket ends at 2^24 - 1; everything from 2^24 overflows
+    const uint32_t top = (1UL << HISTOGRAM_MAX_BITS) - 1;
+    CHECK_EQ(LatencyHistogram::bucketOf(top), HISTOGRAM_OVERFLOW - 1);
+    CHECK_EQ(LatencyHistogram::bucketTop(HISTOGRAM_OVERFLOW - 1), top);
+    CHECK_EQ(LatencyHistogram::bucketOf(top + 1), HISTOGRAM_OVERFLOW);
+    CHECK_EQ(LatencyHistogram::bucketOf(UINT32_MAX), HISTOGRAM_OVERFLOW);
+    CHECK_EQ(LatencyHistogram::bucketTop(HISTOGRAM_OVERFLOW), UINT32_MAX);
+
+    // Buckets are contiguous: each starts right after the previous one's top
+    int gaps = 0;
+    for (size_t b = 0; b + 1 < HISTOGRAM_OVERFLOW; ++b) {
+        uint32_t t = LatencyHistogram::bucketTop(b);
+        if (LatencyHistogram::bucketOf(t) != b || LatencyHistogram::bucketOf(t + 1) != b + 1) gaps++;
+    }
+    CHECK_EQ(gaps, 0);
+}
+
+// A bucket's top is never more than 12.5% above any value in it
+static void testBucketError() {
+    uint32_t worst = 0;
+    int outside = 0;
+    for (uint64_t v = 1; v < (1UL << HISTOGRAM_MAX_BITS); v += v < 65536 ? 1 : 1 + v / 4096) {
+        uint32_t t = LatencyHistogram::bucketTop(LatencyHistogram::bucketOf((uint32_t)v));
+        if (t < v || (t - v) * 8 > v) outside++;
+        uint32_t permille = (uint32_t)((t - v) * 1000 / v);
+        if (permille > worst) worst = permille;
+    }
+    CHECK_EQ(outside, 0);
+    printf("  largest bucket error %u.%u%%\n", worst / 10, worst % 10);
+}
+
+static uint32_t nearestRank(std::vector<uint32_t> v, uint32_t pct) {
+    std::sort(v.begin(), v.end());
+    size_t r = (pct * v.size() + 99) / 100;
+    return v[r == 0 ? 0 : r - 1];
+}
+
+static bool within(uint32_t reported, uint32_t truth) {
+    return reported >= truth && (uint64_t)(reported - truth) * 8 <= truth;
+}
+
+static void testPercentiles() {
+    LatencyHistogram h;
+    LatencyPercentiles p = h.percentiles();
+    CHECK_EQ(p.samples, 0);
+    CHECK_EQ(h.mean(), 0);
+
+    // Skewed values with a long tail, in a scrambled order
+    std::vector<uint32_t> values;
+    uint32_t seed = 7;
+    for (int i = 0; i < 5000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t r = (seed >> 8) % 1000;
+        uint32_t v = r < 900 ? 200 + r : r < 990 ? 5000 + r * 37 : 400000 + r * 1000;
+        values.push_back(v);
+        h.add(v);
+    }
+    p = h.percentiles();
+    CHECK_EQ(p.samples, 5000);
+    CHECK(within(p.p50, nearestRank(values, 50)));
+    CHECK(within(p.p90, nearestRank(values, 90)));
+    CHECK(within(p.p99, nearestRank(values, 99)));
+    CHECK_EQ(p.max, *std::max_element(values.begin(), values.end()));
+    CHECK(p.p99 <= p.max);
+
+    // Reported values are capped at the largest one seen
+    LatencyHistogram one;
+    one.add(1000);
+    p = one.percentiles();
+    CHECK_EQ(p.p50, 1000);
+    CHECK_EQ(p.p99, 1000);
+    CHECK_EQ(one.mean(), 1000);
+
+    // Past 2^24 us the overflow bucket holds the sample and the maximum reports it
+    LatencyHistogram slow;
+    for (int i = 0; i < 98; ++i) slow.add(100);
+    slow.add(20000000);
+    slow.add(30000000);
+    p = slow.percentiles();
+    CHECK_EQ(p.p50, LatencyHistogram::bucketTop(LatencyHistogram::bucketOf(100)));
+    CHECK_EQ(p.p99, 30000000);
+    CHECK_EQ(p.max, 30000000);
+}
+
+// At HISTOGRAM_DECAY_COUNT samples every bucket is halved and the count follows the buckets
+static void testDecay() {
+    LatencyHistogram h;
+    uint32_t shadow[HISTOGRAM_BUCKETS] = {};
+    uint64_t sum = 0;
+    uint32_t seed = 99;
+    for (uint32_t i = 0; i + 1 < HISTOGRAM_DECAY_COUNT; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t v = (seed >> 8) % 8 == 0 ? 50000 + (seed >> 12) % 1000 : 100 + (seed >> 12) % 50;
+        h.add(v);
+        shadow[LatencyHistogram::bucketOf(v)]++;
+        sum += v;
+    }
+    CHECK_EQ(h.samples(), HISTOGRAM_DECAY_COUNT - 1);
+    LatencyPercentiles before = h.percentiles();
+
+    h.add(120);
+    shadow[LatencyHistogram::bucketOf(120)]++;
+    sum += 120;
+    uint32_t expect = 0;
+    for (size_t b = 0; b < HISTOGRAM_BUCKETS; ++b) expect += shadow[b] / 2;
+    CHECK_EQ(h.samples(), expect);
+    CHECK(h.samples() <= HISTOGRAM_DECAY_COUNT / 2);
+    CHECK_EQ(h.mean(), (sum / 2) / expect);
+
+    // Same shape, so the same buckets; the maximum is kept
+    LatencyPercentiles after = h.percentiles();
+    CHECK_EQ(after.samples, expect);
+    CHECK_EQ(after.p50, before.p50);
+    CHECK_EQ(after.p99, before.p99);
+    CHECK_EQ(after.max, before.max);
+
+    // Recording goes on from the halved counts
+    for (int i = 0; i < 1000; ++i) h.add(120);
+    CHECK_EQ(h.samples(), expect + 1000);
+}
+
+static void testTimer() {
+    PipelineTimer t;
+    t.begin(1000);
+    t.mark(PIPE_READ, 1100);
+    t.mark(PIPE_DECODE, 1150);
+    t.mark(PIPE_PUBLISH, 1400);
+    t.finish(2000);
+    CHECK_EQ(t.stage(PIPE_READ).percentiles().max, 100);
+    CHECK_EQ(t.stage(PIPE_DECODE).percentiles().max, 50);
+    CHECK_EQ(t.stage(PIPE_PUBLISH).percentiles().max, 250);
+    CHECK_EQ(t.stage(PIPE_REPEAT_TX).samples(), 0);
+    CHECK_EQ(t.stage(PIPE_TOTAL).percentiles().max, 1000);
+
+    // Outside a frame stamps are ignored
+    t.mark(PIPE_REPEAT_TX, 5000);
+    t.finish(6000);
+    CHECK_EQ(t.stage(PIPE_REPEAT_TX).samples(), 0);
+    CHECK_EQ(t.stage(PIPE_TOTAL).samples(), 1);
+
+    // A skipped stage: the next stamp covers the gap
+    t.begin(10000);
+    t.mark(PIPE_READ, 10010);
+    t.mark(PIPE_PUBLISH, 10500);
+    t.finish(10500);
+    CHECK_EQ(t.stage(PIPE_DECODE).samples(), 1);
+    CHECK_EQ(t.stage(PIPE_PUBLISH).percentiles().max, 490);
+
+    // A clock that steps back records 0; a huge gap is clamped into the overflow bucket
+    t.begin(20000);
+    t.mark(PIPE_READ, 19000);
+    t.finish(20000 + (int64_t)UINT32_MAX + 5);
+    CHECK_EQ(t.stage(PIPE_READ).percentiles().p50, 10);
+    CHECK_EQ(t.stage(PIPE_TOTAL).percentiles().max, UINT32_MAX);
+
+    // begin() while a frame is open starts over from the new interrupt
+    t.begin(30000);
+    t.begin(40000);
+    t.finish(40200);
+    CHECK_EQ(t.stage(PIPE_TOTAL).samples(), 4);
+}
+
+int main() {
+    testBuckets();
+    testBucketError();
+    testPercentiles();
+    testDecay();
+    testTimer();
+    return testResult("test_pipeline_timing");
+}
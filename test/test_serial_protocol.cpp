@@ -0,0 +1,189 @@
+// Console command protocol (src/serial_protocol.h): line collection with CRLF, overflow and
+// the idle timeout, argument splitting with quotes and escapes, the reply writer's JSON and
+// truncation, and get/set through the key table (secrets masked, read-only keys, ranges,
+// derived topic prefix and client id, a bad pair rejecting the whole set).
+
+#include <string>
+#include "test_support.h"
+#include "serial_protocol.h"
+
+// Feed text and return the completed line, or "<none>"
+static const char* feedLine(HostLineReader& reader, const char* text, uint32_t nowMs = 0) {
+    const char* line = "<none>";
+    for (const char* p = text; *p; ++p) {
+        if (reader.feed(*p, nowMs)) line = reader.overflowed() ? "<overflow>" : reader.line();
+    }
+    return line;
+}
+
+static void testLineReader() {
+    HostLineReader reader;
+    CHECK(!reader.feed('s', 0));
+    CHECK(!reader.active());
+    CHECK_STR(feedLine(reader, "@get lora.frequency\r\n"), "get lora.frequency");
+    CHECK(!reader.active());
+
+    // An empty line is dropped, the next prefix starts over
+    CHECK_STR(feedLine(reader, "@\r\n"), "<none>");
+    CHECK_STR(feedLine(reader, "@help\n"), "help");
+
+    // Characters after the prefix belong to the line, single-key letters included
+    CHECK_STR(feedLine(reader, "@set repeater.nodeName=cdr\n"), "set repeater.nodeName=cdr");
+
+    // Too long: reported once the newline comes, then the reader is usable again
+    std::string longLine = "@set wifi.ssid=" + std::string(HOST_LINE_MAX + 10, 'x') + "\n";
+    CHECK_STR(feedLine(reader, longLine.c_str()), "<overflow>");
+    CHECK_STR(feedLine(reader, "@save\n"), "save");
+
+    // A line whose newline never comes is dropped after the timeout
+    feedLine(reader, "@get", 1000);
+    reader.expire(1000 + HOST_LINE_TIMEOUT_MS);
+    CHECK(reader.active());
+    reader.expire(1001 + HOST_LINE_TIMEOUT_MS);
+    CHECK(!reader.active());
+}
+
+static void testSplitArgs() {
+    char* argv[HOST_MAX_ARGS];
+    char line1[] = "  set  wifi.ssid=\"My Network\"\tlora.frequency=915 ";
+    CHECK_EQ(splitHostArgs(line1, argv, HOST_MAX_ARGS), 3);
+    CHECK_STR(argv[0], "set");
+    CHECK_STR(argv[1], "wifi.ssid=My Network");
+    CHECK_STR(argv[2], "lora.frequency=915");
+
+    char line2[] = "set wifi.password=\"a\\\"b\\\\c d\" x=\"\"";
+    CHECK_EQ(splitHostArgs(line2, argv, HOST_MAX_ARGS), 3);
+    CHECK_STR(argv[1], "wifi.password=a\"b\\c d");
+    CHECK_STR(argv[2], "x=");
+
+    // Backslashes outside quotes, or before other characters, are kept
+    char line3[] = "set a=C:\\x b=\"\\n\"";
+    CHECK_EQ(splitHostArgs(line3, argv, HOST_MAX_ARGS), 3);
+    CHECK_STR(argv[1], "a=C:\\x");
+    CHECK_STR(argv[2], "b=\\n");
+
+    char line4[] = "set mqtt.server=\"unterminated";
+    CHECK_EQ(splitHostArgs(line4, argv, HOST_MAX_ARGS), -1);
+    char line5[] = "a b c d";
+    CHECK_EQ(splitHostArgs(line5, argv, 3), -1);
+    char line6[] = "   ";
+    CHECK_EQ(splitHostArgs(line6, argv, HOST_MAX_ARGS), 0);
+}
+
+static void testReply() {
+    char buffer[HOST_REPLY_MAX];
+    HostReply reply(buffer, sizeof(buffer));
+    reply.open();
+    reply.key("text");
+    reply.string("a\"b\\c\n");
+    reply.key("list");
+    reply.openArray();
+    reply.number(1);
+    reply.boolean(false);
+    reply.raw("2.5");
+    reply.closeArray();
+    reply.key("empty");
+    reply.open();
+    reply.close();
+    reply.close();
+    CHECK(reply.finish());
+    CHECK_STR(reply.text(), "@OK {\"text\":\"a\\\"b\\\\c\\u000a\",\"list\":[1,false,2.5],\"empty\":{}}\n");
+
+    HostReply error(buffer, sizeof(buffer));
+    error.open();
+    error.key("partial");
+    hostError(error, "unknown key", "nope");
+    CHECK(error.finish());
+    CHECK_STR(error.text(), "@ERR {\"error\":\"unknown key\",\"key\":\"nope\"}\n");
+
+    // What does not fit marks the reply truncated instead of cutting the line
+    char small[24];
+    HostReply tight(small, sizeof(small));
+    tight.open();
+    tight.key("key");
+    tight.string("a value that does not fit");
+    tight.close();
+    CHECK(!tight.finish());
+    hostError(tight, "full");
+    CHECK(tight.finish());
+    CHECK_STR(tight.text(), "@ERR {\"error\":\"full\"}\n");
+}
+
+// Run a get or set line against cfg the way the firmware's dispatcher does
+static const char* run(GatewayConfig& cfg, const char* command) {
+    static char buffer[HOST_REPLY_MAX];
+    char line[HOST_LINE_MAX];
+    strncpy(line, command, sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    char* argv[HOST_MAX_ARGS];
+    int argc = splitHostArgs(line, argv, HOST_MAX_ARGS);
+    HostReply reply(buffer, sizeof(buffer));
+    if (!strcmp(argv[0], "get")) {
+        hostGetConfig(reply, cfg, argc, argv);
+    } else {
+        GatewayConfig draft = cfg;
+        if (hostParseSet(reply, draft, argc, argv)) {
+            cfg = draft;
+            reply.open();
+            reply.close();
+        }
+    }
+    if (!reply.finish()) return "<truncated>";
+    buffer[reply.textLength() - 1] = '\0';    // without the newline
+    return buffer;
+}
+
+static void testGetSet() {
+    GatewayConfig cfg = getDefaultConfig();
+    std::string all = run(cfg, "get");
+    CHECK(all.compare(0, 5, "@OK {") == 0);
+    for (size_t i = 0; i < CONFIG_KEY_COUNT; ++i) {
+        CHECK(all.find(std::string("\"") + CONFIG_KEYS[i].name + "\":") != std::string::npos);
+    }
+    CHECK_STR(run(cfg, "get wifi.password"), "@OK {\"wifi.password\":\"\"}");
+
+    CHECK_STR(run(cfg, "set wifi.ssid=\"Trucell Signage\" wifi.password=\"p\\\"w\" lora.frequency=916.575 "
+                       "lora.syncWord=0x34 mqtt.country=au repeater.nodeName=\"My Node\""),
+              "@OK {}");
+    CHECK_STR(cfg.wifi.password, "p\"w");
+    CHECK_STR(run(cfg, "get wifi.ssid wifi.password lora.syncWord mqtt.topicPrefix mqtt.clientId"),
+              "@OK {\"wifi.ssid\":\"Trucell Signage\",\"wifi.password\":\"***\",\"lora.syncWord\":52,"
+              "\"mqtt.topicPrefix\":\"MESHCORE/AU\",\"mqtt.clientId\":\"My_Node\"}");
+    CHECK(cfg.lora.frequency > 916.57f && cfg.lora.frequency < 916.58f);
+
+    CHECK_STR(run(cfg, "set mqtt.interestTopics=raw,adverts mqtt.tlsProfile=ecdsa mqtt.tlsMaxFragment=1024 "
+                       "clock.timezoneMinutes=-300"),
+              "@OK {}");
+    CHECK_STR(run(cfg, "get mqtt.interestTopics mqtt.tlsProfile mqtt.tlsMaxFragment clock.timezoneMinutes"),
+              "@OK {\"mqtt.interestTopics\":\"raw,adverts\",\"mqtt.tlsProfile\":\"ecdsa\","
+              "\"mqtt.tlsMaxFragment\":1024,\"clock.timezoneMinutes\":-300}");
+
+    // One bad pair rejects the whole set
+    GatewayConfig before = cfg;
+    CHECK_STR(run(cfg, "set lora.frequency=915 lora.spreadingFactor=13"),
+              "@ERR {\"error\":\"out of range\",\"key\":\"lora.spreadingFactor\"}");
+    CHECK(memcmp(&before, &cfg, sizeof(cfg)) == 0);
+
+    CHECK_STR(run(cfg, "set mqtt.topicPrefix=x"), "@ERR {\"error\":\"read-only\",\"key\":\"mqtt.topicPrefix\"}");
+    CHECK_STR(run(cfg, "set mqtt.interestTopics=raw,bogus"),
+              "@ERR {\"error\":\"unknown topic class\",\"key\":\"mqtt.interestTopics\"}");
+    CHECK(!strncmp(run(cfg, "set mqtt.tlsMaxFragment=1000"), "@ERR ", 5));
+    CHECK(!strncmp(run(cfg, "set lora.txPower=abc"), "@ERR ", 5));
+    CHECK_STR(run(cfg, "set nope=1"), "@ERR {\"error\":\"unknown key\",\"key\":\"nope\"}");
+    CHECK_STR(run(cfg, "set wifi.ssid"), "@ERR {\"error\":\"expected key=value\",\"key\":\"wifi.ssid\"}");
+    CHECK_STR(run(cfg, "set"), "@ERR {\"error\":\"usage: set key=value ...\"}");
+    CHECK_STR(run(cfg, "get lora.frequency nope"), "@ERR {\"error\":\"unknown key\",\"key\":\"nope\"}");
+    CHECK(memcmp(&before, &cfg, sizeof(cfg)) == 0);
+
+    // A value longer than its field is refused rather than cut
+    std::string tooLong = "set wifi.ssid=" + std::string(sizeof(cfg.wifi.ssid), 'x');
+    CHECK(!strncmp(run(cfg, tooLong.c_str()), "@ERR ", 5));
+}
+
+int main() {
+    testLineReader();
+    testSplitArgs();
+    testReply();
+    testGetSet();
+    return testResult("test_serial_protocol");
+}
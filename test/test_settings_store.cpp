@@ -0,0 +1,309 @@
+// Settings storage (src/config_store.h, src/settings_manager.h) against an in-memory NVS:
+// blob round trip with a single read, unchanged saves writing nothing, corrupt and too-new
+// blobs ignored, the v1 -> v2 migration moving the CA to the certificate store, and the
+// old key-per-field layout read once and converted. Prints the NVS calls and host time of
+// a blob load against a per-key load.
+
+#include <chrono>
+#include "test_support.h"
+#include "settings_manager.h"
+#include "ca_cert.h"
+
+static GatewayConfig sampleConfig() {
+    GatewayConfig c = getDefaultConfig();
+    strcpy(c.wifi.ssid, "meshlab");
+    strcpy(c.wifi.password, "hunter22");
+    c.wifi.enabled = true;
+    strcpy(c.mqtt.server, "broker.example");
+    c.mqtt.port = 8883;
+    c.mqtt.useTLS = true;
+    strcpy(c.mqtt.basePrefix, "meshcore");
+    strcpy(c.mqtt.country, "de");
+    strcpy(c.mqtt.region, "by");
+    c.lora.frequency = 869.525f;
+    c.lora.spreadingFactor = 11;
+    strcpy(c.repeater.nodeName, "Roof Node 1");
+    c.access.denyCount = 2;
+    c.access.denylist[0] = 0xDEADBEEF;
+    c.access.denylist[1] = 0x01020304;
+    c.location.latitude = 48.137f;
+    c.clock.timezoneMinutes = 60;
+    deriveTopicPrefix(c.mqtt, c.mqtt.topicPrefix, sizeof(c.mqtt.topicPrefix));
+    deriveClientIdFromNodeName(c.repeater.nodeName, c.mqtt.clientId, sizeof(c.mqtt.clientId));
+    return c;
+}
+
+static void checkSample(const GatewayConfig& c) {
+    CHECK_EQ(c.magic, CONFIG_MAGIC);
+    CHECK_STR(c.wifi.ssid, "meshlab");
+    CHECK_STR(c.wifi.password, "hunter22");
+    CHECK(c.wifi.enabled);
+    CHECK_STR(c.mqtt.server, "broker.example");
+    CHECK_EQ(c.mqtt.port, 8883);
+    CHECK(c.mqtt.useTLS);
+    CHECK_STR(c.mqtt.topicPrefix, "MESHCORE/DE/BY");
+    CHECK_STR(c.mqtt.clientId, "Roof_Node_1");
+    CHECK(c.lora.frequency == 869.525f);
+    CHECK_EQ(c.lora.spreadingFactor, 11);
+    CHECK_STR(c.repeater.nodeName, "Roof Node 1");
+    CHECK_EQ(c.access.denyCount, 2);
+    CHECK_EQ(c.access.denylist[0], 0xDEADBEEF);
+    CHECK_EQ(c.access.denylist[1], 0x01020304);
+    CHECK(c.location.latitude == 48.137f);
+    CHECK_EQ(c.clock.timezoneMinutes, 60);
+}
+
+static std::vector<uint8_t>& storedBlob() { return hostNvs().namespaces[CONFIG_NAMESPACE][CONFIG_BLOB_KEY]; }
+
+static void testCrc() {
+    CHECK_EQ(configCrc32((const uint8_t*)"123456789", 9), 0xCBF43926u);
+    CHECK_EQ(configCrc32(nullptr, 0), 0u);
+    // Chunked and one-shot agree
+    CHECK_EQ(configCrc32((const uint8_t*)"6789", 4, configCrc32((const uint8_t*)"12345", 5)), 0xCBF43926u);
+}
+
+static void testRoundTrip() {
+    hostNvs().reset();
+    static GatewayConfig saved;
+    saved = sampleConfig();
+    {
+        SettingsManager settings;
+        CHECK(settings.saveConfig(saved));
+        CHECK_EQ(settings.getSaveStats().writes, 1);
+    }
+    CHECK_EQ(hostNvs().writes, 1);
+    CHECK_EQ(storedBlob().size(), sizeof(ConfigRecord));
+
+    // A fresh boot reads it back with one length lookup and one getBytes
+    static GatewayConfig loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    SettingsManager settings;
+    hostNvs().reads = 0;
+    CHECK(settings.loadConfig(loaded));
+    CHECK_EQ(hostNvs().reads, 2);
+    CHECK_EQ(settings.getLoadStats().source, CONFIG_SOURCE_BLOB);
+    CHECK_EQ(settings.getLoadStats().version, CONFIG_BLOB_VERSION);
+    checkSample(loaded);
+
+    // Saving what was loaded writes nothing; a real change writes once
+    hostNvs().writes = 0;
+    CHECK(settings.saveConfig(loaded));
+    CHECK_EQ(hostNvs().writes, 0);
+    CHECK_EQ(settings.getSaveStats().unchanged, 1);
+    loaded.lora.txPower = 7;
+    CHECK(settings.saveConfig(loaded));
+    CHECK_EQ(hostNvs().writes, 1);
+    CHECK(settings.saveConfig(loaded));
+    CHECK_EQ(hostNvs().writes, 1);
+}
+
+static void testRejectedBlobs() {
+    hostNvs().reset();
+    static GatewayConfig c;
+    c = sampleConfig();
+    SettingsManager().saveConfig(c);
+
+    // One flipped payload bit fails the CRC; with no per-key settings behind it nothing loads
+    storedBlob()[sizeof(ConfigBlobHeader) + 40] ^= 0x10;
+    static GatewayConfig out;
+    SettingsManager settings;
+    Serial.take();
+    CHECK(!settings.loadConfig(out));
+    CHECK_EQ(settings.getLoadStats().source, CONFIG_SOURCE_NONE);
+    CHECK(Serial.take().find("rejected (corrupt)") != std::string::npos);
+
+    // A blob from newer firmware is left alone, not misread
+    static ConfigRecord r;
+    memset(&r, 0, sizeof(r));
+    r.config = c;
+    sealConfigRecord(r);
+    r.header.version = CONFIG_BLOB_VERSION + 1;
+    Preferences prefs;
+    prefs.begin(CONFIG_NAMESPACE, false);
+    prefs.putBytes(CONFIG_BLOB_KEY, &r, sizeof(r));
+    prefs.end();
+    CHECK(!SettingsManager().loadConfig(out));
+    CHECK(Serial.take().find("rejected (unsupported version)") != std::string::npos);
+
+    // Truncated, oversized and wrong-magic blobs
+    static uint8_t buf[sizeof(ConfigRecord) + 64];
+    uint16_t version = 0;
+    ConfigMigrationContext ctx = { nullptr, 0 };
+    sealConfigRecord(r);
+    memcpy(buf, &r, sizeof(r));
+    CHECK_EQ(openConfigBlob(buf, sizeof(r), sizeof(buf), out, version, ctx), CONFIG_BLOB_OK);
+    CHECK_EQ(openConfigBlob(buf, sizeof(r) - 1, sizeof(buf), out, version, ctx), CONFIG_BLOB_CORRUPT);
+    CHECK_EQ(openConfigBlob(buf, 4, sizeof(buf), out, version, ctx), CONFIG_BLOB_CORRUPT);
+    CHECK_EQ(openConfigBlob(buf, sizeof(r), sizeof(r) - 1, out, version, ctx), CONFIG_BLOB_CORRUPT);
+    buf[0] ^= 1;
+    CHECK_EQ(openConfigBlob(buf, sizeof(r), sizeof(buf), out, version, ctx), CONFIG_BLOB_CORRUPT);
+}
+
+// A v1 blob: MQTTConfig still ended in the 2048-byte CA certificate
+static size_t buildV1Blob(const GatewayConfig& c, const char* caPem, uint8_t* out) {
+    size_t at = offsetof(GatewayConfig, mqtt) + sizeof(MQTTConfig);
+    size_t length = sizeof(GatewayConfig) + CONFIG_V1_CA_BYTES;
+    uint8_t* payload = out + sizeof(ConfigBlobHeader);
+    memcpy(payload, &c, at);
+    memset(payload + at, 0, CONFIG_V1_CA_BYTES);
+    strncpy((char*)payload + at, caPem, CONFIG_V1_CA_BYTES - 1);
+    memcpy(payload + at + CONFIG_V1_CA_BYTES, (const uint8_t*)&c + at, sizeof(GatewayConfig) - at);
+    ConfigBlobHeader h = { CONFIG_MAGIC, 1, sizeof(ConfigBlobHeader), (uint32_t)length, configCrc32(payload, length) };
+    memcpy(out, &h, sizeof(h));
+    return sizeof(h) + length;
+}
+
+static void testMigrationV1() {
+    hostNvs().reset();
+    static GatewayConfig c;
+    c = sampleConfig();
+    static uint8_t blob[sizeof(ConfigRecord) + CONFIG_V1_CA_BYTES];
+    size_t length = buildV1Blob(c, MQTT_CA_CERT, blob);
+    Preferences prefs;
+    prefs.begin(CONFIG_NAMESPACE, false);
+    prefs.putBytes(CONFIG_BLOB_KEY, blob, length);
+    prefs.end();
+
+    static GatewayConfig out;
+    SettingsManager settings;
+    CHECK(settings.loadConfig(out));
+    CHECK_EQ(settings.getLoadStats().source, CONFIG_SOURCE_BLOB);
+    CHECK_EQ(settings.getLoadStats().version, 1);
+    checkSample(out);
+    // Rewritten in the current layout, and the CA now lives in the certificate store as DER
+    CHECK_EQ(storedBlob().size(), sizeof(ConfigRecord));
+    ConfigBlobHeader h;
+    memcpy(&h, storedBlob().data(), sizeof(h));
+    CHECK_EQ(h.version, CONFIG_BLOB_VERSION);
+    CertStore certs;
+    CHECK(certs.has(CERT_SLOT_PRIMARY));
+    static uint8_t der[CERT_MAX_BYTES];
+    CHECK_EQ(certs.size(CERT_SLOT_PRIMARY), pemToDer(MQTT_CA_CERT, der, sizeof(der)));
+
+    // Next boot: plain blob, no migration
+    SettingsManager again;
+    CHECK(again.loadConfig(out));
+    CHECK_EQ(again.getLoadStats().version, CONFIG_BLOB_VERSION);
+
+    // No migration registered from version 0
+    buildV1Blob(c, "", blob);
+    ConfigBlobHeader old;
+    memcpy(&old, blob, sizeof(old));
+    old.version = 0;
+    memcpy(blob, &old, sizeof(old));
+    uint16_t version = 0;
+    ConfigMigrationContext ctx = { nullptr, 0 };
+    CHECK_EQ(openConfigBlob(blob, length, sizeof(blob), out, version, ctx), CONFIG_BLOB_UNSUPPORTED);
+}
+
+// The layout older firmware wrote: one key per field, with the topic prefix in mqtt_pfx
+static void writeLegacyKeys() {
+    Preferences prefs;
+    prefs.begin(CONFIG_NAMESPACE, false);
+    prefs.putUInt("magic", CONFIG_MAGIC);
+    prefs.putString("wifi_ssid", "meshlab");
+    prefs.putString("wifi_pass", "hunter22");
+    prefs.putBool("wifi_en", true);
+    prefs.putString("mqtt_srv", "broker.example");
+    prefs.putUShort("mqtt_port", 8883);
+    prefs.putBool("mqtt_tls", true);
+    prefs.putString("mqtt_pfx", "meshcore/de/by");
+    prefs.putFloat("lora_freq", 869.525f);
+    prefs.putUChar("lora_sf", 11);
+    prefs.putString("rep_name", "Roof Node 1");
+    prefs.putUChar("ac_deny_cnt", 2);
+    prefs.putUInt("ac_dn_00", 0xDEADBEEF);
+    prefs.putUInt("ac_dn_01", 0x01020304);
+    prefs.putFloat("loc_lat", 48.137f);
+    prefs.putShort("clk_tz", 60);
+    prefs.end();
+}
+
+static void testLegacyConversion() {
+    hostNvs().reset();
+    writeLegacyKeys();
+    size_t legacyKeys = hostNvs().namespaces[CONFIG_NAMESPACE].size();
+
+    static GatewayConfig out;
+    memset(&out, 0, sizeof(out));
+    SettingsManager settings;
+    hostNvs().reads = hostNvs().writes = 0;
+    CHECK(settings.loadConfig(out));
+    CHECK_EQ(settings.getLoadStats().source, CONFIG_SOURCE_LEGACY);
+    CHECK(hostNvs().reads > 60);
+    checkSample(out);
+    CHECK_STR(out.mqtt.basePrefix, "meshcore");
+    CHECK_STR(out.mqtt.country, "de");
+    CHECK_STR(out.mqtt.region, "by");
+    CHECK_EQ(out.lora.syncWord, 0x12);        // absent keys take their defaults
+
+    // Converted with one write; the old keys stay for older firmware
+    CHECK_EQ(hostNvs().writes, 1);
+    CHECK_EQ(storedBlob().size(), sizeof(ConfigRecord));
+    CHECK_EQ(hostNvs().namespaces[CONFIG_NAMESPACE].size(), legacyKeys + 1);
+
+    SettingsManager next;
+    hostNvs().reads = 0;
+    CHECK(next.loadConfig(out));
+    CHECK_EQ(next.getLoadStats().source, CONFIG_SOURCE_BLOB);
+    CHECK_EQ(hostNvs().reads, 2);
+    checkSample(out);
+
+    // Legacy prefixes with fewer segments
+    const char* prefixes[][4] = {
+        { "meshcore", "meshcore", "", "" },
+        { "meshcore/nl", "meshcore", "nl", "" },
+    };
+    for (auto& p : prefixes) {
+        hostNvs().reset();
+        writeLegacyKeys();
+        Preferences prefs;
+        prefs.begin(CONFIG_NAMESPACE, false);
+        prefs.putString("mqtt_pfx", p[0]);
+        prefs.end();
+        CHECK(SettingsManager().loadConfig(out));
+        CHECK_STR(out.mqtt.basePrefix, p[1]);
+        CHECK_STR(out.mqtt.country, p[2]);
+        CHECK_STR(out.mqtt.region, p[3]);
+    }
+}
+
+// Per-load NVS calls and host time, blob against per-key
+static void reportLoadCost() {
+    const int rounds = 2000;
+    static GatewayConfig out;
+    double us[2];
+    uint32_t reads[2];
+    for (int mode = 0; mode < 2; ++mode) {
+        hostNvs().reset();
+        writeLegacyKeys();
+        if (mode == 0) {
+            SettingsManager().loadConfig(out);      // converts, so a blob is stored from here on
+        }
+        std::map<std::string, std::vector<uint8_t>> keys = hostNvs().namespaces[CONFIG_NAMESPACE];
+        hostNvs().reads = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            hostNvs().namespaces[CONFIG_NAMESPACE] = keys;  // undo the conversion of the per-key load
+            SettingsManager settings;
+            settings.loadConfig(out);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        us[mode] = std::chrono::duration<double, std::micro>(t1 - t0).count() / rounds;
+        reads[mode] = hostNvs().reads / rounds;
+    }
+    Serial.take();
+    printf("  settings load: blob %u NVS reads, %.1f us; per-key %u NVS reads, %.1f us (host, incl. conversion write)\n",
+           (unsigned)reads[0], us[0], (unsigned)reads[1], us[1]);
+    CHECK(reads[0] < reads[1]);
+}
+
+int main() {
+    testCrc();
+    testRoundTrip();
+    testRejectedBlobs();
+    testMigrationV1();
+    testLegacyConversion();
+    reportLoadCost();
+    return testResult("test_settings_store");
+}
@@ -0,0 +1,190 @@
+// Sniffer stream encoder (src/sniffer.h): CRC-16 check value, COBS against known encodings
+// and a round trip over payloads full of zeros, 0xFF and long zero-free runs, and the RX/TX
+// and INFO record layouts read back after decoding, with sequence numbers, drop counts and
+// the worst-case frame size.
+
+#include <stdlib.h>
+#include <vector>
+#include "test_support.h"
+#include "sniffer.h"
+
+// Reference decoder, the same steps as cobs_decode() in sniffer_capture.py. frame is
+// without its delimiter; false if malformed.
+static bool cobsDecode(const uint8_t* frame, size_t length, std::vector<uint8_t>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < length) {
+        uint8_t code = frame[i];
+        if (code == 0 || i + code > length) return false;
+        out.insert(out.end(), frame + i + 1, frame + i + code);
+        i += code;
+        if (code < 0xFF && i < length) out.push_back(0);
+    }
+    return true;
+}
+
+// Encode, check the framing, decode; the decoded bytes equal the input
+static bool roundTrip(const std::vector<uint8_t>& in) {
+    std::vector<uint8_t> encoded(in.size() + in.size() / 254 + 2);
+    size_t n = cobsEncode(in.data(), in.size(), encoded.data());
+    if (n > encoded.size() || encoded[n - 1] != 0) return false;
+    if (memchr(encoded.data(), 0, n - 1)) return false;
+    std::vector<uint8_t> decoded;
+    return cobsDecode(encoded.data(), n - 1, decoded) && decoded == in;
+}
+
+static void testCrc() {
+    CHECK_EQ(snifferCrc16((const uint8_t*)"123456789", 9), 0x29B1);
+    CHECK_EQ(snifferCrc16(nullptr, 0), 0xFFFF);
+}
+
+static void testCobsVectors() {
+    uint8_t out[16];
+    size_t n;
+    static const uint8_t in1[] = {0x00};
+    static const uint8_t out1[] = {0x01, 0x01, 0x00};
+    n = cobsEncode(in1, sizeof(in1), out);
+    CHECK_BYTES(out, n, out1);
+    static const uint8_t in2[] = {0x00, 0x00};
+    static const uint8_t out2[] = {0x01, 0x01, 0x01, 0x00};
+    n = cobsEncode(in2, sizeof(in2), out);
+    CHECK_BYTES(out, n, out2);
+    static const uint8_t in3[] = {0x11, 0x22, 0x00, 0x33};
+    static const uint8_t out3[] = {0x03, 0x11, 0x22, 0x02, 0x33, 0x00};
+    n = cobsEncode(in3, sizeof(in3), out);
+    CHECK_BYTES(out, n, out3);
+    static const uint8_t in4[] = {0x11, 0x22, 0x33, 0x44};
+    static const uint8_t out4[] = {0x05, 0x11, 0x22, 0x33, 0x44, 0x00};
+    n = cobsEncode(in4, sizeof(in4), out);
+    CHECK_BYTES(out, n, out4);
+    static const uint8_t in5[] = {0x11, 0x00, 0x00, 0x00};
+    static const uint8_t out5[] = {0x02, 0x11, 0x01, 0x01, 0x01, 0x00};
+    n = cobsEncode(in5, sizeof(in5), out);
+    CHECK_BYTES(out, n, out5);
+    static const uint8_t out6[] = {0x01, 0x00};
+    n = cobsEncode(nullptr, 0, out);
+    CHECK_BYTES(out, n, out6);
+
+    // 254 non-zero bytes fill a block; a zero right after starts the next one
+    uint8_t run[255];
+    for (int i = 0; i < 254; ++i) run[i] = (uint8_t)(i + 1);
+    run[254] = 0;
+    uint8_t encoded[260];
+    n = cobsEncode(run, 255, encoded);
+    CHECK_EQ(n, 258);
+    CHECK_EQ(encoded[0], 0xFF);
+    CHECK_EQ(encoded[255], 0x01);
+    CHECK_EQ(encoded[256], 0x01);
+    CHECK_EQ(encoded[257], 0x00);
+}
+
+static void testCobsRoundTrip() {
+    srand(1);
+    int failed = 0;
+    for (size_t length = 0; length <= 600; ++length) {
+        std::vector<uint8_t> zeros(length, 0), full(length, 0xFF), random(length), counting(length);
+        for (size_t i = 0; i < length; ++i) {
+            int k = rand() % 4;
+            random[i] = k == 0 ? 0 : k == 1 ? 0xFF : (uint8_t)rand();
+            counting[i] = (uint8_t)(1 + i % 254);
+        }
+        failed += !roundTrip(zeros) + !roundTrip(full) + !roundTrip(random) + !roundTrip(counting);
+    }
+    CHECK_EQ(failed, 0);
+}
+
+// Decode one frame from Sniffer (leading and trailing delimiter) and check its CRC
+static bool readRecord(const uint8_t* frame, size_t n, std::vector<uint8_t>& record) {
+    if (n < 3 || frame[0] != 0 || frame[n - 1] != 0 || memchr(frame + 1, 0, n - 2)) return false;
+    if (!cobsDecode(frame + 1, n - 2, record) || record.size() < SNIFFER_HEADER_BYTES + 2) return false;
+    uint16_t crc = (uint16_t)(record[record.size() - 2] | record[record.size() - 1] << 8);
+    record.resize(record.size() - 2);
+    return crc == snifferCrc16(record.data(), record.size());
+}
+
+static uint32_t get16(const std::vector<uint8_t>& r, size_t at) { return (uint32_t)(r[at] | r[at + 1] << 8); }
+static uint32_t get32(const std::vector<uint8_t>& r, size_t at) { return get16(r, at) | get16(r, at + 2) << 16; }
+
+static void testPacketRecords() {
+    Sniffer sniffer;
+    sniffer.start();
+    uint8_t frame[SNIFFER_FRAME_MAX];
+    std::vector<uint8_t> record;
+
+    uint8_t payload[] = {0x00, 0x11, 0x00, 0x00, 0xFF};
+    size_t n = sniffer.packet(SNIFFER_RX, SNIFFER_FLAG_CRC_ERROR, 0x123456789AULL, -97, -7.3f, payload,
+                              sizeof(payload), frame);
+    CHECK(readRecord(frame, n, record));
+    CHECK_EQ(record.size(), SNIFFER_HEADER_BYTES + 6 + sizeof(payload));
+    CHECK_EQ(record[0], SNIFFER_RX);
+    CHECK_EQ(record[1], SNIFFER_FLAG_CRC_ERROR);
+    CHECK_EQ(get16(record, 2), 0);
+    CHECK_EQ(get32(record, 4), 0x3456789Au);
+    CHECK_EQ(get32(record, 8), 0x12u);
+    CHECK_EQ((int16_t)get16(record, 12), -97);
+    CHECK_EQ((int16_t)get16(record, 14), -29);     // -7.3 dB in 0.25 dB steps, rounded
+    CHECK_EQ(get16(record, 16), sizeof(payload));
+    CHECK(memcmp(record.data() + 18, payload, sizeof(payload)) == 0);
+
+    // Sequence numbers count every record, written or not
+    n = sniffer.packet(SNIFFER_TX, 0, 1, 0, 0.0f, payload, 0, frame);
+    CHECK(readRecord(frame, n, record));
+    CHECK_EQ(get16(record, 2), 1);
+    CHECK_EQ(get16(record, 16), 0);
+
+    // The largest record, with no zeros to shorten COBS blocks, fits the frame buffer; longer
+    // payloads are cut to SNIFFER_PAYLOAD_MAX
+    uint8_t big[300];
+    memset(big, 0xA5, sizeof(big));
+    n = sniffer.packet(SNIFFER_RX, 0, 0x0101010101010101ULL, -1, 1.0f, big, sizeof(big), frame);
+    CHECK(n <= SNIFFER_FRAME_MAX);
+    CHECK(readRecord(frame, n, record));
+    CHECK_EQ(get16(record, 16), SNIFFER_PAYLOAD_MAX);
+    CHECK_EQ(record.size(), SNIFFER_RECORD_MAX - 2);
+}
+
+static void testInfoRecord() {
+    Sniffer sniffer;
+    sniffer.start();
+    uint8_t frame[SNIFFER_FRAME_MAX];
+    std::vector<uint8_t> record;
+    SnifferRadioInfo radio = {915800000, 250000, 11, 5, 0x12, -4, 0xDEADBEEF};
+
+    sniffer.noteDropped();
+    sniffer.noteDropped();
+    size_t n = sniffer.info(radio, 1000, 1700000000000000LL, frame);
+    CHECK(readRecord(frame, n, record));
+    CHECK_EQ(record.size(), SNIFFER_HEADER_BYTES + 28);
+    CHECK_EQ(record[0], SNIFFER_INFO);
+    CHECK_EQ(record[1], SNIFFER_FLAG_CLOCK_SET);
+    CHECK_EQ(get32(record, 12), 915800000u);
+    CHECK_EQ(get32(record, 16), 250000u);
+    CHECK_EQ(record[20], 11);
+    CHECK_EQ(record[21], 5);
+    CHECK_EQ(record[22], 0x12);
+    CHECK_EQ((int8_t)record[23], -4);
+    CHECK_EQ(get32(record, 24) | (uint64_t)get32(record, 28) << 32, 1700000000000000ULL);
+    CHECK_EQ(get32(record, 32), 0xDEADBEEFu);
+    CHECK_EQ(get32(record, 36), 2u);
+
+    n = sniffer.info(radio, 2000, 0, frame);
+    CHECK(readRecord(frame, n, record));
+    CHECK_EQ(record[1], 0);
+
+    // Due after start, on a new configuration, and on the interval
+    CHECK(sniffer.infoDue(0, 1));
+    CHECK(!sniffer.infoDue(SNIFFER_INFO_INTERVAL_MS - 1, 1));
+    CHECK(sniffer.infoDue(SNIFFER_INFO_INTERVAL_MS - 1, 2));
+    CHECK(sniffer.infoDue(2 * SNIFFER_INFO_INTERVAL_MS - 1, 2));
+    sniffer.start();
+    CHECK(sniffer.infoDue(2 * SNIFFER_INFO_INTERVAL_MS, 2));
+}
+
+int main() {
+    testCrc();
+    testCobsVectors();
+    testCobsRoundTrip();
+    testPacketRecords();
+    testInfoRecord();
+    return testResult("test_sniffer");
+}
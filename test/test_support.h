@@ -0,0 +1,77 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+// Minimal check macros for the host tests: a failed check is reported with its location and
+// the test carries on, so one run lists every failure. main() ends with testResult().
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TEST_SKIP 77    // ctest SKIP_RETURN_CODE, see CMakeLists.txt
+
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline int& testChecks() {
+    static int checks = 0;
+    return checks;
+}
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        testChecks()++;                                                             \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            testFailures()++;                                                       \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                              \
+    do {                                                                            \
+        testChecks()++;                                                             \
+        long long va_ = (long long)(a), vb_ = (long long)(b);                      \
+        if (va_ != vb_) {                                                           \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",      \
+                    __FILE__, __LINE__, #a, #b, va_, vb_);                          \
+            testFailures()++;                                                       \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_STR(a, b)                                                             \
+    do {                                                                            \
+        testChecks()++;                                                             \
+        const char* sa_ = (a);                                                      \
+        const char* sb_ = (b);                                                      \
+        if (strcmp(sa_, sb_) != 0) {                                                \
+            fprintf(stderr, "%s:%d: CHECK_STR(%s, %s) failed: \"%s\" != \"%s\"\n", \
+                    __FILE__, __LINE__, #a, #b, sa_, sb_);                          \
+            testFailures()++;                                                       \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_BYTES(data, length, expected)                                         \
+    do {                                                                            \
+        testChecks()++;                                                             \
+        if ((length) != sizeof(expected) || memcmp((data), (expected), sizeof(expected)) != 0) { \
+            fprintf(stderr, "%s:%d: CHECK_BYTES(%s) failed\n  got     ", __FILE__, __LINE__, #data); \
+            for (size_t i_ = 0; i_ < (size_t)(length); ++i_) fprintf(stderr, "%02x", ((const uint8_t*)(data))[i_]); \
+            fprintf(stderr, "\n  expected ");                                       \
+            for (size_t i_ = 0; i_ < sizeof(expected); ++i_) fprintf(stderr, "%02x", (expected)[i_]); \
+            fprintf(stderr, "\n");                                                  \
+            testFailures()++;                                                       \
+        }                                                                           \
+    } while (0)
+
+inline int testResult(const char* name) {
+    if (testFailures()) {
+        fprintf(stderr, "%s: %d of %d checks failed\n", name, testFailures(), testChecks());
+        return 1;
+    }
+    printf("%s: %d checks passed\n", name, testChecks());
+    return 0;
+}
+
+#endif // TEST_SUPPORT_H
@@ -0,0 +1,193 @@
+// Inbound topic router (src/topic_router.h): '+' and '#' semantics, literal over '+' over '#'
+// whatever the registration order, "a/#" also matching "a", backtracking out of a literal
+// branch that dead-ends, duplicate and malformed patterns, and the fixed node, text and route
+// tables filling up without disturbing the routes already held.
+
+#include <string>
+#include "test_support.h"
+#include "topic_router.h"
+
+static uint8_t lastTag;
+static std::string lastTail;
+static std::string lastPayload;
+
+static void record(const TopicMatch& m, uint8_t* payload, size_t length) {
+    lastTag = m.tag;
+    lastTail = m.tail;
+    lastPayload.assign((const char*)payload, length);
+}
+
+// Tag of the route topic dispatches to, or 0 when nothing matches
+static int route(TopicRouter& r, const char* topic) {
+    uint8_t payload[] = "x";
+    lastTag = 0;
+    lastTail = "-";
+    return r.dispatch(topic, payload, 1) ? lastTag : 0;
+}
+
+static const char* tail() { return lastTail.c_str(); }
+
+static void testWildcards() {
+    TopicRouter r;
+    CHECK(r.add("MESHCORE/+/commands/send", 1, record));
+    CHECK(r.add("MESHCORE/AU/bridge/#", 2, record));
+    CHECK(r.add("status/#", 3, record));
+
+    CHECK_EQ(route(r, "MESHCORE/AU/commands/send"), 1);
+    CHECK_EQ(route(r, "MESHCORE/NZ/commands/send"), 1);
+    CHECK_STR(tail(), "");
+    CHECK_EQ(route(r, "MESHCORE//commands/send"), 1);     // '+' matches an empty level
+    CHECK_EQ(route(r, "MESHCORE/AU/NSW/commands/send"), 0); // but only one level
+    CHECK_EQ(route(r, "MESHCORE/AU/commands"), 0);
+    CHECK_EQ(route(r, "MESHCORE/AU/commands/send/x"), 0);
+
+    CHECK_EQ(route(r, "MESHCORE/AU/bridge/raw"), 2);
+    CHECK_STR(tail(), "raw");
+    CHECK_EQ(route(r, "MESHCORE/AU/bridge/NSW/raw"), 2);
+    CHECK_STR(tail(), "NSW/raw");
+    CHECK_EQ(route(r, "MESHCORE/NZ/bridge/raw"), 0);
+
+    // "a/#" also matches "a" itself, with nothing in the tail
+    CHECK_EQ(route(r, "status"), 3);
+    CHECK_STR(tail(), "");
+    CHECK_EQ(route(r, "status/"), 3);
+    CHECK_EQ(route(r, "statusx"), 0);
+
+    // A lone '#' takes everything nothing else claims
+    CHECK(r.add("#", 4, record));
+    CHECK_EQ(route(r, "anything/at/all"), 4);
+    CHECK_STR(tail(), "anything/at/all");
+    CHECK_EQ(route(r, "MESHCORE/AU/commands/send"), 1);
+
+    // The payload reaches the handler as given
+    uint8_t payload[] = "{\"n\":1}";
+    CHECK(r.dispatch("MESHCORE/AU/commands/send", payload, sizeof(payload) - 1));
+    CHECK_STR(lastPayload.c_str(), "{\"n\":1}");
+}
+
+static void testPrecedence() {
+    // Registered least specific first: the order of add() does not matter
+    TopicRouter r;
+    CHECK(r.add("a/#", 3, record));
+    CHECK(r.add("a/+", 2, record));
+    CHECK(r.add("a/b", 1, record));
+    CHECK_EQ(route(r, "a/b"), 1);
+    CHECK_EQ(route(r, "a/c"), 2);
+    CHECK_EQ(route(r, "a/b/c"), 3);
+    CHECK_STR(tail(), "b/c");
+    CHECK_EQ(route(r, "a"), 3);
+
+    // Precedence is level by level: a literal first level wins even if a later level is a
+    // wildcard on that branch
+    TopicRouter levels;
+    CHECK(levels.add("+/b", 1, record));
+    CHECK(levels.add("a/#", 2, record));
+    CHECK_EQ(route(levels, "a/b"), 2);
+    CHECK_EQ(route(levels, "z/b"), 1);
+
+    // A literal branch that dead-ends falls back to '+', then '#'
+    TopicRouter back;
+    CHECK(back.add("a/b/c", 1, record));
+    CHECK(back.add("a/+/d", 2, record));
+    CHECK(back.add("a/#", 3, record));
+    CHECK_EQ(route(back, "a/b/c"), 1);
+    CHECK_EQ(route(back, "a/b/d"), 2);
+    CHECK_EQ(route(back, "a/b/e"), 3);
+    CHECK_STR(tail(), "b/e");
+}
+
+static void testPatterns() {
+    TopicRouter r;
+    CHECK(r.add("a/b", 1, record));
+    CHECK(!r.add("a/b", 2, record));            // duplicate: the first registration stays
+    CHECK_EQ(r.routeTotal(), 1);
+    CHECK_EQ(route(r, "a/b"), 1);
+    CHECK(r.add("a/+", 2, record));             // same shape, different wildcard: distinct
+    CHECK(!r.add("a/+", 3, record));
+    CHECK(r.add("a/#", 3, record));
+    CHECK(!r.add("a/#", 4, record));
+    CHECK_EQ(r.routeTotal(), 3);
+
+    CHECK(!r.add("a/#/b", 5, record));          // '#' only as the last level
+    CHECK(!r.add("", 5, record));
+    CHECK(!r.add(nullptr, 5, record));
+    CHECK_EQ(r.routeTotal(), 3);
+
+    // Counters: hits per tag, misses overall; a route without a handler still counts
+    TopicRouter c;
+    CHECK(c.add("x/+", 7, nullptr));
+    CHECK(c.add("y/+", 7, nullptr));
+    CHECK(c.add("z", 8, nullptr));
+    uint8_t payload[] = "";
+    CHECK(c.dispatch("x/1", payload, 0));
+    CHECK(c.dispatch("y/1", payload, 0));
+    CHECK(c.dispatch("y/2", payload, 0));
+    CHECK(!c.dispatch("w", payload, 0));
+    CHECK_EQ(c.hitsForTag(7), 3);
+    CHECK_EQ(c.hitsForTag(8), 0);
+    CHECK_EQ(c.unmatchedCount(), 1);
+
+    c.clear();
+    CHECK_EQ(c.routeTotal(), 0);
+    CHECK_EQ(c.unmatchedCount(), 0);
+    CHECK(!c.dispatch("x/1", payload, 0));
+    CHECK(c.add("x/+", 7, nullptr));
+}
+
+static void testFullTables() {
+    char pattern[300];
+
+    // Nodes: three per route; 42 routes leave one free node next to the root
+    TopicRouter nodes;
+    int added = 0;
+    for (int i = 0; i < 64; ++i) {
+        snprintf(pattern, sizeof(pattern), "a%d/b/c", i);
+        if (!nodes.add(pattern, (uint8_t)(i + 1), record)) break;
+        added++;
+    }
+    CHECK_EQ(added, (TOPIC_ROUTER_MAX_NODES - 1) / 3);
+    CHECK(nodes.add("a0/b/d", 100, record));     // one more node fits exactly
+    CHECK(!nodes.add("a0/b/e", 101, record));
+    CHECK(!nodes.add("a0/+", 101, record));
+    CHECK(nodes.add("a0/b", 102, record));       // existing nodes only
+    CHECK_EQ(route(nodes, "a0/b/c"), 1);
+    CHECK_EQ(route(nodes, "a41/b/c"), 42);
+    CHECK_EQ(route(nodes, "a0/b/d"), 100);
+    CHECK_EQ(route(nodes, "a0/b"), 102);
+    CHECK_EQ(route(nodes, "a0/b/e"), 0);
+
+    // Literal text: 200-byte levels, three fit in the shared buffer
+    TopicRouter text;
+    std::string level(200, 'x');
+    for (int i = 0; i < 3; ++i) {
+        level[0] = (char)('a' + i);
+        CHECK(text.add(level.c_str(), (uint8_t)(i + 1), record));
+    }
+    level[0] = 'd';
+    CHECK(!text.add(level.c_str(), 4, record));
+    CHECK(text.add("+", 5, record));            // wildcards take no text
+    level[0] = 'b';
+    CHECK_EQ(route(text, level.c_str()), 2);
+    level[0] = 'd';
+    CHECK_EQ(route(text, level.c_str()), 5);
+    std::string tooLong(256, 'y');              // a level is at most 255 bytes
+    CHECK(!TopicRouter().add(tooLong.c_str(), 1, record));
+
+    // Routes
+    TopicRouter routes;
+    for (int i = 0; i < TOPIC_ROUTER_MAX_ROUTES; ++i) {
+        snprintf(pattern, sizeof(pattern), "r/%d", i);
+        CHECK(routes.add(pattern, (uint8_t)i, record));
+    }
+    CHECK(!routes.add("r/+", 200, record));
+    CHECK_EQ(routes.routeTotal(), TOPIC_ROUTER_MAX_ROUTES);
+    CHECK_EQ(route(routes, "r/63"), 63);
+}
+
+int main() {
+    testWildcards();
+    testPrecedence();
+    testPatterns();
+    testFullTables();
+    return testResult("test_topic_router");
+}